@@ -125,11 +125,12 @@ public:
 };
 
 IPlugChunks::IPlugChunks(IPlugInstanceInfo instanceInfo)
-  : IPLUG_CTOR(kNumParams, kNumPrograms, instanceInfo), mGain(1.)
+  : IPLUG_CTOR(kNumParams, kNumPrograms, instanceInfo), mGain(1.), mStepsChanged(0)
 {
   TRACE;
   
   memset(mSteps, 0, NUM_SLIDERS*sizeof(double));
+  memset(mStateSteps, 0, NUM_SLIDERS*sizeof(double));
 
   // Define parameter ranges, display units, labels.
   //arguments are: name, defaultVal, minVal, maxVal, step, label
@@ -165,8 +166,6 @@ IPlugChunks::~IPlugChunks() {}
 
 void IPlugChunks::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
   double* in1 = inputs[0];
   double* in2 = inputs[1];
   double* out1 = outputs[0];
@@ -178,6 +177,15 @@ void IPlugChunks::ProcessDoubleReplacing(double** inputs, double** outputs, int
   int count = mCount;
   int prevcount = mPrevCount;
 
+  // pick up restored or edited steps, if the GUI or host is writing them try again next block
+  int changed = wdl_atomic_get(&mStepsChanged);
+  if (changed && mStepsMutex.TryEnter())
+  {
+    memcpy(mSteps, mStateSteps, NUM_SLIDERS*sizeof(double));
+    wdl_atomic_add(&mStepsChanged, -changed);
+    mStepsMutex.Leave();
+  }
+
   for (int s = 0; s < nFrames; ++s, ++in1, ++in2, ++out1, ++out2)
   {
     int mod = (samplePos + s) % (samplesPerBeat * BEAT_DIV);
@@ -211,7 +219,6 @@ void IPlugChunks::ProcessDoubleReplacing(double** inputs, double** outputs, int
 void IPlugChunks::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   mCount = 0;
   mPrevCount = ULONG_MAX;
@@ -221,13 +228,16 @@ void IPlugChunks::OnParamChange(int paramIdx)
 {
   TRACE;
 
-  IMutexLock lock(this);
 
   switch (paramIdx)
   {
-    case kDummyParamForMultislider:
-      mMSlider->GetLatestChange(mSteps);
+    case kDummyParamForMultislider: // called by the multislider on the GUI thread
+    {
+      WDL_MutexLock lock(&mStepsMutex);
+      mMSlider->GetLatestChange(mStateSteps);
+      wdl_atomic_incr(&mStepsChanged);
       break;
+    }
     case kGain:
       mGain = GetParam(kGain)->DBToAmp();
       break;
@@ -244,9 +254,10 @@ bool IPlugChunks::SerializeState(ByteChunk* pChunk)
   double v;
 
   // serialize the multi-slider state state before serializing the regular params
+  WDL_MutexLock stepsLock(&mStepsMutex);
   for (int i = 0; i< NUM_SLIDERS; i++)
   {
-    v = mSteps[i];
+    v = mStateSteps[i];
     pChunk->Put(&v);
   }
 
@@ -260,17 +271,20 @@ int IPlugChunks::UnserializeState(ByteChunk* pChunk, int startPos)
   IMutexLock lock(this);
   double v = 0.0;
 
-  // unserialize the multi-slider state before unserializing the regular params
+  // unserialize the multi-slider state before unserializing the regular params,
+  // the audio thread picks it up at the start of the next block
+  WDL_MutexLock stepsLock(&mStepsMutex);
   for (int i = 0; i< NUM_SLIDERS; i++)
   {
     v = 0.0;
     startPos = pChunk->Get(&v, startPos);
-    mSteps[i] = v;
+    mStateSteps[i] = v;
   }
+  wdl_atomic_incr(&mStepsChanged);
 
   // update values in control, will set dirty
   if(mMSlider)
-    mMSlider->SetState(mSteps);
+    mMSlider->SetState(mStateSteps);
 
   return IPlugBase::UnserializeParams(pChunk, startPos); // must remember to call UnserializeParams at the end
 }
@@ -280,7 +294,10 @@ bool IPlugChunks::CompareState(const unsigned char* incomingState, int startPos)
   bool isEqual = true;
   const double* data = (const double*) incomingState;
   startPos = NUM_SLIDERS * sizeof(double);
-  isEqual = (memcmp(data, mSteps, startPos) == 0);
+  {
+    WDL_MutexLock lock(&mStepsMutex);
+    isEqual = (memcmp(data, mStateSteps, startPos) == 0);
+  }
   isEqual &= IPlugBase::CompareState(incomingState, startPos); // fuzzy compare regular params
   
   return isEqual;
@@ -290,9 +307,10 @@ void IPlugChunks::PresetsChangedByHost()
 {
   TRACE;
   IMutexLock lock(this);
+  WDL_MutexLock stepsLock(&mStepsMutex);
 
   if(mMSlider)
-    mMSlider->SetState(mSteps);
+    mMSlider->SetState(mStateSteps);
 
   if(GetGUI())
     GetGUI()->SetAllControlsDirty();
@@ -15,8 +15,8 @@
 
  You need to override SerializeState / UnserializeState and set PLUG_DOES_STATE_CHUNKS 1 in resource.h
 
- // WARNING - I'm not happy with how the multislider data is shared with the high priority thread
- // need to rethink that
+ The multislider data is edited in mStateSteps (GUI / host state), under mStepsMutex, and copied to
+ mSteps at the start of a block. The audio thread only try-locks, so it never waits for the GUI or host.
  
 */
 
@@ -44,7 +44,11 @@ public:
 
 private:
 
-  double mSteps[NUM_SLIDERS];
+  double mSteps[NUM_SLIDERS];       // audio thread
+
+  WDL_Mutex mStepsMutex;
+  double mStateSteps[NUM_SLIDERS];  // GUI and host state
+  int mStepsChanged;                // changes to mStateSteps not yet copied to mSteps
 
   double mGain;
   unsigned long mCount, mPrevCount;
@@ -144,8 +144,6 @@ IPlugControls::~IPlugControls() {}
 
 void IPlugControls::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
   double* in1 = inputs[0];
   double* in2 = inputs[1];
   double* out1 = outputs[0];
@@ -160,8 +158,6 @@ void IPlugControls::ProcessDoubleReplacing(double** inputs, double** outputs, in
 
 void IPlugControls::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   if (paramIdx == kIInvisibleSwitchControl)
   {
     if (GetGUI())
@@ -77,8 +77,6 @@ IPlugConvoEngine::~IPlugConvoEngine()
 
 void IPlugConvoEngine::OnParamChange(int paramIdx)
 {
-	IMutexLock lock(this);
-
 	switch (paramIdx)
 	{
 		case kDry:
@@ -169,7 +167,7 @@ void IPlugConvoEngine::Resample(const I* src, int src_len, double src_srate, O*
 
 void IPlugConvoEngine::Reset()
 {
-	TRACE; IMutexLock lock(this);
+	TRACE;
 
 	// Detect a change in sample rate.
 	if (GetSampleRate() != mSampleRate)
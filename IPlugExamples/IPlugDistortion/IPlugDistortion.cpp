@@ -65,8 +65,6 @@ IPlugDistortion::IPlugDistortion(IPlugInstanceInfo instanceInfo):
 
 void IPlugDistortion::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kDrive:
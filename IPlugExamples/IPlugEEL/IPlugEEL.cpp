@@ -76,8 +76,6 @@ IPlugEEL::~IPlugEEL()
 
 void IPlugEEL::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
   double* in1 = inputs[0];
   double* in2 = inputs[1];
   double* out1 = outputs[0];
@@ -94,15 +92,12 @@ void IPlugEEL::ProcessDoubleReplacing(double** inputs, double** outputs, int nFr
 void IPlugEEL::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   //double sr = GetSampleRate();
 }
 
 void IPlugEEL::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kGain:
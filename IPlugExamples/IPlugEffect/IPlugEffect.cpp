@@ -47,8 +47,6 @@ IPlugEffect::~IPlugEffect() {}
 
 void IPlugEffect::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
   double* in1 = inputs[0];
   double* in2 = inputs[1];
   double* out1 = outputs[0];
@@ -64,13 +62,10 @@ void IPlugEffect::ProcessDoubleReplacing(double** inputs, double** outputs, int
 void IPlugEffect::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 }
 
 void IPlugEffect::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kGain:
@@ -51,8 +51,6 @@ void IPlugGUIResize::CreateControls(IGraphics* pGraphics, int size)
 
 void IPlugGUIResize::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
   double* in1 = inputs[0];
   double* in2 = inputs[1];
   double* out1 = outputs[0];
@@ -68,15 +66,12 @@ void IPlugGUIResize::ProcessDoubleReplacing(double** inputs, double** outputs, i
 void IPlugGUIResize::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   //double sr = GetSampleRate();
 }
 
 void IPlugGUIResize::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
 //  switch (paramIdx)
 //  {
 //    case kGain:
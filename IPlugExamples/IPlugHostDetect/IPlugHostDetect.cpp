@@ -48,14 +48,12 @@ void IPlugHostDetect::ProcessDoubleReplacing(double** inputs, double** outputs,
 void IPlugHostDetect::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   //double sr = GetSampleRate();
 }
 
 void IPlugHostDetect::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
 }
 
 void IPlugHostDetect::OnHostIdentified()
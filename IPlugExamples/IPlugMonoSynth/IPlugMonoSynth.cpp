@@ -31,7 +31,6 @@ IPlugMonoSynth::IPlugMonoSynth(IPlugInstanceInfo instanceInfo)
     mSampleRate(44100.),
     mFreq(440.),
     mNumKeys(0),
-    mKey(-1),
     mPrevL(0.0),
     mPrevR(0.0)
 
@@ -63,6 +62,7 @@ IPlugMonoSynth::IPlugMonoSynth(IPlugInstanceInfo instanceInfo)
   int coords[12] = { 0, 7, 12, 20, 24, 36, 43, 48, 56, 60, 69, 72 };
   mKeyboard = new IKeyboardControl(this, kKeybX, kKeybY, 48, 5, &regular, &sharp, coords);
 
+  ((IKeyboardControl*)mKeyboard)->SetMidiQueue(&mMidiQueue);
   pGraphics->AttachControl(mKeyboard);
 
   IBitmap about = pGraphics->LoadIBitmap(ABOUTBOX_ID, ABOUTBOX_FN);
@@ -78,7 +78,6 @@ IPlugMonoSynth::~IPlugMonoSynth() {}
 
 void IPlugMonoSynth::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
 //  double* in1 = inputs[0];
 //  double* in2 = inputs[1];
   double* out1 = outputs[0];
@@ -87,34 +86,13 @@ void IPlugMonoSynth::ProcessDoubleReplacing(double** inputs, double** outputs, i
 
   GetTime(&mTimeInfo);
 
-  IKeyboardControl* pKeyboard = (IKeyboardControl*) mKeyboard;
-
-  if (pKeyboard->GetKey() != mKey)
-  {
-    IMidiMsg msg;
-
-    if (mKey >= 0)
-    {
-      msg.MakeNoteOffMsg(mKey + 48, 0, 0);
-      mMidiQueue.Add(&msg);
-    }
-
-    mKey = pKeyboard->GetKey();
-
-    if (mKey >= 0)
-    {
-      msg.MakeNoteOnMsg(mKey + 48, pKeyboard->GetVelocity(), 0, 0);
-      mMidiQueue.Add(&msg);
-    }
-  }
+  mMidiQueue.BeginBlock(nFrames);
 
   for (int offset = 0; offset < nFrames; ++offset, /*++in1, ++in2,*/ ++out1, ++out2)
   {
-    while (!mMidiQueue.Empty())
+    IMidiMsg* pMsg;
+    while ((pMsg = mMidiQueue.Next(offset)))
     {
-      IMidiMsg* pMsg = mMidiQueue.Peek();
-      if (pMsg->mOffset > offset) break;
-
       // TODO: make this work on win sa
 #if !defined(OS_WIN) && !defined(SA_API)
       SendMidiMsg(pMsg);
@@ -146,8 +124,6 @@ void IPlugMonoSynth::ProcessDoubleReplacing(double** inputs, double** outputs, i
           break;
         }
       }
-
-      mMidiQueue.Remove();
     }
 
     *out1 = sin( 2. * M_PI * mFreq * mPhase / mSampleRate ) * mGainLSmoother.Process(mGainL * mNoteGain);
@@ -173,13 +149,12 @@ void IPlugMonoSynth::ProcessDoubleReplacing(double** inputs, double** outputs, i
     GetGUI()->SetControlFromPlug(mMeterIdx_R, peakR);
   }
 
-  mMidiQueue.Flush(nFrames);
+  mMidiQueue.EndBlock(nFrames);
 }
 
 void IPlugMonoSynth::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   mPhase = 0;
   mNoteGain = 0.;
@@ -189,8 +164,6 @@ void IPlugMonoSynth::Reset()
 
 void IPlugMonoSynth::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kGainL:
@@ -38,14 +38,13 @@ private:
   IControl* mKeyboard;
   int mMeterIdx_L, mMeterIdx_R;
 
-  IMidiQueue mMidiQueue;
+  IMidiBlockQueue mMidiQueue;
 
   int mNumKeys; // how many keys are being played (via midi)
   bool mKeyStatus[128]; // array of on/off for each key
 
   int mPhase;
   int mNote;
-  int mKey;
 
   double mGainL, mGainR;
   double mSampleRate;
@@ -64,7 +64,6 @@ IPlugMouseTest::~IPlugMouseTest()
 
 void IPlugMouseTest::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
   double* out1 = outputs[0];
   double* out2 = outputs[1];
 
@@ -78,7 +77,6 @@ void IPlugMouseTest::ProcessDoubleReplacing(double** inputs, double** outputs, i
 void IPlugMouseTest::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   mSampleRate = GetSampleRate();
   mOsc1_ctx.mPhaseIncr = (1./mSampleRate) * midi2CPS(GetParam(kPitchA)->Value());
@@ -88,8 +86,6 @@ void IPlugMouseTest::Reset()
 
 void IPlugMouseTest::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kPitchA:
@@ -33,8 +33,6 @@ IPlugMultiChannel::~IPlugMultiChannel() {}
 
 void IPlugMultiChannel::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
 //  bool in1ic = IsInChannelConnected(0);
 //  bool in2ic = IsInChannelConnected(1);
 //  bool in3ic = IsInChannelConnected(2);
@@ -64,13 +62,10 @@ void IPlugMultiChannel::ProcessDoubleReplacing(double** inputs, double** outputs
 void IPlugMultiChannel::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 }
 
 void IPlugMultiChannel::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kGain:
@@ -97,7 +97,6 @@ IPlugMultiTargets::~IPlugMultiTargets() {}
 #ifdef OS_IOS
 void IPlugMultiTargets::ProcessSingleReplacing(float** inputs, float** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
   float* in1 = inputs[0];
   float* in2 = inputs[1];
   float* out1 = outputs[0];
@@ -112,7 +111,6 @@ void IPlugMultiTargets::ProcessSingleReplacing(float** inputs, float** outputs,
 #else
 void IPlugMultiTargets::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
   double* in1 = inputs[0];
   double* in2 = inputs[1];
   double* out1 = outputs[0];
@@ -214,7 +212,6 @@ void IPlugMultiTargets::ProcessDoubleReplacing(double** inputs, double** outputs
 void IPlugMultiTargets::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   mPhase = 0;
   mNoteGain = 0.;
@@ -224,8 +221,6 @@ void IPlugMultiTargets::Reset()
 
 void IPlugMultiTargets::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kGainL:
@@ -44,8 +44,6 @@ IPlugOpenGL::~IPlugOpenGL() {}
 
 void IPlugOpenGL::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
   double* in1 = inputs[0];
   double* in2 = inputs[1];
   double* out1 = outputs[0];
@@ -65,15 +63,12 @@ void IPlugOpenGL::ProcessDoubleReplacing(double** inputs, double** outputs, int
 void IPlugOpenGL::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   //double sr = GetSampleRate();
 }
 
 void IPlugOpenGL::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kGain:
@@ -45,8 +45,6 @@ IPlugPlush::~IPlugPlush() {}
 
 void IPlugPlush::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
   double* in1 = inputs[0];
   double* in2 = inputs[1];
   double* out1 = outputs[0];
@@ -66,15 +64,12 @@ void IPlugPlush::ProcessDoubleReplacing(double** inputs, double** outputs, int n
 void IPlugPlush::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   //double sr = GetSampleRate();
 }
 
 void IPlugPlush::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kGain:
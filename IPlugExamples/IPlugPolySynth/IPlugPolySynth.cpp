@@ -9,11 +9,6 @@
 const int kNumPrograms = 8;
 
 #define PITCH 440.
-#define TABLE_SIZE 512
-
-#ifndef M_PI
-#define M_PI 3.14159265
-#endif
 
 #define GAIN_FACTOR 0.2;
 
@@ -28,24 +23,17 @@ enum EParams
 
 IPlugPolySynth::IPlugPolySynth(IPlugInstanceInfo instanceInfo)
   : IPLUG_CTOR(kNumParams, kNumPrograms, instanceInfo),
+    mMidiQueue(MAX_MIDI_EVENTS),
     mSampleRate(44100.),
     mNumHeldKeys(0),
-    mKey(-1),
-    mActiveVoices(0)
+    mVoices(MAX_VOICES),
+    mVoiceAllocator(&mVoices, MAX_VOICES)
 
 {
   TRACE;
 
-  mTable = new double[TABLE_SIZE];
-
-  for (int i = 0; i < TABLE_SIZE; i++)
-  {
-    mTable[i] = sin( i/double(TABLE_SIZE) * 2. * M_PI);
-    //printf("mTable[%i] %f\n", i, mTable[i]);
-  }
-
-  mOsc = new CWTOsc(mTable, TABLE_SIZE);
-  mEnv = new CADSREnvL();
+  mWavetable = IWavetableLibrary::Acquire(IWavetableLibrary::kSine);
+  mVoices.setWavetable(mWavetable);
 
   memset(mKeyStatus, 0, 128 * sizeof(bool));
 
@@ -68,6 +56,7 @@ IPlugPolySynth::IPlugPolySynth(IPlugInstanceInfo instanceInfo)
   mKeyboard = new IKeyboardControl(this, kKeybX, kKeybY, 48, 5, &regular, &sharp, coords);
 
   pGraphics->AttachControl(mKeyboard);
+  ((IKeyboardControl*)mKeyboard)->SetMidiQueue(&mMidiQueue);
 
   IBitmap about = pGraphics->LoadIBitmap(ABOUTBOX_ID, ABOUTBOX_FN);
   mAboutBox = new IBitmapOverlayControl(this, 100, 100, &about, IRECT(540, 250, 680, 290));
@@ -80,190 +69,66 @@ IPlugPolySynth::IPlugPolySynth(IPlugInstanceInfo instanceInfo)
 
 IPlugPolySynth::~IPlugPolySynth()
 {
-  delete mOsc;
-  delete mEnv;
-  delete [] mTable;
+  IWavetableLibrary::Release(mWavetable);
 }
 
-int IPlugPolySynth::FindFreeVoice()
+void IPlugPolySynth::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  int v;
+  double* out1 = outputs[0];
+  double* out2 = outputs[1];
 
-  for(v = 0; v < MAX_VOICES; v++)
-  {
-    if(!mVS[v].GetBusy())
-      return v;
-  }
+  mMidiQueue.BeginBlock(nFrames);
 
-  int quietestVoice = 0;
-  double level = 2.;
+  // render the voices in runs between MIDI events
+  int nEvents = mMidiQueue.NEvents();
+  int i = 0, pos = 0;
 
-  for(v = 0; v < MAX_VOICES; v++)
+  while (pos < nFrames)
   {
-    double summed = mVS[v].mEnv_ctx.mPrev;
-
-    if (summed < level)
+    for (; i < nEvents && mMidiQueue.Get(i)->mOffset <= pos; ++i)
     {
-      level = summed;
-      quietestVoice = v;
+      mVoiceAllocator.ProcessMidiMsg(mMidiQueue.Get(i));
     }
 
+    int end = i < nEvents ? IPMIN(mMidiQueue.Get(i)->mOffset, nFrames) : nFrames;
+    mVoices.Render(out1 + pos, end - pos, mVoiceAllocator.NActiveVoices());
+    mVoiceAllocator.Update();
+    pos = end;
   }
 
-  DBGMSG("stealing voice %i\n", quietestVoice);
-  return quietestVoice;
-}
-
-void IPlugPolySynth::NoteOnOff(IMidiMsg* pMsg)
-{
-  int v;
-
-  int status = pMsg->StatusMsg();
-  int velocity = pMsg->Velocity();
-  int note = pMsg->NoteNumber();
-
-  if (status == IMidiMsg::kNoteOn && velocity) // Note on
-  {
-    v = FindFreeVoice(); // or quietest
-    mVS[v].mKey = note;
-    mVS[v].mOsc_ctx.mPhaseIncr = (1./mSampleRate) * midi2CPS(note);
-    mVS[v].mEnv_ctx.mLevel = (double) velocity / 127.;
-    mVS[v].mEnv_ctx.mStage = kStageAttack;
-
-    mActiveVoices++;
-  }
-  else  // Note off
+  for (int s = 0; s < nFrames; ++s)
   {
-    for (v = 0; v < MAX_VOICES; v++)
-    {
-      if (mVS[v].mKey == note)
-      {
-        if (mVS[v].GetBusy())
-        {
-          mVS[v].mKey = -1;
-          mVS[v].mEnv_ctx.mStage = kStageRelease;
-          mVS[v].mEnv_ctx.mReleaseLevel = mVS[v].mEnv_ctx.mPrev;
-
-          return;
-        }
-      }
-    }
+    out1[s] *= GAIN_FACTOR;
+    out2[s] = out1[s];
   }
 
-}
-
-void IPlugPolySynth::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
-{
-  // Mutex is already locked for us
-  IKeyboardControl* pKeyboard = (IKeyboardControl*) mKeyboard;
-
-  if (pKeyboard->GetKey() != mKey)
-  {
-    IMidiMsg msg;
-
-    if (mKey >= 0)
-    {
-      msg.MakeNoteOffMsg(mKey + 48, 0, 0);
-      mMidiQueue.Add(&msg);
-    }
-
-    mKey = pKeyboard->GetKey();
-
-    if (mKey >= 0)
-    {
-      msg.MakeNoteOnMsg(mKey + 48, pKeyboard->GetVelocity(), 0, 0);
-      mMidiQueue.Add(&msg);
-    }
-  }
-
-  if (mActiveVoices > 0 || !mMidiQueue.Empty()) // block not empty
-  {
-    double* out1 = outputs[0];
-    double* out2 = outputs[1];
-
-    double output;
-    CVoiceState* vs;
-
-    for (int s = 0; s < nFrames; ++s)
-    {
-      while (!mMidiQueue.Empty())
-      {
-        IMidiMsg* pMsg = mMidiQueue.Peek();
-
-        if (pMsg->mOffset > s) break;
-
-        int status = pMsg->StatusMsg(); // get the MIDI status byte
-
-        switch (status)
-        {
-          case IMidiMsg::kNoteOn:
-          case IMidiMsg::kNoteOff:
-          {
-            NoteOnOff(pMsg);
-            break;
-          }
-          case IMidiMsg::kPitchWheel:
-          {
-            //TODO
-            break;
-          }
-        }
-
-        mMidiQueue.Remove();
-      }
-
-      output = 0.;
-
-      for(int v = 0; v < MAX_VOICES; v++) // for each vs
-      {
-        vs = &mVS[v];
-
-        if (vs->GetBusy())
-        {
-          output += mOsc->process(&vs->mOsc_ctx) * mEnv->process(&vs->mEnv_ctx);
-        }
-      }
-
-      output *= GAIN_FACTOR;
-
-      *out1++ = output;
-      *out2++ = output;
-    }
-
-    mMidiQueue.Flush(nFrames);
-  }
-//  else // empty block
-//  {
-//  }
+  mMidiQueue.EndBlock(nFrames);
 }
 
 void IPlugPolySynth::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   mSampleRate = GetSampleRate();
-  mMidiQueue.Resize(GetBlockSize());
-  mEnv->setSampleRate(mSampleRate);
+  mVoices.setSampleRate(mSampleRate);
+  mVoiceAllocator.Reset();
 }
 
 void IPlugPolySynth::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kAttack:
-      mEnv->setStageTime(kStageAttack, GetParam(kAttack)->Value());
+      mVoices.setStageTime(kStageAttack, GetParam(kAttack)->Value());
       break;
     case kDecay:
-      mEnv->setStageTime(kStageDecay, GetParam(kDecay)->Value());
+      mVoices.setStageTime(kStageDecay, GetParam(kDecay)->Value());
       break;
     case kSustain:
-      mEnv->setSustainLevel( GetParam(kSustain)->Value() );
+      mVoices.setSustainLevel( GetParam(kSustain)->Value() );
       break;
     case kRelease:
-      mEnv->setStageTime(kStageRelease, GetParam(kRelease)->Value());
+      mVoices.setStageTime(kStageRelease, GetParam(kRelease)->Value());
       break;
     default:
       break;
@@ -291,8 +156,10 @@ void IPlugPolySynth::ProcessMidiMsg(IMidiMsg* pMsg)
         mNumHeldKeys -= 1;
       }
       break;
+    case IMidiMsg::kControlChange:
+      break; // sustain pedal, all notes off
     default:
-      return; // if !note message, nothing gets added to the queue
+      return; // nothing else gets added to the queue
   }
   
 
@@ -3,9 +3,11 @@
 
 #include "IPlug_include_in_plug_hdr.h"
 #include "IMidiQueue.h"
+#include "IVoiceAllocator.h"
 #include "IPlugPolySynthDSP.h"
 
 #define MAX_VOICES 16
+#define MAX_MIDI_EVENTS 1024 // per block, independent of the block size
 #define ATTACK_DEFAULT 5.
 #define DECAY_DEFAULT 20.
 #define RELEASE_DEFAULT 500.
@@ -28,29 +30,22 @@ public:
   int GetNumKeys();
   bool GetKeyStatus(int key);
   void ProcessMidiMsg(IMidiMsg* pMsg);
-  void NoteOnOff(IMidiMsg* pMsg);
 
 private:
 
-  void NoteOnOffPoly(IMidiMsg* pMsg);
-  int FindFreeVoice();
-
   IBitmapOverlayControl* mAboutBox;
   IControl* mKeyboard;
 
-  IMidiQueue mMidiQueue;
+  IMidiBlockQueue mMidiQueue;
 
-  int mActiveVoices;
-  int mKey;
   int mNumHeldKeys;
   bool mKeyStatus[128]; // array of on/off for each key
 
   double mSampleRate;
 
-  CVoiceState mVS[MAX_VOICES];
-  CWTOsc* mOsc;
-  CADSREnvL* mEnv;
-  double* mTable;
+  CPolyVoices mVoices;
+  IVoiceAllocator mVoiceAllocator;
+  const IWavetable* mWavetable;
 };
 
 enum ELayout
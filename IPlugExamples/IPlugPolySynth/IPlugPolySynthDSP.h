@@ -2,6 +2,13 @@
 #ifndef __IPLUGPOLYSYNTHDSP__
 #define __IPLUGPOLYSYNTHDSP__
 
+#include "IVoiceAllocator.h"
+#include "IWavetable.h"
+
+#ifdef IPLUG_SSE2
+  #include <emmintrin.h>
+#endif
+
 const double ENV_VALUE_LOW = 0.000001; // -120dB
 const double ENV_VALUE_HIGH = 0.999;
 const double MIN_ENV_TIME_MS = 0.5;
@@ -46,220 +53,303 @@ inline double calcIncrFromTimeLinear(double timeMS, double sr)
   else return (1./sr) / (timeMS/1000.);
 }
 
-struct CWTOscState
+enum EADSREnvStage
 {
-  double mPhase;        // float phase (goes between 0. and 1.)
-  double mPhaseIncr;    // freq * mPhaseStep
-
-  CWTOscState()
-  {
-    mPhase = 0.;
-    mPhaseIncr = 0.;
-  }
-
-} WDL_FIXALIGN;
+  kIdle = 0,
+  kStageAttack,
+  kStageDecay,
+  kStageSustain,
+  kStageRelease,
+};
 
-class CWTOsc
+// State of all voices as structure-of-arrays, managed by an IVoiceAllocator that keeps the
+// sounding voices in slots [0, nActive). Render() runs a band-limited wavetable oscillator
+// (see IWavetable.h) and a linear ADSR envelope for two voices at a time with SSE2.
+// The envelope of a voice is value * scale + offset, with value ramping by incr until it
+// crosses ENV_VALUE_HIGH (attack) or ENV_VALUE_LOW (decay, release).
+class CPolyVoices : public IVoiceBank
 {
 protected:
-  const double* mLUT;           // pointer to waveform lookup table, const because the oscilator doesn't change the table data
-  unsigned long int mLUTSize;   // wavetable size
-  unsigned long int mLUTSizeM;  // wavetable Mask (size -1)
-  double mLUTSizeF;             // float version
+  int mNumVoices; // rounded up to even, the padding voice stays idle
+  WDL_TypedBuf<double> mPhase, mPhaseIncr;
+  WDL_TypedBuf<double> mEnvValue, mEnvIncr, mEnvScale, mEnvOffset, mEnvOut, mLevel;
+  WDL_TypedBuf<int> mStage;
+  WDL_TypedBuf<const double*> mTable; // per voice, the mip-map level for its pitch
+  WDL_TypedBuf<double> mOsc; // scratch, one sample per voice
 
-public:
+  const IWavetable* mWavetable;
+
+  double mAttackMS, mDecayMS, mReleaseMS;
+  double mAttackIncr, mDecayIncr, mReleaseIncr;
+  double mSustainLevel;
+  double mSampleRate;
 
-  CWTOsc(const double* LUT, unsigned long int LUTSize)
+public:
+  CPolyVoices(int maxVoices)
+  : mNumVoices((maxVoices + 1) & ~1)
+  , mWavetable(0)
+  , mAttackMS(1.), mDecayMS(100.), mReleaseMS(20.)
+  , mSustainLevel(1.)
+  , mSampleRate(44100.)
   {
-    setLUT(LUT, LUTSize);
+    WDL_TypedBuf<double>* bufs[] = { &mPhase, &mPhaseIncr, &mEnvValue, &mEnvIncr, &mEnvScale, &mEnvOffset, &mEnvOut, &mLevel };
+    for (int i = 0; i < (int) (sizeof(bufs) / sizeof(bufs[0])); ++i)
+    {
+      memset(bufs[i]->Resize(mNumVoices), 0, mNumVoices * sizeof(double));
+    }
+    memset(mStage.Resize(mNumVoices), 0, mNumVoices * sizeof(int));
+    memset(mTable.Resize(mNumVoices), 0, mNumVoices * sizeof(const double*));
+    mOsc.Resize(mNumVoices);
+    calcIncrs();
   }
 
-  ~CWTOsc() {}
+  ~CPolyVoices() {}
 
-  void setLUT(const double* LUT, unsigned long int LUTSize)
+  // Not while rendering. The wavetable is not owned.
+  void setWavetable(const IWavetable* pWavetable)
   {
-    mLUTSize = LUTSize;
-    mLUTSizeM = LUTSize-1;
-    mLUTSizeF = (double) LUTSize;
-    mLUT = LUT;
+    mWavetable = pWavetable;
+    for (int v = 0; v < mNumVoices; ++v)
+    {
+      mTable.Get()[v] = mWavetable->GetTableForIncr(mPhaseIncr.Get()[v]);
+    }
+  }
+
+  void setStageTime(int stage, double timeMS)
+  {
+    switch(stage)
+    {
+      case kStageAttack: mAttackMS = timeMS; break;
+      case kStageDecay: mDecayMS = timeMS; break;
+      case kStageRelease: mReleaseMS = timeMS; break;
+      default: return;
+    }
+    calcIncrs();
   }
 
-  inline double process(CWTOscState* pState)
+  void setSustainLevel(double sustainLevel)
   {
-    pState->mPhase = wrap(pState->mPhase, 0., 1.);
-    const double output = lerp(pState->mPhase * mLUTSizeF, mLUT, mLUTSizeM);
-    pState->mPhase += pState->mPhaseIncr;
+    mSustainLevel = sustainLevel;
+    for (int v = 0; v < mNumVoices; ++v)
+    {
+      if (mStage.Get()[v] == kStageDecay || mStage.Get()[v] == kStageSustain)
+      {
+        updateStage(v);
+      }
+    }
+  }
 
-    return output;
+  void setSampleRate(double sr)
+  {
+    mSampleRate = sr;
+    calcIncrs();
   }
 
-} WDL_FIXALIGN;
+  // IVoiceBank
+  void StartVoice(int v, int note, int velocity, bool legato)
+  {
+    mPhaseIncr.Get()[v] = (1./mSampleRate) * midi2CPS(note);
+    if (mWavetable) mTable.Get()[v] = mWavetable->GetTableForIncr(mPhaseIncr.Get()[v]);
 
-enum EADSREnvStage
-{
-  kIdle = 0,
-  kStageAttack,
-  kStageDecay,
-  kStageSustain,
-  kStageRelease,
-};
+    if (!legato)
+    {
+      double level = (double) velocity / 127.;
+      mLevel.Get()[v] = level;
+      // a stolen or retriggered voice attacks from where it is, no click
+      mEnvValue.Get()[v] = level > 0. ? IPMIN(mEnvOut.Get()[v] / level, 1.) : 0.;
+      setStage(v, kStageAttack);
+    }
+  }
 
-struct CADSREnvLState
-{
-  double mEnvValue;          // current value of the envelope
-  int mStage;                // idle, attack, decay, sustain, release
-  double mLevel;             // envelope depth
-  double mPrev;
-  double mReleaseLevel;
+  void ReleaseVoice(int v) { setStage(v, kStageRelease); }
 
-  CADSREnvLState()
+  void StopVoice(int v)
   {
-    mEnvValue = 0.;
-    mStage = kIdle;
-    mLevel = 0.;
-    mReleaseLevel = 0.;
-    mPrev = 0.;
+    setStage(v, kIdle);
+    mEnvOut.Get()[v] = 0.;
+    mPhaseIncr.Get()[v] = 0.;
   }
 
-} WDL_FIXALIGN;
+  void SwapVoices(int a, int b)
+  {
+    WDL_TypedBuf<double>* bufs[] = { &mPhase, &mPhaseIncr, &mEnvValue, &mEnvIncr, &mEnvScale, &mEnvOffset, &mEnvOut, &mLevel };
+    for (int i = 0; i < (int) (sizeof(bufs) / sizeof(bufs[0])); ++i)
+    {
+      double* p = bufs[i]->Get();
+      double t = p[a]; p[a] = p[b]; p[b] = t;
+    }
+    int t = mStage.Get()[a]; mStage.Get()[a] = mStage.Get()[b]; mStage.Get()[b] = t;
+    const double* table = mTable.Get()[a]; mTable.Get()[a] = mTable.Get()[b]; mTable.Get()[b] = table;
+  }
 
-class CADSREnvL
-{
-protected:
-  double mAttackIncr, mDecayIncr, mReleaseIncr;
-  double mSustainLevel, mReleaseLevel;
-  double mPrev;
-  double mSampleRate;
+  bool IsVoiceFinished(int v) { return mStage.Get()[v] == kIdle; }
+  double GetVoiceLevel(int v) { return mEnvOut.Get()[v]; }
 
-public:
-  CADSREnvL()
+  // Writes the sum of voices [0, nActive) to out.
+  void Render(double* out, int nFrames, int nActive)
+  {
+    if (!nActive || !mWavetable)
+    {
+      memset(out, 0, nFrames * sizeof(double));
+      return;
+    }
+
+    int nVoices = (nActive + 1) & ~1;
+    double* phase = mPhase.Get();
+    const double* phaseIncr = mPhaseIncr.Get();
+    const double* const* tables = mTable.Get();
+    const int tableSize = mWavetable->GetTableSize();
+    const double* osc = mOsc.Get();
+    double* envValue = mEnvValue.Get();
+    const double* envIncr = mEnvIncr.Get();
+    const double* envScale = mEnvScale.Get();
+    const double* envOffset = mEnvOffset.Get();
+    double* envOut = mEnvOut.Get();
+
+#ifdef IPLUG_SSE2
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d high = _mm_set1_pd(ENV_VALUE_HIGH), low = _mm_set1_pd(ENV_VALUE_LOW);
+#endif
+
+    for (int s = 0; s < nFrames; ++s)
+    {
+      IWavetable::ReadVoices(tables, tableSize, phase, phaseIncr, mOsc.Get(), nVoices);
+
+#ifdef IPLUG_SSE2
+      __m128d sum = zero;
+
+      for (int v = 0; v < nVoices; v += 2)
+      {
+        // envelope, a stage ends when the value crosses its limit
+        __m128d incr = _mm_loadu_pd(envIncr + v);
+        __m128d value = _mm_add_pd(_mm_loadu_pd(envValue + v), incr);
+        _mm_storeu_pd(envValue + v, value);
+        __m128d ended = _mm_or_pd(_mm_and_pd(_mm_cmpgt_pd(incr, zero), _mm_cmpgt_pd(value, high)),
+                                  _mm_and_pd(_mm_cmplt_pd(incr, zero), _mm_cmplt_pd(value, low)));
+        int endedMask = _mm_movemask_pd(ended);
+        if (endedMask)
+        {
+          if (endedMask & 1) nextStage(v);
+          if (endedMask & 2) nextStage(v + 1);
+        }
+        __m128d env = _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(envValue + v), _mm_loadu_pd(envScale + v)), _mm_loadu_pd(envOffset + v));
+        _mm_storeu_pd(envOut + v, env);
+
+        sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(osc + v), env));
+      }
+
+      out[s] = _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+#else
+      double sum = 0.;
+
+      for (int v = 0; v < nVoices; ++v)
+      {
+        double value = (envValue[v] += envIncr[v]);
+        if ((envIncr[v] > 0. && value > ENV_VALUE_HIGH) || (envIncr[v] < 0. && value < ENV_VALUE_LOW))
+        {
+          nextStage(v);
+        }
+        double env = envOut[v] = envValue[v] * envScale[v] + envOffset[v];
+
+        sum += osc[v] * env;
+      }
+
+      out[s] = sum;
+#endif
+    }
+  }
+
+protected:
+  void calcIncrs()
   {
-    mSustainLevel = 1.;
-    mReleaseLevel = 0.;
-    mPrev = 0.;
-    mSampleRate = 44100.;
-
-    setStageTime(kStageAttack, 1.);
-    setStageTime(kStageDecay, 100.);
-    setStageTime(kStageRelease, 20.);
+    mAttackIncr = calcIncrFromTimeLinear(fastClip(mAttackMS, MIN_ENV_TIME_MS, MAX_ENV_TIME_MS), mSampleRate);
+    mDecayIncr = calcIncrFromTimeLinear(fastClip(mDecayMS, MIN_ENV_TIME_MS, MAX_ENV_TIME_MS), mSampleRate);
+    mReleaseIncr = calcIncrFromTimeLinear(fastClip(mReleaseMS, MIN_ENV_TIME_MS, MAX_ENV_TIME_MS), mSampleRate);
+
+    for (int v = 0; v < mNumVoices; ++v)
+    {
+      updateStage(v);
+    }
   }
 
-  void setStageTime(int stage, double timeMS)
+  // new envelope rates/levels for the current stage, keeping the value
+  void updateStage(int v)
   {
-    const double incr = calcIncrFromTimeLinear(fastClip(timeMS, MIN_ENV_TIME_MS, MAX_ENV_TIME_MS), mSampleRate);
+    const double level = mLevel.Get()[v];
 
-    switch(stage)
+    switch (mStage.Get()[v])
     {
       case kStageAttack:
-        mAttackIncr = incr;
+        mEnvIncr.Get()[v] = mAttackIncr;
+        mEnvScale.Get()[v] = level;
+        mEnvOffset.Get()[v] = 0.;
         break;
       case kStageDecay:
-        mDecayIncr = incr;
+        mEnvIncr.Get()[v] = -mDecayIncr;
+        mEnvScale.Get()[v] = level * (1. - mSustainLevel);
+        mEnvOffset.Get()[v] = level * mSustainLevel;
+        break;
+      case kStageSustain:
+        mEnvIncr.Get()[v] = 0.;
+        mEnvScale.Get()[v] = 0.;
+        mEnvOffset.Get()[v] = level * mSustainLevel;
         break;
       case kStageRelease:
-        mReleaseIncr = incr;
+        mEnvIncr.Get()[v] = -mReleaseIncr; // scale was set from the level at note off
+        mEnvOffset.Get()[v] = 0.;
         break;
       default:
-        //error
+        mEnvIncr.Get()[v] = 0.;
+        mEnvScale.Get()[v] = 0.;
+        mEnvOffset.Get()[v] = 0.;
         break;
     }
   }
 
-  void setSustainLevel(double sustainLevel)
-  {
-    mSustainLevel = sustainLevel;
-  }
-
-  virtual void setSampleRate(double sr)
+  void setStage(int v, int stage)
   {
-    mSampleRate = sr;
-  }
-
-  inline double process(CADSREnvLState* pS)
-  {
-    double result = 0.;
+    mStage.Get()[v] = stage;
 
-    switch(pS->mStage)
+    switch (stage)
     {
-      case kIdle:
-        result = pS->mEnvValue;
-        break;
       case kStageAttack:
-        pS->mEnvValue += mAttackIncr;
-        if (pS->mEnvValue > ENV_VALUE_HIGH || mAttackIncr == 0.)
+        if (mAttackIncr <= 0.)
         {
-          pS->mStage = kStageDecay;
-          pS->mEnvValue = 1.0;
+          setStage(v, kStageDecay);
+          return;
         }
-        result = pS->mEnvValue;
         break;
       case kStageDecay:
-        pS->mEnvValue -= mDecayIncr;
-        result = (pS->mEnvValue * (1.-mSustainLevel)) + mSustainLevel;
-        if (pS->mEnvValue < ENV_VALUE_LOW)
-        {
-          pS->mStage = kStageSustain;
-          pS->mEnvValue = 1.;
-          result = mSustainLevel;
-        }
-        break;
       case kStageSustain:
-        result = mSustainLevel;
+        mEnvValue.Get()[v] = 1.;
         break;
       case kStageRelease:
-        pS->mEnvValue -= mReleaseIncr;
-        if(pS->mEnvValue < ENV_VALUE_LOW || mReleaseIncr == 0.)
+        if (mReleaseIncr <= 0.)
         {
-          pS->mStage = kIdle;
-          pS->mEnvValue = 0.0;
+          setStage(v, kIdle);
+          return;
         }
-        result = pS->mEnvValue * pS->mReleaseLevel;
+        mEnvValue.Get()[v] = 1.;
+        mEnvScale.Get()[v] = mEnvOut.Get()[v];
         break;
       default:
-        result = pS->mEnvValue;
+        mEnvValue.Get()[v] = 0.;
         break;
     }
 
-    pS->mPrev = result;
-
-    return result * pS->mLevel;
-  }
-
-} WDL_FIXALIGN ;
-
-// http://www.musicdsp.org/archive.php?classid=3#257
-
-//class CParamSmooth
-//{
-//public:
-//  CParamSmooth() { a = 0.99; b = 1. - a; z = 0.; };
-//  ~CParamSmooth() {};
-//  inline double Process(double in) { z = (in * b) + (z * a); return z; }
-//private:
-//  double a, b, z;
-//};
-
-struct CVoiceState
-{
-  CWTOscState mOsc_ctx;
-  CADSREnvLState mEnv_ctx;
-  //bool mLastBusy;
-  int mKey;
-
-  CVoiceState()
-  {
-    mKey = -1;
-    //mLastBusy = false;
+    updateStage(v);
   }
 
-  bool GetBusy()
+  void nextStage(int v)
   {
-    if (mEnv_ctx.mStage == kIdle)
-      return false;
-    else
-      return true;
+    switch (mStage.Get()[v])
+    {
+      case kStageAttack: setStage(v, kStageDecay); break;
+      case kStageDecay: setStage(v, kStageSustain); break;
+      default: setStage(v, kIdle); break;
+    }
   }
-};
 
+} WDL_FIXALIGN;
 
 #endif //__IPLUGPOLYSYNTHDSP__
\ No newline at end of file
@@ -59,7 +59,6 @@ IPlugResampler::~IPlugResampler() {}
 void IPlugResampler::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
   
   mSampleIndx = 0;
   mResampler.Reset();
@@ -69,8 +68,6 @@ void IPlugResampler::Reset()
 
 void IPlugResampler::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
   double* out1 = outputs[0];
   double* out2 = outputs[1];
 
@@ -94,8 +91,6 @@ void IPlugResampler::ProcessDoubleReplacing(double** inputs, double** outputs, i
 
 void IPlugResampler::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kGain:
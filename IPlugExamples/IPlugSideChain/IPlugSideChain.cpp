@@ -93,8 +93,6 @@ IPlugSideChain::~IPlugSideChain() {}
 
 void IPlugSideChain::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
-
   bool in1ic = IsInChannelConnected(0);
   bool in2ic = IsInChannelConnected(1);
   bool in3ic = IsInChannelConnected(2);
@@ -204,15 +202,12 @@ void IPlugSideChain::ProcessDoubleReplacing(double** inputs, double** outputs, i
 void IPlugSideChain::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
 
   //double sr = GetSampleRate();
 }
 
 void IPlugSideChain::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-
   switch (paramIdx)
   {
     case kGain:
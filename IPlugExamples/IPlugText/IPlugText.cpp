@@ -81,7 +81,6 @@ IPlugText::~IPlugText() {}
 
 void IPlugText::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked for us.
   
   double* in1 = inputs[0];
   double* in2 = inputs[1];
@@ -102,15 +101,12 @@ void IPlugText::ProcessDoubleReplacing(double** inputs, double** outputs, int nF
 void IPlugText::Reset()
 {
   TRACE;
-  IMutexLock lock(this);
   
   //double sr = GetSampleRate();
 }
 
 void IPlugText::OnParamChange(int paramIdx)
 {
-  IMutexLock lock(this);
-  
   switch (paramIdx)
   {
     case kGain:
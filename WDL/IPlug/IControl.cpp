@@ -29,6 +29,11 @@ void IControl::SetValueFromUserInput(double value)
   }
 }
 
+IControl::~IControl()
+{
+  DELETE_NULL(mLayer);
+}
+
 void IControl::SetDirty(bool pushParamToPlug)
 {
   mValue = BOUNDED(mValue, mClampLo, mClampHi);
@@ -67,6 +72,7 @@ void IControl::Hide(bool hide)
 {
   mHide = hide;
   mRedraw = true;
+  InvalidateLayer();
   SetDirty(false);
 }
 
@@ -74,6 +80,7 @@ void IControl::GrayOut(bool gray)
 {
   mGrayed = gray;
   mBlend.mWeight = (gray ? GRAYED_ALPHA : 1.0f);
+  InvalidateLayer();
   SetDirty(false);
 }
 
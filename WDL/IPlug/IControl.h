@@ -14,6 +14,8 @@
 
 #define DEFAULT_TEXT_ENTRY_LEN 7
 
+class LICE_MemBitmap;
+
 class IControl
 {
 public:
@@ -22,9 +24,10 @@ public:
     : mPlug(pPlug), mRECT(pR), mTargetRECT(pR), mParamIdx(paramIdx), mValue(0.0), mDefaultValue(-1.0),
       mBlend(blendMethod), mDirty(true), mHide(false), mGrayed(false), mDisablePrompt(true), mDblAsSingleClick(false),
       mClampLo(0.0), mClampHi(1.0), mMOWhenGreyed(false), mTextEntryLength(DEFAULT_TEXT_ENTRY_LEN), 
-      mValDisplayControl(0), mNameDisplayControl(0), mTooltip("") {}
+      mValDisplayControl(0), mNameDisplayControl(0), mTooltip(""),
+      mLayer(0), mLayerCached(false), mLayerValid(false) {}
 
-  virtual ~IControl() {}
+  virtual ~IControl();
 
   virtual void OnMouseDown(int x, int y, IMouseMod* pMod);
   virtual void OnMouseUp(int x, int y, IMouseMod* pMod) {}
@@ -44,6 +47,17 @@ public:
 
   virtual bool Draw(IGraphics* pGraphics) = 0;
 
+  // Opt-in layer cache, for controls over a costly background or with costly static parts.
+  // IGraphics renders whatever is underneath the control plus DrawStatic() once into an
+  // offscreen bitmap, then only blits that and calls DrawDynamic() while the layer is valid.
+  // Dirty controls underneath, Hide(), GrayOut() and moving the control invalidate it, call
+  // InvalidateLayer() if the static parts change in other ways.
+  void SetLayerCached(bool cached) { mLayerCached = cached; mLayerValid = false; }
+  bool IsLayerCached() const { return mLayerCached; }
+  void InvalidateLayer() { mLayerValid = false; }
+  virtual bool DrawStatic(IGraphics* pGraphics) { return true; }
+  virtual bool DrawDynamic(IGraphics* pGraphics) { return Draw(pGraphics); }
+
   // Ask the IGraphics object to open an edit box so the user can enter a value for this control.
   void PromptUserInput();
   void PromptUserInput(IRECT* pTextRect);
@@ -136,6 +150,12 @@ protected:
   IControl* mValDisplayControl;
   IControl* mNameDisplayControl;
   WDL_String mTooltip;
+
+private:
+  friend class IGraphics;
+  LICE_MemBitmap* mLayer;
+  IRECT mLayerRECT; // mRECT when the layer was rendered
+  bool mLayerCached, mLayerValid;
 };
 
 enum EDirection { kVertical, kHorizontal };
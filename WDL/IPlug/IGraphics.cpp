@@ -6,6 +6,14 @@
 // Only looked at if USE_IDLE_CALLS is defined.
 #define IDLE_TICKS 20
 
+// Cell size in pixels of the grid that indexes control rects for non-strict drawing.
+#ifndef CONTROL_GRID_CELL_SIZE
+  #define CONTROL_GRID_CELL_SIZE 64
+#endif
+
+// mControlRegion value of controls that cover the whole GUI, drawn in every dirty region.
+#define FULL_COVER_REGION -2
+
 #ifndef CONTROL_BOUNDS_COLOR
   #define CONTROL_BOUNDS_COLOR COLOR_GREEN
 #endif
@@ -180,22 +188,36 @@ IGraphics::IGraphics(IPlugBase* pPlug, int w, int h, int refreshFPS)
   , mHiddenMousePointY(-1)
   , mEnableTooltips(false)
   , mShowControlBounds(false)
+  , mGridCols(0)
+  , mGridRows(0)
+  , mUseRenderThread(false)
+  , mRenderThreadRunning(false)
+  , mRenderThread(0)
+  , mRenderStopEvent(0)
+  , mEventLocks(0)
+  , mScreenBitmap(0)
+  , mQueuePlugUpdates(0)
+  , mPlugUpdatesPending(0)
 {
   mFPS = (refreshFPS > 0 ? refreshFPS : DEFAULT_FPS);
 }
 
 IGraphics::~IGraphics()
 {
+  StopRenderThread();
+
   if (mKeyCatcher)
     DELETE_NULL(mKeyCatcher);
 
   mControls.Empty(true);
   DELETE_NULL(mDrawBitmap);
   DELETE_NULL(mTmpBitmap);
+  DELETE_NULL(mScreenBitmap);
 }
 
 void IGraphics::Resize(int w, int h)
 {
+  StopRenderThread();
   mWidth = w;
   mHeight = h;
   ReleaseMouseCapture();
@@ -208,6 +230,7 @@ void IGraphics::Resize(int w, int h)
 
 void IGraphics::SetFromStringAfterPrompt(IControl* pControl, IParam* pParam, char *txt)
 {
+  WDL_MutexLock lock(&mMutex);
   if (pParam)
   {
     double v;
@@ -313,6 +336,24 @@ void IGraphics::SetParameterFromPlug(int paramIdx, double value, bool normalized
     IParam* pParam = mPlug->GetParam(paramIdx);
     value = pParam->GetNormalized(value);
   }
+
+  if (wdl_atomic_get(&mQueuePlugUpdates))
+  {
+    if (paramIdx >= 0 && paramIdx < mParamUpdated.GetSize())
+    {
+      mParamUpdates.Get()[paramIdx] = value;
+      wdl_atomic_incr(mParamUpdated.Get() + paramIdx);
+      wdl_atomic_incr(&mPlugUpdatesPending);
+    }
+  }
+  else
+  {
+    SetParamControlsFromPlug(paramIdx, value);
+  }
+}
+
+void IGraphics::SetParamControlsFromPlug(int paramIdx, double value)
+{
   int i, n = mControls.GetSize();
   IControl** ppControl = mControls.GetList();
   for (i = 0; i < n; ++i, ++ppControl)
@@ -320,7 +361,6 @@ void IGraphics::SetParameterFromPlug(int paramIdx, double value, bool normalized
     IControl* pControl = *ppControl;
     if (pControl->ParamIdx() == paramIdx)
     {
-      //WDL_MutexLock lock(&mMutex);
       pControl->SetValueFromPlug(value);
       // Could be more than one, don't break until we check them all.
     }
@@ -337,15 +377,61 @@ void IGraphics::SetParameterFromPlug(int paramIdx, double value, bool normalized
 
 void IGraphics::SetControlFromPlug(int controlIdx, double normalizedValue)
 {
-  if (controlIdx >= 0 && controlIdx < mControls.GetSize())
+  if (wdl_atomic_get(&mQueuePlugUpdates))
+  {
+    if (controlIdx >= 0 && controlIdx < mControlUpdated.GetSize())
+    {
+      mControlUpdates.Get()[controlIdx] = normalizedValue;
+      wdl_atomic_incr(mControlUpdated.Get() + controlIdx);
+      wdl_atomic_incr(&mPlugUpdatesPending);
+    }
+  }
+  else if (controlIdx >= 0 && controlIdx < mControls.GetSize())
   {
-    //WDL_MutexLock lock(&mMutex);
     mControls.Get(controlIdx)->SetValueFromPlug(normalizedValue);
   }
 }
 
+// Called with mMutex locked, or from the GUI thread once the render thread has stopped.
+// Only subtracts the counts it has seen, so a value stored meanwhile (or read torn) is applied
+// again next time.
+void IGraphics::ApplyPlugUpdates()
+{
+  int pending = wdl_atomic_get(&mPlugUpdatesPending);
+  if (!pending)
+  {
+    return;
+  }
+  wdl_atomic_add(&mPlugUpdatesPending, -pending);
+
+  int i, n = mParamUpdated.GetSize();
+  int* pUpdated = mParamUpdated.Get();
+  for (i = 0; i < n; ++i)
+  {
+    int nUpdates = wdl_atomic_get(pUpdated + i);
+    if (nUpdates)
+    {
+      SetParamControlsFromPlug(i, mParamUpdates.Get()[i]);
+      wdl_atomic_add(pUpdated + i, -nUpdates);
+    }
+  }
+
+  n = IPMIN(mControlUpdated.GetSize(), mControls.GetSize());
+  pUpdated = mControlUpdated.Get();
+  for (i = 0; i < n; ++i)
+  {
+    int nUpdates = wdl_atomic_get(pUpdated + i);
+    if (nUpdates)
+    {
+      mControls.Get(i)->SetValueFromPlug(mControlUpdates.Get()[i]);
+      wdl_atomic_add(pUpdated + i, -nUpdates);
+    }
+  }
+}
+
 void IGraphics::SetAllControlsDirty()
 {
+  WDL_MutexLock lock(&mMutex);
   int i, n = mControls.GetSize();
   IControl** ppControl = mControls.GetList();
   for (i = 0; i < n; ++i, ++ppControl)
@@ -713,6 +799,44 @@ bool IGraphics::DrawRadialLine(const IColor* pColor, float cx, float cy, float a
 }
 
 bool IGraphics::IsDirty(IRECT* pR)
+{
+  bool dirty;
+
+  if (mUseRenderThread && !mRenderThreadRunning)
+  {
+    StartRenderThread();
+  }
+
+  if (mRenderThreadRunning)
+  {
+    // what the render thread has finished since the last call
+    WDL_MutexLock lock(&mScreenMutex);
+    dirty = !mScreenRECT.Empty();
+    *pR = mScreenRECT;
+    mScreenRECT = IRECT();
+  }
+  else
+  {
+    dirty = ControlsDirty(pR);
+  }
+
+#ifdef USE_IDLE_CALLS
+  if (dirty)
+  {
+    mIdleTicks = 0;
+  }
+  else if (++mIdleTicks > IDLE_TICKS)
+  {
+    WDL_MutexLock lock(&mMutex);
+    OnGUIIdle();
+    mIdleTicks = 0;
+  }
+#endif
+
+  return dirty;
+}
+
+bool IGraphics::ControlsDirty(IRECT* pR)
 {
 #ifndef NDEBUG
   if (mShowControlBounds)
@@ -735,18 +859,6 @@ bool IGraphics::IsDirty(IRECT* pR)
     }
   }
 
-#ifdef USE_IDLE_CALLS
-  if (dirty)
-  {
-    mIdleTicks = 0;
-  }
-  else if (++mIdleTicks > IDLE_TICKS)
-  {
-    OnGUIIdle();
-    mIdleTicks = 0;
-  }
-#endif
-
   return dirty;
 }
 
@@ -754,26 +866,38 @@ bool IGraphics::IsDirty(IRECT* pR)
 // which may be a larger area than what is strictly dirty.
 bool IGraphics::Draw(IRECT* pR)
 {
-//  #pragma REMINDER("Mutex set while drawing")
-//  WDL_MutexLock lock(&mMutex);
+  if (mRenderThreadRunning)
+  {
+    // the screen buffer always holds the last complete frame
+    WDL_MutexLock lock(&mScreenMutex);
+    return DrawScreen(pR);
+  }
 
+  DrawControls(pR);
+  return DrawScreen(pR);
+}
+
+void IGraphics::DrawControls(IRECT* pR)
+{
   int i, j, n = mControls.GetSize();
   if (!n)
   {
-    return true;
+    return;
   }
 
   if (mStrict)
   {
-    mDrawRECT = *pR;
-    int n = mControls.GetSize();
-    IControl** ppControl = mControls.GetList();
-    for (int i = 0; i < n; ++i, ++ppControl)
+    UpdateControlGrid();
+    InvalidateLayersOverDirty();
+
+    // nothing below a cached layer that covers pR needs drawing
+    int base = FindLayerBase(pR);
+    for (i = 0; i < n; ++i)
     {
-      IControl* pControl = *ppControl;
-      if (!(pControl->IsHidden()) && pR->Intersects(pControl->GetRECT()))
+      IControl* pControl = mControls.Get(i);
+      if (i >= base && !(pControl->IsHidden()) && pR->Intersects(pControl->GetRECT()))
       {
-        pControl->Draw(this);
+        DrawControl(pControl, pR, i == base);
       }
       pControl->SetClean();
     }
@@ -783,41 +907,72 @@ bool IGraphics::Draw(IRECT* pR)
     IControl* pBG = mControls.Get(0);
     if (pBG->IsDirty())   // Special case when everything needs to be drawn.
     {
-      mDrawRECT = *(pBG->GetRECT());
+      IRECT all = *(pBG->GetRECT());
       for (int j = 0; j < n; ++j)
       {
         IControl* pControl2 = mControls.Get(j);
+        pControl2->InvalidateLayer();
         if (!j || !(pControl2->IsHidden()))
         {
-          pControl2->Draw(this);
+          DrawControl(pControl2, &all, false);
           pControl2->SetClean();
         }
       }
     }
     else
     {
-      for (i = 1; i < n; ++i)   // loop through all controls starting from one (not bg)
+      UpdateControlGrid();
+      InvalidateLayersOverDirty();
+
+      // the dirty control rects, merged into regions that don't overlap
+      mDirtyRegions.Resize(0, false);
+      for (i = 1; i < n; ++i)
       {
-        IControl* pControl = mControls.Get(i); // assign control i to pControl
-        if (pControl->IsDirty())   // if pControl is dirty
+        IControl* pControl = mControls.Get(i);
+        if (pControl->IsDirty())
         {
+          AddDirtyRegion(pControl->GetRECT());
+        }
+      }
 
-          // printf("control %i is Dirty\n", i);
+      // find the controls to redraw, merging regions until each control is in one of them
+      while (!AssignControlsToRegions()) {}
 
-          mDrawRECT = *(pControl->GetRECT()); // put the rect in the mDrawRect member variable
-          for (j = 0; j < n; ++j)   // loop through all controls
-          {
-            IControl* pControl2 = mControls.Get(j); // assign control j to pControl2
+      // nothing below a cached layer that covers the region needs drawing
+      int nRegions = mDirtyRegions.GetSize();
+      int* pBase = mRegionBase.Resize(nRegions);
+      for (i = 0; i < nRegions; ++i)
+      {
+        pBase[i] = FindLayerBase(mDirtyRegions.Get() + i);
+      }
 
-            // if control1 == control2 OR control2 is not hidden AND control2's rect intersects mDrawRect
-            if (!pControl2->IsHidden() && (i == j || pControl2->GetRECT()->Intersects(&mDrawRECT)))
+      // each control is drawn once, bottom to top, clipped to its region,
+      // controls covering the whole GUI once in every region
+      int* pRegionIdx = mControlRegion.Get();
+      for (j = 0; j < n; ++j)
+      {
+        int r = pRegionIdx[j];
+        if (r == FULL_COVER_REGION)
+        {
+          for (r = 0; r < nRegions; ++r)
+          {
+            if (j >= pBase[r])
             {
-              //if ((i == j) && (!pControl2->IsHidden())|| (!(pControl2->IsHidden()) && pControl2->GetRECT()->Intersects(&mDrawRECT))) {
-              //printf("control %i and %i \n", i, j);
-
-              pControl2->Draw(this);
+              DrawControl(mControls.Get(j), mDirtyRegions.Get() + r, j == pBase[r]);
             }
           }
+        }
+        else if (r >= 0 && j >= pBase[r])
+        {
+          DrawControl(mControls.Get(j), mDirtyRegions.Get() + r, j == pBase[r]);
+        }
+      }
+
+      for (i = 1; i < n; ++i)
+      {
+        IControl* pControl = mControls.Get(i);
+        if (pControl->IsDirty())
+        {
           pControl->SetClean();
         }
       }
@@ -840,8 +995,413 @@ bool IGraphics::Draw(IRECT* pR)
     DrawIText(&txt, str.Get(), &rect);
   }
 #endif
+}
 
-  return DrawScreen(pR);
+void IGraphics::UpdateControlGrid()
+{
+  int c, n = mControls.GetSize();
+  bool changed = (mGridRECTs.GetSize() != n);
+  for (c = 0; c < n && !changed; ++c)
+  {
+    changed = (mGridRECTs.Get()[c] != *(mControls.Get(c)->GetRECT()));
+  }
+  if (!changed)
+  {
+    return;
+  }
+
+  // rebuilt when controls are attached, moved or the GUI is resized: count the controls in each
+  // cell, then fill the cells in control (z) order
+  mGridCols = IPMAX(1, (Width() + CONTROL_GRID_CELL_SIZE - 1) / CONTROL_GRID_CELL_SIZE);
+  mGridRows = IPMAX(1, (Height() + CONTROL_GRID_CELL_SIZE - 1) / CONTROL_GRID_CELL_SIZE);
+  int nCells = mGridCols * mGridRows;
+
+  IRECT* pRECTs = mGridRECTs.Resize(n);
+  int* pStart = mGridCellStart.Resize(nCells + 1);
+  memset(pStart, 0, (nCells + 1) * sizeof(int));
+
+  int col0, row0, col1, row1, col, row;
+  for (c = 0; c < n; ++c)
+  {
+    pRECTs[c] = *(mControls.Get(c)->GetRECT());
+    if (pRECTs[c].Empty()) continue;
+    GetGridCells(pRECTs + c, &col0, &row0, &col1, &row1);
+    for (row = row0; row <= row1; ++row)
+    {
+      for (col = col0; col <= col1; ++col)
+      {
+        ++pStart[row * mGridCols + col + 1];
+      }
+    }
+  }
+
+  for (int cell = 0; cell < nCells; ++cell)
+  {
+    pStart[cell + 1] += pStart[cell];
+  }
+
+  WDL_TypedBuf<int> fill;
+  int* pFill = fill.Resize(nCells);
+  memcpy(pFill, pStart, nCells * sizeof(int));
+  int* pCells = mGridCellControls.Resize(pStart[nCells]);
+
+  for (c = 0; c < n; ++c)
+  {
+    if (pRECTs[c].Empty()) continue;
+    GetGridCells(pRECTs + c, &col0, &row0, &col1, &row1);
+    for (row = row0; row <= row1; ++row)
+    {
+      for (col = col0; col <= col1; ++col)
+      {
+        pCells[pFill[row * mGridCols + col]++] = c;
+      }
+    }
+  }
+
+  mControlRegion.Resize(n);
+}
+
+void IGraphics::GetGridCells(IRECT* pR, int* pCol0, int* pRow0, int* pCol1, int* pRow1)
+{
+  // IRECT::Intersects() counts touching edges, so R and B are included
+  *pCol0 = BOUNDED(pR->L / CONTROL_GRID_CELL_SIZE, 0, mGridCols - 1);
+  *pRow0 = BOUNDED(pR->T / CONTROL_GRID_CELL_SIZE, 0, mGridRows - 1);
+  *pCol1 = BOUNDED(pR->R / CONTROL_GRID_CELL_SIZE, 0, mGridCols - 1);
+  *pRow1 = BOUNDED(pR->B / CONTROL_GRID_CELL_SIZE, 0, mGridRows - 1);
+}
+
+void IGraphics::AddDirtyRegion(IRECT* pR)
+{
+  IRECT r = *pR;
+  int i = 0;
+  while (i < mDirtyRegions.GetSize())
+  {
+    IRECT* pRegion = mDirtyRegions.Get() + i;
+    if (pRegion->Intersects(&r))
+    {
+      // absorb it and start over, the bigger rect may overlap regions already checked
+      r = r.Union(pRegion);
+      RemoveDirtyRegion(i);
+      i = 0;
+    }
+    else
+    {
+      ++i;
+    }
+  }
+  mDirtyRegions.Add(r);
+}
+
+void IGraphics::RemoveDirtyRegion(int idx)
+{
+  int last = mDirtyRegions.GetSize() - 1;
+  mDirtyRegions.Get()[idx] = mDirtyRegions.Get()[last];
+  mDirtyRegions.Resize(last, false);
+}
+
+bool IGraphics::AssignControlsToRegions()
+{
+  // controls covering the whole GUI (backgrounds) would merge every region into one,
+  // they are drawn in each region instead
+  IRECT all(0, 0, Width(), Height());
+  int c, n = mControls.GetSize();
+  int* pRegionIdx = mControlRegion.Get();
+  for (c = 0; c < n; ++c)
+  {
+    IControl* pControl = mControls.Get(c);
+    pRegionIdx[c] = (!pControl->IsHidden() && pControl->GetRECT()->Contains(&all) ? FULL_COVER_REGION : -1);
+  }
+
+  const int* pStart = mGridCellStart.Get();
+  const int* pCells = mGridCellControls.Get();
+  int col0, row0, col1, row1, col, row;
+
+  for (int r = 0; r < mDirtyRegions.GetSize(); ++r)
+  {
+    IRECT* pRegion = mDirtyRegions.Get() + r;
+    GetGridCells(pRegion, &col0, &row0, &col1, &row1);
+
+    for (row = row0; row <= row1; ++row)
+    {
+      for (col = col0; col <= col1; ++col)
+      {
+        int cell = row * mGridCols + col;
+        for (int k = pStart[cell]; k < pStart[cell + 1]; ++k)
+        {
+          c = pCells[k];
+          if (pRegionIdx[c] == r || pRegionIdx[c] == FULL_COVER_REGION) continue;
+
+          IControl* pControl = mControls.Get(c);
+          if (pControl->IsHidden() || !pControl->GetRECT()->Intersects(pRegion)) continue;
+
+          if (pRegionIdx[c] >= 0)
+          {
+            // the control overlaps two regions, draw them as one
+            IRECT merged = pRegion->Union(mDirtyRegions.Get() + pRegionIdx[c]);
+            RemoveDirtyRegion(IPMAX(r, pRegionIdx[c]));
+            RemoveDirtyRegion(IPMIN(r, pRegionIdx[c]));
+            AddDirtyRegion(&merged);
+            return false;
+          }
+
+          pRegionIdx[c] = r;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+void IGraphics::DrawControl(IControl* pControl, IRECT* pClip, bool fromLayer)
+{
+  mDrawRECT = *pClip;
+
+  if (!pControl->IsLayerCached())
+  {
+    pControl->Draw(this);
+    return;
+  }
+
+  IRECT* pR = pControl->GetRECT();
+  if (fromLayer)
+  {
+    // the layer already has everything underneath and the static parts
+    IRECT r = pR->Intersect(pClip);
+    _LICE::LICE_Blit(mDrawBitmap, pControl->mLayer, r.L, r.T, r.L - pR->L, r.T - pR->T, r.W(), r.H(), 1.0f, LICE_BLIT_MODE_COPY);
+  }
+  else
+  {
+    pControl->DrawStatic(this);
+
+    // only complete if the whole control was drawn
+    if (pClip->Contains(pR))
+    {
+      if (!pControl->mLayer)
+      {
+        pControl->mLayer = new LICE_MemBitmap(pR->W(), pR->H());
+      }
+      else
+      {
+        pControl->mLayer->resize(pR->W(), pR->H());
+      }
+      _LICE::LICE_Blit(pControl->mLayer, mDrawBitmap, 0, 0, pR->L, pR->T, pR->W(), pR->H(), 1.0f, LICE_BLIT_MODE_COPY);
+      pControl->mLayerRECT = *pR;
+      pControl->mLayerValid = true;
+    }
+  }
+
+  pControl->DrawDynamic(this);
+}
+
+void IGraphics::InvalidateLayersOverDirty()
+{
+  const int* pStart = mGridCellStart.Get();
+  const int* pCells = mGridCellControls.Get();
+  int col0, row0, col1, row1, col, row;
+  int i, n = mControls.GetSize();
+
+  for (i = 0; i < n; ++i)
+  {
+    IControl* pControl = mControls.Get(i);
+    if (!pControl->IsDirty()) continue;
+
+    GetGridCells(pControl->GetRECT(), &col0, &row0, &col1, &row1);
+    for (row = row0; row <= row1; ++row)
+    {
+      for (col = col0; col <= col1; ++col)
+      {
+        int cell = row * mGridCols + col;
+        for (int k = pStart[cell]; k < pStart[cell + 1]; ++k)
+        {
+          IControl* pAbove = mControls.Get(pCells[k]);
+          if (pCells[k] > i && pAbove->mLayerValid && pAbove->GetRECT()->Intersects(pControl->GetRECT()))
+          {
+            pAbove->InvalidateLayer();
+          }
+        }
+      }
+    }
+  }
+}
+
+int IGraphics::FindLayerBase(IRECT* pR)
+{
+  // a control containing pR overlaps the cell of its top left corner
+  int col0, row0, col1, row1;
+  GetGridCells(pR, &col0, &row0, &col1, &row1);
+  int cell = row0 * mGridCols + col0;
+  const int* pCells = mGridCellControls.Get();
+
+  for (int k = mGridCellStart.Get()[cell + 1] - 1; k >= mGridCellStart.Get()[cell]; --k)
+  {
+    IControl* pControl = mControls.Get(pCells[k]);
+    if (!pControl->IsHidden() && pControl->mLayerValid && pControl->IsLayerCached() &&
+        pControl->mLayerRECT == *(pControl->GetRECT()) && pControl->GetRECT()->Contains(pR))
+    {
+      return pCells[k];
+    }
+  }
+  return -1;
+}
+
+void IGraphics::EnableRenderThread(bool enable)
+{
+  mUseRenderThread = enable;
+  if (!enable)
+  {
+    StopRenderThread();
+  }
+  // else started by the next IsDirty() call, i.e. once the window is open
+}
+
+void IGraphics::StartRenderThread()
+{
+  if (mRenderThreadRunning || !mDrawBitmap)
+  {
+    return;
+  }
+
+  // the screen buffer starts as a copy of the draw buffer, then everything is redrawn
+  if (!mScreenBitmap)
+  {
+    mScreenBitmap = new LICE_SysBitmap(Width(), Height());
+  }
+  else
+  {
+    mScreenBitmap->resize(Width(), Height());
+  }
+  _LICE::LICE_Copy(mScreenBitmap, mDrawBitmap);
+  mScreenRECT = IRECT();
+  SetAllControlsDirty();
+
+  // from now on values from the plug go through ApplyPlugUpdates()
+  // (the buffers are only used by the plug while queueing, which is off here)
+  {
+    int nParams = mPlug->NParams(), nControls = mControls.GetSize();
+    mParamUpdates.Resize(nParams, false);
+    memset(mParamUpdated.Resize(nParams, false), 0, nParams * sizeof(int));
+    mControlUpdates.Resize(nControls, false);
+    memset(mControlUpdated.Resize(nControls, false), 0, nControls * sizeof(int));
+    mPlugUpdatesPending = 0;
+    wdl_atomic_incr(&mQueuePlugUpdates);
+  }
+
+  mRenderStopEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+  DWORD tid;
+  mRenderThread = CreateThread(NULL, 0, RenderThreadProc, this, 0, &tid);
+  mRenderThreadRunning = (mRenderThread != 0);
+
+  if (!mRenderThreadRunning)
+  {
+    CloseHandle(mRenderStopEvent);
+    mRenderStopEvent = 0;
+    mUseRenderThread = false;
+
+    wdl_atomic_decr(&mQueuePlugUpdates);
+    ApplyPlugUpdates();
+  }
+}
+
+void IGraphics::StopRenderThread()
+{
+  if (mRenderThreadRunning)
+  {
+    SetEvent(mRenderStopEvent);
+    WaitForSingleObject(mRenderThread, INFINITE);
+    CloseHandle(mRenderThread);
+    CloseHandle(mRenderStopEvent);
+    mRenderThread = mRenderStopEvent = 0;
+    mRenderThreadRunning = false;
+
+    // values queued until now are applied here, later ones go to the controls directly
+    wdl_atomic_decr(&mQueuePlugUpdates);
+    ApplyPlugUpdates();
+
+    // the draw buffer is up to date and presented directly again
+    SetAllControlsDirty();
+  }
+}
+
+DWORD WINAPI IGraphics::RenderThreadProc(LPVOID pParam)
+{
+  ((IGraphics*) pParam)->RenderThread();
+  return 0;
+}
+
+void IGraphics::RenderThread()
+{
+  DWORD period = IPMAX(1000 / IPMAX(mFPS, 1), 1);
+  DWORD next = GetTickCount() + period;
+  DWORD wait = period;
+
+  while (WaitForSingleObject(mRenderStopEvent, wait) == WAIT_TIMEOUT)
+  {
+    bool presented;
+    {
+      WDL_MutexLock lock(&mScreenMutex);
+      presented = mScreenRECT.Empty();
+    }
+
+    // if the OS hasn't shown the last frame yet, skip this one, dirty controls just wait
+    if (presented)
+    {
+      // never block on mMutex: the GUI thread may be stopping this thread while it holds it,
+      // e.g. Resize() called from a mouse handler
+      while (!mMutex.TryEnter())
+      {
+        if (WaitForSingleObject(mRenderStopEvent, 1) != WAIT_TIMEOUT)
+        {
+          return;
+        }
+      }
+
+      ApplyPlugUpdates();
+
+      IRECT r;
+      if (ControlsDirty(&r))
+      {
+        DrawControls(&r);
+
+        IRECT bounds(0, 0, Width(), Height());
+        r = r.Intersect(&bounds);
+        WDL_MutexLock screenLock(&mScreenMutex);
+        _LICE::LICE_Blit(mScreenBitmap, mDrawBitmap, r.L, r.T, r.L, r.T, r.W(), r.H(), 1.0f, LICE_BLIT_MODE_COPY);
+        mScreenRECT = mScreenRECT.Union(&r);
+      }
+      mMutex.Leave();
+    }
+
+    // frame pacing: when behind, drop the missed frames instead of catching up
+    next += period;
+    DWORD now = GetTickCount();
+    if ((int) (next - now) <= 0)
+    {
+      next = now + period;
+    }
+    wait = next - now;
+  }
+}
+
+IGraphics::IModalUnlock::IModalUnlock(IGraphics* pGraphics)
+  : mGraphics(pGraphics)
+  , mLocks(pGraphics->mEventLocks)
+{
+  // only the GUI thread changes mEventLocks, so if it is set this thread holds mMutex
+  mGraphics->mEventLocks = 0;
+  for (int i = 0; i < mLocks; ++i)
+  {
+    mGraphics->mMutex.Leave();
+  }
+}
+
+IGraphics::IModalUnlock::~IModalUnlock()
+{
+  for (int i = 0; i < mLocks; ++i)
+  {
+    mGraphics->mMutex.Enter();
+  }
+  mGraphics->mEventLocks = mLocks;
 }
 
 void IGraphics::SetStrictDrawing(bool strict)
@@ -852,6 +1412,7 @@ void IGraphics::SetStrictDrawing(bool strict)
 
 void IGraphics::OnMouseDown(int x, int y, IMouseMod* pMod)
 {
+  IEventLock lock(this);
   ReleaseMouseCapture();
   int c = GetMouseControlIdx(x, y);
   if (c >= 0)
@@ -869,6 +1430,7 @@ void IGraphics::OnMouseDown(int x, int y, IMouseMod* pMod)
       if (pMod->R && paramIdx >= 0)
       {
         ReleaseMouseCapture();
+        IModalUnlock unlock(this);
         mPlug->PopupHostContextMenuForParam(paramIdx, x, y);
         return;
       }
@@ -906,6 +1468,7 @@ void IGraphics::OnMouseDown(int x, int y, IMouseMod* pMod)
 
 void IGraphics::OnMouseUp(int x, int y, IMouseMod* pMod)
 {
+  IEventLock lock(this);
   int c = GetMouseControlIdx(x, y);
   mMouseCapture = mMouseX = mMouseY = -1;
   if (c >= 0)
@@ -923,6 +1486,7 @@ void IGraphics::OnMouseUp(int x, int y, IMouseMod* pMod)
 
 bool IGraphics::OnMouseOver(int x, int y, IMouseMod* pMod)
 {
+  IEventLock lock(this);
   if (mHandleMouseOver)
   {
     int c = GetMouseControlIdx(x, y, true);
@@ -943,6 +1507,7 @@ bool IGraphics::OnMouseOver(int x, int y, IMouseMod* pMod)
 
 void IGraphics::OnMouseOut()
 {
+  IEventLock lock(this);
   int i, n = mControls.GetSize();
   IControl** ppControl = mControls.GetList();
   for (i = 0; i < n; ++i, ++ppControl)
@@ -955,6 +1520,7 @@ void IGraphics::OnMouseOut()
 
 void IGraphics::OnMouseDrag(int x, int y, IMouseMod* pMod)
 {
+  IEventLock lock(this);
   int c = mMouseCapture;
   if (c >= 0)
   {
@@ -971,6 +1537,7 @@ void IGraphics::OnMouseDrag(int x, int y, IMouseMod* pMod)
 
 bool IGraphics::OnMouseDblClick(int x, int y, IMouseMod* pMod)
 {
+  IEventLock lock(this);
   ReleaseMouseCapture();
   bool newCapture = false;
   int c = GetMouseControlIdx(x, y);
@@ -995,6 +1562,7 @@ bool IGraphics::OnMouseDblClick(int x, int y, IMouseMod* pMod)
 
 void IGraphics::OnMouseWheel(int x, int y, IMouseMod* pMod, int d)
 {
+  IEventLock lock(this);
   int c = GetMouseControlIdx(x, y);
   if (c >= 0)
   {
@@ -1009,6 +1577,7 @@ void IGraphics::ReleaseMouseCapture()
 
 bool IGraphics::OnKeyDown(int x, int y, int key)
 {
+  IEventLock lock(this);
   int c = GetMouseControlIdx(x, y);
   if (c > 0)
     return mControls.Get(c)->OnKeyDown(x, y, key);
@@ -116,11 +116,22 @@ public:
 
   // Strict (default): draw everything within the smallest rectangle that contains everything dirty.
   // Every control is guaranteed to get no more than one Draw() call per cycle.
-  // Fast: draw only controls that intersect something dirty.
-  // If there are overlapping controls, fast drawing can generate multiple Draw() calls per cycle
-  // (a control may be asked to draw multiple parts of itself, if it intersects with something dirty.)
+  // Fast: draw only controls that intersect something dirty, clipped to the dirty regions.
+  // Each control still gets no more than one Draw() call per cycle, except controls covering the whole
+  // GUI (backgrounds), which are drawn once per region, clipped to it (mDrawRECT).
   void SetStrictDrawing(bool strict);
 
+  // Renders frames on a worker thread, paced at FPS(), into the draw bitmap, and copies finished
+  // frames to a screen bitmap. The OS timer and paint callbacks then only present the screen
+  // bitmap, so heavy drawing doesn't hold up UI events. Frames are skipped while the OS hasn't
+  // presented the previous one. The mouse and keyboard handlers lock mMutex against the render
+  // thread; other GUI thread code that changes controls should lock it too. The render thread only
+  // try-locks mMutex, so it can be stopped (e.g. by Resize()) from a handler. While it runs,
+  // SetParameterFromPlug() and SetControlFromPlug() record the latest value per parameter/control,
+  // which is applied before the next frame; controls shouldn't be touched from other threads directly.
+  void EnableRenderThread(bool enable);
+  bool RenderThreadEnabled() const { return mUseRenderThread; }
+
   virtual void* OpenWindow(void* pParentWnd) = 0;
   virtual void* OpenWindow(void* pParentWnd, void* pParentControl, short leftOffset = 0, short topOffset = 0) { return 0; } // For Carbon / RTAS... mega ugh!
 
@@ -261,6 +272,21 @@ protected:
   
   LICE_SysBitmap* mDrawBitmap;
   LICE_IFont* CacheFont(IText* pTxt);
+
+  // What DrawScreen() should put on the screen.
+  inline LICE_SysBitmap* GetScreenBitmap() const { return mRenderThreadRunning ? mScreenBitmap : mDrawBitmap; }
+  // Call before the window goes away, restarted by IsDirty() while enabled.
+  void StopRenderThread();
+
+  // Menus and dialogs that run a modal loop hold one of these meanwhile: it releases the lock a
+  // mouse or keyboard handler holds on mMutex, so the render thread isn't stalled.
+  struct IModalUnlock
+  {
+    IGraphics* mGraphics;
+    int mLocks;
+    IModalUnlock(IGraphics* pGraphics);
+    ~IModalUnlock();
+  };
   
 #ifdef AAX_API
   AAX_IViewContainer* mAAXViewContainer;  
@@ -273,6 +299,57 @@ private:
   int mMouseCapture, mMouseOver, mMouseX, mMouseY, mLastClickedParam;
   bool mHandleMouseOver, mStrict, mEnableTooltips, mShowControlBounds;
   IControl* mKeyCatcher;
+
+  // Non-strict drawing: a uniform grid over the GUI, each cell lists the controls that overlap
+  // it in z-order, so a dirty region only tests the controls near it.
+  void UpdateControlGrid();
+  void GetGridCells(IRECT* pR, int* pCol0, int* pRow0, int* pCol1, int* pRow1);
+  void AddDirtyRegion(IRECT* pR);
+  void RemoveDirtyRegion(int idx);
+  bool AssignControlsToRegions();
+
+  // Draws pControl clipped to pClip, using or rendering its cached layer if it has one.
+  void DrawControl(IControl* pControl, IRECT* pClip, bool fromLayer);
+  void InvalidateLayersOverDirty();
+  int FindLayerBase(IRECT* pR);     // the topmost control with a valid layer containing pR, or -1
+
+  bool ControlsDirty(IRECT* pR);
+  void DrawControls(IRECT* pR);
+
+  void StartRenderThread();
+  void RenderThread();
+  static DWORD WINAPI RenderThreadProc(LPVOID pParam);
+
+  // The mouse and keyboard handlers lock mMutex through this, counted for IModalUnlock.
+  struct IEventLock
+  {
+    IGraphics* mGraphics;
+    IEventLock(IGraphics* pGraphics) : mGraphics(pGraphics) { mGraphics->mMutex.Enter(); ++mGraphics->mEventLocks; }
+    ~IEventLock() { --mGraphics->mEventLocks; mGraphics->mMutex.Leave(); }
+  };
+  int mEventLocks;
+
+  void SetParamControlsFromPlug(int paramIdx, double normalizedValue);
+  void ApplyPlugUpdates();
+
+  bool mUseRenderThread, mRenderThreadRunning;
+  HANDLE mRenderThread, mRenderStopEvent;
+  LICE_SysBitmap* mScreenBitmap;            // the last finished frame
+  WDL_Mutex mScreenMutex;
+  IRECT mScreenRECT;                        // rendered but not yet presented
+  // Values from the plug (maybe the audio thread) while the render thread runs, lock free:
+  // the value is stored, then its counter and mPlugUpdatesPending are incremented.
+  int mQueuePlugUpdates, mPlugUpdatesPending;
+  WDL_TypedBuf<double> mParamUpdates, mControlUpdates;          // latest value from the plug while queued
+  WDL_TypedBuf<int> mParamUpdated, mControlUpdated;             // updates since the last ApplyPlugUpdates()
+
+  int mGridCols, mGridRows;
+  WDL_TypedBuf<IRECT> mGridRECTs;           // the control rects the grid was built from
+  WDL_TypedBuf<int> mGridCellStart;         // cell i lists mGridCellControls[start[i], start[i + 1])
+  WDL_TypedBuf<int> mGridCellControls;
+  WDL_TypedBuf<IRECT> mDirtyRegions;
+  WDL_TypedBuf<int> mControlRegion;         // per control, the region it is drawn in, -1, or -2 if in all
+  WDL_TypedBuf<int> mRegionBase;            // per region, FindLayerBase()
 };
 
 #endif
\ No newline at end of file
@@ -268,15 +268,16 @@ bool IGraphicsMac::DrawScreen(IRECT* pR)
   CGImageRef img=NULL;
   
 #ifdef IGRAPHICS_MAC_OLD_IMAGE_DRAWING
-  HDC__ * srcCtx = (HDC__*) mDrawBitmap->getDC();
+  HDC__ * srcCtx = (HDC__*) GetScreenBitmap()->getDC();
   img = CGBitmapContextCreateImage(srcCtx->ctx);
 #else
-  const unsigned char *p = (const unsigned char *)mDrawBitmap->getBits();
+  LICE_SysBitmap* pScreenBitmap = GetScreenBitmap();
+  const unsigned char *p = (const unsigned char *)pScreenBitmap->getBits();
   const unsigned char *retina_buf = NULL;
   
-  int sw = mDrawBitmap->getRowSpan();
-  int h = mDrawBitmap->getHeight();
-  int w = mDrawBitmap->getWidth();
+  int sw = pScreenBitmap->getRowSpan();
+  int h = pScreenBitmap->getHeight();
+  int w = pScreenBitmap->getWidth();
 #ifndef __ppc__
   if (CGContextConvertSizeToDeviceSpace(pCGC, CGSizeMake(1,1)).width > 1.9)
   {
@@ -426,6 +427,8 @@ void IGraphicsMac::RemoveSubWindow()
 
 void IGraphicsMac::CloseWindow()
 {
+  StopRenderThread();
+
   #ifndef IPLUG_NO_CARBON_SUPPORT
   if (mGraphicsCarbon)
   {
@@ -501,6 +504,7 @@ void IGraphicsMac::ShowMouseCursor()
 
 int IGraphicsMac::ShowMessageBox(const char* pText, const char* pCaption, int type)
 {
+  IModalUnlock unlock(this);
   int result = 0;
 
   CFStringRef defaultButtonTitle = NULL;
@@ -718,6 +722,7 @@ void IGraphicsMac::PromptForFile(WDL_String* pFilename, EFileAction action, WDL_
   }
 
   pFilename->Set(""); // reset it
+  IModalUnlock unlock(this);
 
   //if (CSTR_NOT_EMPTY(extensions))
   fileTypes = [[NSString stringWithUTF8String:extensions] componentsSeparatedByString: @" "];
@@ -792,6 +797,7 @@ bool IGraphicsMac::PromptForColor(IColor* pColor, char* prompt)
 IPopupMenu* IGraphicsMac::CreateIPopupMenu(IPopupMenu* pMenu, IRECT* pTextRect)
 {
   ReleaseMouseCapture();
+  IModalUnlock unlock(this);
 
   if (mGraphicsCocoa)
   {
@@ -88,6 +88,7 @@ LRESULT CALLBACK IGraphicsWin::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARA
 
         if (pGraphics->mParamEditWnd && pGraphics->mParamEditMsg != kNone)
         {
+          WDL_MutexLock lock(&pGraphics->mMutex);
           switch (pGraphics->mParamEditMsg)
           {
             case kCommit:
@@ -617,6 +618,7 @@ void IGraphicsWin::ShowMouseCursor()
 
 int IGraphicsWin::ShowMessageBox(const char* pText, const char* pCaption, int type)
 {
+  IModalUnlock unlock(this);
   return MessageBox(GetMainWnd(), pText, pCaption, type);
 }
 
@@ -625,7 +627,7 @@ bool IGraphicsWin::DrawScreen(IRECT* pR)
   PAINTSTRUCT ps;
   HWND hWnd = (HWND) GetWindow();
   HDC dc = BeginPaint(hWnd, &ps);
-  BitBlt(dc, pR->L, pR->T, pR->W(), pR->H(), mDrawBitmap->getDC(), pR->L, pR->T, SRCCOPY);
+  BitBlt(dc, pR->L, pR->T, pR->W(), pR->H(), GetScreenBitmap()->getDC(), pR->L, pR->T, SRCCOPY);
   EndPaint(hWnd, &ps);
   return true;
 }
@@ -765,6 +767,8 @@ void IGraphicsWin::SetWindowTitle(char* str)
 
 void IGraphicsWin::CloseWindow()
 {
+  StopRenderThread();
+
   if (mPlugWnd)
   {
     if (mTooltipWnd)
@@ -914,6 +918,7 @@ IPopupMenu* IGraphicsWin::CreateIPopupMenu(IPopupMenu* pMenu, IRECT* pAreaRect)
 
     ClientToScreen(mPlugWnd, &cPos);
 
+    IModalUnlock unlock(this);
     if (TrackPopupMenu(hMenu,
                        TPM_LEFTALIGN,
                        cPos.x,
@@ -1141,6 +1146,7 @@ void IGraphicsWin::PromptForFile(WDL_String* pFilename, EFileAction action, WDL_
   }
 
   bool rc = false;
+  IModalUnlock unlock(this);
   switch (action)
   {
     case kFileSave:
@@ -1206,6 +1212,7 @@ bool IGraphicsWin::PromptForColor(IColor* pColor, char* prompt)
   cc.lpfnHook = CCHookProc;
   cc.Flags = CC_RGBINIT | CC_ANYCOLOR | CC_FULLOPEN | CC_SOLIDCOLOR | CC_ENABLEHOOK;
 
+  IModalUnlock unlock(this);
   if (ChooseColor(&cc))
   {
     pColor->R = GetRValue(cc.rgbResult);
@@ -1220,6 +1227,7 @@ bool IGraphicsWin::PromptForColor(IColor* pColor, char* prompt)
 bool IGraphicsWin::OpenURL(const char* url,
                            const char* msgWindowTitle, const char* confirmMsg, const char* errMsgOnFailure)
 {
+  IModalUnlock unlock(this);
   if (confirmMsg && MessageBox(mPlugWnd, confirmMsg, msgWindowTitle, MB_YESNO) != IDYES)
   {
     return false;
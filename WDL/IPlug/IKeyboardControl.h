@@ -75,6 +75,12 @@ bool MyPlug::GetKeyStatus(int key)
 GetNumKeys() and GetKeyStatus() methods, i.e. "char GetNumKeys()" or
 "bool GetKeyStatus(char note)" will also work.)
 
+If the plug-in processes MIDI through an IMidiBlockQueue, the keyboard can
+inject its Note On/Off messages straight into that queue, instead of the
+plug-in polling GetKey() from the audio thread:
+
+((IKeyboardControl*)mKeyboard)->SetMidiQueue(&mMidiQueue);
+
 When the keyboard should be redrawn, e.g. when the plug-in has received a
 MIDI Note On/Off message, the plug-in should call mKeyboard->SetDirty().
 
@@ -87,13 +93,15 @@ been declared, so it is propbably best to include it in your plug-in's main
 
 */
 
+#include "IMidiQueue.h"
+
 class IKeyboardControl: public IControl
 {
 public:
   IKeyboardControl(IPlugBase* pPlug, int x, int y, int minNote, int nOctaves, IBitmap* pRegularKeys, IBitmap* pSharpKey, const int *pKeyCoords = 0):
     IControl(pPlug, IRECT(x, y, pRegularKeys), -1),
     mMinNote(minNote), mNumOctaves(nOctaves), mRegularKeys(*pRegularKeys), mSharpKey(*pSharpKey),
-    mOctaveWidth(pRegularKeys->W * 7), mMaxKey(nOctaves * 12), mKey(-1)
+    mOctaveWidth(pRegularKeys->W * 7), mMaxKey(nOctaves * 12), mKey(-1), mMidiQueue(0)
   {
     memcpy(mKeyCoords, pKeyCoords, 12 * sizeof(int));
     mRECT.R += nOctaves * mOctaveWidth;
@@ -111,6 +119,9 @@ public:
   // Returns the velocity as a floating point value.
   inline double GetReal() const { return mVelocity; }
 
+  // Sends Note On/Off messages for mouse played keys to pQueue (may be NULL).
+  inline void SetMidiQueue(IMidiBlockQueue* pQueue) { mMidiQueue = pQueue; }
+
   virtual void OnMouseDown(int x, int y, IMouseMod* pMod)
   {
     if (pMod->R) return;
@@ -121,7 +132,9 @@ public:
 
     if (((PLUG_CLASS_NAME*)mPlug)->GetKeyStatus(key + mMinNote)) return;
 
+    SendNoteOff();
     mKey = key;
+    SendNoteOn();
 
     //Update the keyboard in the GUI.
     SetDirty();
@@ -131,6 +144,7 @@ public:
   {
     // Skip if no key is playing.
     if (mKey < 0) return;
+    SendNoteOff();
     mKey = -1;
 
     // Update the keyboard in the GUI.
@@ -191,6 +205,22 @@ public:
   }
 
 protected:
+  void SendNoteOn()
+  {
+    if (!mMidiQueue || mKey < 0) return;
+    IMidiMsg msg;
+    msg.MakeNoteOnMsg(mKey + mMinNote, GetVelocity(), 0);
+    mMidiQueue->Inject(&msg);
+  }
+
+  void SendNoteOff()
+  {
+    if (!mMidiQueue || mKey < 0) return;
+    IMidiMsg msg;
+    msg.MakeNoteOffMsg(mKey + mMinNote, 0);
+    mMidiQueue->Inject(&msg);
+  }
+
   virtual void DrawKey(IGraphics* pGraphics, IRECT* pR, int key, int note, bool sharp)
   {
     if (sharp)
@@ -305,6 +335,7 @@ protected:
   int mOctaveWidth, mNumOctaves;
   int mKey, mMinNote, mMaxKey;
   double mVelocity;
+  IMidiBlockQueue* mMidiQueue;
 };
 
 
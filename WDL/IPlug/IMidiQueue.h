@@ -1,6 +1,12 @@
 #ifndef _IMIDIQUEUE_
 #define _IMIDIQUEUE_
 
+#include "../wdlatomic.h"
+
+#ifndef DEFAULT_BLOCK_SIZE
+#define DEFAULT_BLOCK_SIZE 1024
+#endif
+
 /*
 
 IMidiQueue
@@ -73,6 +79,40 @@ void MyPlug::ProcessDoubleReplacing(double** inputs, double** outputs, int nFram
   mMidiQueue.Flush(nFrames);
 }
 
+
+IMidiBlockQueue is a fixed-capacity alternative to IMidiQueue. All memory is
+allocated up front, so nothing is (re)allocated on the audio thread. It holds
+the events of one block sorted by sample offset, lets you iterate the events
+between two offsets, and has a lock-free Inject() for MIDI coming from any
+other thread, e.g. a GUI keyboard (see IKeyboardControl::SetMidiQueue()):
+
+IMidiBlockQueue mMidiQueue; // MyPlug member
+
+void MyPlug::ProcessMidiMsg(IMidiMsg* pMsg)
+{
+  mMidiQueue.Add(pMsg);
+}
+
+void MyPlug::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
+{
+  mMidiQueue.BeginBlock(nFrames);
+  for (int offset = 0; offset < nFrames; ++offset)
+  {
+    IMidiMsg* pMsg;
+    while ((pMsg = mMidiQueue.Next(offset)))
+    {
+      // To-do: Handle the MIDI message
+    }
+
+    // To-do: Process audio
+
+  }
+  mMidiQueue.EndBlock(nFrames);
+}
+
+Instead of Next() you can also fetch all events in [start, end) at once with
+GetEvents(), e.g. to render sub-blocks between events.
+
 */
 
 
@@ -198,4 +238,177 @@ protected:
 } WDL_FIXALIGN;
 
 
+class IMidiBlockQueue
+{
+public:
+  // size is the maximum number of events per block, injectSize the maximum
+  // number of injected events pending between two blocks (rounded up to a
+  // power of 2).
+  IMidiBlockQueue(int size = DEFAULT_BLOCK_SIZE, int injectSize = 256):
+    mBuf(NULL), mSize(0), mN(0), mCursor(0),
+    mInject(NULL), mInjectReady(NULL), mInjectMask(0), mInjectWrite(0), mInjectRead(0), mInjectUsed(0)
+  {
+    Resize(size);
+    int n = 1;
+    while (n < injectSize) n <<= 1;
+    mInject = (IMidiMsg*)malloc(n * sizeof(IMidiMsg));
+    mInjectReady = (int*)calloc(n, sizeof(int));
+    if (mInject && mInjectReady)
+    {
+      mInjectMask = n - 1;
+    }
+    else
+    {
+      free(mInject);
+      free(mInjectReady);
+      mInject = NULL;
+      mInjectReady = NULL;
+    }
+  }
+
+  ~IMidiBlockQueue()
+  {
+    free(mBuf);
+    free(mInject);
+    free(mInjectReady);
+  }
+
+  // Sets the maximum number of events per block. This reallocates, so don't
+  // call it from the audio thread; the constructor or OnActivate() are fine.
+  int Resize(int size)
+  {
+    if (size < 1) size = 1;
+    if (size == mSize) return mSize;
+    void* buf = realloc(mBuf, size * sizeof(IMidiMsg));
+    if (!buf) return mSize;
+    mBuf = (IMidiMsg*)buf;
+    mSize = size;
+    if (mN > mSize) mN = mSize;
+    if (mCursor > mN) mCursor = mN;
+    return mSize;
+  }
+
+  // Adds a MIDI message to the current block (audio thread only), keeping
+  // the events sorted by offset. Events with equal offsets keep their
+  // order. Returns false (and drops the message) if the block is full.
+  bool Add(const IMidiMsg* pMsg)
+  {
+    if (mN >= mSize) return false;
+    int i = mN;
+    if (i > 0 && pMsg->mOffset < mBuf[i - 1].mOffset)
+    {
+      i = Find(pMsg->mOffset + 1);
+      memmove(&mBuf[i + 1], &mBuf[i], (mN - i) * sizeof(IMidiMsg));
+    }
+    mBuf[i] = *pMsg;
+    ++mN;
+    return true;
+  }
+
+  // Queues a MIDI message from any thread (GUI, timer, another plug-in
+  // instance) without locking or allocating. It will be added to the next
+  // block by BeginBlock(). Returns false if the inject FIFO is full.
+  bool Inject(const IMidiMsg* pMsg)
+  {
+    if (!mInject) return false;
+    // Reserve room first, so the slot claimed below is guaranteed free.
+    if (wdl_atomic_incr(&mInjectUsed) > mInjectMask + 1)
+    {
+      wdl_atomic_decr(&mInjectUsed);
+      return false;
+    }
+    unsigned int slot = (unsigned int)(wdl_atomic_incr(&mInjectWrite) - 1) & (unsigned int)mInjectMask;
+    mInject[slot] = *pMsg;
+    wdl_atomic_incr(&mInjectReady[slot]); // publish
+    return true;
+  }
+
+  // Call at the start of the block: moves injected messages into the block
+  // (at their offset, clipped to the block) and rewinds Next().
+  void BeginBlock(int nFrames)
+  {
+    mCursor = 0;
+    if (!mInject) return;
+    // Stop when the block is full, the rest stays queued for the next one.
+    while (mN < mSize)
+    {
+      unsigned int slot = (unsigned int)mInjectRead & (unsigned int)mInjectMask;
+      // A producer that has claimed this slot but not yet written it will
+      // be picked up next block.
+      if (!wdl_atomic_get(&mInjectReady[slot])) break;
+      IMidiMsg msg = mInject[slot];
+      wdl_atomic_decr(&mInjectReady[slot]);
+      ++mInjectRead;
+      wdl_atomic_decr(&mInjectUsed);
+
+      if (msg.mOffset < 0) msg.mOffset = 0;
+      else if (msg.mOffset >= nFrames) msg.mOffset = nFrames > 0 ? nFrames - 1 : 0;
+      Add(&msg);
+    }
+  }
+
+  // Call at the end of the block: drops the events before nFrames, and
+  // moves any later events to the next block.
+  void EndBlock(int nFrames)
+  {
+    int i = Find(nFrames);
+    mN -= i;
+    if (mN > 0)
+    {
+      memmove(&mBuf[0], &mBuf[i], mN * sizeof(IMidiMsg));
+      for (int j = 0; j < mN; ++j) mBuf[j].mOffset -= nFrames;
+    }
+    mCursor = 0;
+  }
+
+  // Returns the next event at or before offset, or NULL if there is none.
+  inline IMidiMsg* Next(int offset)
+  {
+    if (mCursor < mN && mBuf[mCursor].mOffset <= offset) return &mBuf[mCursor++];
+    return NULL;
+  }
+
+  // Returns the events with startOffset <= mOffset < endOffset, *pN is set
+  // to their count.
+  IMidiMsg* GetEvents(int startOffset, int endOffset, int* pN)
+  {
+    int i = Find(startOffset);
+    int j = (endOffset > startOffset ? Find(endOffset) : i);
+    *pN = j - i;
+    return &mBuf[i];
+  }
+
+  // Returns the index of the first event with mOffset >= offset.
+  int Find(int offset) const
+  {
+    int lo = 0, hi = mN;
+    while (lo < hi)
+    {
+      int mid = (lo + hi) >> 1;
+      if (mBuf[mid].mOffset < offset) lo = mid + 1;
+      else hi = mid;
+    }
+    return lo;
+  }
+
+  inline int NEvents() const { return mN; }
+  inline IMidiMsg* Get(int idx) const { return &mBuf[idx]; }
+  inline int GetSize() const { return mSize; }
+  inline bool Empty() const { return mN == 0; }
+
+  // Clears the current block (audio thread only, injected messages are
+  // kept).
+  inline void Clear() { mN = mCursor = 0; }
+
+protected:
+  IMidiMsg* mBuf;
+  int mSize, mN, mCursor;
+
+  IMidiMsg* mInject;
+  int* mInjectReady;
+  int mInjectMask;
+  int mInjectWrite, mInjectRead, mInjectUsed;
+} WDL_FIXALIGN;
+
+
 #endif // _IMIDIQUEUE_
@@ -1,6 +1,11 @@
 #include "IParam.h"
+#include "IPlugOSDetect.h"
 #include <stdio.h>
 
+#ifdef IPLUG_SSE2
+  #include <emmintrin.h>
+#endif
+
 IParam::IParam()
   : mType(kTypeNone)
   , mValue(0.0)
@@ -10,9 +15,22 @@ IParam::IParam()
   , mDisplayPrecision(0)
   , mNegateDisplay(false)
   , mShape(1.0)
+  , mShapePow(1)
+  , mShapeSqrt(false)
+  , mInvShape(1.0)
   , mCanAutomate(true)
   , mDefault(0.)
   , mIsMeta(false)
+  , mSmoothMode(kSmoothNone)
+  , mSmoothMoving(false)
+  , mSmoothRemaining(0)
+  , mSmoothTimeMs(20.)
+  , mSampleRate(44100.)
+  , mSmoothTarget(0.)
+  , mSmoothCurrent(0.)
+  , mSmoothInc(0.)
+  , mSmoothCoef(0.)
+  , mSmoothAmp(1.)
 {
   memset(mName, 0, MAX_PARAM_NAME_LEN * sizeof(char));
   memset(mLabel, 0, MAX_PARAM_LABEL_LEN * sizeof(char));
@@ -72,6 +90,22 @@ void IParam::SetShape(double shape)
 {
   if(shape != 0.0)
     mShape = shape;
+
+  mInvShape = 1.0 / mShape;
+  mShapeSqrt = (mShape == 2.0);
+  // x * x is correctly rounded like pow(x, 2), repeated multiplies for higher powers are not
+  mShapePow = (mShape == 1.0 || mShape == 2.0) ? (int) mShape : 0;
+}
+
+// x^shape
+static inline double ShapePow(double x, int shapePow, double shape)
+{
+  switch (shapePow)
+  {
+    case 1: return x;
+    case 2: return x * x;
+  }
+  return pow(x, shape);
 }
 
 void IParam::SetDisplayText(int value, const char* text)
@@ -90,7 +124,7 @@ double IParam::DBToAmp()
 
 void IParam::SetNormalized(double normalizedValue)
 {
-  mValue = FromNormalizedParam(normalizedValue, mMin, mMax, mShape);
+  mValue = GetNonNormalized(normalizedValue);
   
   if (mType != kTypeDouble)
   {
@@ -108,17 +142,78 @@ double IParam::GetNormalized()
 double IParam::GetNormalized(double nonNormalizedValue)
 {
   nonNormalizedValue = BOUNDED(nonNormalizedValue, mMin, mMax);
-  return ToNormalizedParam(nonNormalizedValue, mMin, mMax, mShape);
+  double x = (nonNormalizedValue - mMin) / (mMax - mMin);
+  if (mShapePow == 1) return x;
+  return mShapeSqrt ? sqrt(x) : pow(x, mInvShape);
 }
 
 double IParam::GetNonNormalized(double normalizedValue)
 {
-  return FromNormalizedParam(normalizedValue, mMin, mMax, mShape);
+  return mMin + ShapePow(normalizedValue, mShapePow, mShape) * (mMax - mMin);
+}
+
+void IParam::GetNormalized(const double* pNonNormalized, double* pNormalized, int n)
+{
+  // divides like GetNormalized(double), so both give the same results
+  const double min = mMin, range = mMax - mMin;
+  int i = 0;
+
+  if (mShapePow == 1)
+  {
+    #ifdef IPLUG_SSE2
+    const __m128d vmin = _mm_set1_pd(mMin), vmax = _mm_set1_pd(mMax), vrange = _mm_set1_pd(range);
+    for (; i + 2 <= n; i += 2)
+    {
+      __m128d v = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(pNonNormalized + i), vmin), vmax);
+      _mm_storeu_pd(pNormalized + i, _mm_div_pd(_mm_sub_pd(v, vmin), vrange));
+    }
+    #endif
+    for (; i < n; ++i)
+    {
+      pNormalized[i] = (BOUNDED(pNonNormalized[i], mMin, mMax) - min) / range;
+    }
+    return;
+  }
+
+  for (; i < n; ++i)
+  {
+    double x = (BOUNDED(pNonNormalized[i], mMin, mMax) - min) / range;
+    pNormalized[i] = mShapeSqrt ? sqrt(x) : pow(x, mInvShape);
+  }
+}
+
+void IParam::GetNonNormalized(const double* pNormalized, double* pNonNormalized, int n)
+{
+  const double min = mMin, range = mMax - mMin;
+  int i = 0;
+
+  if (mShapePow)
+  {
+    #ifdef IPLUG_SSE2
+    const __m128d vmin = _mm_set1_pd(min), vrange = _mm_set1_pd(range);
+    for (; i + 2 <= n; i += 2)
+    {
+      __m128d x = _mm_loadu_pd(pNormalized + i), y = x;
+      for (int k = 1; k < mShapePow; ++k) y = _mm_mul_pd(y, x);
+      _mm_storeu_pd(pNonNormalized + i, _mm_add_pd(vmin, _mm_mul_pd(y, vrange)));
+    }
+    #endif
+    for (; i < n; ++i)
+    {
+      pNonNormalized[i] = min + ShapePow(pNormalized[i], mShapePow, mShape) * range;
+    }
+    return;
+  }
+
+  for (; i < n; ++i)
+  {
+    pNonNormalized[i] = min + pow(pNormalized[i], mShape) * range;
+  }
 }
 
 void IParam::GetDisplayForHost(double value, bool normalized, char* rDisplay, bool withDisplayText)
 {
-  if (normalized) value = FromNormalizedParam(value, mMin, mMax, mShape);
+  if (normalized) value = GetNonNormalized(value);
 
   if (withDisplayText)
   {
@@ -219,6 +314,167 @@ bool IParam::MapDisplayText(char* str, int* pValue)
   return false;
 }
 
+// buf[i] = start + inc * (i + 1)
+static void RampLinear(double* buf, double start, double inc, int n)
+{
+  int i = 0;
+  #ifdef IPLUG_SSE2
+  __m128d v = _mm_set_pd(start + 2. * inc, start + inc);
+  __m128d step = _mm_set1_pd(2. * inc);
+  for (; i + 2 <= n; i += 2)
+  {
+    _mm_storeu_pd(buf + i, v);
+    v = _mm_add_pd(v, step);
+  }
+  #endif
+  for (; i < n; ++i)
+  {
+    buf[i] = start + inc * (double) (i + 1);
+  }
+}
+
+// buf[i] = offset + scale * ratio^(i + 1)
+static void RampGeometric(double* buf, double offset, double scale, double ratio, int n)
+{
+  int i = 0;
+  #ifdef IPLUG_SSE2
+  __m128d v = _mm_set_pd(scale * ratio * ratio, scale * ratio);
+  __m128d step = _mm_set1_pd(ratio * ratio);
+  __m128d off = _mm_set1_pd(offset);
+  for (; i + 2 <= n; i += 2)
+  {
+    _mm_storeu_pd(buf + i, _mm_add_pd(off, v));
+    v = _mm_mul_pd(v, step);
+  }
+  if (i < n)
+  {
+    double last[2];
+    _mm_storeu_pd(last, v);
+    buf[i++] = offset + last[0];
+  }
+  #else
+  double v = scale;
+  for (; i < n; ++i)
+  {
+    v *= ratio;
+    buf[i] = offset + v;
+  }
+  #endif
+}
+
+static void FillConstant(double* buf, double value, int n)
+{
+  for (int i = 0; i < n; ++i)
+  {
+    buf[i] = value;
+  }
+}
+
+void IParam::SetSmoothing(ESmoothing mode, double timeMs)
+{
+  mSmoothMode = mode;
+  mSmoothTimeMs = IPMAX(timeMs, 0.);
+  PrepareSmoothing(mSampleRate, mSmoothBuf.GetSize());
+}
+
+void IParam::PrepareSmoothing(double sampleRate, int maxBlockSize)
+{
+  if (sampleRate > 0.) mSampleRate = sampleRate;
+  if (mSmoothMode == kSmoothNone) return;
+
+  if (maxBlockSize > mSmoothBuf.GetSize())
+  {
+    mSmoothBuf.Resize(maxBlockSize);
+  }
+
+  // one pole coefficient per sample for the time constant
+  double samples = mSmoothTimeMs * 0.001 * mSampleRate;
+  mSmoothCoef = (samples > 1. ? exp(-1. / samples) : 0.);
+
+  mSmoothTarget = mSmoothCurrent = mValue;
+  mSmoothAmp = ::DBToAmp(mValue);
+  mSmoothRemaining = 0;
+  mSmoothMoving = false;
+}
+
+void IParam::SmoothBlock(int nFrames)
+{
+  if (mSmoothMode == kSmoothNone) return;
+
+  double target = mValue;
+
+  if (target == mSmoothTarget && !mSmoothRemaining && mSmoothCurrent == target)
+  {
+    mSmoothMoving = false; // the idle case, nothing to compute
+    return;
+  }
+
+  if (nFrames > mSmoothBuf.GetSize())
+  {
+    // never allocates here, IPlugBase splits blocks to fit: otherwise jump to the target
+    mSmoothTarget = mSmoothCurrent = target;
+    mSmoothAmp = ::DBToAmp(target);
+    mSmoothRemaining = 0;
+    mSmoothMoving = false;
+    return;
+  }
+  double* buf = mSmoothBuf.Get();
+  mSmoothMoving = true;
+
+  if (mSmoothMode == kSmoothExp)
+  {
+    mSmoothTarget = target;
+    double diff = mSmoothCurrent - target;
+    RampGeometric(buf, target, diff, mSmoothCoef, nFrames);
+    mSmoothCurrent = (nFrames > 0 ? buf[nFrames - 1] : mSmoothCurrent);
+
+    if (fabs(mSmoothCurrent - target) <= 1e-6 * IPMAX(mMax - mMin, 1e-3))
+    {
+      mSmoothCurrent = target; // close enough, idle from the next block
+    }
+    return;
+  }
+
+  // linear ramps restart from the current value when the target changes
+  if (target != mSmoothTarget)
+  {
+    mSmoothTarget = target;
+    mSmoothRemaining = IPMAX(int(mSmoothTimeMs * 0.001 * mSampleRate + 0.5), 1);
+    mSmoothInc = (target - mSmoothCurrent) / (double) mSmoothRemaining;
+  }
+
+  int n = IPMIN(nFrames, mSmoothRemaining);
+
+  if (mSmoothMode == kSmoothDB)
+  {
+    RampGeometric(buf, 0., mSmoothAmp, ::DBToAmp(mSmoothInc), n);
+  }
+  else
+  {
+    RampLinear(buf, mSmoothCurrent, mSmoothInc, n);
+  }
+
+  mSmoothRemaining -= n;
+  if (mSmoothRemaining)
+  {
+    mSmoothCurrent += mSmoothInc * (double) n;
+  }
+  else
+  {
+    mSmoothCurrent = target;
+  }
+
+  if (mSmoothMode == kSmoothDB)
+  {
+    mSmoothAmp = (mSmoothRemaining && n ? buf[n - 1] : ::DBToAmp(mSmoothCurrent));
+    FillConstant(buf + n, mSmoothAmp, nFrames - n);
+  }
+  else
+  {
+    FillConstant(buf + n, mSmoothCurrent, nFrames - n);
+  }
+}
+
 void IParam::GetBounds(double* pMin, double* pMax)
 {
   *pMin = mMin;
@@ -11,11 +11,13 @@
 
 inline double ToNormalizedParam(double nonNormalizedValue, double min, double max, double shape)
 {
+  if (shape == 1.0) return (nonNormalizedValue - min) / (max - min);
   return pow((nonNormalizedValue - min) / (max - min), 1.0 / shape);
 }
 
 inline double FromNormalizedParam(double normalizedValue, double min, double max, double shape)
 {
+  if (shape == 1.0) return min + normalizedValue * (max - min);
   return min + pow((double) normalizedValue, shape) * (max - min);
 }
 
@@ -23,6 +25,7 @@ class IParam
 {
 public:
   enum EParamType { kTypeNone, kTypeBool, kTypeInt, kTypeEnum, kTypeDouble };
+  enum ESmoothing { kSmoothNone, kSmoothLinear, kSmoothExp, kSmoothDB };
 
   IParam();
   ~IParam();
@@ -60,6 +63,9 @@ public:
   double GetNormalized();
   double GetNormalized(double nonNormalizedValue);
   double GetNonNormalized(double normalizedValue);
+  // Batch versions, e.g. for a block of automation. The arrays may be the same.
+  void GetNormalized(const double* pNonNormalized, double* pNormalized, int n);
+  void GetNonNormalized(const double* pNormalized, double* pNonNormalized, int n);
 
   void GetDisplayForHost(char* rDisplay) { GetDisplayForHost(mValue, false, rDisplay); }
   void GetDisplayForHostNoDisplayText(char* rDisplay) { GetDisplayForHost(mValue, false, rDisplay, false); }
@@ -76,7 +82,7 @@ public:
   const double GetShape() {return mShape;}
   const double GetStep() {return mStep;}
   const double GetDefault() {return mDefault;}
-  const double GetDefaultNormalized() {return ToNormalizedParam(mDefault, mMin, mMax, mShape);}
+  const double GetDefaultNormalized() {return GetNormalized(mDefault);}
   const double GetMin() {return mMin;}
   const double GetMax() {return mMax;}
   const double GetRange() {return mMax - mMin;}
@@ -84,11 +90,31 @@ public:
   bool GetCanAutomate() { return mCanAutomate; }
   bool GetIsMeta() { return mIsMeta; }
 
+  // Opt-in smoothing for audio rate use, call from the plug constructor.
+  // kSmoothLinear ramps to each new value in timeMs, kSmoothExp is a one pole with a timeMs time constant,
+  // kSmoothDB treats the value as dB and ramps linearly in dB over timeMs, the smoothed output is amplitude.
+  // IPlugBase computes the ramp before each ProcessDoubleReplacing (or sub-block).
+  void SetSmoothing(ESmoothing mode, double timeMs = 20.);
+  ESmoothing GetSmoothing() const { return mSmoothMode; }
+  // Per frame values for the current block, or NULL if the param isn't moving (use GetSmoothedValue()).
+  const double* GetSmoothedBlock() const { return mSmoothMoving ? mSmoothBuf.Get() : 0; }
+  // Value at the end of the current block, amplitude for kSmoothDB.
+  double GetSmoothedValue() const { return mSmoothMode == kSmoothDB ? mSmoothAmp : mSmoothCurrent; }
+
+  // Called by IPlugBase. PrepareSmoothing jumps to the current value and sizes the ramp buffer (not on the
+  // audio thread), SmoothBlock never allocates and doesn't ramp blocks longer than maxBlockSize.
+  void PrepareSmoothing(double sampleRate, int maxBlockSize);
+  void SmoothBlock(int nFrames);
+
 private:
   // All we store is the readable values.
   // SetFromHost() and GetForHost() handle conversion from/to (0,1).
   EParamType mType;
   double mValue, mMin, mMax, mStep, mShape, mDefault;
+  // SetShape() picks the cheapest exact form of x^shape and x^(1/shape)
+  int mShapePow; // 1 is linear, 2 is x * x, 0 uses pow()
+  bool mShapeSqrt; // shape == 2, so x^(1/shape) is sqrt()
+  double mInvShape;
   int mDisplayPrecision;
   char mName[MAX_PARAM_NAME_LEN];
   char mLabel[MAX_PARAM_LABEL_LEN];
@@ -97,6 +123,13 @@ private:
   bool mSignDisplay;
   bool mCanAutomate;
   bool mIsMeta;
+
+  ESmoothing mSmoothMode;
+  bool mSmoothMoving;
+  int mSmoothRemaining; // linear and dB ramps
+  double mSmoothTimeMs, mSampleRate;
+  double mSmoothTarget, mSmoothCurrent, mSmoothInc, mSmoothCoef, mSmoothAmp; // mSmoothCurrent is in dB for kSmoothDB
+  WDL_TypedBuf<double> mSmoothBuf;
   
   struct DisplayText
   {
@@ -131,6 +131,7 @@ IPlugAAX::IPlugAAX(IPlugInstanceInfo instanceInfo,
   if (NInChannels()) 
   {
     mDelay = new NChanDelayLine(NInChannels(), NOutChannels());
+    mDelay->SetMaxDelayTime(latency);
     mDelay->SetDelayTime(latency);
   }
   
@@ -258,8 +259,6 @@ AAX_Result IPlugAAX::UpdateParameterNormalizedValue(AAX_CParamID iParameterID, d
   
   if ((paramIdx >= 0) && (paramIdx < NParams())) 
   {
-    IMutexLock lock(this);
-    
     GetParam(paramIdx)->SetNormalized(iValue);
     
     if (GetGUI())
@@ -267,7 +266,7 @@ AAX_Result IPlugAAX::UpdateParameterNormalizedValue(AAX_CParamID iParameterID, d
       GetGUI()->SetParameterFromPlug(paramIdx, iValue, true);
     }
     
-    OnParamChange(paramIdx);      
+    QueueParamChange(paramIdx);
   }
   
   // Now the control has changed
@@ -282,7 +281,7 @@ void IPlugAAX::RenderAudio(AAX_SIPlugRenderInfo* ioRenderInfo)
 {
   TRACE_PROCESS;
 
-  IMutexLock lock(this);
+  FlushParamChanges();
 
   // Get bypass parameter value
   bool bypass;
@@ -530,8 +529,4 @@ void IPlugAAX::SetLatency(int latency)
   IPlugBase::SetLatency(latency); // will update delay time
 }
 
-// TODO: SendMidiMsg()
-bool IPlugAAX::SendMidiMsg(IMidiMsg* pMsg)
-{
-  return false;
-}
\ No newline at end of file
+// TODO: SendMidiOutput(), needs a MIDI output node in the render context
\ No newline at end of file
@@ -88,9 +88,6 @@ public:
   void SetLatency(int samples);
   void DirtyPTCompareState() { mNumPlugInChanges++; }
   
-protected:
-  bool SendMidiMsg(IMidiMsg* pMsg);
-
 private:
   AAX_CParameter<bool>* mBypassParameter;
   AAX_ITransport* mTransport;
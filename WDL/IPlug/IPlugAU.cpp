@@ -4,6 +4,7 @@
 #include "Hosts.h"
 
 #include "dfx/dfx-au-utilities.h"
+#include <CoreMIDI/MIDIServices.h>
 
 #define kAudioUnitRemovePropertyListenerWithUserDataSelect 0x0012
 
@@ -85,6 +86,82 @@ ComponentResult IPlugAU::IPlugAUEntry(ComponentParameters *params, void* pPlug)
     return noErr;
   }
 
+  // Selects that can come from the render thread don't take the mutex.
+  switch (select)
+  {
+    case kAudioUnitGetParameterSelect:
+    {
+      AudioUnitParameterID paramID = GET_COMP_PARAM(AudioUnitParameterID, 3, 4);
+      AudioUnitScope scope = GET_COMP_PARAM(AudioUnitScope, 2, 4);
+      AudioUnitElement element = GET_COMP_PARAM(AudioUnitElement, 1, 4);
+      AudioUnitParameterValue* pValue = GET_COMP_PARAM(AudioUnitParameterValue*, 0, 4);
+      return GetParamProc(pPlug, paramID, scope, element, pValue);
+    }
+    case kAudioUnitSetParameterSelect:
+    {
+      AudioUnitParameterID paramID = GET_COMP_PARAM(AudioUnitParameterID, 4, 5);
+      AudioUnitScope scope = GET_COMP_PARAM(AudioUnitScope, 3, 5);
+      AudioUnitElement element = GET_COMP_PARAM(AudioUnitElement, 2, 5);
+      AudioUnitParameterValue value = GET_COMP_PARAM(AudioUnitParameterValue, 1, 5);
+      UInt32 offset = GET_COMP_PARAM(UInt32, 0, 5);
+      return SetParamProc(pPlug, paramID, scope, element, value, offset);
+    }
+    case kAudioUnitScheduleParametersSelect:
+    {
+      AudioUnitParameterEvent* pEvent = GET_COMP_PARAM(AudioUnitParameterEvent*, 1, 2);
+      UInt32 nEvents = GET_COMP_PARAM(UInt32, 0, 2);
+      // scheduled on the render thread for the coming render call, so these can be sample accurate
+      for (int i = 0; i < nEvents; ++i, ++pEvent)
+      {
+        if (pEvent->eventType == kParameterEvent_Immediate)
+        {
+          if (pEvent->scope != kAudioUnitScope_Global)
+          {
+            return kAudioUnitErr_InvalidProperty;
+          }
+          if (pEvent->parameter >= _this->NParams())
+          {
+            return kAudioUnitErr_InvalidParameter;
+          }
+          AudioUnitParameterValue value = pEvent->eventValues.immediate.value;
+          _this->AddParamChange(pEvent->parameter, _this->GetParam(pEvent->parameter)->GetNormalized(value),
+                                pEvent->eventValues.immediate.bufferOffset);
+          if (_this->GetGUI())
+          {
+            _this->GetGUI()->SetParameterFromPlug(pEvent->parameter, value, false);
+          }
+        }
+      }
+      return noErr;
+    }
+    case kAudioUnitRenderSelect:
+    {
+      AudioUnitRenderActionFlags* pFlags = GET_COMP_PARAM(AudioUnitRenderActionFlags*, 4, 5);
+      const AudioTimeStamp* pTimestamp = GET_COMP_PARAM(AudioTimeStamp*, 3, 5);
+      UInt32 outputBusIdx = GET_COMP_PARAM(UInt32, 2, 5);
+      UInt32 nFrames = GET_COMP_PARAM(UInt32, 1, 5);
+      AudioBufferList* pBufferList = GET_COMP_PARAM(AudioBufferList*, 0, 5);
+      return RenderProc(_this, pFlags, pTimestamp, outputBusIdx, nFrames, pBufferList);
+    }
+    case kMusicDeviceMIDIEventSelect: {
+      IMidiMsg msg;
+      msg.mStatus = GET_COMP_PARAM(UInt32, 3, 4);
+      msg.mData1 = GET_COMP_PARAM(UInt32, 2, 4);
+      msg.mData2 = GET_COMP_PARAM(UInt32, 1, 4);
+      msg.mOffset = GET_COMP_PARAM(UInt32, 0, 4);
+      _this->ProcessMidiMsg(&msg);
+      return noErr;
+    }
+    case kMusicDeviceSysExSelect: {
+      ISysEx sysex;
+      sysex.mData = GET_COMP_PARAM(UInt8*, 1, 2);
+      sysex.mSize = GET_COMP_PARAM(UInt32, 0, 2);
+      sysex.mOffset = 0;
+      _this->ProcessSysEx(&sysex);
+      return noErr;
+    }
+  }
+
   IPlugBase::IMutexLock lock(_this);
 
   switch (select)
@@ -100,7 +177,8 @@ ComponentResult IPlugAU::IPlugAUEntry(ComponentParameters *params, void* pPlug)
         return badComponentSelector;
       }
       _this->mActive = true;
-      _this->OnParamReset();
+      _this->QueueParamReset();
+      _this->FlushParamChanges(); // no render calls before initialization completes
       _this->OnActivate(true);
       return noErr;
     }
@@ -235,72 +313,11 @@ ComponentResult IPlugAU::IPlugAUEntry(ComponentParameters *params, void* pPlug)
       }
       return noErr;
     }
-    case kAudioUnitGetParameterSelect:
-    {
-      AudioUnitParameterID paramID = GET_COMP_PARAM(AudioUnitParameterID, 3, 4);
-      AudioUnitScope scope = GET_COMP_PARAM(AudioUnitScope, 2, 4);
-      AudioUnitElement element = GET_COMP_PARAM(AudioUnitElement, 1, 4);
-      AudioUnitParameterValue* pValue = GET_COMP_PARAM(AudioUnitParameterValue*, 0, 4);
-      return GetParamProc(pPlug, paramID, scope, element, pValue);
-    }
-    case kAudioUnitSetParameterSelect:
-    {
-      AudioUnitParameterID paramID = GET_COMP_PARAM(AudioUnitParameterID, 4, 5);
-      AudioUnitScope scope = GET_COMP_PARAM(AudioUnitScope, 3, 5);
-      AudioUnitElement element = GET_COMP_PARAM(AudioUnitElement, 2, 5);
-      AudioUnitParameterValue value = GET_COMP_PARAM(AudioUnitParameterValue, 1, 5);
-      UInt32 offset = GET_COMP_PARAM(UInt32, 0, 5);
-      return SetParamProc(pPlug, paramID, scope, element, value, offset);
-    }
-    case kAudioUnitScheduleParametersSelect:
-    {
-      AudioUnitParameterEvent* pEvent = GET_COMP_PARAM(AudioUnitParameterEvent*, 1, 2);
-      UInt32 nEvents = GET_COMP_PARAM(UInt32, 0, 2);
-      for (int i = 0; i < nEvents; ++i, ++pEvent)
-      {
-        if (pEvent->eventType == kParameterEvent_Immediate)
-        {
-          ComponentResult r = SetParamProc(pPlug, pEvent->parameter, pEvent->scope, pEvent->element,
-                                           pEvent->eventValues.immediate.value, pEvent->eventValues.immediate.bufferOffset);
-          if (r != noErr)
-          {
-            return r;
-          }
-        }
-      }
-      return noErr;
-    }
-    case kAudioUnitRenderSelect:
-    {
-      AudioUnitRenderActionFlags* pFlags = GET_COMP_PARAM(AudioUnitRenderActionFlags*, 4, 5);
-      const AudioTimeStamp* pTimestamp = GET_COMP_PARAM(AudioTimeStamp*, 3, 5);
-      UInt32 outputBusIdx = GET_COMP_PARAM(UInt32, 2, 5);
-      UInt32 nFrames = GET_COMP_PARAM(UInt32, 1, 5);
-      AudioBufferList* pBufferList = GET_COMP_PARAM(AudioBufferList*, 0, 5);
-      return RenderProc(_this, pFlags, pTimestamp, outputBusIdx, nFrames, pBufferList);
-    }
     case kAudioUnitResetSelect:
     {
       _this->Reset();
       return noErr;
     }
-    case kMusicDeviceMIDIEventSelect: {
-      IMidiMsg msg;
-      msg.mStatus = GET_COMP_PARAM(UInt32, 3, 4);
-      msg.mData1 = GET_COMP_PARAM(UInt32, 2, 4);
-      msg.mData2 = GET_COMP_PARAM(UInt32, 1, 4);
-      msg.mOffset = GET_COMP_PARAM(UInt32, 0, 4);
-      _this->ProcessMidiMsg(&msg);
-      return noErr;
-    }
-    case kMusicDeviceSysExSelect: {
-      ISysEx sysex;
-      sysex.mData = GET_COMP_PARAM(UInt8*, 1, 2);
-      sysex.mSize = GET_COMP_PARAM(UInt32, 0, 2);
-      sysex.mOffset = 0;
-      _this->ProcessSysEx(&sysex);
-      return noErr;
-    }
     case kMusicDevicePrepareInstrumentSelect: {
       return noErr;
     }
@@ -1066,8 +1083,36 @@ ComponentResult IPlugAU::GetProperty(AudioUnitPropertyID propID, AudioUnitScope
 
 #if MAC_OS_X_VERSION_MAX_ALLOWED > MAC_OS_X_VERSION_10_4
     NO_OP(kAudioUnitProperty_AUHostIdentifier);           // 46,
-    NO_OP(kAudioUnitProperty_MIDIOutputCallbackInfo);     // 47,
-    NO_OP(kAudioUnitProperty_MIDIOutputCallback);         // 48,
+    case kAudioUnitProperty_MIDIOutputCallbackInfo:       // 47,
+    {
+      ASSERT_SCOPE(kAudioUnitScope_Global);
+      if (!DoesMIDI())
+      {
+        return kAudioUnitErr_InvalidProperty;
+      }
+      *pDataSize = sizeof(CFArrayRef);
+      if (pData)
+      {
+        CFStringRef outputName = CFSTR("MIDI Output");
+        *((CFArrayRef*) pData) = CFArrayCreate(0, (const void**) &outputName, 1, 0);
+      }
+      return noErr;
+    }
+    case kAudioUnitProperty_MIDIOutputCallback:           // 48,
+    {
+      ASSERT_SCOPE(kAudioUnitScope_Global);
+      if (!DoesMIDI())
+      {
+        return kAudioUnitErr_InvalidProperty;
+      }
+      *pDataSize = sizeof(AUMIDIOutputCallbackStruct);
+      *pWriteable = true;
+      if (pData)
+      {
+        *((AUMIDIOutputCallbackStruct*) pData) = mMidiCallback;
+      }
+      return noErr;
+    }
     NO_OP(kAudioUnitProperty_InputSamplesInOutput);       // 49,
     NO_OP(kAudioUnitProperty_ClassInfoFromDocument);      // 50
 #endif
@@ -1267,7 +1312,12 @@ ComponentResult IPlugAU::SetProperty(AudioUnitPropertyID propID, AudioUnitScope
       return noErr;
     }
     NO_OP(kAudioUnitProperty_MIDIOutputCallbackInfo);   // 47,
-    NO_OP(kAudioUnitProperty_MIDIOutputCallback);       // 48,
+    case kAudioUnitProperty_MIDIOutputCallback:          // 48,
+    {
+      ASSERT_SCOPE(kAudioUnitScope_Global);
+      mMidiCallback = *((AUMIDIOutputCallbackStruct*) pData);
+      return noErr;
+    }
     NO_OP(kAudioUnitProperty_InputSamplesInOutput);       // 49,
     NO_OP(kAudioUnitProperty_ClassInfoFromDocument)       // 50
 #endif
@@ -1577,7 +1627,6 @@ ComponentResult IPlugAU::GetParamProc(void* pPlug, AudioUnitParameterID paramID,
 
   ASSERT_SCOPE(kAudioUnitScope_Global);
   IPlugAU* _this = (IPlugAU*) pPlug;
-  IMutexLock lock(_this);
   *pValue = _this->GetParam(paramID)->Value();
   return noErr;
 }
@@ -1591,14 +1640,13 @@ ComponentResult IPlugAU::SetParamProc(void* pPlug, AudioUnitParameterID paramID,
   // In the SDK, offset frames is only looked at in group scope.
   ASSERT_SCOPE(kAudioUnitScope_Global);
   IPlugAU* _this = (IPlugAU*) pPlug;
-  IMutexLock lock(_this);
   IParam* pParam = _this->GetParam(paramID);
   pParam->Set(value);
   if (_this->GetGUI())
   {
     _this->GetGUI()->SetParameterFromPlug(paramID, value, false);
   }
-  _this->OnParamChange(paramID);
+  _this->QueueParamChange(paramID);
   return noErr;
 }
 
@@ -1759,6 +1807,9 @@ ComponentResult IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFl
       _this->SetOutputChannelConnections(nConnected, totalNumChans - nConnected, false); // this will disconnect the channels that are on the unconnected buses
     }
 
+    _this->FlushParamChanges();
+    _this->mMidiOutputTimeStamp = pTimestamp;
+
     if (_this->mIsBypassed)
     {
       _this->PassThroughBuffers((AudioSampleType) 0, nFrames);
@@ -1767,6 +1818,8 @@ ComponentResult IPlugAU::RenderProc(void* pPlug, AudioUnitRenderActionFlags* pFl
     {
       _this->ProcessBuffers((AudioSampleType) 0, nFrames);
     }
+
+    _this->mMidiOutputTimeStamp = 0;
   }
 
   if (nRenderNotify)
@@ -1861,6 +1914,12 @@ IPlugAU::IPlugAU(IPlugInstanceInfo instanceInfo,
 
   memset(&mHostCallbacks, 0, sizeof(HostCallbackInfo));
   memset(&mMidiCallback, 0, sizeof(AUMIDIOutputCallbackStruct));
+  mMidiOutputTimeStamp = 0;
+  if (plugDoesMidi)
+  {
+    // worst case: every message and SysEx in its own packet
+    mMidiPacketListBuf.Resize(sizeof(MIDIPacketList) + (MIDI_OUTPUT_QUEUE_SIZE + SYSEX_OUTPUT_QUEUE_SIZE) * sizeof(MIDIPacket) + SYSEX_OUTPUT_BUFFER_SIZE);
+  }
   memset(mParamValueString, 0, MAX_PARAM_DISPLAY_LEN * sizeof(char));
 
   mOSXBundleID.Set(instanceInfo.mOSXBundleID.Get());
@@ -2163,8 +2222,52 @@ void IPlugAU::SetLatency(int samples)
   IPlugBase::SetLatency(samples);
 }
 
-// TODO: SendMidiMsg
-bool IPlugAU::SendMidiMsg(IMidiMsg* pMsg)
+// Sends the whole block to the host's MIDI output callback in one MIDIPacketList,
+// packet timestamps are sample offsets into the render buffer.
+void IPlugAU::SendMidiOutput(const IMidiMsg* pMsgs, int nMsgs, const ISysEx* pSysExs, int nSysExs)
 {
-  return false;
+  if (!mMidiCallback.midiOutputCallback || !mMidiOutputTimeStamp || !mMidiPacketListBuf.GetSize())
+  {
+    return;
+  }
+
+  MIDIPacketList* pPacketList = (MIDIPacketList*) mMidiPacketListBuf.Get();
+  MIDIPacket* pPacket = pPacketList->packet;
+  int i = 0, j = 0, n = 0;
+
+  while (i < nMsgs || j < nSysExs)
+  {
+    if (j == nSysExs || (i < nMsgs && pMsgs[i].mOffset <= pSysExs[j].mOffset))
+    {
+      const IMidiMsg* pMsg = pMsgs + i++;
+      if (!(pMsg->mStatus & 0x80))
+      {
+        continue;
+      }
+      int status = pMsg->StatusMsg();
+      pPacket->timeStamp = pMsg->mOffset;
+      pPacket->data[0] = pMsg->mStatus;
+      pPacket->data[1] = pMsg->mData1;
+      pPacket->data[2] = pMsg->mData2;
+      // program change and channel aftertouch have one data byte, system real time messages none
+      if (status == IMidiMsg::kNone) pPacket->length = 1;
+      else if (status == IMidiMsg::kProgramChange || status == IMidiMsg::kChannelAftertouch) pPacket->length = 2;
+      else pPacket->length = 3;
+    }
+    else
+    {
+      const ISysEx* pSysEx = pSysExs + j++;
+      pPacket->timeStamp = pSysEx->mOffset;
+      pPacket->length = pSysEx->mSize;
+      memcpy(pPacket->data, pSysEx->mData, pSysEx->mSize);
+    }
+    pPacket = MIDIPacketNext(pPacket);
+    ++n;
+  }
+
+  if (n)
+  {
+    pPacketList->numPackets = n;
+    mMidiCallback.midiOutputCallback(mMidiCallback.userData, mMidiOutputTimeStamp, 0, pPacketList);
+  }
 }
@@ -78,7 +78,7 @@ public:
 protected:
   void SetBlockSize(int blockSize);
   void SetLatency(int samples);
-  bool SendMidiMsg(IMidiMsg* pMsg);
+  void SendMidiOutput(const IMidiMsg* pMsgs, int nMsgs, const ISysEx* pSysExs, int nSysExs);
   void HostSpecificInit();
   
 private:
@@ -95,6 +95,8 @@ private:
   WDL_TypedBuf<AudioSampleType> mInScratchBuf, mOutScratchBuf;
   WDL_PtrList<AURenderCallbackStruct> mRenderNotify;
   AUMIDIOutputCallbackStruct mMidiCallback;
+  const AudioTimeStamp* mMidiOutputTimeStamp; // valid during render
+  WDL_TypedBuf<char> mMidiPacketListBuf; // preallocated MIDIPacketList for SendMidiOutput()
 
   // Every stereo pair of plugin input or output is a bus.
   // Buses can have zero host channels if the host hasn't connected the bus at all,
@@ -8,6 +8,12 @@
 #include <time.h>
 #include "../wdlendian.h"
 #include "../base64encdec.h"
+#include "../wdlatomic.h"
+#include "../mergesort.h"
+
+#ifdef IPLUG_SSE2
+  #include <emmintrin.h>
+#endif
 
 #ifndef VstInt32
   #ifdef WIN32
@@ -29,6 +35,64 @@ void CastCopy(DEST* pDest, SRC* pSrc, int n)
   }
 }
 
+template <class SRC, class DEST>
+void CastAccumulate(DEST* pDest, SRC* pSrc, int n)
+{
+  for (int i = 0; i < n; ++i, ++pDest, ++pSrc)
+  {
+    *pDest += (DEST) *pSrc;
+  }
+}
+
+#ifdef IPLUG_SSE2
+// float<->double conversion kernels for the host buffer copies, 4 frames per iteration
+inline void CastCopy(double* pDest, float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128 f = _mm_loadu_ps(pSrc + i);
+    _mm_storeu_pd(pDest + i, _mm_cvtps_pd(f));
+    _mm_storeu_pd(pDest + i + 2, _mm_cvtps_pd(_mm_movehl_ps(f, f)));
+  }
+  for (; i < n; ++i) pDest[i] = (double) pSrc[i];
+}
+
+inline void CastCopy(float* pDest, double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(pSrc + i));
+    __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(pSrc + i + 2));
+    _mm_storeu_ps(pDest + i, _mm_movelh_ps(lo, hi));
+  }
+  for (; i < n; ++i) pDest[i] = (float) pSrc[i];
+}
+
+inline void CastAccumulate(float* pDest, double* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(pSrc + i));
+    __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(pSrc + i + 2));
+    _mm_storeu_ps(pDest + i, _mm_add_ps(_mm_loadu_ps(pDest + i), _mm_movelh_ps(lo, hi)));
+  }
+  for (; i < n; ++i) pDest[i] += (float) pSrc[i];
+}
+
+inline void CastAccumulate(float* pDest, float* pSrc, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    _mm_storeu_ps(pDest + i, _mm_add_ps(_mm_loadu_ps(pDest + i), _mm_loadu_ps(pSrc + i)));
+  }
+  for (; i < n; ++i) pDest[i] += pSrc[i];
+}
+#endif
+
 void GetVersionParts(int version, int* pVer, int* pMaj, int* pMin)
 {
   *pVer = (version & 0xFFFF0000) >> 16;
@@ -83,8 +147,20 @@ IPlugBase::IPlugBase(int nParams,
   , mDoesMIDI(plugDoesMidi)
   , mAPI(plugAPI)
   , mIsBypassed(false)
+  , mDoesSingleReplacing(false)
   , mDelay(0)
   , mTailSize(0)
+  , mParamChangesPending(0)
+  , mParamResetPending(0)
+  , mNParamChanges(0)
+  , mParamChangesSorted(true)
+  , mSmoothMaxFrames(0)
+  , mSplitAtParamChanges(false)
+  , mMinSubBlock(16)
+  , mSubBlockOffset(0)
+  , mMidiOutput(MIDI_OUTPUT_QUEUE_SIZE, MIDI_OUTPUT_QUEUE_SIZE)
+  , mNSysExOutput(0)
+  , mSysExOutputDataSize(0)
 {
   Trace(TRACELOC, "%s:%s", effectName, CurrentTime());
 
@@ -92,6 +168,18 @@ IPlugBase::IPlugBase(int nParams,
   {
     mParams.Add(new IParam);
   }
+  memset(mParamChangeCount.Resize(nParams), 0, nParams * sizeof(int));
+  memset(mParamQueuedValue.Resize(nParams), 0, nParams * sizeof(double));
+  memset(mParamQueuedSeq.Resize(nParams), 0, nParams * sizeof(int));
+  memset(mParamAppliedSeq.Resize(nParams), 0, nParams * sizeof(int));
+  memset(mParamSetCount.Resize(nParams), 0, nParams * sizeof(int));
+  memset(mParamQueuedSetCount.Resize(nParams), 0, nParams * sizeof(int));
+  // preallocated, AddParamChange() is called on the audio thread
+  int maxParamChanges = IPMAX(nParams * PARAM_CHANGE_POINTS, 256);
+  mParamChanges.Resize(maxParamChanges);
+  mParamChangesTmp.Resize(maxParamChanges);
+  mSysExOutput.Resize(SYSEX_OUTPUT_QUEUE_SIZE);
+  mSysExOutputData.Resize(SYSEX_OUTPUT_BUFFER_SIZE);
 
   for (int i = 0; i < nPresets; ++i)
   {
@@ -126,24 +214,34 @@ IPlugBase::IPlugBase(int nParams,
 
   mInData.Resize(nInputs);
   mOutData.Resize(nOutputs);
+  mSubInData.Resize(nInputs);
+  mSubOutData.Resize(nOutputs);
+  mInFData.Resize(nInputs);
+  mOutFData.Resize(nOutputs);
+  mSubInFData.Resize(nInputs);
+  mSubOutFData.Resize(nOutputs);
   
   double** ppInData = mInData.Get();
+  float** ppInFData = mInFData.Get();
 
-  for (int i = 0; i < nInputs; ++i, ++ppInData)
+  for (int i = 0; i < nInputs; ++i, ++ppInData, ++ppInFData)
   {
     InChannel* pInChannel = new InChannel;
     pInChannel->mConnected = false;
     pInChannel->mSrc = ppInData;
+    pInChannel->mFSrc = ppInFData;
     mInChannels.Add(pInChannel);
   }
 
   double** ppOutData = mOutData.Get();
+  float** ppOutFData = mOutFData.Get();
 
-  for (int i = 0; i < nOutputs; ++i, ++ppOutData)
+  for (int i = 0; i < nOutputs; ++i, ++ppOutData, ++ppOutFData)
   {
     OutChannel* pOutChannel = new OutChannel;
     pOutChannel->mConnected = false;
     pOutChannel->mDest = ppOutData;
+    pOutChannel->mFOut = ppOutFData;
     pOutChannel->mFDest = 0;
     mOutChannels.Add(pOutChannel);
   }
@@ -304,6 +402,7 @@ double IPlugBase::GetSamplesPerBeat()
 void IPlugBase::SetSampleRate(double sampleRate)
 {
   mSampleRate = sampleRate;
+  PrepareParamSmoothing();
 }
 
 void IPlugBase::SetBlockSize(int blockSize)
@@ -317,6 +416,8 @@ void IPlugBase::SetBlockSize(int blockSize)
       InChannel* pInChannel = mInChannels.Get(i);
       pInChannel->mScratchBuf.Resize(blockSize);
       memset(pInChannel->mScratchBuf.Get(), 0, blockSize * sizeof(double));
+      pInChannel->mFScratchBuf.Resize(blockSize);
+      memset(pInChannel->mFScratchBuf.Get(), 0, blockSize * sizeof(float));
     }
     
     for (i = 0; i < nOut; ++i)
@@ -324,10 +425,43 @@ void IPlugBase::SetBlockSize(int blockSize)
       OutChannel* pOutChannel = mOutChannels.Get(i);
       pOutChannel->mScratchBuf.Resize(blockSize);
       memset(pOutChannel->mScratchBuf.Get(), 0, blockSize * sizeof(double));
+      pOutChannel->mFScratchBuf.Resize(blockSize);
+      memset(pOutChannel->mFScratchBuf.Get(), 0, blockSize * sizeof(float));
     }
     
     mBlockSize = blockSize;
   }
+
+  PrepareParamSmoothing(); // also picks up a sample rate that the API class set directly
+}
+
+// Not called on the audio thread, sizes the ramp buffers so SmoothParams() doesn't allocate.
+void IPlugBase::PrepareParamSmoothing()
+{
+  int i, n = mParams.GetSize();
+  mSmoothedParams.Resize(0, false);
+
+  for (i = 0; i < n; ++i)
+  {
+    IParam* pParam = mParams.Get(i);
+    if (pParam->GetSmoothing() != IParam::kSmoothNone)
+    {
+      pParam->PrepareSmoothing(mSampleRate, mBlockSize);
+      mSmoothedParams.Add(i);
+    }
+  }
+  mSmoothMaxFrames = (mSmoothedParams.GetSize() ? IPMAX(mBlockSize, 1) : 0);
+}
+
+void IPlugBase::SmoothParams(int nFrames)
+{
+  int i, n = mSmoothedParams.GetSize();
+  const int* pIdx = mSmoothedParams.Get();
+
+  for (i = 0; i < n; ++i)
+  {
+    mParams.Get(pIdx[i])->SmoothBlock(nFrames);
+  }
 }
 
 void IPlugBase::SetInputChannelConnections(int idx, int n, bool connected)
@@ -342,6 +476,7 @@ void IPlugBase::SetInputChannelConnections(int idx, int n, bool connected)
     if (!connected)
     {
       *(pInChannel->mSrc) = pInChannel->mScratchBuf.Get();
+      *(pInChannel->mFSrc) = pInChannel->mFScratchBuf.Get();
     }
   }
 }
@@ -358,6 +493,7 @@ void IPlugBase::SetOutputChannelConnections(int idx, int n, bool connected)
     if (!connected)
     {
       *(pOutChannel->mDest) = pOutChannel->mScratchBuf.Get();
+      *(pOutChannel->mFOut) = pOutChannel->mFScratchBuf.Get();
     }
   }
 }
@@ -394,9 +530,16 @@ void IPlugBase::AttachInputBuffers(int idx, int n, float** ppData, int nFrames)
     InChannel* pInChannel = mInChannels.Get(i);
     if (pInChannel->mConnected)
     {
-      double* pScratch = pInChannel->mScratchBuf.Get();
-      CastCopy(pScratch, *(ppData++), nFrames);
-      *(pInChannel->mSrc) = pScratch;
+      if (mDoesSingleReplacing)
+      {
+        *(pInChannel->mFSrc) = *(ppData++); // converted only if PassThroughBuffers() needs it
+      }
+      else
+      {
+        double* pScratch = pInChannel->mScratchBuf.Get();
+        CastCopy(pScratch, *(ppData++), nFrames);
+        *(pInChannel->mSrc) = pScratch;
+      }
     }
   }
 }
@@ -423,6 +566,7 @@ void IPlugBase::AttachOutputBuffers(int idx, int n, float** ppData)
     if (pOutChannel->mConnected)
     {
       *(pOutChannel->mDest) = pOutChannel->mScratchBuf.Get();
+      *(pOutChannel->mFOut) = *ppData;
       pOutChannel->mFDest = *(ppData++);
     }
   }
@@ -430,6 +574,9 @@ void IPlugBase::AttachOutputBuffers(int idx, int n, float** ppData)
 
 void IPlugBase::PassThroughBuffers(double sampleType, int nFrames)
 {
+  ApplyParamChanges();
+  mNParamChanges = 0;
+
   if (mLatency && mDelay) 
   {
     mDelay->ProcessBlock(mInData.Get(), mOutData.Get(), nFrames);
@@ -438,10 +585,30 @@ void IPlugBase::PassThroughBuffers(double sampleType, int nFrames)
   {
     IPlugBase::ProcessDoubleReplacing(mInData.Get(), mOutData.Get(), nFrames);
   }
+
+  FlushMidiOutput(nFrames);
 }
 
 void IPlugBase::PassThroughBuffers(float sampleType, int nFrames)
 {
+  if (mDoesSingleReplacing)
+  {
+    // the float inputs were attached without conversion
+    int i, n = NInChannels();
+    InChannel** ppInChannel = mInChannels.GetList();
+
+    for (i = 0; i < n; ++i, ++ppInChannel)
+    {
+      InChannel* pInChannel = *ppInChannel;
+      if (pInChannel->mConnected)
+      {
+        double* pScratch = pInChannel->mScratchBuf.Get();
+        CastCopy(pScratch, *(pInChannel->mFSrc), nFrames);
+        *(pInChannel->mSrc) = pScratch;
+      }
+    }
+  }
+
   // for 32 bit buffers, first run the delay (if mLatency) on the 64bit IPlug buffers
   PassThroughBuffers(0., nFrames);
   
@@ -458,14 +625,64 @@ void IPlugBase::PassThroughBuffers(float sampleType, int nFrames)
   }
 }
 
+// double host buffers, plug processes single precision
+void IPlugBase::ProcessSingleFromDoubleBuffers(int nFrames)
+{
+  int i, nIn = NInChannels(), nOut = NOutChannels();
+
+  for (i = 0; i < nIn; ++i)
+  {
+    InChannel* pInChannel = mInChannels.Get(i);
+    if (pInChannel->mConnected)
+    {
+      float* pScratch = pInChannel->mFScratchBuf.Get();
+      CastCopy(pScratch, *(pInChannel->mSrc), nFrames);
+      *(pInChannel->mFSrc) = pScratch;
+    }
+  }
+
+  for (i = 0; i < nOut; ++i)
+  {
+    *(mOutChannels.Get(i)->mFOut) = mOutChannels.Get(i)->mFScratchBuf.Get();
+  }
+
+  ProcessParamChangeSubBlocks(mInFData.Get(), mOutFData.Get(), mSubInFData.Get(), mSubOutFData.Get(), nFrames);
+
+  for (i = 0; i < nOut; ++i)
+  {
+    OutChannel* pOutChannel = mOutChannels.Get(i);
+    if (pOutChannel->mConnected)
+    {
+      CastCopy(*(pOutChannel->mDest), *(pOutChannel->mFOut), nFrames);
+    }
+  }
+}
+
 void IPlugBase::ProcessBuffers(double sampleType, int nFrames)
 {
-  ProcessDoubleReplacing(mInData.Get(), mOutData.Get(), nFrames);
+  if (mDoesSingleReplacing)
+  {
+    ProcessSingleFromDoubleBuffers(nFrames);
+  }
+  else
+  {
+    ProcessParamChangeSubBlocks(mInData.Get(), mOutData.Get(), mSubInData.Get(), mSubOutData.Get(), nFrames);
+  }
+
+  FlushMidiOutput(nFrames);
 }
 
 void IPlugBase::ProcessBuffers(float sampleType, int nFrames)
 {
-  ProcessDoubleReplacing(mInData.Get(), mOutData.Get(), nFrames);
+  if (mDoesSingleReplacing)
+  {
+    // host buffers are attached directly
+    ProcessParamChangeSubBlocks(mInFData.Get(), mOutFData.Get(), mSubInFData.Get(), mSubOutFData.Get(), nFrames);
+    FlushMidiOutput(nFrames);
+    return;
+  }
+
+  ProcessParamChangeSubBlocks(mInData.Get(), mOutData.Get(), mSubInData.Get(), mSubOutData.Get(), nFrames);
   int i, n = NOutChannels();
   OutChannel** ppOutChannel = mOutChannels.GetList();
   
@@ -478,28 +695,45 @@ void IPlugBase::ProcessBuffers(float sampleType, int nFrames)
       CastCopy(pOutChannel->mFDest, *(pOutChannel->mDest), nFrames);
     }
   }
+
+  FlushMidiOutput(nFrames);
 }
 
 void IPlugBase::ProcessBuffersAccumulating(float sampleType, int nFrames)
 {
-  ProcessDoubleReplacing(mInData.Get(), mOutData.Get(), nFrames);
   int i, n = NOutChannels();
   OutChannel** ppOutChannel = mOutChannels.GetList();
+
+  if (mDoesSingleReplacing)
+  {
+    for (i = 0; i < n; ++i)
+    {
+      *(ppOutChannel[i]->mFOut) = ppOutChannel[i]->mFScratchBuf.Get();
+    }
+    ProcessParamChangeSubBlocks(mInFData.Get(), mOutFData.Get(), mSubInFData.Get(), mSubOutFData.Get(), nFrames);
+  }
+  else
+  {
+    ProcessParamChangeSubBlocks(mInData.Get(), mOutData.Get(), mSubInData.Get(), mSubOutData.Get(), nFrames);
+  }
   
   for (i = 0; i < n; ++i, ++ppOutChannel)
   {
     OutChannel* pOutChannel = *ppOutChannel;
     if (pOutChannel->mConnected)
     {
-      float* pDest = pOutChannel->mFDest;
-      double* pSrc = *(pOutChannel->mDest);
-      
-      for (int j = 0; j < nFrames; ++j, ++pDest, ++pSrc)
+      if (mDoesSingleReplacing)
       {
-        *pDest += (float) *pSrc;
+        CastAccumulate(pOutChannel->mFDest, *(pOutChannel->mFOut), nFrames);
+      }
+      else
+      {
+        CastAccumulate(pOutChannel->mFDest, *(pOutChannel->mDest), nFrames);
       }
     }
   }
+
+  FlushMidiOutput(nFrames);
 }
 
 void IPlugBase::ZeroScratchBuffers()
@@ -510,12 +744,14 @@ void IPlugBase::ZeroScratchBuffers()
   {
     InChannel* pInChannel = mInChannels.Get(i);
     memset(pInChannel->mScratchBuf.Get(), 0, mBlockSize * sizeof(double));
+    memset(pInChannel->mFScratchBuf.Get(), 0, mBlockSize * sizeof(float));
   }
 
   for (i = 0; i < nOut; ++i)
   {
     OutChannel* pOutChannel = mOutChannels.Get(i);
     memset(pOutChannel->mScratchBuf.Get(), 0, mBlockSize * sizeof(double));
+    memset(pOutChannel->mFScratchBuf.Get(), 0, mBlockSize * sizeof(float));
   }
 }
 
@@ -530,14 +766,243 @@ void IPlugBase::SetLatency(int samples)
   }
 }
 
+void IPlugBase::SetMaxLatency(int samples)
+{
+  if (mDelay)
+  {
+    mDelay->SetMaxDelayTime(samples);
+    mDelay->SetDelayTime(mLatency); // may have been clamped before
+  }
+}
+
 // this is over-ridden for AAX
 void IPlugBase::SetParameterFromGUI(int idx, double normalizedValue)
 {
   Trace(TRACELOC, "%d:%f", idx, normalizedValue);
-  WDL_MutexLock lock(&mMutex);
   GetParam(idx)->SetNormalized(normalizedValue);
   InformHostOfParamChange(idx, normalizedValue);
-  OnParamChange(idx);
+  QueueParamChange(idx);
+}
+
+// Producers bump a per param count and then the pending count (both full barriers, so the
+// new param value is visible before the count). FlushParamChanges() subtracts only what it
+// observed, so a change arriving mid-flush stays pending for the next block rather than being lost.
+void IPlugBase::QueueParamChange(int paramIdx)
+{
+  if (paramIdx >= 0 && paramIdx < mParamChangeCount.GetSize())
+  {
+    wdl_atomic_incr(mParamSetCount.Get() + paramIdx); // supersedes a value from QueueParamValue()
+    wdl_atomic_incr(mParamChangeCount.Get() + paramIdx);
+    wdl_atomic_incr(&mParamChangesPending);
+  }
+}
+
+// The value is written between two increments of the param's seq, FlushParamChanges() only takes it
+// if the seq was even and unchanged around the read, and records the seq it applied. A value set
+// directly (followed by QueueParamChange()) after this one was queued wins.
+void IPlugBase::QueueParamValue(int paramIdx, double value)
+{
+  if (paramIdx >= 0 && paramIdx < mParamQueuedSeq.GetSize())
+  {
+    int* pSeq = mParamQueuedSeq.Get() + paramIdx;
+    wdl_atomic_incr(pSeq);
+    mParamQueuedValue.Get()[paramIdx] = value;
+    mParamQueuedSetCount.Get()[paramIdx] = wdl_atomic_get(mParamSetCount.Get() + paramIdx);
+    wdl_atomic_incr(pSeq);
+    wdl_atomic_incr(mParamChangeCount.Get() + paramIdx);
+    wdl_atomic_incr(&mParamChangesPending);
+  }
+}
+
+bool IPlugBase::GetQueuedParamValue(int paramIdx, double* pValue, int* pSeq)
+{
+  if (paramIdx < 0 || paramIdx >= mParamQueuedSeq.GetSize()) return false;
+  int* pQueuedSeq = mParamQueuedSeq.Get() + paramIdx;
+  int seq = wdl_atomic_get(pQueuedSeq);
+  if ((seq & 1) || seq == wdl_atomic_get(mParamAppliedSeq.Get() + paramIdx)) return false;
+  double v = mParamQueuedValue.Get()[paramIdx];
+  int setCount = mParamQueuedSetCount.Get()[paramIdx];
+  if (wdl_atomic_get(pQueuedSeq) != seq) return false; // rewritten meanwhile, it will be pending again
+  if (setCount != wdl_atomic_get(mParamSetCount.Get() + paramIdx)) return false; // superseded
+  *pValue = v;
+  if (pSeq) *pSeq = seq;
+  return true;
+}
+
+void IPlugBase::QueueParamReset()
+{
+  wdl_atomic_incr(&mParamResetPending);
+  wdl_atomic_incr(&mParamChangesPending);
+}
+
+void IPlugBase::FlushParamChanges()
+{
+  int pending = wdl_atomic_get(&mParamChangesPending);
+  if (!pending) return;
+
+  int i, n = mParamChangeCount.GetSize();
+  int* pCount = mParamChangeCount.Get();
+
+  int reset = wdl_atomic_get(&mParamResetPending);
+  if (reset)
+  {
+    wdl_atomic_add(&mParamResetPending, -reset);
+  }
+
+  for (i = 0; i < n; ++i)
+  {
+    int c = wdl_atomic_get(pCount + i);
+    if (c || reset)
+    {
+      if (c)
+      {
+        wdl_atomic_add(pCount + i, -c);
+      }
+      double v;
+      int seq;
+      if (GetQueuedParamValue(i, &v, &seq))
+      {
+        mParams.Get(i)->Set(v);
+        int* pApplied = mParamAppliedSeq.Get() + i;
+        wdl_atomic_add(pApplied, seq - wdl_atomic_get(pApplied));
+      }
+      OnParamChange(i);
+    }
+  }
+
+  wdl_atomic_add(&mParamChangesPending, -pending);
+}
+
+void IPlugBase::SetSampleAccurateAutomation(bool splitBlocks, int minSubBlock)
+{
+  mSplitAtParamChanges = splitBlocks;
+  mMinSubBlock = IPMAX(minSubBlock, 1);
+}
+
+void IPlugBase::AddParamChange(int paramIdx, double normalizedValue, int offset)
+{
+  if (paramIdx < 0 || paramIdx >= NParams()) return;
+  if (offset < 0) offset = 0;
+
+  IParamChange* pChanges = mParamChanges.Get();
+  int n = mNParamChanges;
+
+  if (n == mParamChanges.GetSize())
+  {
+    // full, coalesce with the param's latest change
+    for (int i = n - 1; i >= 0; --i)
+    {
+      if (pChanges[i].mIdx == paramIdx)
+      {
+        if (offset > pChanges[i].mOffset)
+        {
+          pChanges[i].mOffset = offset;
+          mParamChangesSorted = false;
+        }
+        pChanges[i].mNormalizedValue = normalizedValue;
+        return;
+      }
+    }
+    return;
+  }
+
+  // hosts mostly send changes in order, sorted once at the start of the block if not
+  if (n && offset < pChanges[n - 1].mOffset)
+  {
+    mParamChangesSorted = false;
+  }
+  pChanges[n] = IParamChange(offset, paramIdx, normalizedValue);
+  mNParamChanges = n + 1;
+}
+
+static int CompareParamChangeOffsets(const void* p1, const void* p2)
+{
+  return ((const IParamChange*) p1)->mOffset - ((const IParamChange*) p2)->mOffset;
+}
+
+// Stable, so changes at the same offset stay in the order they arrived.
+void IPlugBase::SortParamChanges()
+{
+  if (!mParamChangesSorted)
+  {
+    WDL_mergesort(mParamChanges.Get(), mNParamChanges, sizeof(IParamChange), CompareParamChangeOffsets, (char*) mParamChangesTmp.Get());
+    mParamChangesSorted = true;
+  }
+}
+
+// Applies all of the block's changes up front (last value wins), ProcessDoubleReplacing can still read them.
+void IPlugBase::ApplyParamChanges()
+{
+  SortParamChanges();
+  int i, n = mNParamChanges;
+  const IParamChange* pChange = mParamChanges.Get();
+  for (i = 0; i < n; ++i, ++pChange)
+  {
+    ApplyParamChange(pChange);
+  }
+}
+
+template <class SAMPLETYPE>
+void IPlugBase::ProcessParamChangeSubBlocks(SAMPLETYPE** inputs, SAMPLETYPE** outputs, SAMPLETYPE** subInputs, SAMPLETYPE** subOutputs, int nFrames)
+{
+  int nChanges = mNParamChanges;
+  mSubBlockOffset = 0;
+
+  const int maxFrames = mSmoothMaxFrames;
+  if ((!nChanges || !mSplitAtParamChanges) && (!maxFrames || nFrames <= maxFrames))
+  {
+    ApplyParamChanges();
+    SmoothParams(nFrames);
+    ProcessReplacing(inputs, outputs, nFrames);
+    mNParamChanges = 0;
+    return;
+  }
+
+  if (!mSplitAtParamChanges)
+  {
+    ApplyParamChanges(); // only splitting because the block is longer than the smoothing ramps
+    nChanges = 0;
+  }
+  SortParamChanges();
+
+  const IParamChange* pChanges = mParamChanges.Get();
+  int i, j = 0, nIn = mInData.GetSize(), nOut = mOutData.GetSize();
+  int pos = 0;
+
+  while (pos < nFrames)
+  {
+    for (; j < nChanges && pChanges[j].mOffset <= pos; ++j)
+    {
+      ApplyParamChange(pChanges + j);
+    }
+
+    int end = (j < nChanges ? IPMIN(pChanges[j].mOffset, nFrames) : nFrames);
+    if (end < nFrames && end - pos < mMinSubBlock)
+    {
+      end = IPMIN(pos + mMinSubBlock, nFrames); // changes inside a too short sub-block move to its end
+    }
+    if (maxFrames && end - pos > maxFrames)
+    {
+      end = pos + maxFrames; // the host exceeded the block size it announced
+    }
+
+    for (i = 0; i < nIn; ++i) subInputs[i] = inputs[i] + pos;
+    for (i = 0; i < nOut; ++i) subOutputs[i] = outputs[i] + pos;
+
+    mSubBlockOffset = pos;
+    SmoothParams(end - pos);
+    ProcessReplacing(subInputs, subOutputs, end - pos);
+    pos = end;
+  }
+
+  // offsets past the end of the block
+  for (; j < nChanges; ++j)
+  {
+    ApplyParamChange(pChanges + j);
+  }
+
+  mSubBlockOffset = 0;
+  mNParamChanges = 0;
 }
 
 void IPlugBase::OnParamReset()
@@ -552,7 +1017,6 @@ void IPlugBase::OnParamReset()
 // Default passthrough.
 void IPlugBase::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  // Mutex is already locked.
   int i, nIn = mInChannels.GetSize(), nOut = mOutChannels.GetSize();
   int j = 0;
   for (i = 0; i < nOut; ++i)
@@ -570,10 +1034,9 @@ void IPlugBase::ProcessDoubleReplacing(double** inputs, double** outputs, int nF
   }
 }
 
-// Default passthrough ONLY USED BY IOS.
+// Default passthrough, used by IOS or if DoesSingleReplacing().
 void IPlugBase::ProcessSingleReplacing(float** inputs, float** outputs, int nFrames)
 {
-  // Mutex is already locked.
   int i, nIn = mInChannels.GetSize(), nOut = mOutChannels.GetSize();
   for (i = 0; i < nIn; ++i)
   {
@@ -893,14 +1356,14 @@ bool IPlugBase::SerializeParams(ByteChunk* pChunk)
 {
   TRACE;
 
-  WDL_MutexLock lock(&mMutex);
   bool savedOK = true;
   int i, n = mParams.GetSize();
   for (i = 0; i < n && savedOK; ++i)
   {
     IParam* pParam = mParams.Get(i);
     Trace(TRACELOC, "%d %s %f", i, pParam->GetNameForHost(), pParam->Value());
-    double v = pParam->Value();
+    double v;
+    if (!GetQueuedParamValue(i, &v)) v = pParam->Value(); // restored but not applied yet
     savedOK &= (pChunk->Put(&v) > 0);
   }
   return savedOK;
@@ -910,7 +1373,6 @@ int IPlugBase::UnserializeParams(ByteChunk* pChunk, int startPos)
 {
   TRACE;
 
-  WDL_MutexLock lock(&mMutex);
   int i, n = mParams.GetSize(), pos = startPos;
   for (i = 0; i < n && pos >= 0; ++i)
   {
@@ -918,9 +1380,8 @@ int IPlugBase::UnserializeParams(ByteChunk* pChunk, int startPos)
     double v = 0.0;
     Trace(TRACELOC, "%d %s %f", i, pParam->GetNameForHost(), pParam->Value());
     pos = pChunk->Get(&v, pos);
-    pParam->Set(v);
+    QueueParamValue(i, v); // set at the start of the next block
   }
-  OnParamReset();
   return pos;
 }
 
@@ -951,7 +1412,8 @@ void IPlugBase::RedrawParamControls()
     int i, n = mParams.GetSize();
     for (i = 0; i < n; ++i)
     {
-      double v = mParams.Get(i)->Value();
+      double v;
+      if (!GetQueuedParamValue(i, &v)) v = mParams.Get(i)->Value();
       mGraphics->SetParameterFromPlug(i, v, false);
     }
   }
@@ -1519,6 +1981,11 @@ int IPlugBase::GetIPlugVerFromChunk(ByteChunk* pChunk, int* pPos)
   return ver;
 }
 
+bool IPlugBase::SendMidiMsg(IMidiMsg* pMsg)
+{
+  return mMidiOutput.Inject(pMsg);
+}
+
 bool IPlugBase::SendMidiMsgs(WDL_TypedBuf<IMidiMsg>* pMsgs)
 {
   bool rc = true;
@@ -1528,4 +1995,41 @@ bool IPlugBase::SendMidiMsgs(WDL_TypedBuf<IMidiMsg>* pMsgs)
     rc &= SendMidiMsg(pMsg);
   }
   return rc;
+}
+
+bool IPlugBase::SendSysEx(ISysEx* pSysEx)
+{
+  int size = pSysEx->mSize;
+  if (mNSysExOutput >= mSysExOutput.GetSize() || mSysExOutputDataSize + size > mSysExOutputData.GetSize())
+  {
+    return false;
+  }
+
+  BYTE* pData = mSysExOutputData.Get() + mSysExOutputDataSize;
+  memcpy(pData, pSysEx->mData, size);
+  mSysExOutputDataSize += size;
+
+  // keep sorted by offset
+  ISysEx* pSysExs = mSysExOutput.Get();
+  int i = mNSysExOutput++;
+  for (; i > 0 && pSysExs[i - 1].mOffset > pSysEx->mOffset; --i)
+  {
+    pSysExs[i] = pSysExs[i - 1];
+  }
+  pSysExs[i] = ISysEx(pSysEx->mOffset, pData, size);
+  return true;
+}
+
+void IPlugBase::FlushMidiOutput(int nFrames)
+{
+  mMidiOutput.BeginBlock(nFrames); // collects messages sent from other threads
+  int nMsgs = mMidiOutput.NEvents();
+
+  if (nMsgs || mNSysExOutput)
+  {
+    SendMidiOutput(mMidiOutput.Get(0), nMsgs, mSysExOutput.Get(), mNSysExOutput);
+  }
+
+  mMidiOutput.Clear();
+  mNSysExOutput = mSysExOutputDataSize = 0;
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include "Hosts.h"
 #include "Log.h"
 #include "NChanDelay.h"
+#include "IMidiQueue.h"
 
 // Uncomment to enable IPlug::OnIdle() and IGraphics::OnGUIIdle().
 // #define USE_IDLE_CALLS
@@ -17,6 +18,10 @@
 #define MAX_EFFECT_NAME_LEN 128
 #define DEFAULT_BLOCK_SIZE 1024
 #define DEFAULT_TEMPO 120.0
+#define MIDI_OUTPUT_QUEUE_SIZE 1024 // outgoing MIDI messages per block
+#define SYSEX_OUTPUT_QUEUE_SIZE 64 // outgoing SysEx messages per block
+#define SYSEX_OUTPUT_BUFFER_SIZE 16384 // total outgoing SysEx bytes per block
+#define PARAM_CHANGE_POINTS 16 // timestamped host changes per block, per parameter on average, more are coalesced
 
 // All version ints are stored as 0xVVVVRRMM: V = version, R = revision, M = minor revision.
 
@@ -47,12 +52,16 @@ public:
 
   virtual ~IPlugBase();
 
-  // Implementations should set a mutex lock like in the no-op!
-  virtual void Reset() { TRACE; IMutexLock lock(this); }
-  virtual void OnParamChange(int paramIdx) { IMutexLock lock(this); }
+  // Reset is called while audio processing is stopped.
+  // OnParamChange is called on the audio thread at the start of a block, or when processing starts
+  // (VST2 resume, VST3 setActive, AU initialize) for changes queued meanwhile, so implementations
+  // must not lock the mutex there.
+  virtual void Reset() { TRACE; }
+  virtual void OnParamChange(int paramIdx) {}
 
   // Default passthrough.  Inputs and outputs are [nChannel][nSample].
-  // Mutex is already locked.
+  // The mutex is NOT locked, parameter changes have already been applied via OnParamChange.
+  // ProcessSingleReplacing is used on iOS, and instead of ProcessDoubleReplacing if SetDoesSingleReplacing(true).
   virtual void ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames);
   virtual void ProcessSingleReplacing(float** inputs, float** outputs, int nFrames);
 
@@ -68,8 +77,7 @@ public:
 
   // Not usually needed ... Reset is called on activate regardless of whether this is implemented.
   // Also different hosts have different interpretations of "activate".
-  // Implementations should set a mutex lock like in the no-op!
-  virtual void OnActivate(bool active) { TRACE;  IMutexLock lock(this); }
+  virtual void OnActivate(bool active) { TRACE; }
 
   virtual void ProcessMidiMsg(IMidiMsg* pMsg);
   virtual void ProcessSysEx(ISysEx* pSysEx) {}
@@ -99,6 +107,17 @@ public:
   // ----------------------------------------
   // Your plugin class, or a control class, can call these functions.
 
+  // Sample accurate automation, off by default. When on, ProcessDoubleReplacing() is called once per
+  // sub-block between host parameter change offsets (sub-blocks are at least minSubBlock frames, except
+  // the last), and OnParamChange() at the start of each sub-block. GetSubBlockOffset() is the position of
+  // the current sub-block within the host block, e.g. for MIDI message offsets.
+  // When off, all of the block's changes are applied before ProcessDoubleReplacing(), which can read them
+  // with NParamChanges()/GetParamChange() (sorted by offset) to ramp internally.
+  void SetSampleAccurateAutomation(bool splitBlocks, int minSubBlock = 16);
+  int GetSubBlockOffset() { return mSubBlockOffset; }
+  int NParamChanges() { return mNParamChanges; }
+  const IParamChange* GetParamChange(int idx) { return idx >= 0 && idx < mNParamChanges ? mParamChanges.Get() + idx : 0; }
+
   int NParams() { return mParams.GetSize(); }
   IParam* GetParam(int idx) { return mParams.Get(idx); }
   IGraphics* GetGUI() { return mGraphics; }
@@ -197,16 +216,24 @@ protected:
   virtual void AttachGraphics(IGraphics* pGraphics);
   #endif
 
-  // If latency changes after initialization (often not supported by the host).
+  // If latency changes after initialization (often not supported by the host). Never allocates,
+  // the bypass delay is clamped to the max latency (the constructor's latency by default).
   virtual void SetLatency(int samples);
+  // Call from the constructor if the latency can grow while processing, to size the bypass delay
+  // line up front. Not while processing, it reallocates and clears the delay line.
+  void SetMaxLatency(int samples);
   
   // set to 0xffffffff for infinite tail (VST3), or 0 for none (default)
   // for VST2 setting to 1 means no tail, but it would be better i think to leave it at 0, the default
   void SetTailSize(unsigned int tailSizeSamples) { mTailSize = tailSizeSamples; }
   
-  virtual bool SendMidiMsg(IMidiMsg* pMsg) = 0;
+  // MIDI output is queued and sent to the host in one batch at the end of the block.
+  // SendMidiMsg() is safe from any thread and never blocks. Offsets are relative to the
+  // host block, messages sent from other threads go out at the start of the next block.
+  bool SendMidiMsg(IMidiMsg* pMsg);
   bool SendMidiMsgs(WDL_TypedBuf<IMidiMsg>* pMsgs);
-  virtual bool SendSysEx(ISysEx* pSysEx) { return false; }
+  // Audio thread only, the SysEx data is copied.
+  bool SendSysEx(ISysEx* pSysEx);
   bool IsInst() { return mIsInst; }
   bool DoesMIDI() { return mDoesMIDI; }
   
@@ -224,6 +251,11 @@ protected:
 
   bool DoesStateChunks() { return mStateChunks; }
 
+  // Call from the constructor if the plug implements ProcessSingleReplacing: float hosts then pass
+  // their buffers straight through without converting to double and back.
+  void SetDoesSingleReplacing(bool doesSingle) { mDoesSingleReplacing = doesSingle; }
+  bool DoesSingleReplacing() { return mDoesSingleReplacing; }
+
   // Will append if the chunk is already started
   bool SerializeParams(ByteChunk* pChunk);
   int UnserializeParams(ByteChunk* pChunk, int startPos); // Returns the new chunk position (endPos)
@@ -237,6 +269,23 @@ protected:
 
   void OnParamReset();  // Calls OnParamChange(each param) + Reset().
 
+  // Safe from any thread, never blocks: the parameter value is already set,
+  // OnParamChange() is deferred to the next FlushParamChanges().
+  void QueueParamChange(int paramIdx);
+  // Like QueueParamChange(), but FlushParamChanges() also sets the value, so that the audio thread
+  // never sees it change mid-block. One writer at a time (state restores hold mMutex).
+  void QueueParamValue(int paramIdx, double value);
+  // The value from QueueParamValue() if FlushParamChanges() hasn't applied it yet.
+  bool GetQueuedParamValue(int paramIdx, double* pValue, int* pSeq = 0);
+  void QueueParamReset(); // OnParamReset() at the next FlushParamChanges().
+  void FlushParamChanges(); // API classes call this on the audio thread at the start of each block.
+
+  // Audio thread only, before ProcessBuffers()/PassThroughBuffers(): a host parameter change
+  // at offset frames into the coming block. Applied by the next ProcessBuffers() call.
+  // Never allocates: past NParams() * PARAM_CHANGE_POINTS changes in a block, a change replaces
+  // the param's latest one, or is dropped if the param has none.
+  void AddParamChange(int paramIdx, double normalizedValue, int offset);
+
   void PruneUninitializedPresets();
 
   // Unserialize / SerializePresets - Only used by VST2
@@ -259,6 +308,11 @@ protected:
   void ProcessBuffers(double sampleType, int nFrames);
   void ProcessBuffersAccumulating(float sampleType, int nFrames);
   void ZeroScratchBuffers();
+
+  // Called at the end of the block with the queued MIDI output, both lists sorted by offset.
+  // API classes override this to hand the events to the host.
+  virtual void SendMidiOutput(const IMidiMsg* pMsgs, int nMsgs, const ISysEx* pSysExs, int nSysExs) {}
+  void FlushMidiOutput(int nFrames); // Called by ProcessBuffers()/PassThroughBuffers().
   
 public:
   void ModifyCurrentPreset(const char* name = 0);     // Sets the currently active preset to whatever current params are.
@@ -286,6 +340,7 @@ public:
   void SetSampleRate(double sampleRate);
   virtual void SetBlockSize(int blockSize); // overridden in IPlugAU
   
+  // Guards state (de)serialization and GUI attachment, never taken on the audio thread.
   WDL_Mutex mMutex;
 
   struct IMutexLock
@@ -308,7 +363,9 @@ private:
   {
     bool mConnected;
     double** mSrc;   // Points into mInData.
+    float** mFSrc;   // Points into mInFData.
     WDL_TypedBuf<double> mScratchBuf;
+    WDL_TypedBuf<float> mFScratchBuf;
     WDL_String mLabel;
   };
 
@@ -316,13 +373,15 @@ private:
   {
     bool mConnected;
     double** mDest;  // Points into mOutData.
+    float** mFOut;   // Points into mOutFData.
     float* mFDest;
     WDL_TypedBuf<double> mScratchBuf;
+    WDL_TypedBuf<float> mFScratchBuf;
     WDL_String mLabel;
   };
 
 protected:
-  bool mStateChunks, mIsInst, mDoesMIDI, mIsBypassed;
+  bool mStateChunks, mIsInst, mDoesMIDI, mIsBypassed, mDoesSingleReplacing;
   int mCurrentPresetIdx;
   double mSampleRate;
   int mBlockSize, mLatency;
@@ -333,8 +392,38 @@ protected:
 private:
   IGraphics* mGraphics;
   WDL_PtrList<IParam> mParams;
+  WDL_TypedBuf<int> mParamChangeCount; // per param, changes not yet seen by FlushParamChanges()
+  WDL_TypedBuf<double> mParamQueuedValue; // per param, see QueueParamValue()
+  WDL_TypedBuf<int> mParamQueuedSeq, mParamAppliedSeq; // seq is odd while the value is written
+  WDL_TypedBuf<int> mParamSetCount, mParamQueuedSetCount; // QueueParamChange() calls, now and when the value was queued
+  int mParamChangesPending, mParamResetPending;
+  WDL_TypedBuf<IParamChange> mParamChanges; // timestamped changes for the coming block, preallocated, mNParamChanges used
+  WDL_TypedBuf<IParamChange> mParamChangesTmp; // WDL_mergesort() space
+  int mNParamChanges;
+  bool mParamChangesSorted; // by offset, stable
+  WDL_TypedBuf<double*> mSubInData, mSubOutData;
+  WDL_TypedBuf<int> mSmoothedParams; // indices of params with smoothing, built by PrepareParamSmoothing()
+  int mSmoothMaxFrames; // size of their ramp buffers, longer blocks are processed in pieces (0 = no limit)
+  WDL_TypedBuf<float*> mSubInFData, mSubOutFData;
+  bool mSplitAtParamChanges;
+  int mMinSubBlock, mSubBlockOffset;
+  IMidiBlockQueue mMidiOutput;
+  WDL_TypedBuf<ISysEx> mSysExOutput; // preallocated, mNSysExOutput used
+  WDL_TypedBuf<BYTE> mSysExOutputData; // preallocated, mSysExOutputDataSize used
+  int mNSysExOutput, mSysExOutputDataSize;
+
+  void ApplyParamChange(const IParamChange* pChange) { GetParam(pChange->mIdx)->SetNormalized(pChange->mNormalizedValue); OnParamChange(pChange->mIdx); }
+  void ApplyParamChanges();
+  void SortParamChanges();
+  void PrepareParamSmoothing();
+  void SmoothParams(int nFrames);
+  void ProcessReplacing(double** inputs, double** outputs, int nFrames) { ProcessDoubleReplacing(inputs, outputs, nFrames); }
+  void ProcessReplacing(float** inputs, float** outputs, int nFrames) { ProcessSingleReplacing(inputs, outputs, nFrames); }
+  template <class SAMPLETYPE> void ProcessParamChangeSubBlocks(SAMPLETYPE** inputs, SAMPLETYPE** outputs, SAMPLETYPE** subInputs, SAMPLETYPE** subOutputs, int nFrames);
+  void ProcessSingleFromDoubleBuffers(int nFrames);
   WDL_PtrList<IPreset> mPresets;
   WDL_TypedBuf<double*> mInData, mOutData;
+  WDL_TypedBuf<float*> mInFData, mOutFData; // used if mDoesSingleReplacing
   WDL_PtrList<InChannel> mInChannels;
   WDL_PtrList<OutChannel> mOutChannels;
   WDL_PtrList<WDL_String> mInputBusLabels;
@@ -20,4 +20,9 @@
   #define ARCH_64BIT 
 #endif
 
+// SSE2 kernels (include <emmintrin.h>), define IPLUG_NO_SIMD to use the plain C++ loops
+#if !defined(IPLUG_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+  #define IPLUG_SSE2
+#endif
+
 #endif // _IPLUG_OSDETECT_H_
\ No newline at end of file
@@ -41,6 +41,7 @@ IPlugRTAS::IPlugRTAS(IPlugInstanceInfo instanceInfo,
   if (nInputs) 
   {
     mDelay = new NChanDelayLine(nInputs, nOutputs);
+    mDelay->SetMaxDelayTime(latency);
     mDelay->SetDelayTime(latency);
   }
 
@@ -65,7 +66,7 @@ void IPlugRTAS::SetIO(int nInputs, int nOutputs)
 
 void IPlugRTAS::ProcessAudio(float** inputs, float** outputs, int nFrames)
 {
-  IMutexLock lock(this);
+  FlushParamChanges();
 
   AttachInputBuffers(0, NInChannels(), inputs, nFrames);
   AttachOutputBuffers(0, NOutChannels(), outputs);
@@ -75,7 +76,7 @@ void IPlugRTAS::ProcessAudio(float** inputs, float** outputs, int nFrames)
 
 void IPlugRTAS::ProcessAudioBypassed(float** inputs, float** outputs, int nFrames)
 {
-  IMutexLock lock(this);
+  FlushParamChanges();
 
   AttachInputBuffers(0, NInChannels(), inputs, nFrames);
   AttachOutputBuffers(0, NOutChannels(), outputs);
@@ -197,11 +198,7 @@ void IPlugRTAS::Created(class IPlugProcess* pProcess)
   OnHostIdentified();
 }
 
-// TODO: SendMidiMsg/s()
-bool IPlugRTAS::SendMidiMsg(IMidiMsg* pMsg)
-{
-  return false;
-}
+// TODO: SendMidiOutput()
 
 void IPlugRTAS::SetParameter(int idx)
 {
@@ -232,13 +229,11 @@ void IPlugRTAS::SetParameter(int idx)
         break;
     }
 
-    IMutexLock lock(this);
-
     if (GetGUI())
       GetGUI()->SetParameterFromPlug(idx - kPTParamIdxOffset, value, false);
 
     pParam->Set(value);
-    OnParamChange(idx - kPTParamIdxOffset);
+    QueueParamChange(idx - kPTParamIdxOffset);
   }
 }
 
@@ -57,9 +57,6 @@ public:
   
   void DirtyPTCompareState();
 
-protected:
-  bool SendMidiMsg(IMidiMsg* pMsg);
-
 private:
   bool mHasSideChain, mSideChainIsConnected;
   int mSideChainConnectionNum;
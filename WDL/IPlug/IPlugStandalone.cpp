@@ -48,6 +48,7 @@ IPlugStandalone::IPlugStandalone(IPlugInstanceInfo instanceInfo,
   #else
   mMidiOutChan = instanceInfo.mMidiOutChan;
   mMidiOut = instanceInfo.mRTMidiOut;
+  mMidiOutMessage.reserve(SYSEX_OUTPUT_BUFFER_SIZE);
   #endif
 }
 
@@ -68,61 +69,64 @@ void IPlugStandalone::ResizeGraphics(int w, int h)
   #endif
 }
 
-bool IPlugStandalone::SendMidiMsg(IMidiMsg* pMsg)
+// There are no sample offsets on a MIDI port, the block's events go out in order right away.
+void IPlugStandalone::SendMidiOutput(const IMidiMsg* pMsgs, int nMsgs, const ISysEx* pSysExs, int nSysExs)
 {
   #ifdef OS_IOS
-  mIOSLink->SendMidiMsg(pMsg);
+  for (int i = 0; i < nMsgs; ++i)
+  {
+    mIOSLink->SendMidiMsg((IMidiMsg*) pMsgs + i);
+  }
   #else
-  if (DoesMIDI())
+  if (!DoesMIDI() || !mMidiOut)
   {
-    IMidiMsg newMsg = *pMsg;
+    return;
+  }
 
-    // if the midi channel out filter is set, reassign the status byte appropriately
-    if (mMidiOutChan != 0)
+  int i = 0, j = 0;
+
+  while (i < nMsgs || j < nSysExs)
+  {
+    if (j == nSysExs || (i < nMsgs && pMsgs[i].mOffset <= pSysExs[j].mOffset))
     {
-      newMsg.mStatus = (*mMidiOutChan)-1 | ((unsigned int) newMsg.StatusMsg() << 4) ;
-    }
+      IMidiMsg newMsg = pMsgs[i++];
 
-    std::vector<unsigned char> message;
-    message.push_back( newMsg.mStatus );
-    message.push_back( newMsg.mData1 );
-    message.push_back( newMsg.mData2 );
+      // if the midi channel out filter is set, reassign the status byte appropriately
+      if (mMidiOutChan != 0)
+      {
+        newMsg.mStatus = (*mMidiOutChan)-1 | ((unsigned int) newMsg.StatusMsg() << 4) ;
+      }
 
-    mMidiOut->sendMessage( &message );
-    return true;
-  }
-  #endif
-  return false;
-}
-
-bool IPlugStandalone::SendSysEx(ISysEx* pSysEx)
-{
-#ifndef OS_IOS
-  if (mMidiOut)
-  {  
-    std::vector<unsigned char> message;
-    
-    for (int i = 0; i < pSysEx->mSize; i++) {
-      message.push_back(pSysEx->mData[i]);
+      mMidiOutMessage.resize(3);
+      mMidiOutMessage[0] = newMsg.mStatus;
+      mMidiOutMessage[1] = newMsg.mData1;
+      mMidiOutMessage[2] = newMsg.mData2;
+    }
+    else
+    {
+      const ISysEx* pSysEx = pSysExs + j++;
+      mMidiOutMessage.assign(pSysEx->mData, pSysEx->mData + pSysEx->mSize);
     }
-    
-    mMidiOut->sendMessage( &message );
-    return true;
+
+    mMidiOut->sendMessage( &mMidiOutMessage );
   }
-#endif
-  return false;
+  #endif
 }
 
 #ifdef OS_IOS
 void IPlugStandalone::LockMutexAndProcessSingleReplacing(float** inputs, float** outputs, int nFrames)
 {
-  IMutexLock lock(this);
+  FlushParamChanges();
   ProcessSingleReplacing(inputs, outputs, nFrames);
+  FlushMidiOutput(nFrames);
 }
 #else
 void IPlugStandalone::LockMutexAndProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
 {
-  IMutexLock lock(this);
-  ProcessDoubleReplacing(inputs, outputs, nFrames);
+  FlushParamChanges();
+  // via ProcessBuffers so that plugs doing single replacing get converted buffers
+  AttachInputBuffers(0, NInChannels(), inputs, nFrames);
+  AttachOutputBuffers(0, NOutChannels(), outputs);
+  ProcessBuffers((double) 0.0, nFrames);
 }
 #endif
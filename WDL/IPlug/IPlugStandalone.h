@@ -66,6 +66,8 @@ public:
 
   void ResizeGraphics(int w, int h);
 
+  // called by the app wrapper's audio callback, despite the name these don't lock the mutex any more:
+  // pending parameter changes are flushed and the block is processed
   #ifdef OS_IOS
   void LockMutexAndProcessSingleReplacing(float** inputs, float** outputs, int nFrames);
   #else
@@ -73,8 +75,7 @@ public:
   #endif
 
 protected:
-  bool SendMidiMsg(IMidiMsg* pMsg);
-  bool SendSysEx(ISysEx* pSysEx);
+  void SendMidiOutput(const IMidiMsg* pMsgs, int nMsgs, const ISysEx* pSysExs, int nSysExs);
 
 private:
   #ifdef OS_IOS
@@ -82,6 +83,7 @@ private:
   #else // OSX or WIN
   RtMidiOut* mMidiOut;
   unsigned short* mMidiOutChan;
+  std::vector<unsigned char> mMidiOutMessage; // reserved up front, reused for every message
   #endif
 };
 
@@ -48,6 +48,10 @@ IPlugVST::IPlugVST(IPlugInstanceInfo instanceInfo,
 
   mHasVSTExtensions = VSTEXT_NONE;
 
+  mMidiOutEvents.Resize(MIDI_OUTPUT_QUEUE_SIZE);
+  mSysExOutEvents.Resize(SYSEX_OUTPUT_QUEUE_SIZE);
+  mOutEventList.Resize(sizeof(VstEvents) + (MIDI_OUTPUT_QUEUE_SIZE + SYSEX_OUTPUT_QUEUE_SIZE) * sizeof(VstEvent*));
+
   int nInputs = NInChannels(), nOutputs = NOutChannels();
 
   memset(&mAEffect, 0, sizeof(AEffect));
@@ -250,45 +254,47 @@ void IPlugVST::SetLatency(int samples)
   IPlugBase::SetLatency(samples);
 }
 
-bool IPlugVST::SendVSTEvent(VstEvent* pEvent)
+// The whole block goes to the host in one audioMasterProcessEvents call.
+void IPlugVST::SendMidiOutput(const IMidiMsg* pMsgs, int nMsgs, const ISysEx* pSysExs, int nSysExs)
 {
-  // It would be more efficient to bundle these and send at the end of a processed block,
-  // but that would require writing OnBlockEnd and making sure it always gets called,
-  // and who cares anyway, midi events aren't that dense.
-  VstEvents events;
-  memset(&events, 0, sizeof(VstEvents));
-  events.numEvents = 1;
-  events.events[0] = pEvent;
-  return (mHostCallback(&mAEffect, audioMasterProcessEvents, 0, 0, &events, 0.0f) == 1);
-}
-
-bool IPlugVST::SendMidiMsg(IMidiMsg* pMsg)
-{
-  VstMidiEvent midiEvent;
-  memset(&midiEvent, 0, sizeof(VstMidiEvent));
-
-  midiEvent.type = kVstMidiType;
-  midiEvent.byteSize = sizeof(VstMidiEvent);  // Should this be smaller?
-  midiEvent.deltaFrames = pMsg->mOffset;
-  midiEvent.midiData[0] = pMsg->mStatus;
-  midiEvent.midiData[1] = pMsg->mData1;
-  midiEvent.midiData[2] = pMsg->mData2;
+  VstEvents* pEvents = (VstEvents*) mOutEventList.Get();
+  int i = 0, j = 0, n = 0;
 
-  return SendVSTEvent((VstEvent*) &midiEvent);
-}
+  // Merge the two lists, hosts expect the events sorted by deltaFrames.
+  while (i < nMsgs || j < nSysExs)
+  {
+    if (j == nSysExs || (i < nMsgs && pMsgs[i].mOffset <= pSysExs[j].mOffset))
+    {
+      const IMidiMsg* pMsg = pMsgs + i;
+      VstMidiEvent* pMidiEvent = mMidiOutEvents.Get() + i++;
+      memset(pMidiEvent, 0, sizeof(VstMidiEvent));
 
-bool IPlugVST::SendSysEx(ISysEx* pSysEx)
-{ 
-  VstMidiSysexEvent sysexEvent;
-  memset(&sysexEvent, 0, sizeof(VstMidiSysexEvent));
+      pMidiEvent->type = kVstMidiType;
+      pMidiEvent->byteSize = sizeof(VstMidiEvent);  // Should this be smaller?
+      pMidiEvent->deltaFrames = pMsg->mOffset;
+      pMidiEvent->midiData[0] = pMsg->mStatus;
+      pMidiEvent->midiData[1] = pMsg->mData1;
+      pMidiEvent->midiData[2] = pMsg->mData2;
+      pEvents->events[n++] = (VstEvent*) pMidiEvent;
+    }
+    else
+    {
+      const ISysEx* pSysEx = pSysExs + j;
+      VstMidiSysexEvent* pSysExEvent = mSysExOutEvents.Get() + j++;
+      memset(pSysExEvent, 0, sizeof(VstMidiSysexEvent));
 
-  sysexEvent.type = kVstSysExType;
-  sysexEvent.byteSize = sizeof(VstMidiSysexEvent);
-  sysexEvent.deltaFrames = pSysEx->mOffset;
-  sysexEvent.dumpBytes = pSysEx->mSize;
-  sysexEvent.sysexDump = (char*)pSysEx->mData;
+      pSysExEvent->type = kVstSysExType;
+      pSysExEvent->byteSize = sizeof(VstMidiSysexEvent);
+      pSysExEvent->deltaFrames = pSysEx->mOffset;
+      pSysExEvent->dumpBytes = pSysEx->mSize;
+      pSysExEvent->sysexDump = (char*) pSysEx->mData;
+      pEvents->events[n++] = (VstEvent*) pSysExEvent;
+    }
+  }
 
-  return SendVSTEvent((VstEvent*) &sysexEvent);
+  pEvents->numEvents = n;
+  pEvents->reserved = 0;
+  mHostCallback(&mAEffect, audioMasterProcessEvents, 0, 0, pEvents, 0.0f);
 }
 
 audioMasterCallback IPlugVST::GetHostCallback()
@@ -331,9 +337,9 @@ VstIntPtr VSTCALLBACK IPlugVST::VSTDispatcher(AEffect *pEffect, VstInt32 opCode,
   {
     return 0;
   }
-  IPlugBase::IMutexLock lock(_this);
 
   // Handle a couple of opcodes here to make debugging easier.
+  // These may come from the audio thread, so they don't take the mutex.
   switch (opCode)
   {
     case effEditIdle:
@@ -342,8 +348,41 @@ VstIntPtr VSTCALLBACK IPlugVST::VSTDispatcher(AEffect *pEffect, VstInt32 opCode,
     _this->OnIdle();
     #endif
     return 0;
+    case effProcessEvents:
+    {
+      VstEvents* pEvents = (VstEvents*) ptr;
+      if (pEvents && pEvents->events)
+      {
+        for (int i = 0; i < pEvents->numEvents; ++i)
+        {
+          VstEvent* pEvent = pEvents->events[i];
+          if (pEvent)
+          {
+            if (pEvent->type == kVstMidiType)
+            {
+              VstMidiEvent* pME = (VstMidiEvent*) pEvent;
+              IMidiMsg msg(pME->deltaFrames, pME->midiData[0], pME->midiData[1], pME->midiData[2]);
+              _this->ProcessMidiMsg(&msg);
+              //#ifdef TRACER_BUILD
+              //  msg.LogMsg();
+              //#endif
+            }
+            else if (pEvent->type == kVstSysExType) 
+            {
+              VstMidiSysexEvent* pSE = (VstMidiSysexEvent*) pEvent;
+              ISysEx sysex(pSE->deltaFrames, (const BYTE*)pSE->sysexDump, pSE->dumpBytes);
+              _this->ProcessSysEx(&sysex);
+            }
+          }
+        }
+        return 1;
+      }
+      return 0;
+    }
   }
 
+  IPlugBase::IMutexLock lock(_this);
+
   Trace(TRACELOC, "%d(%s):%d:%d", opCode, VSTOpcodeStr(opCode), idx, (int) value);
 
   switch (opCode)
@@ -351,7 +390,7 @@ VstIntPtr VSTCALLBACK IPlugVST::VSTDispatcher(AEffect *pEffect, VstInt32 opCode,
     case effOpen:
     {
       _this->HostSpecificInit();
-      _this->OnParamReset();
+      _this->QueueParamReset();
       return 0;
     }
     case effClose:
@@ -419,7 +458,7 @@ VstIntPtr VSTCALLBACK IPlugVST::VSTDispatcher(AEffect *pEffect, VstInt32 opCode,
           }
           if (_this->GetGUI()) _this->GetGUI()->SetParameterFromPlug(idx, v, false);
           pParam->Set(v);
-          _this->OnParamChange(idx);
+          _this->QueueParamChange(idx);
         }
         return 1;
       }
@@ -446,6 +485,7 @@ VstIntPtr VSTCALLBACK IPlugVST::VSTDispatcher(AEffect *pEffect, VstInt32 opCode,
       }
       else
       {
+        _this->FlushParamChanges(); // processing is stopped until this returns
         _this->OnActivate(true);
       }
       return 0;
@@ -557,37 +597,6 @@ VstIntPtr VSTCALLBACK IPlugVST::VSTDispatcher(AEffect *pEffect, VstInt32 opCode,
       }
       return 0;
     }
-    case effProcessEvents:
-    {
-      VstEvents* pEvents = (VstEvents*) ptr;
-      if (pEvents && pEvents->events)
-      {
-        for (int i = 0; i < pEvents->numEvents; ++i)
-        {
-          VstEvent* pEvent = pEvents->events[i];
-          if (pEvent)
-          {
-            if (pEvent->type == kVstMidiType)
-            {
-              VstMidiEvent* pME = (VstMidiEvent*) pEvent;
-              IMidiMsg msg(pME->deltaFrames, pME->midiData[0], pME->midiData[1], pME->midiData[2]);
-              _this->ProcessMidiMsg(&msg);
-              //#ifdef TRACER_BUILD
-              //  msg.LogMsg();
-              //#endif
-            }
-            else if (pEvent->type == kVstSysExType) 
-            {
-              VstMidiSysexEvent* pSE = (VstMidiSysexEvent*) pEvent;
-              ISysEx sysex(pSE->deltaFrames, (const BYTE*)pSE->sysexDump, pSE->dumpBytes);
-              _this->ProcessSysEx(&sysex);
-            }
-          }
-        }
-        return 1;
-      }
-      return 0;
-    }
     case effCanBeAutomated:
     {
       return 1;
@@ -859,7 +868,7 @@ void VSTCALLBACK IPlugVST::VSTProcess(AEffect* pEffect, float** inputs, float**
 {
   TRACE_PROCESS;
   IPlugVST* _this = (IPlugVST*) pEffect->object;
-  IMutexLock lock(_this);
+  _this->FlushParamChanges();
   _this->VSTPrepProcess(inputs, outputs, nFrames);
   _this->ProcessBuffersAccumulating((float) 0.0f, nFrames);
 }
@@ -868,7 +877,7 @@ void VSTCALLBACK IPlugVST::VSTProcessReplacing(AEffect* pEffect, float** inputs,
 {
   TRACE_PROCESS;
   IPlugVST* _this = (IPlugVST*) pEffect->object;
-  IMutexLock lock(_this);
+  _this->FlushParamChanges();
   _this->VSTPrepProcess(inputs, outputs, nFrames);
   _this->ProcessBuffers((float) 0.0f, nFrames);
 }
@@ -877,7 +886,7 @@ void VSTCALLBACK IPlugVST::VSTProcessDoubleReplacing(AEffect* pEffect, double**
 {
   TRACE_PROCESS;
   IPlugVST* _this = (IPlugVST*) pEffect->object;
-  IMutexLock lock(_this);
+  _this->FlushParamChanges();
   _this->VSTPrepProcess(inputs, outputs, nFrames);
   _this->ProcessBuffers((double) 0.0, nFrames);
 }
@@ -886,7 +895,6 @@ float VSTCALLBACK IPlugVST::VSTGetParameter(AEffect *pEffect, VstInt32 idx)
 {
   Trace(TRACELOC, "%d", idx);
   IPlugVST* _this = (IPlugVST*) pEffect->object;
-  IMutexLock lock(_this);
   if (idx >= 0 && idx < _this->NParams())
   {
     return (float) _this->GetParam(idx)->GetNormalized();
@@ -898,7 +906,6 @@ void VSTCALLBACK IPlugVST::VSTSetParameter(AEffect *pEffect, VstInt32 idx, float
 {
   Trace(TRACELOC, "%d:%f", idx, value);
   IPlugVST* _this = (IPlugVST*) pEffect->object;
-  IMutexLock lock(_this);
   if (idx >= 0 && idx < _this->NParams())
   {
     if (_this->GetGUI())
@@ -906,6 +913,6 @@ void VSTCALLBACK IPlugVST::VSTSetParameter(AEffect *pEffect, VstInt32 idx, float
       _this->GetGUI()->SetParameterFromPlug(idx, value, true);
     }
     _this->GetParam(idx)->SetNormalized(value);
-    _this->OnParamChange(idx);
+    _this->QueueParamChange(idx);
   }
 }
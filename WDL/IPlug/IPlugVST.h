@@ -54,8 +54,7 @@ protected:
   void HostSpecificInit();
   void AttachGraphics(IGraphics* pGraphics);
   void SetLatency(int samples);
-  bool SendMidiMsg(IMidiMsg* pMsg);
-  bool SendSysEx(ISysEx* pSysEx);
+  void SendMidiOutput(const IMidiMsg* pMsgs, int nMsgs, const ISysEx* pSysExs, int nSysExs);
   audioMasterCallback GetHostCallback();
 
 private:
@@ -65,8 +64,10 @@ private:
   ERect mEditRect;
   audioMasterCallback mHostCallback;
 
-  bool SendVSTEvent(VstEvent* pEvent);
-  bool SendVSTEvents(WDL_TypedBuf<VstEvent>* pEvents);
+  // Preallocated, filled by SendMidiOutput() on the audio thread.
+  WDL_TypedBuf<VstMidiEvent> mMidiOutEvents;
+  WDL_TypedBuf<VstMidiSysexEvent> mSysExOutEvents;
+  WDL_TypedBuf<char> mOutEventList; // VstEvents with room for all event pointers
 
   VstSpeakerArrangement mInputSpkrArr, mOutputSpkrArr;
 
@@ -105,6 +105,7 @@ IPlugVST3::IPlugVST3(IPlugInstanceInfo instanceInfo,
               kAPIVST3)
   , mScChans(plugScChans)
   , mSidechainActive(false)
+  , mOutputEvents(0)
 {
   SetInputChannelConnections(0, NInChannels(), true);
   SetOutputChannelConnections(0, NOutChannels(), true);
@@ -112,6 +113,7 @@ IPlugVST3::IPlugVST3(IPlugInstanceInfo instanceInfo,
   if (NInChannels()) 
   {
     mDelay = new NChanDelayLine(NInChannels(), NOutChannels());
+    mDelay->SetMaxDelayTime(latency);
     mDelay->SetDelayTime(latency);
   }
 
@@ -199,7 +201,7 @@ tresult PLUGIN_API IPlugVST3::initialize (FUnknown* context)
     if(DoesMIDI())
     {
       addEventInput (STR16("MIDI Input"), 1);
-      //addEventOutput(STR16("MIDI Output"), 1);
+      addEventOutput(STR16("MIDI Output"), 1);
     }
 
     if (NPresets())
@@ -330,6 +332,10 @@ tresult PLUGIN_API IPlugVST3::setActive(TBool state)
 {
   TRACE;
 
+  if (state)
+  {
+    FlushParamChanges(); // not processing yet
+  }
   OnActivate((bool) state);
 
   return SingleComponentEffect::setActive(state);
@@ -355,8 +361,6 @@ tresult PLUGIN_API IPlugVST3::process(ProcessData& data)
 {
   TRACE_PROCESS;
 
-  IMutexLock lock(this);
-
   if(data.processContext)
     memcpy(&mProcessContext, data.processContext, sizeof(ProcessContext));
 
@@ -366,8 +370,7 @@ tresult PLUGIN_API IPlugVST3::process(ProcessData& data)
   {
     int32 numParamsChanged = paramChanges->getParameterCount();
 
-    //it is possible to get a finer resolution of control here by retrieving more values (points) from the queue
-    //for now we just grab the last one
+    //bypass and preset changes use the last point, plug parameters pass every point on for sample accurate automation
 
     for (int32 i = 0; i < numParamsChanged; i++)
     {
@@ -402,9 +405,16 @@ tresult PLUGIN_API IPlugVST3::process(ProcessData& data)
             default:
               if (idx >= 0 && idx < NParams())
               {
-                GetParam(idx)->SetNormalized((double)value);
+                for (int32 p = 0; p < numPoints; p++)
+                {
+                  int32 pointOffset;
+                  double pointValue;
+                  if (paramQueue->getPoint(p, pointOffset, pointValue) == kResultTrue)
+                  {
+                    AddParamChange(idx, pointValue, pointOffset);
+                  }
+                }
                 if (GetGUI()) GetGUI()->SetParameterFromPlug(idx, (double)value, true);
-                OnParamChange(idx);
               }
               break;
           }
@@ -414,6 +424,13 @@ tresult PLUGIN_API IPlugVST3::process(ProcessData& data)
     }
   }
 
+  // OnParamChange() for changes made from the GUI or a preset recall since the last block,
+  // the timestamped changes above are applied by ProcessBuffers()
+  FlushParamChanges();
+
+  // for SendMidiOutput(), called at the end of ProcessBuffers()/PassThroughBuffers()
+  mOutputEvents = DoesMIDI() ? data.outputEvents : 0;
+
   if(DoesMIDI())
   {
     //process events.. only midi note on and note off?
@@ -550,24 +567,71 @@ tresult PLUGIN_API IPlugVST3::process(ProcessData& data)
       ProcessBuffers(0.0, data.numSamples); // process buffers double precision
   }
 
-// Midi Out
-//  if (mDoesMidi) {
-//    IEventList eventList = data.outputEvents;
-//
-//    if (eventList)
-//    {
-//      Event event;
-//
-//      while (!mMidiOutputQueue.Empty()) {
-//        //TODO: parse events and add
-//        eventList.addEvent(event);
-//      }
-//    }
-//  }
+  mOutputEvents = 0;
 
   return kResultOk;
 }
 
+// VST3 events only carry notes, poly pressure and SysEx, other MIDI messages are dropped.
+void IPlugVST3::SendMidiOutput(const IMidiMsg* pMsgs, int nMsgs, const ISysEx* pSysExs, int nSysExs)
+{
+  if (!mOutputEvents) return;
+
+  int i = 0, j = 0;
+  Event event;
+
+  // merge, the host expects events in sampleOffset order
+  while (i < nMsgs || j < nSysExs)
+  {
+    memset(&event, 0, sizeof(Event));
+    event.busIndex = 0;
+
+    if (j == nSysExs || (i < nMsgs && pMsgs[i].mOffset <= pSysExs[j].mOffset))
+    {
+      const IMidiMsg* pMsg = pMsgs + i++;
+      event.sampleOffset = pMsg->mOffset;
+
+      switch (pMsg->StatusMsg())
+      {
+        case IMidiMsg::kNoteOn:
+          event.type = Event::kNoteOnEvent;
+          event.noteOn.channel = pMsg->Channel();
+          event.noteOn.pitch = pMsg->NoteNumber();
+          event.noteOn.velocity = (float) pMsg->Velocity() / 127.f;
+          event.noteOn.noteId = -1;
+          break;
+        case IMidiMsg::kNoteOff:
+          event.type = Event::kNoteOffEvent;
+          event.noteOff.channel = pMsg->Channel();
+          event.noteOff.pitch = pMsg->NoteNumber();
+          event.noteOff.velocity = (float) pMsg->Velocity() / 127.f;
+          event.noteOff.noteId = -1;
+          break;
+        case IMidiMsg::kPolyAftertouch:
+          event.type = Event::kPolyPressureEvent;
+          event.polyPressure.channel = pMsg->Channel();
+          event.polyPressure.pitch = pMsg->NoteNumber();
+          event.polyPressure.pressure = (float) pMsg->PolyAfterTouch() / 127.f;
+          event.polyPressure.noteId = -1;
+          break;
+        default:
+          continue;
+      }
+    }
+    else
+    {
+      const ISysEx* pSysEx = pSysExs + j++;
+      event.sampleOffset = pSysEx->mOffset;
+      event.type = Event::kDataEvent;
+      event.data.type = DataEvent::kMidiSysEx;
+      event.data.size = pSysEx->mSize;
+      event.data.bytes = pSysEx->mData;
+    }
+
+    mOutputEvents->addEvent(event);
+  }
+}
+
 //tresult PLUGIN_API IPlugVST3::setState(IBStream* state)
 //{
 //  TRACE;
@@ -8,7 +8,6 @@
 #include "pluginterfaces/vst/ivstprocesscontext.h"
 #include "pluginterfaces/vst/vsttypes.h"
 #include "pluginterfaces/vst/ivstcontextmenu.h"
-//#include "IMidiQueue.h"
 
 struct IPlugInstanceInfo
 {
@@ -119,7 +118,7 @@ public:
   REFCOUNT_METHODS(SingleComponentEffect)
 
 protected:
-  virtual bool SendMidiMsg(IMidiMsg* pMsg) {return false;}  //TODO
+  void SendMidiOutput(const IMidiMsg* pMsgs, int nMsgs, const ISysEx* pSysExs, int nSysExs);
 
 private:
   void addDependentView (IPlugVST3View* view);
@@ -133,7 +132,7 @@ private:
 
   int mScChans;
   bool mSidechainActive;
-//  IMidiQueue mMidiOutputQueue;
+  Steinberg::Vst::IEventList* mOutputEvents; // valid during process()
   Steinberg::Vst::ProcessContext mProcessContext;
   Steinberg::TArray <IPlugVST3View*> viewsArray;
 
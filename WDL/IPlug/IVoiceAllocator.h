@@ -0,0 +1,430 @@
+#ifndef _IVOICEALLOCATOR_
+#define _IVOICEALLOCATOR_
+
+/*
+
+IVoiceAllocator assigns MIDI notes to the voices of an instrument, in poly,
+mono or legato mode, with note priority, voice stealing and the sustain pedal.
+
+The voice state itself lives in an IVoiceBank, preferably as structure-of-
+arrays (one array per state variable, indexed by voice slot). The allocator
+keeps the sounding voices packed in slots [0, NActiveVoices()): a voice whose
+release has finished is swapped with the last active one and parked. The
+bank's render loop therefore only runs over active voices, with contiguous
+state that can be processed several voices per SIMD instruction, and idle
+voices cost nothing.
+
+MyPlug.h:
+
+#include "WDL/IPlug/IVoiceAllocator.h"
+
+class MyVoiceBank : public IVoiceBank { ... };
+
+MyVoiceBank mVoices;
+IVoiceAllocator mVoiceAllocator; // constructed with (&mVoices, MAX_VOICES)
+
+MyPlug.cpp:
+
+void MyPlug::ProcessDoubleReplacing(double** inputs, double** outputs, int nFrames)
+{
+  // for each MIDI message: mVoiceAllocator.ProcessMidiMsg(pMsg);
+  mVoices.Render(outputs[0], nFrames, mVoiceAllocator.NActiveVoices());
+  mVoiceAllocator.Update();
+}
+
+*/
+
+#include "IPlugStructs.h"
+
+class IVoiceBank
+{
+public:
+  virtual ~IVoiceBank() {}
+
+  // Starts the voice in slot. If legato the voice is already sounding, and
+  // should glide to the new note without retriggering its envelopes.
+  virtual void StartVoice(int slot, int note, int velocity, bool legato) = 0;
+  virtual void ReleaseVoice(int slot) = 0;
+  // Silences the voice, it is about to be parked.
+  virtual void StopVoice(int slot) = 0;
+  virtual void SwapVoices(int slotA, int slotB) = 0;
+  // True once a released voice has become inaudible.
+  virtual bool IsVoiceFinished(int slot) = 0;
+  // Only needed for kStealQuietest.
+  virtual double GetVoiceLevel(int slot) { return 0.; }
+};
+
+class IVoiceAllocator
+{
+public:
+  enum EMode { kModePoly = 0, kModeMono, kModeLegato };
+  enum ENotePriority { kPriorityLast = 0, kPriorityLow, kPriorityHigh }; // mono and legato
+  enum ESteal { kStealOldest = 0, kStealQuietest, kStealNone };
+
+  // maxVoices is the number of slots in pBank, nothing is allocated later.
+  IVoiceAllocator(IVoiceBank* pBank, int maxVoices)
+  : mBank(pBank)
+  , mCapacity(maxVoices)
+  , mMaxVoices(maxVoices)
+  , mNActive(0)
+  , mNHeld(0)
+  , mClock(0)
+  , mMode(kModePoly)
+  , mPriority(kPriorityLast)
+  , mSteal(kStealOldest)
+  , mSustain(false)
+  {
+    mVoiceNote.Resize(maxVoices);
+    mVoiceAge.Resize(maxVoices);
+    mVoiceFlags.Resize(maxVoices);
+    memset(mHeldVelocity, 0, sizeof(mHeldVelocity));
+    memset(mNoteSustained, 0, sizeof(mNoteSustained));
+    for (int i = 0; i < maxVoices; ++i)
+    {
+      mVoiceNote.Get()[i] = -1;
+      mVoiceFlags.Get()[i] = 0;
+    }
+  }
+
+  ~IVoiceAllocator() {}
+
+  void SetMode(EMode mode)
+  {
+    if (mode != mMode)
+    {
+      AllNotesOff();
+      mMode = mode;
+    }
+  }
+
+  void SetNotePriority(ENotePriority priority) { mPriority = priority; }
+  void SetStealMode(ESteal steal) { mSteal = steal; }
+  // Polyphony, up to the maxVoices given to the constructor. Sounding voices
+  // above the new limit play on until released.
+  void SetMaxVoices(int n) { mMaxVoices = IPMAX(1, IPMIN(n, mCapacity)); }
+
+  EMode GetMode() const { return mMode; }
+  int NActiveVoices() const { return mNActive; }
+  int GetVoiceNote(int slot) const { return mVoiceNote.Get()[slot]; }
+
+  // Handles note on/off, sustain pedal, all notes off and all sound off.
+  void ProcessMidiMsg(const IMidiMsg* pMsg)
+  {
+    switch (pMsg->StatusMsg())
+    {
+      case IMidiMsg::kNoteOn:
+        if (pMsg->Velocity())
+        {
+          NoteOn(pMsg->NoteNumber(), pMsg->Velocity());
+        }
+        else
+        {
+          NoteOff(pMsg->NoteNumber());
+        }
+        break;
+      case IMidiMsg::kNoteOff:
+        NoteOff(pMsg->NoteNumber());
+        break;
+      case IMidiMsg::kControlChange:
+        switch (pMsg->mData1)
+        {
+          case 64: SetSustain(pMsg->mData2 >= 64); break;
+          case 120: Reset(); break; // all sound off
+          case 123: AllNotesOff(); break;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  void NoteOn(int note, int velocity)
+  {
+    if (note < 0 || note > 127) return;
+
+    AddHeldNote(note, velocity);
+    mNoteSustained[note] = false;
+
+    if (mMode == kModePoly)
+    {
+      PolyNoteOn(note, velocity);
+    }
+    else if (PickHeldNote() == note)
+    {
+      MonoPlay(note, velocity);
+    }
+  }
+
+  void NoteOff(int note)
+  {
+    if (note < 0 || note > 127) return;
+
+    RemoveHeldNote(note);
+
+    if (mSustain)
+    {
+      mNoteSustained[note] = true;
+      return;
+    }
+
+    if (mMode == kModePoly)
+    {
+      ReleaseNote(note);
+    }
+    else
+    {
+      MonoNoteOff(note);
+    }
+  }
+
+  void SetSustain(bool sustain)
+  {
+    if (sustain == mSustain) return;
+    mSustain = sustain;
+
+    if (!sustain)
+    {
+      for (int note = 0; note < 128; ++note)
+      {
+        if (mNoteSustained[note])
+        {
+          mNoteSustained[note] = false;
+          if (mMode == kModePoly)
+          {
+            ReleaseNote(note);
+          }
+          else
+          {
+            MonoNoteOff(note);
+          }
+        }
+      }
+    }
+  }
+
+  // Releases all voices.
+  void AllNotesOff()
+  {
+    mNHeld = 0;
+    mSustain = false;
+    memset(mNoteSustained, 0, sizeof(mNoteSustained));
+
+    for (int i = 0; i < mNActive; ++i)
+    {
+      if (!(mVoiceFlags.Get()[i] & kReleased))
+      {
+        mVoiceFlags.Get()[i] |= kReleased;
+        mBank->ReleaseVoice(i);
+      }
+    }
+  }
+
+  // Stops and parks all voices immediately.
+  void Reset()
+  {
+    AllNotesOff();
+    for (int i = 0; i < mNActive; ++i)
+    {
+      mBank->StopVoice(i);
+      mVoiceNote.Get()[i] = -1;
+      mVoiceFlags.Get()[i] = 0;
+    }
+    mNActive = 0;
+  }
+
+  // Call after rendering: parks the voices that have finished their release.
+  void Update()
+  {
+    for (int i = mNActive - 1; i >= 0; --i)
+    {
+      if ((mVoiceFlags.Get()[i] & kReleased) && mBank->IsVoiceFinished(i))
+      {
+        mBank->StopVoice(i);
+        int last = --mNActive;
+        if (i != last)
+        {
+          mBank->SwapVoices(i, last);
+          SwapSlots(i, last);
+        }
+        mVoiceNote.Get()[last] = -1;
+        mVoiceFlags.Get()[last] = 0;
+      }
+    }
+  }
+
+private:
+  enum { kReleased = 1 };
+
+  void PolyNoteOn(int note, int velocity)
+  {
+    int* pNote = mVoiceNote.Get();
+    int slot = -1;
+
+    // a repeated note restarts its own voice
+    for (int i = 0; i < mNActive; ++i)
+    {
+      if (pNote[i] == note)
+      {
+        slot = i;
+        break;
+      }
+    }
+
+    if (slot < 0)
+    {
+      if (mNActive < mMaxVoices)
+      {
+        slot = mNActive++;
+      }
+      else if ((slot = FindVoiceToSteal()) < 0)
+      {
+        return;
+      }
+    }
+
+    StartSlot(slot, note, velocity, false);
+  }
+
+  int FindVoiceToSteal()
+  {
+    if (mSteal == kStealNone) return -1;
+
+    const int* pFlags = mVoiceFlags.Get();
+    const unsigned int* pAge = mVoiceAge.Get();
+    int best = -1;
+    bool bestReleased = false;
+    double bestLevel = 0.;
+
+    for (int i = 0; i < mNActive; ++i)
+    {
+      bool released = !!(pFlags[i] & kReleased);
+      double level = (mSteal == kStealQuietest ? mBank->GetVoiceLevel(i) : 0.);
+
+      // released voices go first, then the quietest or oldest
+      bool better;
+      if (best < 0) better = true;
+      else if (released != bestReleased) better = released;
+      else if (mSteal == kStealQuietest) better = (level < bestLevel);
+      else better = (mClock - pAge[i] > mClock - pAge[best]);
+
+      if (better)
+      {
+        best = i;
+        bestReleased = released;
+        bestLevel = level;
+      }
+    }
+    return best;
+  }
+
+  void StartSlot(int slot, int note, int velocity, bool legato)
+  {
+    mVoiceNote.Get()[slot] = note;
+    mVoiceAge.Get()[slot] = ++mClock;
+    mVoiceFlags.Get()[slot] = 0;
+    mBank->StartVoice(slot, note, velocity, legato);
+  }
+
+  void ReleaseNote(int note)
+  {
+    int* pNote = mVoiceNote.Get();
+    int* pFlags = mVoiceFlags.Get();
+
+    for (int i = 0; i < mNActive; ++i)
+    {
+      if (pNote[i] == note && !(pFlags[i] & kReleased))
+      {
+        pFlags[i] |= kReleased;
+        mBank->ReleaseVoice(i);
+      }
+    }
+  }
+
+  // mono and legato use slot 0 only
+  void MonoPlay(int note, int velocity)
+  {
+    bool sounding = (mNActive && !(mVoiceFlags.Get()[0] & kReleased));
+    if (!mNActive) mNActive = 1;
+    StartSlot(0, note, velocity, sounding && mMode == kModeLegato);
+  }
+
+  void MonoNoteOff(int note)
+  {
+    if (!mNActive || mVoiceNote.Get()[0] != note || (mVoiceFlags.Get()[0] & kReleased)) return;
+
+    if (mNHeld)
+    {
+      // back to the held note with the highest priority
+      int next = PickHeldNote();
+      MonoPlay(next, mHeldVelocity[next]);
+    }
+    else
+    {
+      mVoiceFlags.Get()[0] |= kReleased;
+      mBank->ReleaseVoice(0);
+    }
+  }
+
+  void AddHeldNote(int note, int velocity)
+  {
+    RemoveHeldNote(note);
+    mHeldNotes[mNHeld++] = note;
+    mHeldVelocity[note] = velocity;
+  }
+
+  void RemoveHeldNote(int note)
+  {
+    for (int i = 0; i < mNHeld; ++i)
+    {
+      if (mHeldNotes[i] == note)
+      {
+        memmove(mHeldNotes + i, mHeldNotes + i + 1, (--mNHeld - i) * sizeof(int));
+        return;
+      }
+    }
+  }
+
+  int PickHeldNote() const
+  {
+    if (!mNHeld) return -1;
+    int note = mHeldNotes[mNHeld - 1];
+    if (mPriority == kPriorityLast) return note;
+
+    for (int i = 0; i < mNHeld - 1; ++i)
+    {
+      if (mPriority == kPriorityLow ? mHeldNotes[i] < note : mHeldNotes[i] > note)
+      {
+        note = mHeldNotes[i];
+      }
+    }
+    return note;
+  }
+
+  void SwapSlots(int a, int b)
+  {
+    int note = mVoiceNote.Get()[a]; mVoiceNote.Get()[a] = mVoiceNote.Get()[b]; mVoiceNote.Get()[b] = note;
+    unsigned int age = mVoiceAge.Get()[a]; mVoiceAge.Get()[a] = mVoiceAge.Get()[b]; mVoiceAge.Get()[b] = age;
+    int flags = mVoiceFlags.Get()[a]; mVoiceFlags.Get()[a] = mVoiceFlags.Get()[b]; mVoiceFlags.Get()[b] = flags;
+  }
+
+  IVoiceBank* mBank;
+  int mCapacity, mMaxVoices, mNActive;
+
+  // per slot
+  WDL_TypedBuf<int> mVoiceNote;
+  WDL_TypedBuf<unsigned int> mVoiceAge;
+  WDL_TypedBuf<int> mVoiceFlags;
+
+  // held keys, in the order they were pressed
+  int mHeldNotes[128], mNHeld;
+  int mHeldVelocity[128];
+  bool mNoteSustained[128];
+
+  unsigned int mClock;
+  EMode mMode;
+  ENotePriority mPriority;
+  ESteal mSteal;
+  bool mSustain;
+};
+
+#endif // _IVOICEALLOCATOR_
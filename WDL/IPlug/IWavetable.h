@@ -0,0 +1,287 @@
+#ifndef _IWAVETABLE_
+#define _IWAVETABLE_
+
+/*
+
+IWavetable is a band-limited, mip-mapped single cycle waveform: one table per
+octave of playback pitch, each containing only the harmonics that stay below
+Nyquist at the highest pitch it is used for. Tables are selected by phase
+increment (cycles per sample), so they don't depend on the sample rate.
+
+Tables are built once per process and shared between plugin instances through
+IWavetableLibrary, which is reference counted.
+
+MyPlug.h:
+
+#include "WDL/IPlug/IWavetable.h"
+
+const IWavetable* mWavetable;
+
+MyPlug.cpp:
+
+MyPlug::MyPlug(...)
+{
+  mWavetable = IWavetableLibrary::Acquire(IWavetableLibrary::kSaw);
+}
+
+MyPlug::~MyPlug()
+{
+  IWavetableLibrary::Release(mWavetable);
+}
+
+// when a voice changes pitch (not per sample)
+mVoiceTable[v] = mWavetable->GetTableForIncr(mVoiceIncr[v]);
+
+// per sample, for all voices at once
+IWavetable::ReadVoices(mVoiceTable, mWavetable->GetTableSize(), mVoicePhase, mVoiceIncr, mVoiceOut, nVoices);
+
+*/
+
+#include <math.h>
+#include "../mutex.h"
+#include "../ptrlist.h"
+#include "IPlugStructs.h"
+
+#ifdef IPLUG_SSE2
+  #include <emmintrin.h>
+#endif
+
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
+#define DEFAULT_WAVETABLE_SIZE 2048
+
+class IWavetable
+{
+public:
+  // amps[h] is the amplitude of harmonic h + 1 (sine phase). tableSize must be a power of 2.
+  IWavetable(const double* amps, int nHarmonics, int tableSize = DEFAULT_WAVETABLE_SIZE)
+  : mTableSize(tableSize)
+  , mNTables(0)
+  {
+    // table i holds harmonics up to (tableSize / 2) >> i
+    for (int h = tableSize / 2; h >= 1; h >>= 1) ++mNTables;
+
+    int stride = mTableSize + 1;
+    double* pTables = mTables.Resize(mNTables * stride);
+    memset(pTables, 0, mNTables * stride * sizeof(double));
+
+    WDL_TypedBuf<double> sinBuf;
+    double* sinTable = sinBuf.Resize(mTableSize);
+    for (int i = 0; i < mTableSize; ++i)
+    {
+      sinTable[i] = sin(2. * M_PI * (double) i / (double) mTableSize);
+    }
+
+    // build from the top octave down, each table adds its extra harmonics to the one above
+    int mask = mTableSize - 1, prevHarmonics = 0;
+    for (int t = mNTables - 1; t >= 0; --t)
+    {
+      double* table = pTables + t * stride;
+      int nTableHarmonics = IPMIN((mTableSize / 2) >> t, nHarmonics);
+
+      if (t < mNTables - 1) memcpy(table, table + stride, mTableSize * sizeof(double));
+
+      for (int h = prevHarmonics + 1; h <= nTableHarmonics; ++h)
+      {
+        double amp = amps[h - 1];
+        if (amp == 0.) continue;
+        for (int i = 0; i < mTableSize; ++i)
+        {
+          table[i] += amp * sinTable[(h * i) & mask];
+        }
+      }
+      prevHarmonics = IPMAX(prevHarmonics, nTableHarmonics);
+    }
+
+    // one gain for all tables (from the fullest one), so the level doesn't jump between octaves
+    double peak = 0.;
+    for (int i = 0; i < mTableSize; ++i) peak = IPMAX(peak, fabs(pTables[i]));
+    double gain = peak > 0. ? 1. / peak : 1.;
+
+    for (int t = 0; t < mNTables; ++t)
+    {
+      double* table = pTables + t * stride;
+      for (int i = 0; i < mTableSize; ++i) table[i] *= gain;
+      table[mTableSize] = table[0]; // guard sample, so interpolation doesn't need to wrap
+    }
+  }
+
+  ~IWavetable() {}
+
+  int GetTableSize() const { return mTableSize; }
+  int NTables() const { return mNTables; }
+
+  // Each table is GetTableSize() + 1 samples, the last one repeats the first.
+  const double* GetTable(int idx) const { return mTables.Get() + idx * (mTableSize + 1); }
+
+  // The table to play at phaseIncr cycles per sample: the fullest one whose highest harmonic
+  // stays below Nyquist. Cheap, but meant to be called on pitch changes, not per sample.
+  const double* GetTableForIncr(double phaseIncr) const
+  {
+    int t = 0;
+    double maxIncr = 1. / (double) mTableSize;
+    while (t < mNTables - 1 && fabs(phaseIncr) > maxIncr)
+    {
+      maxIncr *= 2.;
+      ++t;
+    }
+    return GetTable(t);
+  }
+
+  // One sample of table at phase [0, 1), linear interpolated.
+  static inline double Read(const double* table, int tableSize, double phase)
+  {
+    double pos = phase * (double) tableSize;
+    int i = (int) pos;
+    double frac = pos - (double) i;
+    return table[i] + (table[i + 1] - table[i]) * frac;
+  }
+
+  // Reads one sample for each of nVoices voices into out, and advances their phase by
+  // phaseIncr (0 <= phaseIncr < 1), wrapping to [0, 1). All tables must be tableSize long.
+  static void ReadVoices(const double* const* tables, int tableSize, double* phase, const double* phaseIncr, double* out, int nVoices)
+  {
+    int v = 0;
+
+#ifdef IPLUG_SSE2
+    const __m128d size = _mm_set1_pd((double) tableSize), one = _mm_set1_pd(1.);
+
+    for (; v + 1 < nVoices; v += 2)
+    {
+      __m128d ph = _mm_loadu_pd(phase + v);
+      __m128d pos = _mm_mul_pd(ph, size);
+      __m128i ipos = _mm_cvttpd_epi32(pos);
+      __m128d frac = _mm_sub_pd(pos, _mm_cvtepi32_pd(ipos));
+
+      // no gather in SSE2, the loads are per voice
+      const double* p0 = tables[v] + _mm_cvtsi128_si32(ipos);
+      const double* p1 = tables[v + 1] + _mm_cvtsi128_si32(_mm_shuffle_epi32(ipos, 1));
+      __m128d a = _mm_set_pd(p1[0], p0[0]);
+      __m128d b = _mm_set_pd(p1[1], p0[1]);
+      _mm_storeu_pd(out + v, _mm_add_pd(a, _mm_mul_pd(_mm_sub_pd(b, a), frac)));
+
+      ph = _mm_add_pd(ph, _mm_loadu_pd(phaseIncr + v));
+      ph = _mm_sub_pd(ph, _mm_and_pd(_mm_cmpge_pd(ph, one), one));
+      _mm_storeu_pd(phase + v, ph);
+    }
+#endif
+
+    for (; v < nVoices; ++v)
+    {
+      out[v] = Read(tables[v], tableSize, phase[v]);
+      phase[v] += phaseIncr[v];
+      if (phase[v] >= 1.) phase[v] -= 1.;
+    }
+  }
+
+private:
+  int mTableSize, mNTables;
+  WDL_TypedBuf<double> mTables;
+} WDL_FIXALIGN;
+
+// Shared, reference counted wavetables, one per shape and table size. Acquire() and Release()
+// lock and may allocate, call them from the constructor/destructor, not the audio thread.
+class IWavetableLibrary
+{
+public:
+  enum EShape { kSine = 0, kSaw, kSquare, kTriangle, kNumShapes };
+
+  static const IWavetable* Acquire(int shape, int tableSize = DEFAULT_WAVETABLE_SIZE)
+  {
+    Storage* pStorage = &StaticStorage<0>::sStorage;
+    WDL_MutexLock lock(&pStorage->mMutex);
+
+    for (int i = 0; i < pStorage->mEntries.GetSize(); ++i)
+    {
+      Entry* pEntry = pStorage->mEntries.Get(i);
+      if (pEntry->mShape == shape && pEntry->mTable->GetTableSize() == tableSize)
+      {
+        pEntry->mRefs++;
+        return pEntry->mTable;
+      }
+    }
+
+    int nHarmonics = tableSize / 2;
+    WDL_TypedBuf<double> ampsBuf;
+    double* amps = ampsBuf.Resize(nHarmonics);
+    memset(amps, 0, nHarmonics * sizeof(double));
+
+    for (int h = 1; h <= nHarmonics; ++h)
+    {
+      switch (shape)
+      {
+        case kSine:
+          amps[h - 1] = h == 1 ? 1. : 0.;
+          break;
+        case kSaw:
+          amps[h - 1] = 1. / (double) h;
+          break;
+        case kSquare:
+          amps[h - 1] = (h & 1) ? 1. / (double) h : 0.;
+          break;
+        case kTriangle:
+          amps[h - 1] = (h & 1) ? ((h & 2) ? -1. : 1.) / (double) (h * h) : 0.;
+          break;
+        default:
+          break;
+      }
+    }
+
+    Entry* pEntry = pStorage->mEntries.Add(new Entry);
+    pEntry->mShape = shape;
+    pEntry->mRefs = 1;
+    pEntry->mTable = new IWavetable(amps, nHarmonics, tableSize);
+    return pEntry->mTable;
+  }
+
+  static void Release(const IWavetable* pTable)
+  {
+    Storage* pStorage = &StaticStorage<0>::sStorage;
+    WDL_MutexLock lock(&pStorage->mMutex);
+
+    for (int i = 0; i < pStorage->mEntries.GetSize(); ++i)
+    {
+      Entry* pEntry = pStorage->mEntries.Get(i);
+      if (pEntry->mTable == pTable)
+      {
+        if (--pEntry->mRefs <= 0)
+        {
+          delete pEntry->mTable;
+          pStorage->mEntries.Delete(i, true);
+        }
+        return;
+      }
+    }
+  }
+
+private:
+  struct Entry
+  {
+    int mShape, mRefs;
+    IWavetable* mTable;
+  };
+
+  struct Storage
+  {
+    WDL_PtrList<Entry> mEntries;
+    WDL_Mutex mMutex;
+
+    ~Storage()
+    {
+      for (int i = 0; i < mEntries.GetSize(); ++i)
+      {
+        delete mEntries.Get(i)->mTable;
+      }
+      mEntries.Empty(true);
+    }
+  };
+
+  // a class template static, so this header can be included in several translation units
+  template <int N> struct StaticStorage { static Storage sStorage; };
+};
+
+template <int N> IWavetableLibrary::Storage IWavetableLibrary::StaticStorage<N>::sStorage;
+
+#endif //_IWAVETABLE_
@@ -2,60 +2,116 @@
 #define _NCHANDELAY_
 
 // A static delayline used to delay bypassed signals to match mLatency in RTAS/AAX/VST3/AU
+// One ring buffer per channel, a power of 2 long. Blocks are copied in and out with at most
+// two memcpy()s per channel, and the delay time can change without touching the buffer
+// (it is clamped to the size set with SetMaxDelayTime()).
 class NChanDelayLine
 {
 private:
-  WDL_TypedBuf<double> mBuffer;
-  unsigned long mWriteAddress;
+  WDL_TypedBuf<double> mBuffer; // mNumChans rings of mRingSize samples
   unsigned int mNumInChans, mNumOutChans;
-  unsigned long mDTSamples;
-  
+  unsigned int mRingSize, mWriteAddress;
+  unsigned int mDTSamples;
+
+  enum { kMinHeadroom = 1024 }; // ring space beyond the delay time, i.e. the copy chunk size
+
+  int NChans() const { return mNumInChans < mNumOutChans ? mNumInChans : mNumOutChans; }
+
+  // copies n samples into ring at pos, wrapping
+  static void CopyIn(double* ring, unsigned int ringSize, unsigned int pos, const double* src, unsigned int n)
+  {
+    unsigned int n1 = ringSize - pos;
+    if (n1 >= n)
+    {
+      memcpy(ring + pos, src, n * sizeof(double));
+    }
+    else
+    {
+      memcpy(ring + pos, src, n1 * sizeof(double));
+      memcpy(ring, src + n1, (n - n1) * sizeof(double));
+    }
+  }
+
+  static void CopyOut(double* dest, const double* ring, unsigned int ringSize, unsigned int pos, unsigned int n)
+  {
+    unsigned int n1 = ringSize - pos;
+    if (n1 >= n)
+    {
+      memcpy(dest, ring + pos, n * sizeof(double));
+    }
+    else
+    {
+      memcpy(dest, ring + pos, n1 * sizeof(double));
+      memcpy(dest + n1, ring, (n - n1) * sizeof(double));
+    }
+  }
+
 public:
   NChanDelayLine(int maxInputChans = 2, int maxOutputChans = 2)
   : mNumInChans(maxInputChans)
-  , mNumOutChans(maxOutputChans) 
+  , mNumOutChans(maxOutputChans)
+  , mRingSize(0)
   , mWriteAddress(0)
   , mDTSamples(0) {}
-  
+
   ~NChanDelayLine() {}
-  
-  void SetDelayTime(int delayTimeSamples)
+
+  // Allocates for delay times up to maxDelayTimeSamples and clears the buffer, not while processing.
+  void SetMaxDelayTime(int maxDelayTimeSamples)
   {
-    mDTSamples = delayTimeSamples;
-    mBuffer.Resize(mNumInChans * delayTimeSamples);
+    unsigned int size = 1;
+    while (size < (unsigned int) maxDelayTimeSamples + kMinHeadroom) size <<= 1;
+    if (size <= mRingSize) return;
+
+    mRingSize = size;
+    mBuffer.Resize(NChans() * mRingSize);
     mWriteAddress = 0;
     ClearBuffer();
   }
-  
+
+  // Safe while running, never allocates: the ring always holds the most recent input, so the
+  // output just continues at the new delay. Clamped to GetMaxDelayTime().
+  void SetDelayTime(int delayTimeSamples)
+  {
+    int maxDelay = GetMaxDelayTime();
+    mDTSamples = IPMAX(IPMIN(delayTimeSamples, maxDelay), 0);
+  }
+
+  int GetDelayTime() const { return mDTSamples; }
+  int GetMaxDelayTime() const { return mRingSize ? mRingSize - kMinHeadroom : 0; }
+
   void ClearBuffer()
   {
-    memset(mBuffer.Get(), 0, mNumInChans * mDTSamples * sizeof(double));
+    memset(mBuffer.Get(), 0, mBuffer.GetSize() * sizeof(double));
   }
-  
+
+  // inputs and outputs may be the same buffers
   void ProcessBlock(double** inputs, double** outputs, int nFrames)
   {
+    int nChans = NChans();
+    unsigned int delay = mDTSamples, mask = mRingSize - 1;
+    if (!mRingSize || delay >= mRingSize) return;
+
+    // write before read, so each chunk must not overwrite the delay time worth of history
+    unsigned int chunk = mRingSize - delay;
     double* buffer = mBuffer.Get();
-    
-    for (int s = 0 ; s < nFrames; ++s)
+
+    for (unsigned int s = 0; s < (unsigned int) nFrames; s += chunk)
     {
-      signed long readAddress = mWriteAddress - mDTSamples;
-      readAddress %= mDTSamples;
-      
-      for (int chan = 0; chan < mNumInChans; chan++) 
+      unsigned int n = IPMIN(chunk, (unsigned int) nFrames - s);
+      unsigned int readAddress = (mWriteAddress - delay) & mask;
+
+      for (int chan = 0; chan < nChans; ++chan)
       {
-        if (chan < mNumOutChans)
-        {
-          int offset = chan * mDTSamples;
-          outputs[chan][s] = buffer[offset + readAddress];
-          buffer[offset + mWriteAddress] = inputs[chan][s];
-        }
+        double* ring = buffer + chan * mRingSize;
+        CopyIn(ring, mRingSize, mWriteAddress, inputs[chan] + s, n);
+        CopyOut(outputs[chan] + s, ring, mRingSize, readAddress, n);
       }
-      
-      mWriteAddress++;
-      mWriteAddress %= mDTSamples;
+
+      mWriteAddress = (mWriteAddress + n) & mask;
     }
   }
-  
+
 } WDL_FIXALIGN;
 
 #endif //_NCHANDELAY_
\ No newline at end of file
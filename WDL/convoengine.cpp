@@ -31,6 +31,7 @@
 #include "convoengine.h"
 
 #include "denormal.h"
+#include "wdlatomic.h"
 
 //#define TIMING
 #include "timing.c"
@@ -38,6 +39,64 @@
 #define CONVOENGINE_SILENCE_THRESH 1.0e-12 // -240dB
 #define CONVOENGINE_IMPULSE_SILENCE_THRESH 1.0e-15 // -300dB
 
+#if WDL_FFT_REALSIZE == 4 || defined(WDL_CONVO_WANT_FULLPRECISION_IMPULSE_STORAGE)
+
+// impulse storage has the same precision as the sample history, so use the (SIMD) kernels in fft.c
+
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+static void WDL_CONVO_CplxMul2_Split(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_CONVO_IMPULSEBUFf *b, int n)
+{
+  WDL_fft_complexmul2_split(c,a,(WDL_FFT_REAL*)b,n);
+}
+static void WDL_CONVO_CplxMul3_Split(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_CONVO_IMPULSEBUFf *b, int n)
+{
+  WDL_fft_complexmul3_split(c,a,(WDL_FFT_REAL*)b,n);
+}
+#else
+static void WDL_CONVO_CplxMul2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_CONVO_IMPULSEBUFCPLXf *b, int n)
+{
+  WDL_fft_complexmul2(c,a,(WDL_FFT_COMPLEX*)b,n);
+}
+static void WDL_CONVO_CplxMul3(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_CONVO_IMPULSEBUFCPLXf *b, int n)
+{
+  WDL_fft_complexmul3(c,a,(WDL_FFT_COMPLEX*)b,n);
+}
+#endif
+
+#else
+
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+static void WDL_CONVO_CplxMul2_Split(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_CONVO_IMPULSEBUFf *b, int n)
+{
+  WDL_FFT_REAL *ci=c+n, *ai=a+n;
+  WDL_CONVO_IMPULSEBUFf *bi=b+n;
+  int i;
+  for (i = 0; i < n; i ++)
+  {
+    WDL_FFT_REAL t1 = a[i] * b[i];
+    WDL_FFT_REAL t2 = ai[i] * bi[i];
+    WDL_FFT_REAL t3 = ai[i] * b[i];
+    WDL_FFT_REAL t4 = a[i] * bi[i];
+    c[i] = t1 - t2;
+    ci[i] = t3 + t4;
+  }
+}
+static void WDL_CONVO_CplxMul3_Split(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_CONVO_IMPULSEBUFf *b, int n)
+{
+  WDL_FFT_REAL *ci=c+n, *ai=a+n;
+  WDL_CONVO_IMPULSEBUFf *bi=b+n;
+  int i;
+  for (i = 0; i < n; i ++)
+  {
+    WDL_FFT_REAL t1 = a[i] * b[i];
+    WDL_FFT_REAL t2 = ai[i] * bi[i];
+    WDL_FFT_REAL t3 = ai[i] * b[i];
+    WDL_FFT_REAL t4 = a[i] * bi[i];
+    c[i] += t1 - t2;
+    ci[i] += t3 + t4;
+  }
+}
+#else
 static void WDL_CONVO_CplxMul2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_CONVO_IMPULSEBUFCPLXf *b, int n)
 {
   WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
@@ -92,6 +151,9 @@ static void WDL_CONVO_CplxMul3(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_CONVO
     c += 2;
   } while (n -= 2);
 }
+#endif
+
+#endif
 
 static bool CompareQueueToBuf(WDL_FastQueue *q, const void *data, int len)
 {
@@ -128,6 +190,9 @@ WDL_ConvolutionEngine::WDL_ConvolutionEngine()
   m_fft_size=0;
   m_impulse_len=0;
   m_proc_nch=0;
+  m_zl_delaypos=0;
+  m_zl_dumpage=0;
+  m_zl_nomonoinput=false;
 }
 
 WDL_ConvolutionEngine::~WDL_ConvolutionEngine()
@@ -259,11 +324,20 @@ int WDL_ConvolutionEngine::SetImpulse(WDL_ImpulseBuffer *impulse, int fft_size,
         *zbuf++=mv>CONVOENGINE_IMPULSE_SILENCE_THRESH ? 2 : 1; // 1 means only second channel has content
         WDL_fft((WDL_FFT_COMPLEX*)impout,fft_size,0);
 
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+        {
+          WDL_FFT_REAL *splitbuf=m_combinebuf.Resize(fft_size*2,false);
+          WDL_fft_split(splitbuf,(WDL_FFT_COMPLEX*)imptmp,fft_size);
+          int x,n=fft_size*2;
+          for(x=0;x<n;x++) impout[x]=(WDL_CONVO_IMPULSEBUFf)splitbuf[x];
+        }
+#else
         if (smallerSizeMode)
         {
           int x,n=fft_size*2;
           for(x=0;x<n;x++) impout[x]=(WDL_CONVO_IMPULSEBUFf)imptmp[x];
         }
+#endif
       }
       else *zbuf++=0;
 
@@ -486,7 +560,7 @@ int WDL_ConvolutionEngine::Avail(int want)
     int srcc=ch;
     if (srcc>=m_impulse_nch) srcc=m_impulse_nch-1;
 
-    bool allow_mono_input_mode=true;
+    bool allow_mono_input_mode=!m_zl_nomonoinput;
     bool mono_impulse_mode=false;
 
     if (m_impulse_nch==1 && ch<m_proc_nch-1 && 
@@ -573,7 +647,14 @@ int WDL_ConvolutionEngine::Avail(int want)
       m_zl_fftcnt++;
 #endif
 
-      if (nonzflag) WDL_fft((WDL_FFT_COMPLEX*)optr,m_fft_size,0);
+      if (nonzflag) 
+      {
+        WDL_fft((WDL_FFT_COMPLEX*)optr,m_fft_size,0);
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+        WDL_fft_split(workbuf2,(WDL_FFT_COMPLEX*)optr,m_fft_size);
+        memcpy(optr,workbuf2,m_fft_size*2*sizeof(WDL_FFT_REAL));
+#endif
+      }
 
       if (useSilentList) useSilentList[histpos]=nonzflag ? (mono_input_mode ? 1 : 2) : 0;
     
@@ -591,6 +672,9 @@ int WDL_ConvolutionEngine::Avail(int want)
       }
 
       int applycnt=0;
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+      WDL_FFT_REAL *accbuf=workbuf2+m_fft_size*2; // split, converted back to workbuf2 before the ifft
+#endif
       char *useImpSilentList=m_impulse_zflag[srcc].GetSize() == nblocks ? m_impulse_zflag[srcc].Get() : NULL;
 
       WDL_CONVO_IMPULSEBUFf *impulseptr=m_impulse[srcc].Get();
@@ -604,16 +688,28 @@ int WDL_ConvolutionEngine::Avail(int want)
 
         WDL_FFT_REAL *samplehist=m_samplehist[ch].Get() + m_fft_size*srchistpos*2;
 
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+        if (applycnt++) // add to output
+          WDL_CONVO_CplxMul3_Split(accbuf,samplehist,impulseptr,m_fft_size);
+        else // replace output
+          WDL_CONVO_CplxMul2_Split(accbuf,samplehist,impulseptr,m_fft_size);
+#else
         if (applycnt++) // add to output
           WDL_CONVO_CplxMul3((WDL_FFT_COMPLEX*)workbuf2,(WDL_FFT_COMPLEX*)samplehist,(WDL_CONVO_IMPULSEBUFCPLXf*)impulseptr,m_fft_size);   
         else // replace output
           WDL_CONVO_CplxMul2((WDL_FFT_COMPLEX*)workbuf2,(WDL_FFT_COMPLEX*)samplehist,(WDL_CONVO_IMPULSEBUFCPLXf*)impulseptr,m_fft_size);  
+#endif
 
       }
       if (!applycnt)
         memset(workbuf2,0,m_fft_size*2*sizeof(WDL_FFT_REAL));
       else
+      {
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+        WDL_fft_unsplit((WDL_FFT_COMPLEX*)workbuf2,accbuf,m_fft_size);
+#endif
         WDL_fft((WDL_FFT_COMPLEX*)workbuf2,m_fft_size,1);
+      }
 
       WDL_FFT_REAL *olhist=m_overlaphist[ch].Get(); // errors from last time
       WDL_FFT_REAL *p1=workbuf2,*p3=workbuf2+m_fft_size,*p1o=workbuf2;
@@ -679,6 +775,142 @@ int WDL_ConvolutionEngine::Avail(int want)
   return mv;
 }
 
+bool WDL_ConvolutionEngine::Process(WDL_FFT_REAL **in, WDL_FFT_REAL **out, int nframes, int nch)
+{
+  if (m_fft_size<2 || nframes != m_fft_size/2 || nch<1 || nch>WDL_CONVO_MAX_PROC_NCH) return false;
+
+  const int sz=m_fft_size/2;
+  const int nblocks=(m_impulse_len+sz-1)/sz;
+  int ch;
+
+  if (m_proc_nch != nch)
+  {
+    m_proc_nch=nch;
+    memset(m_hist_pos,0,sizeof(m_hist_pos));
+    for (ch = 0; ch < WDL_CONVO_MAX_PROC_NCH; ch ++)
+    {
+      m_samplesin[ch].Clear();
+      m_samplesout[ch].Clear();
+      memset(m_samplehist_zflag[ch].Resize(nblocks),0,nblocks);
+      m_samplehist[ch].Resize(ch<nch ? nblocks*m_fft_size*2 : 0);
+      m_overlaphist[ch].Resize(ch<nch ? sz : 0);
+      memset(m_samplehist[ch].Get(),0,m_samplehist[ch].GetSize()*sizeof(WDL_FFT_REAL));
+      memset(m_overlaphist[ch].Get(),0,m_overlaphist[ch].GetSize()*sizeof(WDL_FFT_REAL));
+    }
+  }
+
+  if (m_impulse_len<1||!nblocks)
+  {
+    for (ch = 0; ch < nch; ch ++)
+    {
+      if (in && in[ch]) { if (out[ch]!=in[ch]) memcpy(out[ch],in[ch],nframes*sizeof(WDL_FFT_REAL)); }
+      else memset(out[ch],0,nframes*sizeof(WDL_FFT_REAL));
+    }
+    return true;
+  }
+
+  WDL_FFT_REAL *workbuf2 = m_combinebuf.Resize(m_fft_size*4); // temp space
+
+  for (ch = 0; ch < nch; ch ++)
+  {
+    // with a mono impulse, pairs of channels are packed as re/im and processed with a single fft
+    const bool pairmode = m_impulse_nch==1 && ch < nch-1;
+    const int srcc = ch < m_impulse_nch ? ch : m_impulse_nch-1;
+    const WDL_FFT_REAL *src1 = in ? in[ch] : NULL;
+    const WDL_FFT_REAL *src2 = in && pairmode ? in[ch+1] : NULL;
+
+    int histpos;
+    if ((histpos=++m_hist_pos[ch]) >= nblocks) histpos=m_hist_pos[ch]=0;
+    WDL_FFT_REAL *optr = m_samplehist[ch].Get()+histpos*m_fft_size*2;
+    char *useSilentList=m_samplehist_zflag[ch].Get();
+
+    bool nonzflag=false;
+    int i;
+    for (i = 0; i < sz; i ++) // unpack samples, before anything is written to out (which may be in)
+    {
+      WDL_FFT_REAL f=optr[i*2]=src1 ? denormal_filter_aggressive(src1[i]) : 0.0;
+      if (!nonzflag && (f<-CONVOENGINE_SILENCE_THRESH || f>CONVOENGINE_SILENCE_THRESH)) nonzflag=true;
+      f=optr[i*2+1]=src2 ? denormal_filter_aggressive(src2[i]) : 0.0;
+      if (!nonzflag && (f<-CONVOENGINE_SILENCE_THRESH || f>CONVOENGINE_SILENCE_THRESH)) nonzflag=true;
+    }
+    useSilentList[histpos]=nonzflag ? 2 : 0;
+
+    if (nonzflag)
+    {
+      memset(optr+sz*2,0,sz*2*sizeof(WDL_FFT_REAL));
+      WDL_fft((WDL_FFT_COMPLEX*)optr,m_fft_size,0);
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+      WDL_fft_split(workbuf2,(WDL_FFT_COMPLEX*)optr,m_fft_size);
+      memcpy(optr,workbuf2,m_fft_size*2*sizeof(WDL_FFT_REAL));
+#endif
+    }
+
+    int applycnt=0;
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+    WDL_FFT_REAL *accbuf=workbuf2+m_fft_size*2; // split, converted back to workbuf2 before the ifft
+#endif
+    char *useImpSilentList=m_impulse_zflag[srcc].GetSize() == nblocks ? m_impulse_zflag[srcc].Get() : NULL;
+    WDL_CONVO_IMPULSEBUFf *impulseptr=m_impulse[srcc].Get();
+    for (i = 0; i < nblocks; i ++, impulseptr+=m_fft_size*2)
+    {
+      int srchistpos = histpos-i;
+      if (srchistpos < 0) srchistpos += nblocks;
+
+      if (useImpSilentList && useImpSilentList[i]<2) continue;
+      if (!useSilentList[srchistpos]) continue; // silent block
+
+      WDL_FFT_REAL *samplehist=m_samplehist[ch].Get() + m_fft_size*srchistpos*2;
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+      if (applycnt++) WDL_CONVO_CplxMul3_Split(accbuf,samplehist,impulseptr,m_fft_size);
+      else WDL_CONVO_CplxMul2_Split(accbuf,samplehist,impulseptr,m_fft_size);
+#else
+      if (applycnt++) WDL_CONVO_CplxMul3((WDL_FFT_COMPLEX*)workbuf2,(WDL_FFT_COMPLEX*)samplehist,(WDL_CONVO_IMPULSEBUFCPLXf*)impulseptr,m_fft_size);
+      else WDL_CONVO_CplxMul2((WDL_FFT_COMPLEX*)workbuf2,(WDL_FFT_COMPLEX*)samplehist,(WDL_CONVO_IMPULSEBUFCPLXf*)impulseptr,m_fft_size);
+#endif
+    }
+    if (!applycnt)
+      memset(workbuf2,0,m_fft_size*2*sizeof(WDL_FFT_REAL));
+    else
+    {
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+      WDL_fft_unsplit((WDL_FFT_COMPLEX*)workbuf2,accbuf,m_fft_size);
+#endif
+      WDL_fft((WDL_FFT_COMPLEX*)workbuf2,m_fft_size,1);
+    }
+
+    // overlap-add straight to the output
+    const WDL_FFT_REAL *p1=workbuf2, *p3=workbuf2+m_fft_size;
+    WDL_FFT_REAL *olhist=m_overlaphist[ch].Get();
+    WDL_FFT_REAL *o1=out[ch];
+    if (pairmode)
+    {
+      WDL_FFT_REAL *olhist2=m_overlaphist[ch+1].Get();
+      WDL_FFT_REAL *o2=out[ch+1];
+      for (i = 0; i < sz; i ++)
+      {
+        o1[i]=p1[0]+olhist[i];
+        o2[i]=p1[1]+olhist2[i];
+        olhist[i]=p3[0];
+        olhist2[i]=p3[1];
+        p1+=2;
+        p3+=2;
+      }
+      ch++;
+    }
+    else
+    {
+      for (i = 0; i < sz; i ++)
+      {
+        o1[i]=p1[0]+olhist[i];
+        olhist[i]=p3[0];
+        p1+=2;
+        p3+=2;
+      }
+    }
+  }
+  return true;
+}
+
 WDL_FFT_REAL **WDL_ConvolutionEngine::Get() 
 {
   int x;
@@ -705,154 +937,1193 @@ void WDL_ConvolutionEngine::Advance(int len)
 **  low latency version
 */
 
-WDL_ConvolutionEngine_Div::WDL_ConvolutionEngine_Div()
-{
-  timingInit();
-  m_proc_nch=2;
-  m_need_feedsilence=true;
-}
+#ifdef WDL_CONVO_THREAD
 
-int WDL_ConvolutionEngine_Div::SetImpulse(WDL_ImpulseBuffer *impulse, int maxfft_size, int known_blocksize, int max_imp_size, int impulse_offset, int latency_allowed)
-{
-  m_need_feedsilence=true;
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#endif
 
-  m_engines.Empty(true);
-  if (maxfft_size<0)maxfft_size=-maxfft_size;
-  maxfft_size*=2;
-  if (!maxfft_size || maxfft_size>32768) maxfft_size=32768;
+#ifndef WDL_CONVO_THREAD_RINGSIZE
+#define WDL_CONVO_THREAD_RINGSIZE 65536 // minimum samples per channel buffered to/from each background partition (power of 2)
+#endif
 
+// single reader/single writer FIFO of nch channels, allocated up front so that neither side allocates, locks or waits.
+// positions are free-running counters, published with wdl_atomic_*() after the items are written/read (and only
+// accessed with wdl_atomic_*(), since wdl_atomic_get() may be implemented as a write).
+template<class T> class WDL_ConvolutionEngine_Div_Ring
+{
+public:
+  WDL_ConvolutionEngine_Div_Ring() { m_size=0; m_rd=m_wr=0; }
 
-  const int MAX_SIZE_FOR_BRUTE=64;
+  void Init(int size, int nch) // size must be a power of 2, not while in use
+  {
+    memset(m_buf.Resize(size*nch,false),0,size*nch*sizeof(T));
+    m_size=m_buf.GetSize()==size*nch ? size : 0;
+    m_rd=m_wr=0;
+  }
+  int GetSize() { return m_size; }
 
-  int fftsize = MAX_SIZE_FOR_BRUTE;
-  int impulsechunksize = MAX_SIZE_FOR_BRUTE;
+  // reader
+  int ReadPos() { return wdl_atomic_get(&m_rd); }
+  int WritePos() { return wdl_atomic_get(&m_wr); }
 
-  if (known_blocksize && !(known_blocksize&(known_blocksize-1)) && known_blocksize>MAX_SIZE_FOR_BRUTE*2)
+  int Available() { return (int)((unsigned int)WritePos() - (unsigned int)ReadPos()); }
+  void Advance(int len) { wdl_atomic_add(&m_rd,len); }
+  void AddTo(T **outs, int len, int nch) // mixes len items into outs (len <= Available())
   {
-    fftsize=known_blocksize/2;
-    impulsechunksize=known_blocksize/2;
+    int pos=0;
+    while (pos<len)
+    {
+      int n=len-pos, ch;
+      const int idx=GetSegment(ReadPos()+pos,&n);
+      for (ch = 0; ch < nch; ch ++)
+      {
+        T *o=outs[ch]+pos;
+        const T *in=m_buf.Get()+ch*m_size+idx;
+        int i=n;
+        while (i-->0) *o++ += *in++;
+      }
+      pos+=n;
+    }
   }
-  if (latency_allowed*2 > fftsize)
+
+  // writer
+  int Free() { return m_size - (int)((unsigned int)WritePos() - (unsigned int)ReadPos()); }
+  void Write(T **bufs, int len, int nch) // len <= Free(), NULL bufs write zeros
   {
-    int x = 16;
-    while (x <= latency_allowed) x*=2;
-    if (x>32768) x=32768;
-    fftsize=impulsechunksize=x;
+    int pos=0;
+    while (pos<len)
+    {
+      int n=len-pos, ch;
+      const int idx=GetSegment(WritePos()+pos,&n);
+      for (ch = 0; ch < nch; ch ++)
+      {
+        T *o=m_buf.Get()+ch*m_size+idx;
+        if (bufs && bufs[ch]) memcpy(o,bufs[ch]+pos,n*sizeof(T));
+        else memset(o,0,n*sizeof(T));
+      }
+      pos+=n;
+    }
+    wdl_atomic_add(&m_wr,len);
   }
 
-  int offs=0;
-  int samplesleft=impulse->impulses[0].GetSize()-impulse_offset;
-  if (max_imp_size>0 && samplesleft>max_imp_size) samplesleft=max_imp_size;
+  // contiguous items of channel ch at counter position pos, *len is reduced to fit
+  T *GetPtr(int ch, int pos, int *len) { return m_buf.Get()+ch*m_size+GetSegment(pos,len); }
 
-  do
+private:
+  int GetSegment(int pos, int *len)
   {
-    WDL_ConvolutionEngine *eng=new WDL_ConvolutionEngine;
-
-    bool wantBrute = !latency_allowed && !offs;
-    if (impulsechunksize*(wantBrute ? 2 : 3) >= samplesleft) impulsechunksize=samplesleft; // early-out, no point going to a larger FFT (since if we did this, we wouldnt have enough samples for a complete next pass)
-    if (fftsize>=maxfft_size) { impulsechunksize=samplesleft; fftsize=maxfft_size; } // if FFTs are as large as possible, finish up
+    const int idx=pos&(m_size-1);
+    if (*len > m_size-idx) *len=m_size-idx;
+    return idx;
+  }
 
-    eng->SetImpulse(impulse,fftsize,offs+impulse_offset,impulsechunksize, wantBrute);
-    eng->m_zl_delaypos = offs;
-    eng->m_zl_dumpage=0;
-    m_engines.Add(eng);
+  WDL_TypedBuf<T> m_buf;
+  int m_size;
+  int m_rd, m_wr;
+};
+
+// a partition of WDL_ConvolutionEngine_Div that is processed off the calling thread.
+//
+// m_eng has mono input mode disabled (see m_zl_nomonoinput), so its output does not depend on how its blocks are
+// grouped into Avail() calls, and Process() transforms every complete block as soon as its input arrives. the
+// partitions that are planned as jobs start at least one host block after their fft size/2, so a block's output only
+// depends on input that was sent with the previous block, and the worker has that long to finish it. if it hasn't,
+// WDL_ConvolutionEngine_Div::Avail() waits for it, or runs Process() itself (see Claim()), so the output never
+// depends on thread timing. the calling thread tracks the samples m_eng would have in m_sim_*, and only touches
+// m_in, m_cmd (writer), m_out (reader) and the reset request.
+class WDL_ConvolutionEngine_Div_Job
+{
+public:
+  enum { CMD_ADD=0, CMD_ADD_FIRST, CMD_NCH=3 }; // m_cmd channels are type, len, nch
 
-#ifdef WDLCONVO_ZL_ACCOUNTING
-    char buf[512];
-    wsprintf(buf,"ce%d: offs=%d, len=%d, fftsize=%d\n",m_engines.GetSize(),offs,impulsechunksize,fftsize);
-    OutputDebugString(buf);
+  WDL_ConvolutionEngine_Div_Job(WDL_ConvolutionEngine *eng, int dumpage)
+  {
+    m_eng=eng;
+    m_eng->m_zl_nomonoinput=true;
+    m_worker=NULL;
+    m_dumpage=dumpage;
+    m_busy=0;
+    m_reset_req=m_reset_ack=0;
+    m_reset_sent=m_w_ack=0;
+    m_reset_inpos=m_reset_cmdpos=m_reset_outpos=0;
+    m_reset_pending=false;
+    m_overflow=false;
+    m_zeros=0;
+    m_mixpos=0;
+    m_sim_in=m_sim_out=0;
+    m_sim_dump=0;
+    m_w_nch=0;
+
+    int sz=WDL_CONVO_THREAD_RINGSIZE;
+    while (sz < eng->GetFFTSize()*2) sz*=2;
+    m_in.Init(sz,WDL_CONVO_MAX_PROC_NCH);
+    m_out.Init(sz,WDL_CONVO_MAX_PROC_NCH);
+    m_cmd.Init(4096,CMD_NCH);
+  }
+  ~WDL_ConvolutionEngine_Div_Job() { }
+
+  // calling thread
+  void Reset(); // asks the worker to reset m_eng, output is not available until it has
+  void Add(WDL_FFT_REAL **bufs, int len, int nch, bool first);
+  int SimAvail(int want); // what m_eng->Avail(want+dumpage)-dumpage would return
+  void Consume(int len); // the Advance() that follows SimAvail()
+  int ReadAvail();
+  int WaitAvail(int len); // ReadAvail(), after waiting for (or doing) the processing that makes it >= len
+  void AddTo(WDL_FFT_REAL **outs, int len, int nch); // len <= ReadAvail()
+
+  // either thread: Process() only while claimed, it runs m_eng on any pending commands
+  bool Claim() { if (wdl_atomic_incr(&m_busy) == 1) return true; wdl_atomic_decr(&m_busy); return false; }
+  void Release() { wdl_atomic_decr(&m_busy); }
+  void Process();
+
+  WDL_ConvolutionEngine *m_eng; // owned by WDL_ConvolutionEngine_Div::m_engines
+  WDL_ConvolutionEngine_Div_Worker *m_worker;
+  int m_dumpage; // see WDL_ConvolutionEngine::m_zl_dumpage
+
+  WDL_ConvolutionEngine_Div_Ring<WDL_FFT_REAL> m_in, m_out;
+  WDL_ConvolutionEngine_Div_Ring<int> m_cmd;
+
+  int m_busy;
+  int m_reset_req, m_reset_ack; // ack is set by Process() once it has dropped input and commands before
+  int m_reset_inpos, m_reset_cmdpos, m_reset_outpos; // m_reset_inpos/cmdpos, and output before m_reset_outpos
+
+  // used only by the calling thread
+  int m_reset_sent; // last m_reset_req
+  bool m_reset_pending;
+  bool m_overflow; // a block did not fit in the rings, the partition is silent until it has reset
+  int m_zeros; // silence preceding m_out (delay less dumpage)
+  int m_mixpos; // samples of WDL_ConvolutionEngine_Div::m_samplesout that include this partition
+  int m_sim_in, m_sim_out, m_sim_dump;
+
+  // used only by Process()
+  int m_w_ack; // last m_reset_ack
+  int m_w_nch;
+
+private:
+  void PushCmd(int type, int a, int b)
+  {
+    int v[CMD_NCH]={type,a,b}, *p[CMD_NCH]={v,v+1,v+2};
+    m_cmd.Write(p,1,CMD_NCH);
+  }
+  void YieldThread()
+  {
+#ifdef _WIN32
+    Sleep(0);
+#else
+    sched_yield();
 #endif
+  }
+};
 
-    samplesleft -= impulsechunksize;
-    offs+=impulsechunksize;
+class WDL_ConvolutionEngine_Div_Worker
+{
+public:
+  WDL_ConvolutionEngine_Div_Worker();
+  ~WDL_ConvolutionEngine_Div_Worker();
 
-#if 1 // this seems about 10% faster (maybe due to better cache use from less sized ffts used?)
-    impulsechunksize=offs*3;
-    fftsize=offs*2;
-#else
-    impulsechunksize=fftsize;
+  bool Start();
+  void Stop();
 
-    fftsize*=2;
+  void Signal(); // wake the thread to process queued commands, never blocks
+
+  WDL_PtrList<WDL_ConvolutionEngine_Div_Job> m_jobs;
+
+private:
+  void Run();
+#ifdef _WIN32
+  static unsigned WINAPI _threadfunc(void *_d);
+  HANDLE m_thread, m_signal;
+#else
+  static void *_threadfunc(void *_d);
+  pthread_t m_thread;
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_cond;
+  bool m_running;
 #endif
-  }
-  while (samplesleft > 0);
-  
-  return GetLatency();
-}
+  int m_sigcnt;
+  int m_kill;
+};
 
-int WDL_ConvolutionEngine_Div::GetLatency()
+
+void WDL_ConvolutionEngine_Div_Job::Reset()
 {
-  return m_engines.GetSize() ? m_engines.Get(0)->GetLatency() : 0;
+  m_reset_inpos=m_in.WritePos();
+  m_reset_cmdpos=m_cmd.WritePos();
+  m_reset_sent=wdl_atomic_incr(&m_reset_req);
+  m_reset_pending=true;
+  m_zeros=0;
+  m_sim_in=m_sim_out=m_sim_dump=0;
 }
 
-
-void WDL_ConvolutionEngine_Div::Reset()
+void WDL_ConvolutionEngine_Div_Job::Add(WDL_FFT_REAL **bufs, int len, int nch, bool first)
 {
-  int x;
-  for (x = 0; x < m_engines.GetSize(); x ++)
+  if (m_overflow)
   {
-    WDL_ConvolutionEngine *eng=m_engines.Get(x);
-    eng->Reset();
+    if (wdl_atomic_get(&m_reset_ack) != m_reset_sent) return;
+    m_overflow=false;
+    first=true; // restart from here, as if only this partition had been reset
   }
-  for (x = 0; x < WDL_CONVO_MAX_PROC_NCH; x ++)
+
+  if (first)
   {
-    m_samplesout[x].Clear();
+    m_zeros = m_eng->m_zl_delaypos - m_dumpage; // Process() adds the dumpage, and m_out starts after the delay
+    m_sim_dump = m_dumpage;
+    m_sim_in += m_dumpage;
+    m_sim_out += m_eng->m_zl_delaypos;
   }
+  m_sim_in += len;
 
-  m_need_feedsilence=true;
+  // sent in pieces that Process() can always fit in m_out
+  const int maxlen=m_in.GetSize()/2;
+  int pos=0;
+  do
+  {
+    const int n = len-pos < maxlen ? len-pos : maxlen;
+    while (m_cmd.Free() < 1 || m_in.Free() < n)
+    {
+      // Add() without Avail(), make room by processing here unless m_out is full too
+      if (!Claim()) { YieldThread(); continue; }
+      Process();
+      Release();
+      if (m_cmd.Free() < 1 || m_in.Free() < n)
+      {
+        Reset();
+        m_overflow=true;
+        return;
+      }
+    }
+
+    if (n>0)
+    {
+      WDL_FFT_REAL *tp[WDL_CONVO_MAX_PROC_NCH];
+      int ch;
+      for (ch = 0; ch < nch; ch ++) tp[ch] = bufs && bufs[ch] ? bufs[ch]+pos : NULL;
+      m_in.Write(tp,n,nch);
+    }
+    PushCmd(first && !pos ? CMD_ADD_FIRST : CMD_ADD,n,nch);
+    pos+=n;
+  }
+  while (pos<len);
+
+  if (m_worker) m_worker->Signal();
 }
 
-WDL_ConvolutionEngine_Div::~WDL_ConvolutionEngine_Div()
+int WDL_ConvolutionEngine_Div_Job::SimAvail(int want)
 {
-  timingPrint();
-  m_engines.Empty(true);
+  if (m_overflow) return want;
+  const int sz=m_eng->GetFFTSize()/2;
+  while (m_sim_in >= sz && m_sim_out < want+m_sim_dump)
+  {
+    m_sim_in -= sz;
+    m_sim_out += sz;
+  }
+  return m_sim_out - m_sim_dump;
 }
 
-void WDL_ConvolutionEngine_Div::Add(WDL_FFT_REAL **bufs, int len, int nch)
+void WDL_ConvolutionEngine_Div_Job::Consume(int len)
 {
-  m_proc_nch=nch;
+  if (m_overflow || len<1) return;
+  m_sim_out -= m_sim_dump + len;
+  m_sim_dump=0;
+}
 
-  bool ns=m_need_feedsilence;
-  m_need_feedsilence=false;
+int WDL_ConvolutionEngine_Div_Job::ReadAvail()
+{
+  if (m_overflow) return 1<<30;
+  if (m_reset_pending)
+  {
+    if (wdl_atomic_get(&m_reset_ack) != m_reset_sent) return m_zeros;
+    m_out.Advance((int)((unsigned int)m_reset_outpos - (unsigned int)m_out.ReadPos()));
+    m_reset_pending=false;
+  }
+  return m_zeros + m_out.Available();
+}
 
-  int x;
-  for (x = 0; x < m_engines.GetSize(); x ++)
+int WDL_ConvolutionEngine_Div_Job::WaitAvail(int len)
+{
+  for (;;)
   {
-    WDL_ConvolutionEngine *eng=m_engines.Get(x);
-    if (ns)
+    const int a=ReadAvail();
+    if (a >= len) return a;
+    if (Claim())
     {
-      eng->m_zl_dumpage = (x>0 && x < m_engines.GetSize()-1) ? (eng->GetLatency()/4) : 0; // reduce max number of ffts per block by staggering them
-
-      if (eng->m_zl_dumpage>0)
-        eng->Add(NULL,eng->m_zl_dumpage,nch); // added silence to input (to control when fft happens)
+      // the worker is late (or there is none), finish its queued blocks here
+      Process();
+      Release();
+      return ReadAvail(); // short only if m_out is full, see Process()
     }
-
-    eng->Add(bufs,len,nch);
-
-    if (ns) eng->AddSilenceToOutput(eng->m_zl_delaypos,nch); // add silence to output (to delay output to its correct time)
-
+    YieldThread(); // the worker is in Process(), wait for it
   }
 }
-WDL_FFT_REAL **WDL_ConvolutionEngine_Div::Get() 
+
+void WDL_ConvolutionEngine_Div_Job::AddTo(WDL_FFT_REAL **outs, int len, int nch)
 {
-  int x;
-  for (x = 0; x < m_proc_nch; x ++)
+  // leading silence is skipped rather than added, which leaves the sums unchanged
+  if (m_overflow) return;
+  const int z = len<m_zeros ? len : m_zeros;
+  m_zeros-=z;
+  if (len>z)
   {
-    m_get_tmpptrs[x]=(WDL_FFT_REAL *)m_samplesout[x].Get();
+    WDL_FFT_REAL *tp[WDL_CONVO_MAX_PROC_NCH];
+    int ch;
+    for (ch = 0; ch < nch; ch ++) tp[ch]=outs[ch]+z;
+    m_out.AddTo(tp,len-z,nch);
+    m_out.Advance(len-z);
   }
-  return m_get_tmpptrs;
 }
 
-void WDL_ConvolutionEngine_Div::Advance(int len)
+void WDL_ConvolutionEngine_Div_Job::Process()
 {
-  int x;
-  for (x = 0; x < m_proc_nch; x ++)
+  for (;;)
   {
-    m_samplesout[x].Advance(len*sizeof(WDL_FFT_REAL));
-    m_samplesout[x].Compact();
+    const int req=wdl_atomic_get(&m_reset_req);
+    if (req != m_w_ack)
+    {
+      m_in.Advance((int)((unsigned int)m_reset_inpos - (unsigned int)m_in.ReadPos()));
+      m_cmd.Advance((int)((unsigned int)m_reset_cmdpos - (unsigned int)m_cmd.ReadPos()));
+      m_eng->Reset();
+      m_reset_outpos=m_out.WritePos();
+      wdl_atomic_add(&m_reset_ack,req-m_w_ack);
+      m_w_ack=req;
+    }
+
+    if (m_cmd.Available()<1) break;
+    if (wdl_atomic_get(&m_reset_req) != m_w_ack) continue; // reset before the commands that follow it
+
+    int cmd[CMD_NCH], ch;
+    const int cmdpos=m_cmd.ReadPos();
+    for (ch = 0; ch < CMD_NCH; ch ++) { int l=1; cmd[ch]=*m_cmd.GetPtr(ch,cmdpos,&l); }
+
+    const int len=cmd[1];
+    const int sz=m_eng->GetFFTSize()/2;
+    if (m_out.Free() < len + m_dumpage + sz) break; // wait for the calling thread to read m_out
+
+    m_w_nch=cmd[2];
+    if (cmd[0] == CMD_ADD_FIRST && m_dumpage>0) m_eng->Add(NULL,m_dumpage,m_w_nch); // added silence to input (to control when fft happens)
+
+    const int inpos=m_in.ReadPos();
+    int pos=0;
+    while (pos<len)
+    {
+      WDL_FFT_REAL *bufs[WDL_CONVO_MAX_PROC_NCH];
+      int n=len-pos;
+      for (ch = 0; ch < m_w_nch; ch ++) bufs[ch]=m_in.GetPtr(ch,inpos+pos,&n);
+      m_eng->Add(bufs,n,m_w_nch);
+      pos+=n;
+    }
+    m_in.Advance(len);
+
+    // every complete block, m_out is the partition's output after its delay (which the calling thread skips)
+    const int a=m_eng->Avail(m_out.Free());
+    if (a>0)
+    {
+      m_out.Write(m_eng->Get(),a,m_w_nch);
+      m_eng->Advance(a);
+    }
+    m_cmd.Advance(1);
   }
 }
 
+
+WDL_ConvolutionEngine_Div_Worker::WDL_ConvolutionEngine_Div_Worker()
+{
+  m_kill=0;
+  m_sigcnt=0;
+#ifdef _WIN32
+  m_thread=NULL;
+  m_signal=CreateEvent(NULL,FALSE,FALSE,NULL);
+#else
+  m_running=false;
+  pthread_mutex_init(&m_mutex,NULL);
+  pthread_cond_init(&m_cond,NULL);
+#endif
+}
+
+WDL_ConvolutionEngine_Div_Worker::~WDL_ConvolutionEngine_Div_Worker()
+{
+  Stop();
+#ifdef _WIN32
+  CloseHandle(m_signal);
+#else
+  pthread_cond_destroy(&m_cond);
+  pthread_mutex_destroy(&m_mutex);
+#endif
+}
+
+bool WDL_ConvolutionEngine_Div_Worker::Start()
+{
+  m_kill=0;
+#ifdef _WIN32
+  unsigned id;
+  m_thread=(HANDLE)_beginthreadex(NULL,0,_threadfunc,(void *)this,0,&id);
+  if (!m_thread) return false;
+  SetThreadPriority(m_thread,THREAD_PRIORITY_HIGHEST);
+#else
+  if (pthread_create(&m_thread,NULL,_threadfunc,(void *)this) != 0) return false;
+  m_running=true;
+#endif
+  return true;
+}
+
+void WDL_ConvolutionEngine_Div_Worker::Stop()
+{
+  wdl_atomic_incr(&m_kill);
+#ifdef _WIN32
+  SetEvent(m_signal);
+  if (m_thread)
+  {
+    WaitForSingleObject(m_thread,INFINITE);
+    CloseHandle(m_thread);
+    m_thread=NULL;
+  }
+#else
+  pthread_mutex_lock(&m_mutex);
+  pthread_cond_broadcast(&m_cond);
+  pthread_mutex_unlock(&m_mutex);
+  if (m_running)
+  {
+    void *p;
+    pthread_join(m_thread,&p);
+    m_running=false;
+  }
+#endif
+}
+
+void WDL_ConvolutionEngine_Div_Worker::Signal()
+{
+  wdl_atomic_incr(&m_sigcnt);
+#ifdef _WIN32
+  SetEvent(m_signal);
+#else
+  // if the worker holds the mutex it is about to check m_sigcnt (or, rarely, the wakeup is missed and its timed wait expires)
+  if (!pthread_mutex_trylock(&m_mutex))
+  {
+    pthread_cond_signal(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+  }
+#endif
+}
+
+void WDL_ConvolutionEngine_Div_Worker::Run()
+{
+  int lastsig=0;
+  while (!wdl_atomic_get(&m_kill))
+  {
+#ifdef _WIN32
+    if (wdl_atomic_get(&m_sigcnt) == lastsig) WaitForSingleObject(m_signal,INFINITE);
+#else
+    pthread_mutex_lock(&m_mutex);
+    if (wdl_atomic_get(&m_sigcnt) == lastsig && !wdl_atomic_get(&m_kill))
+    {
+      struct timeval tv;
+      gettimeofday(&tv,NULL);
+      long long ns = (long long)tv.tv_usec*1000 + 2000000;
+      struct timespec ts;
+      ts.tv_sec = tv.tv_sec + (time_t)(ns/1000000000);
+      ts.tv_nsec = (long)(ns%1000000000);
+      pthread_cond_timedwait(&m_cond,&m_mutex,&ts);
+    }
+    pthread_mutex_unlock(&m_mutex);
+#endif
+    if (wdl_atomic_get(&m_kill)) break;
+
+    lastsig=wdl_atomic_get(&m_sigcnt);
+
+    int x;
+    for (x = 0; x < m_jobs.GetSize(); x ++)
+    {
+      WDL_ConvolutionEngine_Div_Job *job=m_jobs.Get(x);
+      if (job->Claim()) { job->Process(); job->Release(); } // else the calling thread is processing it
+    }
+  }
+}
+
+#ifdef _WIN32
+unsigned WINAPI WDL_ConvolutionEngine_Div_Worker::_threadfunc(void *_d)
+#else
+void *WDL_ConvolutionEngine_Div_Worker::_threadfunc(void *_d)
+#endif
+{
+  ((WDL_ConvolutionEngine_Div_Worker *)_d)->Run();
+  return 0;
+}
+
+#endif // WDL_CONVO_THREAD
+
+
+WDL_ConvolutionEngine_Div::WDL_ConvolutionEngine_Div()
+{
+  timingInit();
+  m_proc_nch=2;
+  m_need_feedsilence=true;
+  m_use_profile=false;
+  m_plan_cost=m_plan_avgcost=0.0;
+#ifdef WDL_CONVO_THREAD
+  m_thread_cnt=0;
+  m_thread_minfft=0;
+#endif
+}
+
+#ifdef WDL_CONVO_THREAD
+void WDL_ConvolutionEngine_Div::SetThreading(int nthreads, int min_fftsize)
+{
+  m_thread_cnt=nthreads>0 ? nthreads : 0;
+  m_thread_minfft=min_fftsize>0 ? min_fftsize : 0;
+}
+
+void WDL_ConvolutionEngine_Div::StopThreads()
+{
+  m_workers.Empty(true); // stops threads
+  m_jobs.Empty(true);
+}
+#endif
+
+int WDL_ConvolutionEngine_Div::SetImpulse(WDL_ImpulseBuffer *impulse, int maxfft_size, int known_blocksize, int max_imp_size, int impulse_offset, int latency_allowed)
+{
+  m_need_feedsilence=true;
+
+#ifdef WDL_CONVO_THREAD
+  StopThreads();
+#endif
+  m_engines.Empty(true);
+  if (maxfft_size<0)maxfft_size=-maxfft_size;
+  maxfft_size*=2;
+  if (!maxfft_size || maxfft_size>32768) maxfft_size=32768;
+
+  int samplesleft=impulse->impulses[0].GetSize()-impulse_offset;
+  if (max_imp_size>0 && samplesleft>max_imp_size) samplesleft=max_imp_size;
+
+  if (m_use_profile) PlanFromProfile(samplesleft,maxfft_size,known_blocksize,latency_allowed);
+  else PlanDefault(samplesleft,maxfft_size,known_blocksize,latency_allowed);
+
+  m_plan_cost=EvalPlan(m_plan.Get(),m_plan.GetSize(),known_blocksize>0 ? known_blocksize : 512,&m_plan_avgcost);
+
+  int i;
+  for (i = 0; i < m_plan.GetSize(); i ++)
+  {
+    const WDL_ConvolutionEngine_Div_Partition *p=m_plan.Get()+i;
+    WDL_ConvolutionEngine *eng=new WDL_ConvolutionEngine;
+
+    eng->SetImpulse(impulse,p->fft_size,p->offset+impulse_offset,p->length,!p->fft_size);
+    eng->m_zl_delaypos = p->offset;
+    eng->m_zl_dumpage=0;
+    m_engines.Add(eng);
+
+#ifdef WDL_CONVO_THREAD
+    // background partitions must be the last ones (they are, since fft sizes never decrease), see Avail()
+    int j=i;
+    while (j < m_plan.GetSize() && m_plan.Get()[j].threaded) j++;
+    m_jobs.Add(j == m_plan.GetSize() && p->fft_size ? new WDL_ConvolutionEngine_Div_Job(eng,(i>0 && i < m_plan.GetSize()-1) ? (eng->GetLatency()/4) : 0) : NULL); // see Add()
+#endif
+
+#ifdef WDLCONVO_ZL_ACCOUNTING
+    char buf[512];
+    wsprintf(buf,"ce%d: offs=%d, len=%d, fftsize=%d\n",m_engines.GetSize(),p->offset,p->length,p->fft_size);
+    OutputDebugString(buf);
+#endif
+  }
+
+#ifdef WDL_CONVO_THREAD
+  if (m_thread_cnt>0)
+  {
+    int x;
+    // distribute largest partitions first
+    for (x = m_jobs.GetSize()-1; x >= 0; x --)
+    {
+      WDL_ConvolutionEngine_Div_Job *job=m_jobs.Get(x);
+      if (!job) continue;
+      if (m_workers.GetSize()<m_thread_cnt) m_workers.Add(new WDL_ConvolutionEngine_Div_Worker);
+      WDL_ConvolutionEngine_Div_Worker *w=m_workers.Get(m_workers.GetSize()-1);
+      int i;
+      for (i = 0; i < m_workers.GetSize(); i ++) if (m_workers.Get(i)->m_jobs.GetSize() < w->m_jobs.GetSize()) w=m_workers.Get(i);
+      w->m_jobs.Add(job);
+      job->m_worker=w;
+    }
+    for (x = 0; x < m_workers.GetSize(); x ++)
+    {
+      WDL_ConvolutionEngine_Div_Worker *w=m_workers.Get(x);
+      if (!w->Start())
+      {
+        int i;
+        for (i = 0; i < w->m_jobs.GetSize(); i ++) w->m_jobs.Get(i)->m_worker=NULL; // process on calling thread
+        w->m_jobs.Empty();
+      }
+    }
+  }
+#endif
+  
+  return GetLatency();
+}
+
+void WDL_ConvolutionEngine_Div::PlanDefault(int samplesleft, int maxfft_size, int known_blocksize, int latency_allowed)
+{
+  const int MAX_SIZE_FOR_BRUTE=64;
+
+  int fftsize = MAX_SIZE_FOR_BRUTE;
+  int impulsechunksize = MAX_SIZE_FOR_BRUTE;
+
+  if (known_blocksize && !(known_blocksize&(known_blocksize-1)) && known_blocksize>MAX_SIZE_FOR_BRUTE*2)
+  {
+    fftsize=known_blocksize/2;
+    impulsechunksize=known_blocksize/2;
+  }
+  if (latency_allowed*2 > fftsize)
+  {
+    int x = 16;
+    while (x <= latency_allowed) x*=2;
+    if (x>32768) x=32768;
+    fftsize=impulsechunksize=x;
+  }
+
+  m_plan.Resize(0,false);
+
+#ifdef WDL_CONVO_THREAD
+  const int blocksize=known_blocksize>0 ? known_blocksize : 512;
+#endif
+  int offs=0;
+  do
+  {
+    bool wantBrute = !latency_allowed && !offs;
+    if (impulsechunksize*(wantBrute ? 2 : 3) >= samplesleft) impulsechunksize=samplesleft; // early-out, no point going to a larger FFT (since if we did this, we wouldnt have enough samples for a complete next pass)
+    if (fftsize>=maxfft_size) { impulsechunksize=samplesleft; fftsize=maxfft_size; } // if FFTs are as large as possible, finish up
+
+    WDL_ConvolutionEngine_Div_Partition p;
+    p.offset=offs;
+    p.length=impulsechunksize;
+    p.fft_size=wantBrute ? 0 : fftsize;
+    p.threaded=false;
+#ifdef WDL_CONVO_THREAD
+    if (!wantBrute && m_thread_minfft>0 && fftsize>=m_thread_minfft)
+    {
+      // a background partition needs a block of headroom: use the largest fft size that has it
+      int f=fftsize;
+      while (f > m_thread_minfft && f/2 > offs-blocksize) f/=2;
+      if (f/2 <= offs-blocksize)
+      {
+        p.fft_size=f;
+        p.threaded=true;
+      }
+    }
+#endif
+    m_plan.Add(p);
+
+    samplesleft -= impulsechunksize;
+    offs+=impulsechunksize;
+
+#if 1 // this seems about 10% faster (maybe due to better cache use from less sized ffts used?)
+    impulsechunksize=offs*3;
+    fftsize=offs*2;
+#else
+    impulsechunksize=fftsize;
+
+    fftsize*=2;
+#endif
+  }
+  while (samplesleft > 0);
+}
+
+// the layout is a brute force head (or, with latency allowed, a first block size of that latency), followed by
+// groups of FFT blocks with nondecreasing sizes, each group being one WDL_ConvolutionEngine. a group of block size
+// bs can start at delay d >= bs.
+//
+// for each head size and largest allowed block size, a dynamic program over (delay, block size) finds the
+// layout with the lowest average cost, then EvalPlan() estimates its worst-case block, and the candidate with the
+// lowest worst case wins (within 1%, lower average cost breaks the tie).
+void WDL_ConvolutionEngine_Div::PlanFromProfile(int len, int maxfft_size, int known_blocksize, int latency_allowed)
+{
+  if (len<1)
+  {
+    PlanDefault(len,maxfft_size,known_blocksize,latency_allowed);
+    return;
+  }
+
+  const int blocksize=known_blocksize>0 ? known_blocksize : 512;
+  const int nsizes=WDL_ConvolutionEngine_CostProfile::NUM_FFT_SIZES;
+
+  WDL_TypedBuf<WDL_ConvolutionEngine_Div_Partition> best, cand;
+  double best_cost=0.0, best_avg=0.0;
+  bool have_best=false;
+
+  WDL_TypedBuf<double> dpcost;
+  WDL_TypedBuf<int> dpfrom;
+
+  int head;
+  for (head = 32; head <= 512 || head <= blocksize/2; head *= 2)
+  {
+    int u; // first (and smallest) block size
+    int start; // delay of the first FFT block
+
+    if (latency_allowed>0)
+    {
+      if (head>32) break; // only one candidate head: the block size is fixed by the latency
+      u=32;
+      while (u*2 <= latency_allowed && u*2 <= maxfft_size/2) u*=2;
+      start=0;
+    }
+    else
+    {
+      if (head*2 > maxfft_size) break;
+      u=head;
+      start=head;
+    }
+
+    int lvl0=0; // profile index of block size u (fft size u*2)
+    while ((16<<lvl0) < u) lvl0++;
+
+    int nl=0; // block size u<<l, fft size index lvl0+l
+    while (lvl0+nl < nsizes && (u<<nl)*2 <= maxfft_size) nl++;
+    if (!nl) continue;
+
+    if (latency_allowed<=0 && len <= head)
+    {
+      // impulse fits in the head
+      WDL_ConvolutionEngine_Div_Partition p = { 0, len, 0, false };
+      double avg, c=EvalPlan(&p,1,blocksize,&avg);
+      if (!have_best || c < best_cost*0.99 || (c < best_cost*1.01 && avg < best_avg))
+      {
+        best.Resize(0,false);
+        best.Add(p);
+        best_cost=c;
+        best_avg=avg;
+        have_best=true;
+      }
+      continue;
+    }
+
+    const int npos = (len-start+u-1)/u; // delays in units of u, relative to start
+    double *cost=dpcost.Resize((npos+1)*nl,false);
+    int *from=dpfrom.Resize((npos+1)*nl,false);
+    if (!cost || !from) break;
+
+    int cap;
+    for (cap = 0; cap < nl; cap ++)
+    {
+      int pos, l;
+      for (pos = 0; pos < (npos+1)*nl; pos ++) { cost[pos]=-1.0; from[pos]=-1; }
+
+      // per host block, amortized
+      #define PLAN_BLOCK_COST(l) (m_profile.cmul[lvl0+(l)] * (double)blocksize / (double)(u<<(l)))
+      #define PLAN_GROUP_COST(l) (m_profile.fft[lvl0+(l)] * (double)blocksize / (double)(u<<(l)))
+
+      cost[1*nl] = PLAN_GROUP_COST(0) + PLAN_BLOCK_COST(0);
+      for (pos = 1; pos < npos; pos ++)
+      {
+        const int d = start + pos*u;
+        for (l = 0; l <= cap; l ++)
+        {
+          const double c = cost[pos*nl+l];
+          if (c < 0.0) continue;
+
+          int nl2;
+          for (nl2 = l; nl2 <= cap; nl2 ++)
+          {
+            const int bs=u<<nl2;
+            double nc;
+            if (nl2 == l) nc = c + PLAN_BLOCK_COST(l);
+            else
+            {
+              if (d < bs) break;
+#ifdef WDL_CONVO_THREAD
+              if (m_thread_minfft>0 && bs*2 >= m_thread_minfft && d < bs+blocksize) break; // background partitions need a block of headroom
+#endif
+              nc = c + PLAN_GROUP_COST(nl2) + PLAN_BLOCK_COST(nl2);
+            }
+            int np = pos + (bs/u);
+            if (np > npos) np=npos;
+            if (cost[np*nl+nl2] < 0.0 || nc < cost[np*nl+nl2])
+            {
+              cost[np*nl+nl2]=nc;
+              from[np*nl+nl2]=pos*nl+l;
+            }
+          }
+        }
+      }
+
+      #undef PLAN_BLOCK_COST
+      #undef PLAN_GROUP_COST
+
+      int bl=-1;
+      for (l = 0; l <= cap; l ++) if (cost[npos*nl+l] >= 0.0 && (bl<0 || cost[npos*nl+l] < cost[npos*nl+bl])) bl=l;
+      if (bl<0) continue;
+
+      // walk back, one partition per run of the same block size
+      cand.Resize(0,false);
+      int idx=npos*nl+bl;
+      while (idx>=0)
+      {
+        const int pl=idx%nl, endpos=idx/nl;
+        while (from[idx]>=0 && from[idx]%nl == pl) idx=from[idx];
+        const int prev=from[idx];
+        const int startpos = prev>=0 ? prev/nl : 0;
+
+        WDL_ConvolutionEngine_Div_Partition p;
+        p.offset = start + startpos*u;
+        p.length = wdl_min(start + endpos*u, len) - p.offset;
+        p.fft_size = (u<<pl)*2;
+        p.threaded=false;
+#ifdef WDL_CONVO_THREAD
+        p.threaded = m_thread_minfft>0 && p.fft_size>=m_thread_minfft && p.offset >= p.fft_size/2+blocksize;
+#endif
+        cand.Insert(p,0);
+
+        idx=prev;
+      }
+      if (latency_allowed<=0)
+      {
+        WDL_ConvolutionEngine_Div_Partition p = { 0, start, 0, false };
+        cand.Insert(p,0);
+      }
+
+      double avg, c=EvalPlan(cand.Get(),cand.GetSize(),blocksize,&avg);
+      if (!have_best || c < best_cost*0.99 || (c < best_cost*1.01 && avg < best_avg))
+      {
+        best.Resize(0,false);
+        int i;
+        for (i = 0; i < cand.GetSize(); i ++) best.Add(cand.Get()[i]);
+        best_cost=c;
+        best_avg=avg;
+        have_best=true;
+      }
+    }
+  }
+
+  if (!have_best || !best.GetSize())
+  {
+    PlanDefault(len,maxfft_size,known_blocksize,latency_allowed);
+    return;
+  }
+
+  m_plan.Resize(0,false);
+  int i;
+  for (i = 0; i < best.GetSize(); i ++) m_plan.Add(best.Get()[i]);
+}
+
+// estimates the cost of processing one block: the brute force head processes every sample, and each FFT
+// partition fires whenever its (staggered, see Add()) input crosses a block boundary. the worst case is
+// found by stepping through enough blocks for the largest partition to repeat.
+double WDL_ConvolutionEngine_Div::EvalPlan(const WDL_ConvolutionEngine_Div_Partition *plan, int nplan, int blocksize, double *avgcost)
+{
+  double avg=0.0, fixed=0.0;
+  int maxbs=0;
+  int x;
+
+  if (blocksize<1) blocksize=1;
+
+  for (x = 0; x < nplan; x ++)
+  {
+    const WDL_ConvolutionEngine_Div_Partition *p=plan+x;
+    if (!p->fft_size)
+    {
+      fixed += m_profile.brute * p->length * (double)blocksize;
+      continue;
+    }
+    const int bs=p->fft_size/2;
+    int idx=0;
+    while (idx < WDL_ConvolutionEngine_CostProfile::NUM_FFT_SIZES-1 && (32<<idx) < p->fft_size) idx++;
+    const double c = m_profile.fft[idx] + m_profile.cmul[idx] * ((p->length+bs-1)/bs);
+    avg += c * (double)blocksize / (double)bs;
+#ifdef WDL_CONVO_THREAD
+    if (p->threaded && m_thread_cnt>0) continue; // off the calling thread
+#endif
+    if (bs > maxbs) maxbs=bs;
+  }
+
+  double worst=0.0;
+  int nblocks = maxbs*2/blocksize + 2;
+  if (nblocks > 4096) nblocks=4096;
+
+  int b;
+  for (b = 0; b < nblocks; b ++)
+  {
+    const int t=b*blocksize;
+    double c=0.0;
+    for (x = 0; x < nplan; x ++)
+    {
+      const WDL_ConvolutionEngine_Div_Partition *p=plan+x;
+      if (!p->fft_size) continue;
+#ifdef WDL_CONVO_THREAD
+      if (p->threaded && m_thread_cnt>0) continue;
+#endif
+      const int bs=p->fft_size/2;
+      const int d = (x>0 && x<nplan-1) ? bs/4 : 0; // see m_zl_dumpage
+      const int n = (t+blocksize+d)/bs - (t+d)/bs;
+      if (n>0)
+      {
+        int idx=0;
+        while (idx < WDL_ConvolutionEngine_CostProfile::NUM_FFT_SIZES-1 && (32<<idx) < p->fft_size) idx++;
+        c += n * (m_profile.fft[idx] + m_profile.cmul[idx] * ((p->length+bs-1)/bs));
+      }
+    }
+    if (c > worst) worst=c;
+  }
+
+  if (avgcost) *avgcost = avg + fixed;
+  return worst + fixed;
+}
+
+void WDL_ConvolutionEngine_Div::SetCostProfile(const WDL_ConvolutionEngine_CostProfile *profile)
+{
+  m_use_profile = !!profile;
+  if (profile) m_profile = *profile;
+  else m_profile.SetDefault();
+}
+
+
+#ifndef _WIN32
+#include <sys/time.h>
+#endif
+#include "wdlstring.h"
+
+static double WDL_ConvolutionEngine_CostProfile_Time()
+{
+#ifdef _WIN32
+  LARGE_INTEGER now, freq;
+  QueryPerformanceCounter(&now);
+  QueryPerformanceFrequency(&freq);
+  return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+  struct timeval tm={0,};
+  gettimeofday(&tm,NULL);
+  return (double)tm.tv_sec + (double)tm.tv_usec*0.000001;
+#endif
+}
+
+void WDL_ConvolutionEngine_CostProfile::SetDefault()
+{
+  // flops: complex fft ~5n*log2(n) each way, complex multiply-accumulate 8 per bin, brute 2 per tap per channel
+  int x;
+  for (x = 0; x < NUM_FFT_SIZES; x ++)
+  {
+    const int fftsize=1<<(MIN_FFT_SIZE_LOG2+x);
+    fft[x] = 2.0 * 5.0 * fftsize * (MIN_FFT_SIZE_LOG2+x);
+    cmul[x] = 8.0 * fftsize;
+  }
+  brute = 4.0;
+}
+
+void WDL_ConvolutionEngine_CostProfile::Measure(double max_sec)
+{
+  WDL_fft_init();
+
+  if (max_sec < 0.001) max_sec=0.001;
+  const double slot = max_sec / (NUM_FFT_SIZES*2+1);
+
+  // the multiply-accumulates of a long partition stream through more memory than fits in cache, so they
+  // are timed walking through a larger buffer, as the engine walks through its history/impulse blocks
+  const int worksize=1<<20;
+  WDL_TypedBuf<WDL_FFT_REAL> buf;
+  WDL_TypedBuf<WDL_CONVO_IMPULSEBUFf> imp;
+  const int maxsize=1<<(MIN_FFT_SIZE_LOG2+NUM_FFT_SIZES-1);
+  WDL_FFT_REAL *a=buf.Resize(worksize*2+maxsize*2);
+  WDL_CONVO_IMPULSEBUFf *b=imp.Resize(worksize*2);
+  if (!a || !b) return;
+  memset(a,0,buf.GetSize()*sizeof(WDL_FFT_REAL));
+  memset(b,0,imp.GetSize()*sizeof(WDL_CONVO_IMPULSEBUFf));
+
+  int x, mode;
+  for (x = 0; x < NUM_FFT_SIZES; x ++)
+  {
+    const int fftsize=1<<(MIN_FFT_SIZE_LOG2+x);
+    for (mode = 0; mode < 2; mode ++)
+    {
+      const int nblocks=worksize/fftsize;
+      int reps=1, blk=0;
+      for (;;)
+      {
+        const double t0=WDL_ConvolutionEngine_CostProfile_Time();
+        int r;
+        for (r = 0; r < reps; r ++)
+        {
+          if (!mode)
+          {
+            WDL_fft((WDL_FFT_COMPLEX*)a,fftsize,0);
+            WDL_fft((WDL_FFT_COMPLEX*)a,fftsize,1);
+          }
+          else
+          {
+            const int o=blk*fftsize*2;
+            if (++blk >= nblocks) blk=0;
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+            WDL_CONVO_CplxMul3_Split(a+worksize*2,a+o,b+o,fftsize);
+#else
+            WDL_CONVO_CplxMul3((WDL_FFT_COMPLEX*)(a+worksize*2),(WDL_FFT_COMPLEX*)(a+o),(WDL_CONVO_IMPULSEBUFCPLXf*)(b+o),fftsize);
+#endif
+          }
+        }
+        const double t=WDL_ConvolutionEngine_CostProfile_Time()-t0;
+        if (t >= slot || reps >= (1<<24))
+        {
+          if (!mode) fft[x] = t/reps;
+          else cmul[x] = t/reps;
+          break;
+        }
+        reps*=2;
+      }
+    }
+  }
+
+  // brute force, via the engine (stereo)
+  {
+    const int ntaps=256, bs=256;
+    WDL_ImpulseBuffer ib;
+    ib.SetNumChannels(1);
+    ib.SetLength(ntaps);
+    for (x = 0; x < ntaps; x ++) ib.impulses[0].Get()[x]=(WDL_FFT_REAL)0.5;
+
+    WDL_ConvolutionEngine eng;
+    eng.SetImpulse(&ib,0,0,0,true);
+    WDL_FFT_REAL *bufs[2]={ a, a+bs };
+
+    int reps=1;
+    for (;;)
+    {
+      const double t0=WDL_ConvolutionEngine_CostProfile_Time();
+      int r;
+      for (r = 0; r < reps; r ++)
+      {
+        eng.Add(bufs,bs,2);
+        eng.Avail(bs);
+        eng.Advance(bs);
+      }
+      const double t=WDL_ConvolutionEngine_CostProfile_Time()-t0;
+      if (t >= slot || reps >= (1<<20))
+      {
+        brute = t / ((double)reps*bs*ntaps);
+        break;
+      }
+      reps*=2;
+    }
+  }
+}
+
+void WDL_ConvolutionEngine_CostProfile::Save(WDL_FastString *s) const
+{
+  s->SetFormatted(64,"convo1 %d %.6g",NUM_FFT_SIZES,brute);
+  int x;
+  for (x = 0; x < NUM_FFT_SIZES; x ++) s->AppendFormatted(64," %.6g %.6g",fft[x],cmul[x]);
+}
+
+bool WDL_ConvolutionEngine_CostProfile::Load(const char *str)
+{
+  if (!str || strncmp(str,"convo1 ",7)) return false;
+  char *p=(char *)str+7;
+  if (strtol(p,&p,10) != NUM_FFT_SIZES) return false;
+
+  double v[NUM_FFT_SIZES*2+1];
+  int x;
+  for (x = 0; x < NUM_FFT_SIZES*2+1; x ++)
+  {
+    char *np=p;
+    v[x]=strtod(p,&np);
+    if (np==p || !(v[x]>0.0)) return false;
+    p=np;
+  }
+  brute=v[0];
+  for (x = 0; x < NUM_FFT_SIZES; x ++)
+  {
+    fft[x]=v[1+x*2];
+    cmul[x]=v[2+x*2];
+  }
+  return true;
+}
+
+int WDL_ConvolutionEngine_Div::GetLatency()
+{
+  return m_engines.GetSize() ? m_engines.Get(0)->GetLatency() : 0;
+}
+
+
+void WDL_ConvolutionEngine_Div::Reset()
+{
+  int x;
+  for (x = 0; x < m_engines.GetSize(); x ++)
+  {
+#ifdef WDL_CONVO_THREAD
+    WDL_ConvolutionEngine_Div_Job *job=m_jobs.Get(x);
+    if (job) { job->Reset(); job->m_mixpos=0; continue; }
+#endif
+    WDL_ConvolutionEngine *eng=m_engines.Get(x);
+    eng->Reset();
+  }
+  for (x = 0; x < WDL_CONVO_MAX_PROC_NCH; x ++)
+  {
+    m_samplesout[x].Clear();
+  }
+
+  m_need_feedsilence=true;
+}
+
+WDL_ConvolutionEngine_Div::~WDL_ConvolutionEngine_Div()
+{
+  timingPrint();
+#ifdef WDL_CONVO_THREAD
+  StopThreads();
+#endif
+  m_engines.Empty(true);
+}
+
+void WDL_ConvolutionEngine_Div::Add(WDL_FFT_REAL **bufs, int len, int nch)
+{
+  m_proc_nch=nch;
+
+  bool ns=m_need_feedsilence;
+  m_need_feedsilence=false;
+
+  int x;
+  for (x = 0; x < m_engines.GetSize(); x ++)
+  {
+    WDL_ConvolutionEngine *eng=m_engines.Get(x);
+#ifdef WDL_CONVO_THREAD
+    WDL_ConvolutionEngine_Div_Job *job=m_jobs.Get(x);
+    if (job)
+    {
+      job->Add(bufs,len,nch,ns);
+      continue;
+    }
+#endif
+    if (ns)
+    {
+      eng->m_zl_dumpage = (x>0 && x < m_engines.GetSize()-1) ? (eng->GetLatency()/4) : 0; // reduce max number of ffts per block by staggering them
+
+      if (eng->m_zl_dumpage>0)
+        eng->Add(NULL,eng->m_zl_dumpage,nch); // added silence to input (to control when fft happens)
+    }
+
+    eng->Add(bufs,len,nch);
+
+    if (ns) eng->AddSilenceToOutput(eng->m_zl_delaypos,nch); // add silence to output (to delay output to its correct time)
+
+  }
+}
+WDL_FFT_REAL **WDL_ConvolutionEngine_Div::Get() 
+{
+  int x;
+  for (x = 0; x < m_proc_nch; x ++)
+  {
+    m_get_tmpptrs[x]=(WDL_FFT_REAL *)m_samplesout[x].Get();
+  }
+  return m_get_tmpptrs;
+}
+
+void WDL_ConvolutionEngine_Div::Advance(int len)
+{
+  int x;
+  for (x = 0; x < m_proc_nch; x ++)
+  {
+    m_samplesout[x].Advance(len*sizeof(WDL_FFT_REAL));
+    m_samplesout[x].Compact();
+  }
+#ifdef WDL_CONVO_THREAD
+  for (x = 0; x < m_jobs.GetSize(); x ++)
+    if (m_jobs.Get(x)) m_jobs.Get(x)->m_mixpos -= len;
+#endif
+}
+
 int WDL_ConvolutionEngine_Div::Avail(int wantSamples)
 {
   timingEnter(1);
@@ -866,6 +2137,15 @@ int WDL_ConvolutionEngine_Div::Avail(int wantSamples)
   for (x = 0; x < m_engines.GetSize(); x ++)
   {
     WDL_ConvolutionEngine *eng=m_engines.Get(x);
+#ifdef WDL_CONVO_THREAD
+    WDL_ConvolutionEngine_Div_Job *job=m_jobs.Get(x);
+    if (job)
+    {
+      const int a=job->SimAvail(wso); // as if processed here, the output is mixed in below when the worker has it
+      if (a < wantSamples) wantSamples=a;
+      continue;
+    }
+#endif
 #ifdef WDLCONVO_ZL_ACCOUNTING
     eng->m_zl_fftcnt=0;
 #endif
@@ -911,6 +2191,10 @@ int WDL_ConvolutionEngine_Div::Avail(int wantSamples)
     for (x = 0; x < m_engines.GetSize(); x ++)
     {
       WDL_ConvolutionEngine *eng=m_engines.Get(x);
+#ifdef WDL_CONVO_THREAD
+      WDL_ConvolutionEngine_Div_Job *job=m_jobs.Get(x);
+      if (job) continue;
+#endif
       if (eng->m_zl_dumpage>0) { eng->Advance(eng->m_zl_dumpage); eng->m_zl_dumpage=0; }
 
       WDL_FFT_REAL **p=eng->Get();
@@ -928,13 +2212,465 @@ int WDL_ConvolutionEngine_Div::Avail(int wantSamples)
       eng->Advance(wantSamples);
     }
   }
-  timingLeave(1);
 
   int av=m_samplesout[0].Available()/sizeof(WDL_FFT_REAL);
+#ifdef WDL_CONVO_THREAD
+  // background partitions are mixed in order (jobs are always the last partitions). their output for this block
+  // only depends on input from earlier blocks (see PlanDefault()), if a worker hasn't finished it yet this waits
+  for (x = 0; x < m_jobs.GetSize(); x ++)
+  {
+    WDL_ConvolutionEngine_Div_Job *job=m_jobs.Get(x);
+    if (!job) continue;
+    job->Consume(wantSamples);
+
+    int n=av-job->m_mixpos;
+    const int a=n>0 ? job->WaitAvail(n) : 0;
+    if (n>a) n=a;
+    if (n>0)
+    {
+      WDL_FFT_REAL *tp[WDL_CONVO_MAX_PROC_NCH];
+      int i;
+      for (i = 0; i < m_proc_nch; i ++) tp[i]=(WDL_FFT_REAL*)m_samplesout[i].Get()+job->m_mixpos;
+      job->AddTo(tp,n,m_proc_nch);
+      job->m_mixpos+=n;
+    }
+    av=job->m_mixpos;
+  }
+#endif
+  timingLeave(1);
+
   return av>wso ? wso : av;
 }
 
 
+/****************************************************************
+**  impulse swapping version
+*/
+
+WDL_ConvolutionEngine_Swap::WDL_ConvolutionEngine_Swap()
+{
+  m_cur=0;
+  m_swapgen=0;
+  m_fading=false;
+  m_xf_blocks=8;
+  m_xf_len=m_xf_pos=0;
+  m_proc_nch=0;
+}
+
+WDL_ConvolutionEngine_Swap::~WDL_ConvolutionEngine_Swap()
+{
+}
+
+bool WDL_ConvolutionEngine_Swap::PrepareImpulse(WDL_ImpulseBuffer *impulse, int nch, int maxfft_size, int known_blocksize, int max_imp_size, int impulse_offset, int latency_allowed)
+{
+  if (wdl_atomic_get(&m_swapgen)&1) return false; // spare engine still in use
+
+  WDL_ConvolutionEngine_Div *eng=m_engines + !m_cur;
+  eng->SetImpulse(impulse,maxfft_size,known_blocksize,max_imp_size,impulse_offset,latency_allowed);
+  eng->Reset(); // discard anything left from when it was last in use
+
+  if (nch>0 && nch<=WDL_CONVO_MAX_PROC_NCH)
+  {
+    // size the per-channel history and work buffers here rather than on the audio thread
+    eng->Add(NULL,0,nch);
+    eng->Avail(0);
+  }
+
+  wdl_atomic_incr(&m_swapgen); // publish
+  return true;
+}
+
+bool WDL_ConvolutionEngine_Swap::IsSwapPending()
+{
+  return !!(wdl_atomic_get(&m_swapgen)&1);
+}
+
+void WDL_ConvolutionEngine_Swap::FinishSwap()
+{
+  m_cur=!m_cur;
+  m_fading=false;
+  wdl_atomic_incr(&m_swapgen); // old engine is now the spare
+}
+
+int WDL_ConvolutionEngine_Swap::GetLatency()
+{
+  return m_engines[m_cur].GetLatency();
+}
+
+void WDL_ConvolutionEngine_Swap::Reset()
+{
+  if (m_fading) FinishSwap();
+  m_engines[m_cur].Reset();
+}
+
+void WDL_ConvolutionEngine_Swap::Add(WDL_FFT_REAL **bufs, int len, int nch)
+{
+  if (!m_fading && (wdl_atomic_get(&m_swapgen)&1))
+  {
+    if (m_xf_blocks>0 && len>0)
+    {
+      m_fading=true;
+      m_xf_len=m_xf_blocks*len;
+      m_xf_pos=0;
+    }
+    else FinishSwap();
+  }
+
+  m_proc_nch=nch;
+  m_engines[m_cur].Add(bufs,len,nch);
+  if (m_fading) m_engines[!m_cur].Add(bufs,len,nch);
+}
+
+int WDL_ConvolutionEngine_Swap::Avail(int wantSamples)
+{
+  int av=m_engines[m_cur].Avail(wantSamples);
+  if (!m_fading) return av;
+
+  const int av2=m_engines[!m_cur].Avail(wantSamples);
+  if (av2<av) av=av2;
+
+  if (av>0)
+  {
+    WDL_FFT_REAL *mix=m_mixbuf.Resize(av*m_proc_nch,false);
+    WDL_FFT_REAL **oldp=m_engines[m_cur].Get();
+    WDL_FFT_REAL **newp=m_engines[!m_cur].Get();
+    const double dg=1.0/m_xf_len;
+    int ch;
+    for (ch = 0; ch < m_proc_nch; ch ++)
+    {
+      const WDL_FFT_REAL *o=oldp[ch], *n=newp[ch];
+      WDL_FFT_REAL *out=m_get_tmpptrs[ch]=mix+ch*av;
+      int i;
+      for (i = 0; i < av; i ++)
+      {
+        const int pos=m_xf_pos+i+1;
+        if (pos >= m_xf_len) out[i]=n[i];
+        else out[i]=(WDL_FFT_REAL) (o[i] + (n[i]-o[i])*(pos*dg));
+      }
+    }
+  }
+  return av;
+}
+
+WDL_FFT_REAL **WDL_ConvolutionEngine_Swap::Get()
+{
+  return m_fading ? m_get_tmpptrs : m_engines[m_cur].Get();
+}
+
+void WDL_ConvolutionEngine_Swap::Advance(int len)
+{
+  m_engines[m_cur].Advance(len);
+  if (m_fading)
+  {
+    m_engines[!m_cur].Advance(len);
+    if ((m_xf_pos+=len) >= m_xf_len) FinishSwap();
+  }
+}
+
+
+
+/****************************************************************
+**  N-in/M-out version
+*/
+
+WDL_ConvolutionEngine_Matrix::WDL_ConvolutionEngine_Matrix()
+{
+  WDL_fft_init();
+  m_nin=m_nout=m_npairs=0;
+  m_fft_size=0;
+  m_nblocks=0;
+  m_hist_pos=0;
+}
+
+WDL_ConvolutionEngine_Matrix::~WDL_ConvolutionEngine_Matrix()
+{
+  m_samplesin.Empty(true);
+  m_samplesout.Empty(true);
+}
+
+int WDL_ConvolutionEngine_Matrix::SetImpulse(int nin, int nout, const WDL_FFT_REAL * const *impulses, int impulse_len, int fft_size)
+{
+  if (nin<0) nin=0;
+  if (nout<0) nout=0;
+  if (impulse_len<0) impulse_len=0;
+
+  m_nin=nin;
+  m_nout=nout;
+  m_npairs=(nout+1)/2;
+
+  if (fft_size<=0)
+  {
+    int msz=fft_size<=-16? -fft_size*2 : 32768;
+
+    fft_size=32;
+    while (fft_size < impulse_len*2 && fft_size < msz) fft_size*=2;
+  }
+  m_fft_size=fft_size;
+
+  const int chunksize=fft_size/2;
+  m_nblocks=(impulse_len+chunksize-1)/chunksize;
+
+  const int blocksz=fft_size*2;
+  const int npaths=nin*m_npairs*m_nblocks;
+  WDL_CONVO_IMPULSEBUFf *impout=m_impulse.Resize(npaths*blocksz,false);
+  char *zbuf=m_impulse_zflag.Resize(npaths,false);
+  WDL_FFT_REAL *workbuf=m_combinebuf.Resize(blocksz*2,false);
+
+  const WDL_FFT_REAL scale=(WDL_FFT_REAL) (1.0/fft_size);
+  int in,pair,bl;
+  for (in = 0; in < nin; in ++)
+  {
+    for (pair = 0; pair < m_npairs; pair ++)
+    {
+      const WDL_FFT_REAL *imp1=impulses ? impulses[in*nout+pair*2] : NULL;
+      const WDL_FFT_REAL *imp2=impulses && pair*2+1 < nout ? impulses[in*nout+pair*2+1] : NULL;
+
+      for (bl = 0; bl < m_nblocks; bl ++)
+      {
+        int thissz=impulse_len-bl*chunksize;
+        if (thissz > chunksize) thissz=chunksize;
+
+        int i;
+        WDL_FFT_REAL mv=0.0;
+        for (i = 0; i < thissz; i ++)
+        {
+          WDL_FFT_REAL v=imp1 ? imp1[bl*chunksize+i] : 0.0;
+          WDL_FFT_REAL v2=imp2 ? imp2[bl*chunksize+i] : 0.0;
+          if (fabs(v)>mv) mv=(WDL_FFT_REAL)fabs(v);
+          if (fabs(v2)>mv) mv=(WDL_FFT_REAL)fabs(v2);
+          workbuf[i*2]=denormal_filter_aggressive(v*scale);
+          workbuf[i*2+1]=denormal_filter_aggressive(v2*scale);
+        }
+        memset(workbuf+i*2,0,(fft_size-i)*2*sizeof(WDL_FFT_REAL));
+
+        if (mv>CONVOENGINE_IMPULSE_SILENCE_THRESH)
+        {
+          *zbuf++=1;
+          WDL_fft((WDL_FFT_COMPLEX*)workbuf,fft_size,0);
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+          WDL_fft_split(workbuf+blocksz,(WDL_FFT_COMPLEX*)workbuf,fft_size);
+          for (i = 0; i < blocksz; i ++) impout[i]=(WDL_CONVO_IMPULSEBUFf)workbuf[blocksz+i];
+#else
+          for (i = 0; i < blocksz; i ++) impout[i]=(WDL_CONVO_IMPULSEBUFf)workbuf[i];
+#endif
+        }
+        else *zbuf++=0;
+
+        impout+=blocksz;
+      }
+    }
+  }
+
+  m_samplehist.Resize(nin*m_nblocks*blocksz,false);
+  m_samplehist_zflag.Resize(nin*m_nblocks,false);
+  m_overlaphist.Resize(m_npairs*fft_size,false);
+  m_get_tmpptrs.Resize(nin+nout,false);
+
+  while (m_samplesin.GetSize() > nin) m_samplesin.Delete(m_samplesin.GetSize()-1,true);
+  while (m_samplesin.GetSize() < nin) m_samplesin.Add(new WDL_FastQueue);
+  while (m_samplesout.GetSize() > nout) m_samplesout.Delete(m_samplesout.GetSize()-1,true);
+  while (m_samplesout.GetSize() < nout) m_samplesout.Add(new WDL_Queue);
+
+  Reset();
+
+  return GetLatency();
+}
+
+void WDL_ConvolutionEngine_Matrix::Reset()
+{
+  int x;
+  m_hist_pos=0;
+  for (x = 0; x < m_samplesin.GetSize(); x ++) m_samplesin.Get(x)->Clear();
+  for (x = 0; x < m_samplesout.GetSize(); x ++) m_samplesout.Get(x)->Clear();
+  memset(m_samplehist.Get(),0,m_samplehist.GetSize()*sizeof(WDL_FFT_REAL));
+  memset(m_samplehist_zflag.Get(),0,m_samplehist_zflag.GetSize());
+  memset(m_overlaphist.Get(),0,m_overlaphist.GetSize()*sizeof(WDL_FFT_REAL));
+}
+
+void WDL_ConvolutionEngine_Matrix::Add(WDL_FFT_REAL **bufs, int len, int nch)
+{
+  int ch;
+  for (ch = 0; ch < m_nin; ch ++)
+  {
+    m_samplesin.Get(ch)->Add(bufs && ch < nch ? bufs[ch] : NULL,len*sizeof(WDL_FFT_REAL));
+  }
+}
+
+void WDL_ConvolutionEngine_Matrix::ProcessBlock(WDL_FFT_REAL **in, int nch, WDL_FFT_REAL **out)
+{
+  const int sz=m_fft_size/2;
+  const int blocksz=m_fft_size*2;
+  WDL_FFT_REAL *workbuf=m_combinebuf.Resize(blocksz*2,false);
+
+  if (++m_hist_pos >= m_nblocks) m_hist_pos=0;
+  const int histpos=m_hist_pos;
+
+  // transform each input once (all inputs are read before any output is written, so in may equal out)
+  int in_ch;
+  for (in_ch = 0; in_ch < m_nin; in_ch ++)
+  {
+    WDL_FFT_REAL *optr=m_samplehist.Get() + (in_ch*m_nblocks + histpos)*blocksz;
+    const WDL_FFT_REAL *src=in && in_ch < nch ? in[in_ch] : NULL;
+
+    bool nonzflag=false;
+    int i;
+    if (src) for (i = 0; i < sz; i ++) // unpack samples (src may be optr+sz)
+    {
+      WDL_FFT_REAL f=optr[i*2]=denormal_filter_aggressive(src[i]);
+      optr[i*2+1]=0.0;
+      if (!nonzflag && (f<-CONVOENGINE_SILENCE_THRESH || f>CONVOENGINE_SILENCE_THRESH)) nonzflag=true;
+    }
+    m_samplehist_zflag.Get()[in_ch*m_nblocks + histpos]=nonzflag?1:0;
+    if (nonzflag)
+    {
+      memset(optr+sz*2,0,sz*2*sizeof(WDL_FFT_REAL));
+      WDL_fft((WDL_FFT_COMPLEX*)optr,m_fft_size,0);
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+      WDL_fft_split(workbuf,(WDL_FFT_COMPLEX*)optr,m_fft_size);
+      memcpy(optr,workbuf,blocksz*sizeof(WDL_FFT_REAL));
+#endif
+    }
+  }
+
+  // accumulate and inverse transform each pair of outputs
+  int pair;
+  for (pair = 0; pair < m_npairs; pair ++)
+  {
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+    WDL_FFT_REAL *accbuf=workbuf+blocksz; // split, converted back to workbuf before the ifft
+#endif
+    int applycnt=0;
+    for (in_ch = 0; in_ch < m_nin; in_ch ++)
+    {
+      const char *imp_zflag=m_impulse_zflag.Get() + (in_ch*m_npairs + pair)*m_nblocks;
+      const char *hist_zflag=m_samplehist_zflag.Get() + in_ch*m_nblocks;
+      WDL_CONVO_IMPULSEBUFf *impulseptr=m_impulse.Get() + (in_ch*m_npairs + pair)*m_nblocks*blocksz;
+      int i;
+      for (i = 0; i < m_nblocks; i ++, impulseptr+=blocksz)
+      {
+        int srchistpos = histpos-i;
+        if (srchistpos < 0) srchistpos += m_nblocks;
+
+        if (!imp_zflag[i] || !hist_zflag[srchistpos]) continue; // silent block
+
+        WDL_FFT_REAL *samplehist=m_samplehist.Get() + (in_ch*m_nblocks + srchistpos)*blocksz;
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+        if (applycnt++) WDL_CONVO_CplxMul3_Split(accbuf,samplehist,impulseptr,m_fft_size);
+        else WDL_CONVO_CplxMul2_Split(accbuf,samplehist,impulseptr,m_fft_size);
+#else
+        if (applycnt++) WDL_CONVO_CplxMul3((WDL_FFT_COMPLEX*)workbuf,(WDL_FFT_COMPLEX*)samplehist,(WDL_CONVO_IMPULSEBUFCPLXf*)impulseptr,m_fft_size);
+        else WDL_CONVO_CplxMul2((WDL_FFT_COMPLEX*)workbuf,(WDL_FFT_COMPLEX*)samplehist,(WDL_CONVO_IMPULSEBUFCPLXf*)impulseptr,m_fft_size);
+#endif
+      }
+    }
+
+    if (!applycnt)
+      memset(workbuf,0,blocksz*sizeof(WDL_FFT_REAL));
+    else
+    {
+#ifdef WDL_CONVO_SPLIT_COMPLEX
+      WDL_fft_unsplit((WDL_FFT_COMPLEX*)workbuf,accbuf,m_fft_size);
+#endif
+      WDL_fft((WDL_FFT_COMPLEX*)workbuf,m_fft_size,1);
+    }
+
+    // overlap-add, real part is output pair*2, imaginary part is output pair*2+1
+    WDL_FFT_REAL *olhist=m_overlaphist.Get() + pair*m_fft_size;
+    WDL_FFT_REAL *out1=out[pair*2];
+    WDL_FFT_REAL *out2=pair*2+1 < m_nout ? out[pair*2+1] : NULL;
+    const WDL_FFT_REAL *p1=workbuf, *p3=workbuf+m_fft_size;
+    int i;
+    for (i = 0; i < sz; i ++)
+    {
+      out1[i]=p1[0]+olhist[0];
+      if (out2) out2[i]=p1[1]+olhist[1];
+      olhist[0]=p3[0];
+      olhist[1]=p3[1];
+      p1+=2;
+      p3+=2;
+      olhist+=2;
+    }
+  }
+}
+
+bool WDL_ConvolutionEngine_Matrix::Process(WDL_FFT_REAL **in, WDL_FFT_REAL **out, int nframes, int nch)
+{
+  if (m_fft_size<2 || nframes != m_fft_size/2) return false;
+
+  if (m_nblocks<1 || m_nin<1)
+  {
+    int ch;
+    for (ch = 0; ch < m_nout; ch ++) memset(out[ch],0,nframes*sizeof(WDL_FFT_REAL));
+    return true;
+  }
+  ProcessBlock(in,nch,out);
+  return true;
+}
+
+int WDL_ConvolutionEngine_Matrix::Avail(int want)
+{
+  if (m_nout<1) return 0;
+
+  if (m_nblocks<1 || m_nin<1) // no impulse, output silence
+  {
+    const int av=m_nin>0 ? m_samplesin.Get(0)->Available() : 0;
+    int ch;
+    for (ch = 0; ch < m_nout; ch ++) memset(m_samplesout.Get(ch)->Add(NULL,av),0,av);
+    for (ch = 0; ch < m_nin; ch ++) m_samplesin.Get(ch)->Clear();
+  }
+  else
+  {
+    const int sz=m_fft_size/2;
+    WDL_FFT_REAL **inptrs=m_get_tmpptrs.Resize(m_nin+m_nout,false);
+    WDL_FFT_REAL **outptrs=inptrs+m_nin;
+
+    while (m_samplesin.Get(0)->Available()/(int)sizeof(WDL_FFT_REAL) >= sz &&
+           m_samplesout.Get(0)->Available() < want*(int)sizeof(WDL_FFT_REAL))
+    {
+      int ch;
+      const int histpos=m_hist_pos+1 >= m_nblocks ? 0 : m_hist_pos+1;
+      for (ch = 0; ch < m_nin; ch ++) // stage input in the upper half of the history block it will be unpacked to
+      {
+        WDL_FastQueue *q=m_samplesin.Get(ch);
+        inptrs[ch]=m_samplehist.Get() + (ch*m_nblocks + histpos)*m_fft_size*2 + sz;
+        q->GetToBuf(0,inptrs[ch],sz*sizeof(WDL_FFT_REAL));
+        q->Advance(sz*sizeof(WDL_FFT_REAL));
+      }
+      for (ch = 0; ch < m_nout; ch ++) outptrs[ch]=(WDL_FFT_REAL *)m_samplesout.Get(ch)->Add(NULL,sz*sizeof(WDL_FFT_REAL));
+
+      ProcessBlock(inptrs,m_nin,outptrs);
+    }
+  }
+
+  int mv = want;
+  int ch;
+  for (ch=0;ch<m_nout;ch++)
+  {
+    int v = m_samplesout.Get(ch)->Available()/sizeof(WDL_FFT_REAL);
+    if (!ch || v<mv)mv=v;
+  }
+  return mv;
+}
+
+WDL_FFT_REAL **WDL_ConvolutionEngine_Matrix::Get()
+{
+  int x;
+  WDL_FFT_REAL **p=m_get_tmpptrs.Get();
+  for (x = 0; x < m_nout; x ++) p[x]=(WDL_FFT_REAL *)m_samplesout.Get(x)->Get();
+  return p;
+}
+
+void WDL_ConvolutionEngine_Matrix::Advance(int len)
+{
+  int x;
+  for (x = 0; x < m_nout; x ++)
+  {
+    m_samplesout.Get(x)->Advance(len*sizeof(WDL_FFT_REAL));
+    m_samplesout.Get(x)->Compact();
+  }
+}
+
+
 #ifdef WDL_TEST_CONVO
 
 #include <stdio.h>
@@ -34,6 +34,11 @@
 #include "fastqueue.h"
 #include "fft.h"
 
+#ifdef WDL_CONVO_THREAD
+class WDL_ConvolutionEngine_Div_Job;
+class WDL_ConvolutionEngine_Div_Worker;
+#endif
+
 #ifndef WDL_CONVO_MAX_IMPULSE_NCH
 #define WDL_CONVO_MAX_IMPULSE_NCH 2
 #endif
@@ -43,6 +48,7 @@
 #endif
 
 //#define WDL_CONVO_WANT_FULLPRECISION_IMPULSE_STORAGE // define this for slowerness with -138dB error difference in resulting output (+-1 LSB at 24 bit)
+//#define WDL_CONVO_SPLIT_COMPLEX // define this to store FFT'd blocks as split re/im arrays, for a cleaner vectorized multiply-accumulate
 
 #ifdef WDL_CONVO_WANT_FULLPRECISION_IMPULSE_STORAGE 
 
@@ -97,6 +103,12 @@ public:
   WDL_FFT_REAL **Get(); // returns length valid
   void Advance(int len);
 
+  // zero-copy alternative to Add()/Avail()/Get()/Advance() for callers with a fixed block size: requires nframes == GetFFTSize()/2
+  // (i.e. SetImpulse() with fft_size=nframes*2). transforms directly from in (in or in[ch] may be NULL for silence) and writes
+  // directly to out (which may be the same buffers as in), with no added latency. returns false (and does nothing) if nframes
+  // doesn't match. call Reset() when switching between this and Add().
+  bool Process(WDL_FFT_REAL **in, WDL_FFT_REAL **out, int nframes, int nch);
+
 private:
   WDL_TypedBuf<WDL_CONVO_IMPULSEBUFf> m_impulse[WDL_CONVO_MAX_IMPULSE_NCH]; // FFT'd data blocks per channel
   WDL_TypedBuf<char> m_impulse_zflag[WDL_CONVO_MAX_IMPULSE_NCH]; // FFT'd data blocks per channel
@@ -124,6 +136,7 @@ public:
   // _div stuff
   int m_zl_delaypos;
   int m_zl_dumpage;
+  bool m_zl_nomonoinput; // process identical channels separately, so the output doesn't depend on how Avail() is called
 
 //#define WDLCONVO_ZL_ACCOUNTING
 #ifdef WDLCONVO_ZL_ACCOUNTING
@@ -133,6 +146,36 @@ public:
 
 } WDL_FIXALIGN;
 
+class WDL_FastString;
+
+// relative cost of the operations a WDL_ConvolutionEngine_Div partition performs, used to plan partition layouts.
+// defaults to an operation-count estimate; Measure() times the actual code on this machine. the values can be
+// cached with Save()/Load() to avoid measuring every time.
+class WDL_ConvolutionEngine_CostProfile
+{
+public:
+  WDL_ConvolutionEngine_CostProfile() { SetDefault(); }
+
+  enum { MIN_FFT_SIZE_LOG2=5, NUM_FFT_SIZES=11 }; // fft sizes 32..32768
+
+  void SetDefault();
+  void Measure(double max_sec=0.1); // benchmark, takes roughly max_sec seconds
+  void Save(WDL_FastString *s) const;
+  bool Load(const char *str); // returns false (and leaves the profile unchanged) if str is not from Save()
+
+  double fft[NUM_FFT_SIZES]; // forward+inverse transform of size 32<<i
+  double cmul[NUM_FFT_SIZES]; // multiply-accumulate of one FFT'd block of size 32<<i
+  double brute; // per sample per impulse tap, brute force
+};
+
+typedef struct
+{
+  int offset, length; // impulse samples (after impulse_offset)
+  int fft_size; // 0 for brute force
+  bool threaded; // processed as a background job (WDL_CONVO_THREAD)
+}
+WDL_ConvolutionEngine_Div_Partition;
+
 // low latency version
 class WDL_ConvolutionEngine_Div
 {
@@ -151,9 +194,48 @@ public:
   WDL_FFT_REAL **Get(); // returns length valid
   void Advance(int len);
 
+#ifdef WDL_CONVO_THREAD
+  // call before SetImpulse(). tail partitions with fft size >= min_fftsize are processed by nthreads background threads
+  // (nthreads=0 processes them on the calling thread), with no added latency. they are planned to start at least
+  // known_blocksize (or 512) samples after their fft size/2, so each block's output only needs input from earlier blocks
+  // and the threads have a block to finish it. Add()/Avail() never lock, but if a thread is late (e.g. blocks longer than
+  // known_blocksize), Avail() waits for it or does its work, so the output does not depend on thread timing. it is
+  // identical for any nthreads, and to the output without threading for that layout (except with identical channels,
+  // which the background partitions don't process as mono). min_fftsize=0 disables.
+  void SetThreading(int nthreads, int min_fftsize=4096);
+#endif
+
+  // call before SetImpulse(). with a profile set, SetImpulse() plans the partition layout with the lowest estimated
+  // worst-case cost per known_blocksize block (512 if not known) rather than using the default doubling layout.
+  // the profile is copied, NULL reverts to the default layout.
+  void SetCostProfile(const WDL_ConvolutionEngine_CostProfile *profile);
+
+  // layout used by the last SetImpulse()
+  int GetNumPartitions() { return m_plan.GetSize(); }
+  const WDL_ConvolutionEngine_Div_Partition *GetPartition(int idx) { return idx>=0 && idx<m_plan.GetSize() ? m_plan.Get()+idx : NULL; }
+  double GetPlanCost(double *avgcost=NULL) { if (avgcost) *avgcost=m_plan_avgcost; return m_plan_cost; } // estimated worst-case (and average) cost per block, in profile units
+
 private:
   WDL_PtrList<WDL_ConvolutionEngine> m_engines;
 
+  void PlanDefault(int len, int maxfft_size, int known_blocksize, int latency_allowed);
+  void PlanFromProfile(int len, int maxfft_size, int known_blocksize, int latency_allowed);
+  double EvalPlan(const WDL_ConvolutionEngine_Div_Partition *plan, int nplan, int blocksize, double *avgcost);
+
+  WDL_TypedBuf<WDL_ConvolutionEngine_Div_Partition> m_plan;
+  WDL_ConvolutionEngine_CostProfile m_profile;
+  bool m_use_profile;
+  double m_plan_cost, m_plan_avgcost;
+
+#ifdef WDL_CONVO_THREAD
+  void StopThreads();
+
+  WDL_PtrList<WDL_ConvolutionEngine_Div_Job> m_jobs; // parallel to m_engines, NULL for partitions processed directly
+  WDL_PtrList<WDL_ConvolutionEngine_Div_Worker> m_workers;
+  int m_thread_cnt;
+  int m_thread_minfft;
+#endif
+
   WDL_Queue m_samplesout[WDL_CONVO_MAX_PROC_NCH];
   WDL_FFT_REAL *m_get_tmpptrs[WDL_CONVO_MAX_PROC_NCH];
 
@@ -163,4 +245,99 @@ private:
 } WDL_FIXALIGN;
 
 
+// low latency version with impulse changes that don't stall the audio thread: PrepareImpulse() does the FFTs
+// (and allocation) on the calling thread into a spare engine, then publishes it atomically. the audio thread
+// picks it up at the next Add() and crossfades from the old impulse to the new one.
+// Add()/Avail()/Get()/Advance() never lock, and do not allocate once buffers have grown to the block size.
+class WDL_ConvolutionEngine_Swap
+{
+public:
+  WDL_ConvolutionEngine_Swap();
+  ~WDL_ConvolutionEngine_Swap();
+
+  // call from any thread except the audio thread (but not from two threads at once). nch is the channel count
+  // that will be passed to Add(), other parameters are as WDL_ConvolutionEngine_Div::SetImpulse().
+  // returns false (and does nothing) if the previous impulse has not finished crossfading in yet
+  bool PrepareImpulse(WDL_ImpulseBuffer *impulse, int nch, int maxfft_size=0, int known_blocksize=0, int max_imp_size=0, int impulse_offset=0, int latency_allowed=0);
+  bool IsSwapPending(); // true from PrepareImpulse() until the crossfade completes
+
+  void SetCrossfadeBlocks(int blocks) { m_xf_blocks=blocks>0?blocks:0; } // length in Add() blocks, 0 swaps immediately (the first impulse fades in from silence)
+
+  int GetLatency();
+  void Reset();
+
+  void Add(WDL_FFT_REAL **bufs, int len, int nch);
+
+  int Avail(int wantSamples);
+  WDL_FFT_REAL **Get(); // returns length valid
+  void Advance(int len);
+
+private:
+  void FinishSwap();
+
+  WDL_ConvolutionEngine_Div m_engines[2];
+  int m_cur; // engine in use, only changed by the audio thread
+  int m_swapgen; // odd while a prepared engine is pending or crossfading (see wdlatomic.h)
+
+  // audio thread only
+  bool m_fading;
+  int m_xf_blocks, m_xf_len, m_xf_pos; // m_xf_len/m_xf_pos are in samples
+  int m_proc_nch;
+  WDL_TypedBuf<WDL_FFT_REAL> m_mixbuf;
+  WDL_FFT_REAL *m_get_tmpptrs[WDL_CONVO_MAX_PROC_NCH];
+
+} WDL_FIXALIGN;
+
+// N-in/M-out convolution (uniformly partitioned, not limited by WDL_CONVO_MAX_*_NCH).
+// each input is FFT'd once per block and shared by every output. outputs are accumulated in pairs
+// (packed as real/imaginary), so there is one inverse FFT per two outputs. latency is GetFFTSize()/2
+class WDL_ConvolutionEngine_Matrix
+{
+public:
+  WDL_ConvolutionEngine_Matrix();
+  ~WDL_ConvolutionEngine_Matrix();
+
+  // impulses[in*nout+out] is the response from input in to output out (impulse_len samples), or NULL if none.
+  // fft_size<=0 picks one based on impulse_len (capped at -fft_size*2 if fft_size<=-16). returns latency
+  int SetImpulse(int nin, int nout, const WDL_FFT_REAL * const *impulses, int impulse_len, int fft_size=-1);
+
+  int GetFFTSize() { return m_fft_size; }
+  int GetLatency() { return m_fft_size/2; }
+  int GetNumInputs() { return m_nin; }
+  int GetNumOutputs() { return m_nout; }
+
+  void Reset(); // clears out any latent samples
+
+  void Add(WDL_FFT_REAL **bufs, int len, int nch); // inputs >= nch (or NULL bufs) are treated as silent
+
+  int Avail(int wantSamples);
+  WDL_FFT_REAL **Get(); // GetNumOutputs() channels, returns length valid
+  void Advance(int len);
+
+  // zero-copy processing of exactly GetFFTSize()/2 frames (see WDL_ConvolutionEngine::Process()), in has nch channels
+  // and out has GetNumOutputs() channels. returns false if nframes doesn't match
+  bool Process(WDL_FFT_REAL **in, WDL_FFT_REAL **out, int nframes, int nch);
+
+private:
+  void ProcessBlock(WDL_FFT_REAL **in, int nch, WDL_FFT_REAL **out);
+
+  int m_nin, m_nout, m_npairs;
+  int m_fft_size;
+  int m_nblocks;
+  int m_hist_pos;
+
+  WDL_TypedBuf<WDL_CONVO_IMPULSEBUFf> m_impulse; // [in][pair][block], FFT'd (output pairs packed as re/im)
+  WDL_TypedBuf<char> m_impulse_zflag; // [in][pair][block]
+  WDL_TypedBuf<WDL_FFT_REAL> m_samplehist; // [in][block], FFT'd
+  WDL_TypedBuf<char> m_samplehist_zflag; // [in][block]
+  WDL_TypedBuf<WDL_FFT_REAL> m_overlaphist; // [pair]
+  WDL_TypedBuf<WDL_FFT_REAL> m_combinebuf;
+
+  WDL_PtrList<WDL_FastQueue> m_samplesin;
+  WDL_PtrList<WDL_Queue> m_samplesout;
+  WDL_TypedBuf<WDL_FFT_REAL *> m_get_tmpptrs;
+
+} WDL_FIXALIGN;
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,207 @@
+/*
+  WDL - convoengine_test.cpp
+  Copyright (C) 2006 and later Cockos Incorporated
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/*
+  checks that WDL_ConvolutionEngine_Div with SetThreading() adds no latency, that its output is bit-identical
+  with background threads and without (with SetThreading(0,...)), also when the threads are late (blocks
+  longer than known_blocksize) or the channels are identical, and that it matches the engine without
+  threading to within rounding (the layouts differ), including across Reset().
+
+  g++ -O2 -DWDL_CONVO_THREAD convoengine_test.cpp convoengine.cpp fft.c -lpthread
+  cl /O2 /DWDL_CONVO_THREAD convoengine_test.cpp convoengine.cpp fft.c
+*/
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "convoengine.h"
+
+#ifndef WDL_CONVO_THREAD
+#error build with WDL_CONVO_THREAD defined
+#endif
+
+static unsigned int s_rng=1;
+static WDL_FFT_REAL rnd()
+{
+  s_rng = s_rng*1103515245 + 12345;
+  return (WDL_FFT_REAL) ((int)((s_rng>>8)&0xffff) - 32768) / (WDL_FFT_REAL)32768.0;
+}
+
+static void pull(WDL_ConvolutionEngine_Div *eng, WDL_TypedBuf<WDL_FFT_REAL> *out, int nch, int want)
+{
+  const int a=eng->Avail(want);
+  if (a<1) return;
+  WDL_FFT_REAL **p=eng->Get();
+  int ch;
+  for (ch = 0; ch < nch; ch ++)
+  {
+    const int sz=out[ch].GetSize();
+    memcpy(out[ch].Resize(sz+a,false)+sz,p[ch],a*sizeof(WDL_FFT_REAL));
+  }
+  eng->Advance(a);
+}
+
+// feeds the same input to eng in blocks of 1..maxblock (resetting after resetpos samples), returns output in out
+static void run(WDL_ConvolutionEngine_Div *eng, const WDL_TypedBuf<WDL_FFT_REAL> *in, int nch, int len, int maxblock, int resetpos,
+                WDL_TypedBuf<WDL_FFT_REAL> *out, int outlen)
+{
+  int ch;
+  for (ch = 0; ch < nch; ch ++) out[ch].Resize(0,false);
+
+  s_rng=12345; // same block sizes for every run
+  int pos=0;
+  WDL_FFT_REAL *bufs[WDL_CONVO_MAX_PROC_NCH];
+  while (pos < len)
+  {
+    int bs = 1 + (int)(s_rng % maxblock);
+    rnd();
+    if (bs > len-pos) bs = len-pos;
+    if (pos < resetpos && pos+bs >= resetpos)
+    {
+      eng->Reset();
+      for (ch = 0; ch < nch; ch ++) out[ch].Resize(0,false);
+    }
+    for (ch = 0; ch < nch; ch ++) bufs[ch]=(WDL_FFT_REAL*)in[ch].Get()+pos;
+    eng->Add(bufs,bs,nch);
+    pull(eng,out,nch,bs);
+    pos+=bs;
+  }
+
+  while (out[0].GetSize() < outlen)
+  {
+    const int sz=out[0].GetSize();
+    eng->Add(NULL,maxblock,nch);
+    pull(eng,out,nch,maxblock);
+    if (out[0].GetSize()==sz) break; // should not happen, Avail() never comes up short
+  }
+}
+
+// tol is relative to the peak of b, 0 for bit-identical
+static bool same(WDL_TypedBuf<WDL_FFT_REAL> *a, WDL_TypedBuf<WDL_FFT_REAL> *b, int nch, int len, double tol)
+{
+  int ch, i;
+  for (ch = 0; ch < nch; ch ++)
+  {
+    if (a[ch].GetSize() < len || b[ch].GetSize() < len) return false;
+    const WDL_FFT_REAL *pa=a[ch].Get(), *pb=b[ch].Get();
+    if (tol <= 0.0)
+    {
+      if (memcmp(pa,pb,len*sizeof(WDL_FFT_REAL))) return false;
+    }
+    else
+    {
+      double peak=0.0;
+      for (i = 0; i < len; i ++) if (fabs(pb[i]) > peak) peak=fabs(pb[i]);
+      for (i = 0; i < len; i ++) if (fabs(pa[i]-pb[i]) > tol*peak) return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  static const int lens[] = { 5000, 40000, 100000, 200000 };
+  static const int blocks[] = { 64, 512 };
+  const int nch=2;
+  const int inlen=300000;
+  int errors=0;
+
+  WDL_TypedBuf<WDL_FFT_REAL> in[WDL_CONVO_MAX_PROC_NCH], monoin[WDL_CONVO_MAX_PROC_NCH];
+  WDL_TypedBuf<WDL_FFT_REAL> ref[WDL_CONVO_MAX_PROC_NCH], inl[WDL_CONVO_MAX_PROC_NCH], out[WDL_CONVO_MAX_PROC_NCH];
+  int ch, i;
+  for (ch = 0; ch < nch; ch ++)
+  {
+    WDL_FFT_REAL *p=in[ch].Resize(inlen,false);
+    for (i = 0; i < inlen; i ++) p[i]=rnd();
+  }
+  for (ch = 0; ch < nch; ch ++) memcpy(monoin[ch].Resize(inlen,false),in[0].Get(),inlen*sizeof(WDL_FFT_REAL));
+
+  int li, bi, mode;
+  for (li = 0; li < (int)(sizeof(lens)/sizeof(lens[0])); li ++)
+  {
+    WDL_ImpulseBuffer imp;
+    imp.SetNumChannels(2);
+    imp.SetLength(lens[li]);
+    for (ch = 0; ch < 2; ch ++)
+    {
+      WDL_FFT_REAL *p=imp.impulses[ch].Get();
+      for (i = 0; i < lens[li]; i ++) p[i]=rnd() * (WDL_FFT_REAL) (1.0 - i/(double)lens[li]);
+    }
+
+    for (bi = 0; bi < (int)(sizeof(blocks)/sizeof(blocks[0])); bi ++)
+    {
+      const int resetpos=inlen/3;
+      const int outlen=inlen-resetpos+lens[li];
+
+      WDL_ConvolutionEngine_Div base;
+      base.SetImpulse(&imp,0,blocks[bi]);
+      run(&base,in,nch,inlen,blocks[bi],resetpos,ref,outlen);
+
+      WDL_ConvolutionEngine_Div inline_eng;
+      inline_eng.SetThreading(0,4096);
+      inline_eng.SetImpulse(&imp,0,blocks[bi]);
+      run(&inline_eng,in,nch,inlen,blocks[bi],resetpos,inl,outlen);
+
+      int nthr=0;
+      for (i = 0; i < inline_eng.GetNumPartitions(); i ++) if (inline_eng.GetPartition(i)->threaded) nthr++;
+
+      const bool lat_ok = inline_eng.GetLatency() == base.GetLatency();
+      const bool close = same(inl,ref,nch,outlen,1e-5);
+      printf("impulse %d, block %d, inline: %d/%d partitions threaded, latency %s, %s\n",
+        lens[li],blocks[bi],nthr,inline_eng.GetNumPartitions(),lat_ok ? "+0" : "DIFFERS",
+        close ? "matches unthreaded" : "DIFFERS FROM UNTHREADED");
+      if (!lat_ok || !close) errors++;
+
+      for (mode = 0; mode < 3; mode ++)
+      {
+        static const char * const names[] = { "2 threads", "2 threads, late", "2 threads, mono" };
+        WDL_TypedBuf<WDL_FFT_REAL> *src = mode == 2 ? monoin : in, *cmp=inl;
+        int maxblock=blocks[bi];
+        if (mode == 1) maxblock*=8; // longer than the headroom, Avail() waits for or processes the late partitions
+        if (mode > 0)
+        {
+          // mode 2 has identical channels, which the calling thread partitions process as mono
+          cmp=ref;
+          run(&inline_eng,src,nch,inlen,maxblock,resetpos,cmp,outlen);
+        }
+
+        WDL_ConvolutionEngine_Div eng;
+        eng.SetThreading(2,4096);
+        eng.SetImpulse(&imp,0,blocks[bi]);
+        run(&eng,src,nch,inlen,maxblock,resetpos,out,outlen);
+
+        const bool ok = eng.GetLatency() == base.GetLatency() && same(out,cmp,nch,outlen,0.0);
+        printf("impulse %d, block %d, %s: %s\n",lens[li],blocks[bi],names[mode],ok ? "identical to inline" : "OUTPUT DIFFERS");
+        if (!ok) errors++;
+      }
+    }
+  }
+
+  printf("%s\n",errors ? "FAILED" : "passed");
+  return errors ? 1 : 0;
+}
@@ -32,10 +32,15 @@
 // this is based on djbfft
 
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include "fft.h"
 
 
-#define FFT_MAXBITLEN 15
+#ifndef WDL_FFT_MAXBITLEN
+#define WDL_FFT_MAXBITLEN 17 // largest transform is 1<<WDL_FFT_MAXBITLEN, 15..17
+#endif
+#define FFT_MAXBITLEN WDL_FFT_MAXBITLEN
 
 #ifdef _MSC_VER
 #define inline __inline
@@ -55,6 +60,12 @@ static WDL_FFT_COMPLEX d4096[511];
 static WDL_FFT_COMPLEX d8192[1023];
 static WDL_FFT_COMPLEX d16384[2047];
 static WDL_FFT_COMPLEX d32768[4095];
+#if FFT_MAXBITLEN >= 16
+static WDL_FFT_COMPLEX d65536[8191];
+#endif
+#if FFT_MAXBITLEN >= 17
+static WDL_FFT_COMPLEX d131072[16383];
+#endif
 
 
 #define sqrthalf (d16[1].re)
@@ -525,10 +536,11 @@ static void cpass(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX *w,
     w += 2;
   }
 }
+static void (*s_cpass)(WDL_FFT_COMPLEX *, const WDL_FFT_COMPLEX *, unsigned int) = cpass;
 
 static void c32(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d32,4);
+  s_cpass(a,d32,4);
   c8(a + 16);
   c8(a + 24);
   c16(a);
@@ -536,7 +548,7 @@ static void c32(register WDL_FFT_COMPLEX *a)
 
 static void c64(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d64,8);
+  s_cpass(a,d64,8);
   c16(a + 32);
   c16(a + 48);
   c32(a);
@@ -544,7 +556,7 @@ static void c64(register WDL_FFT_COMPLEX *a)
 
 static void c128(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d128,16);
+  s_cpass(a,d128,16);
   c32(a + 64);
   c32(a + 96);
   c64(a);
@@ -552,7 +564,7 @@ static void c128(register WDL_FFT_COMPLEX *a)
 
 static void c256(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d256,32);
+  s_cpass(a,d256,32);
   c64(a + 128);
   c64(a + 192);
   c128(a);
@@ -560,7 +572,7 @@ static void c256(register WDL_FFT_COMPLEX *a)
 
 static void c512(register WDL_FFT_COMPLEX *a)
 {
-  cpass(a,d512,64);
+  s_cpass(a,d512,64);
   c128(a + 384);
   c128(a + 256);
   c256(a);
@@ -615,11 +627,12 @@ static void cpassbig(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX
     w -= 2;
   } while (k -= 2);
 }
+static void (*s_cpassbig)(WDL_FFT_COMPLEX *, const WDL_FFT_COMPLEX *, unsigned int) = cpassbig;
 
 
 static void c1024(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d1024,128);
+  s_cpassbig(a,d1024,128);
   c256(a + 768);
   c256(a + 512);
   c512(a);
@@ -627,7 +640,7 @@ static void c1024(register WDL_FFT_COMPLEX *a)
 
 static void c2048(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d2048,256);
+  s_cpassbig(a,d2048,256);
   c512(a + 1536);
   c512(a + 1024);
   c1024(a);
@@ -635,7 +648,7 @@ static void c2048(register WDL_FFT_COMPLEX *a)
 
 static void c4096(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d4096,512);
+  s_cpassbig(a,d4096,512);
   c1024(a + 3072);
   c1024(a + 2048);
   c2048(a);
@@ -643,7 +656,7 @@ static void c4096(register WDL_FFT_COMPLEX *a)
 
 static void c8192(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d8192,1024);
+  s_cpassbig(a,d8192,1024);
   c2048(a + 6144);
   c2048(a + 4096);
   c4096(a);
@@ -651,7 +664,7 @@ static void c8192(register WDL_FFT_COMPLEX *a)
 
 static void c16384(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d16384,2048);
+  s_cpassbig(a,d16384,2048);
   c4096(a + 8192 + 4096);
   c4096(a + 8192);
   c8192(a);
@@ -659,12 +672,32 @@ static void c16384(register WDL_FFT_COMPLEX *a)
 
 static void c32768(register WDL_FFT_COMPLEX *a)
 {
-  cpassbig(a,d32768,4096);
+  s_cpassbig(a,d32768,4096);
   c8192(a + 16384 + 8192);
   c8192(a + 16384);
   c16384(a);
 }
 
+#if FFT_MAXBITLEN >= 16
+static void c65536(register WDL_FFT_COMPLEX *a)
+{
+  s_cpassbig(a,d65536,8192);
+  c16384(a + 32768 + 16384);
+  c16384(a + 32768);
+  c32768(a);
+}
+#endif
+
+#if FFT_MAXBITLEN >= 17
+static void c131072(register WDL_FFT_COMPLEX *a)
+{
+  s_cpassbig(a,d131072,16384);
+  c32768(a + 65536 + 32768);
+  c32768(a + 65536);
+  c65536(a);
+}
+#endif
+
 #if 0
 static void mulr4(WDL_FFT_REAL *a,WDL_FFT_REAL *b)
 {
@@ -686,37 +719,9 @@ static void mulr4(WDL_FFT_REAL *a,WDL_FFT_REAL *b)
 
 #endif
 /* n even, n > 0 */
-void WDL_fft_complexmul(WDL_FFT_COMPLEX *a,WDL_FFT_COMPLEX *b,int n)
-{
-  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-  if (n<2 || (n&1)) return;
-
-  do {
-    t1 = a[0].re * b[0].re;
-    t2 = a[0].im * b[0].im;
-    t3 = a[0].im * b[0].re;
-    t4 = a[0].re * b[0].im;
-    t5 = a[1].re * b[1].re;
-    t6 = a[1].im * b[1].im;
-    t7 = a[1].im * b[1].re;
-    t8 = a[1].re * b[1].im;
-    t1 -= t2;
-    t3 += t4;
-    t5 -= t6;
-    t7 += t8;
-    a[0].re = t1;
-    a[1].re = t5;
-    a[0].im = t3;
-    a[1].im = t7;
-    a += 2;
-    b += 2;
-  } while (n -= 2);
-}
-
-void WDL_fft_complexmul2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+static void complexmul2_c(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
 {
   register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-  if (n<2 || (n&1)) return;
 
   do {
     t1 = a[0].re * b[0].re;
@@ -740,10 +745,9 @@ void WDL_fft_complexmul2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX
     c += 2;
   } while (n -= 2);
 }
-void WDL_fft_complexmul3(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+static void complexmul3_c(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
 {
   register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-  if (n<2 || (n&1)) return;
 
   do {
     t1 = a[0].re * b[0].re;
@@ -769,220 +773,863 @@ void WDL_fft_complexmul3(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX
 }
 
 
-static inline void u4(register WDL_FFT_COMPLEX *a)
+/* split (planar) layout: n real values followed by n imaginary values */
+static void complexmul2_split_c(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
 {
-  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-
-  t1 = VOL a[1].re;
-  t3 = a[0].re - t1;
-  t6 = VOL a[2].re;
-  t1 += a[0].re;
-  t8 = a[3].re - t6;
-  t6 += a[3].re;
-  a[0].re = t1 + t6;
-  t1 -= t6;
-  a[2].re = t1;
-
-  t2 = VOL a[1].im;
-  t4 = a[0].im - t2;
-  t2 += a[0].im;
-  t5 = VOL a[3].im;
-  a[1].im = t4 + t8;
-  t4 -= t8;
-  a[3].im = t4;
+  register WDL_FFT_REAL t1, t2, t3, t4;
+  WDL_FFT_REAL *ci = c + n;
+  const WDL_FFT_REAL *ai = a + n, *bi = b + n;
+  int i;
 
-  t7 = a[2].im - t5;
-  t5 += a[2].im;
-  a[1].re = t3 + t7;
-  t3 -= t7;
-  a[3].re = t3;
-  a[0].im = t2 + t5;
-  t2 -= t5;
-  a[2].im = t2;
+  for (i = 0; i < n; i ++)
+  {
+    t1 = a[i] * b[i];
+    t2 = ai[i] * bi[i];
+    t3 = ai[i] * b[i];
+    t4 = a[i] * bi[i];
+    t1 -= t2;
+    t3 += t4;
+    c[i] = t1;
+    ci[i] = t3;
+  }
 }
 
-static void u8(register WDL_FFT_COMPLEX *a)
+static void complexmul3_split_c(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
 {
-  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-
-  u4(a);
+  register WDL_FFT_REAL t1, t2, t3, t4;
+  WDL_FFT_REAL *ci = c + n;
+  const WDL_FFT_REAL *ai = a + n, *bi = b + n;
+  int i;
 
-  t1 = a[5].re;
-  a[5].re = a[4].re - t1;
-  t1 += a[4].re;
+  for (i = 0; i < n; i ++)
+  {
+    t1 = a[i] * b[i];
+    t2 = ai[i] * bi[i];
+    t3 = ai[i] * b[i];
+    t4 = a[i] * bi[i];
+    t1 -= t2;
+    t3 += t4;
+    c[i] += t1;
+    ci[i] += t3;
+  }
+}
 
-  t3 = a[7].re;
-  a[7].re = a[6].re - t3;
-  t3 += a[6].re;
 
-  t8 = t3 - t1;
-  t1 += t3;
+/*
+  SIMD versions of the above. These do the same operations in the same order as the scalar
+  versions (negation is exact), so the results are bit-identical. Selected in WDL_fft_init().
+*/
 
-  t6 = a[2].im - t8;
-  t8 += a[2].im;
-  a[2].im = t8;
+#ifndef WDL_FFT_NO_SIMD
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+
+  #ifdef _MSC_VER
+    #include <intrin.h>
+    #define WDL_FFT_SIMD_SSE2
+    #define WDL_FFT_SSE2_TARGET
+    #if _MSC_VER >= 1600
+      #define WDL_FFT_SIMD_AVX
+      #define WDL_FFT_AVX_TARGET
+    #endif
+  #else
+    #include <cpuid.h>
+    #if defined(__has_attribute)
+      #if __has_attribute(target)
+        #define WDL_FFT_SSE2_TARGET __attribute__((target("sse2")))
+        #define WDL_FFT_AVX_TARGET __attribute__((target("avx")))
+        #define WDL_FFT_SIMD_SSE2
+        #define WDL_FFT_SIMD_AVX
+      #endif
+    #endif
+    #if !defined(WDL_FFT_SIMD_SSE2) && defined(__SSE2__)
+      #define WDL_FFT_SSE2_TARGET
+      #define WDL_FFT_SIMD_SSE2
+    #endif
+    #if !defined(WDL_FFT_SIMD_AVX) && defined(__AVX__)
+      #define WDL_FFT_AVX_TARGET
+      #define WDL_FFT_SIMD_AVX
+    #endif
+  #endif
+
+  #include <emmintrin.h>
+  #ifdef WDL_FFT_SIMD_AVX
+    #include <immintrin.h>
+  #endif
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+  #include <arm_neon.h>
+  #define WDL_FFT_SIMD_NEON
 
-  t5 = a[0].re - t1;
-  a[4].re = t5;
-  t1 += a[0].re;
-  a[0].re = t1;
+#endif
 
-  t2 = a[5].im;
-  a[5].im = a[4].im - t2;
-  t2 += a[4].im;
+#endif // WDL_FFT_NO_SIMD
 
-  t4 = a[7].im;
-  a[7].im = a[6].im - t4;
-  t4 += a[6].im;
 
-  a[6].im = t6;
+#ifdef WDL_FFT_SIMD_SSE2
 
-  t7 = t2 - t4;
-  t2 += t4;
+#if WDL_FFT_REALSIZE == 4
 
-  t3 = a[2].re - t7;
-  a[6].re = t3;
-  t7 += a[2].re;
-  a[2].re = t7;
+#define SSE2_CPLXMUL(va,vb,out) { \
+  const __m128 bre = _mm_shuffle_ps(vb,vb,_MM_SHUFFLE(2,2,0,0)); \
+  const __m128 bim = _mm_shuffle_ps(vb,vb,_MM_SHUFFLE(3,3,1,1)); \
+  const __m128 asw = _mm_shuffle_ps(va,va,_MM_SHUFFLE(2,3,0,1)); \
+  out = _mm_add_ps(_mm_mul_ps(va,bre),_mm_xor_ps(_mm_mul_ps(asw,bim),negre)); \
+}
 
-  t6 = a[0].im - t2;
-  a[4].im = t6;
-  t2 += a[0].im;
-  a[0].im = t2;
+WDL_FFT_SSE2_TARGET static void complexmul2_sse2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  const __m128 negre = _mm_castsi128_ps(_mm_set_epi32(0,(int)0x80000000,0,(int)0x80000000));
+  do {
+    const __m128 va = _mm_loadu_ps(&a->re), vb = _mm_loadu_ps(&b->re);
+    __m128 t;
+    SSE2_CPLXMUL(va,vb,t)
+    _mm_storeu_ps(&c->re,t);
+    a += 2;
+    b += 2;
+    c += 2;
+  } while (n -= 2);
+}
 
-  t6 = sqrthalf;
+WDL_FFT_SSE2_TARGET static void complexmul3_sse2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  const __m128 negre = _mm_castsi128_ps(_mm_set_epi32(0,(int)0x80000000,0,(int)0x80000000));
+  do {
+    const __m128 va = _mm_loadu_ps(&a->re), vb = _mm_loadu_ps(&b->re);
+    __m128 t;
+    SSE2_CPLXMUL(va,vb,t)
+    _mm_storeu_ps(&c->re,_mm_add_ps(_mm_loadu_ps(&c->re),t));
+    a += 2;
+    b += 2;
+    c += 2;
+  } while (n -= 2);
+}
 
-  t1 = a[5].re;
-  t2 = a[5].im - t1;
-  t2 *= t6;
-  t1 += a[5].im;
-  t1 *= t6;
-  t4 = a[7].im;
-  t3 = a[7].re - t4;
-  t3 *= t6;
-  t4 += a[7].re;
-  t4 *= t6;
+#undef SSE2_CPLXMUL
 
-  t8 = t3 - t1;
-  t1 += t3;
-  t7 = t2 - t4;
-  t2 += t4;
+#define SSE2_SPLIT_TYPE __m128
+#define SSE2_SPLIT_N 4
+#define SSE2_SPLIT_LOAD _mm_loadu_ps
+#define SSE2_SPLIT_STORE _mm_storeu_ps
+#define SSE2_SPLIT_ADD _mm_add_ps
+#define SSE2_SPLIT_SUB _mm_sub_ps
+#define SSE2_SPLIT_MUL _mm_mul_ps
 
-  t4 = a[3].im - t8;
-  a[7].im = t4;
-  t5 = a[1].re - t1;
-  a[5].re = t5;
-  t3 = a[3].re - t7;
-  a[7].re = t3;
-  t6 = a[1].im - t2;
-  a[5].im = t6;
+#else // WDL_FFT_REALSIZE == 8
 
-  t8 += a[3].im;
-  a[3].im = t8;
-  t1 += a[1].re;
-  a[1].re = t1;
-  t7 += a[3].re;
-  a[3].re = t7;
-  t2 += a[1].im;
-  a[1].im = t2;
+#define SSE2_CPLXMUL(va,vb,out) { \
+  const __m128d bre = _mm_unpacklo_pd(vb,vb); \
+  const __m128d bim = _mm_unpackhi_pd(vb,vb); \
+  const __m128d asw = _mm_shuffle_pd(va,va,1); \
+  out = _mm_add_pd(_mm_mul_pd(va,bre),_mm_xor_pd(_mm_mul_pd(asw,bim),negre)); \
 }
 
-static void u16(register WDL_FFT_COMPLEX *a)
+WDL_FFT_SSE2_TARGET static void complexmul2_sse2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
 {
-  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-
-  u8(a);
-  u4(a + 8);
-  u4(a + 12);
-
-  UNTRANSFORMZERO(a[0],a[4],a[8],a[12]);
-  UNTRANSFORMHALF(a[2],a[6],a[10],a[14]);
-  UNTRANSFORM(a[1],a[5],a[9],a[13],d16[0].re,d16[0].im);
-  UNTRANSFORM(a[3],a[7],a[11],a[15],d16[0].im,d16[0].re);
+  const __m128d negre = _mm_set_pd(0.0,-0.0);
+  do {
+    const __m128d va = _mm_loadu_pd(&a->re), vb = _mm_loadu_pd(&b->re);
+    __m128d t;
+    SSE2_CPLXMUL(va,vb,t)
+    _mm_storeu_pd(&c->re,t);
+    a++;
+    b++;
+    c++;
+  } while (--n);
 }
 
-/* a[0...8n-1], w[0...2n-2] */
-static void upass(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX *w,register unsigned int n)
+WDL_FFT_SSE2_TARGET static void complexmul3_sse2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
 {
-  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-  register WDL_FFT_COMPLEX *a1;
-  register WDL_FFT_COMPLEX *a2;
-  register WDL_FFT_COMPLEX *a3;
+  const __m128d negre = _mm_set_pd(0.0,-0.0);
+  do {
+    const __m128d va = _mm_loadu_pd(&a->re), vb = _mm_loadu_pd(&b->re);
+    __m128d t;
+    SSE2_CPLXMUL(va,vb,t)
+    _mm_storeu_pd(&c->re,_mm_add_pd(_mm_loadu_pd(&c->re),t));
+    a++;
+    b++;
+    c++;
+  } while (--n);
+}
 
-  a2 = a + 4 * n;
-  a1 = a + 2 * n;
-  a3 = a2 + 2 * n;
-  n -= 1;
+#undef SSE2_CPLXMUL
 
-  UNTRANSFORMZERO(a[0],a1[0],a2[0],a3[0]);
-  UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].re,w[0].im);
+#define SSE2_SPLIT_TYPE __m128d
+#define SSE2_SPLIT_N 2
+#define SSE2_SPLIT_LOAD _mm_loadu_pd
+#define SSE2_SPLIT_STORE _mm_storeu_pd
+#define SSE2_SPLIT_ADD _mm_add_pd
+#define SSE2_SPLIT_SUB _mm_sub_pd
+#define SSE2_SPLIT_MUL _mm_mul_pd
 
-  for (;;) {
-    UNTRANSFORM(a[2],a1[2],a2[2],a3[2],w[1].re,w[1].im);
-    UNTRANSFORM(a[3],a1[3],a2[3],a3[3],w[2].re,w[2].im);
-    if (!--n) break;
-    a += 2;
-    a1 += 2;
-    a2 += 2;
-    a3 += 2;
-    w += 2;
-  }
-}
+#endif // WDL_FFT_REALSIZE == 8
 
-static void u32(register WDL_FFT_COMPLEX *a)
+WDL_FFT_SSE2_TARGET static void complexmul2_split_sse2(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
 {
-  u16(a);
-  u8(a + 16);
-  u8(a + 24);
-  upass(a,d32,4);
+  const int nv = n & ~(SSE2_SPLIT_N-1);
+  int i;
+  for (i = 0; i < nv; i += SSE2_SPLIT_N)
+  {
+    const SSE2_SPLIT_TYPE ar = SSE2_SPLIT_LOAD(a+i), ai = SSE2_SPLIT_LOAD(a+n+i);
+    const SSE2_SPLIT_TYPE br = SSE2_SPLIT_LOAD(b+i), bi = SSE2_SPLIT_LOAD(b+n+i);
+    SSE2_SPLIT_STORE(c+i,SSE2_SPLIT_SUB(SSE2_SPLIT_MUL(ar,br),SSE2_SPLIT_MUL(ai,bi)));
+    SSE2_SPLIT_STORE(c+n+i,SSE2_SPLIT_ADD(SSE2_SPLIT_MUL(ai,br),SSE2_SPLIT_MUL(ar,bi)));
+  }
+  if (nv < n)
+  {
+    for (i = nv; i < n; i ++)
+    {
+      const WDL_FFT_REAL ar = a[i], ai = a[n+i], br = b[i], bi = b[n+i];
+      c[i] = ar*br - ai*bi;
+      c[n+i] = ai*br + ar*bi;
+    }
+  }
 }
 
-static void u64(register WDL_FFT_COMPLEX *a)
+WDL_FFT_SSE2_TARGET static void complexmul3_split_sse2(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
 {
-  u32(a);
-  u16(a + 32);
-  u16(a + 48);
-  upass(a,d64,8);
+  const int nv = n & ~(SSE2_SPLIT_N-1);
+  int i;
+  for (i = 0; i < nv; i += SSE2_SPLIT_N)
+  {
+    const SSE2_SPLIT_TYPE ar = SSE2_SPLIT_LOAD(a+i), ai = SSE2_SPLIT_LOAD(a+n+i);
+    const SSE2_SPLIT_TYPE br = SSE2_SPLIT_LOAD(b+i), bi = SSE2_SPLIT_LOAD(b+n+i);
+    SSE2_SPLIT_STORE(c+i,SSE2_SPLIT_ADD(SSE2_SPLIT_LOAD(c+i),SSE2_SPLIT_SUB(SSE2_SPLIT_MUL(ar,br),SSE2_SPLIT_MUL(ai,bi))));
+    SSE2_SPLIT_STORE(c+n+i,SSE2_SPLIT_ADD(SSE2_SPLIT_LOAD(c+n+i),SSE2_SPLIT_ADD(SSE2_SPLIT_MUL(ai,br),SSE2_SPLIT_MUL(ar,bi))));
+  }
+  if (nv < n)
+  {
+    for (i = nv; i < n; i ++)
+    {
+      const WDL_FFT_REAL ar = a[i], ai = a[n+i], br = b[i], bi = b[n+i];
+      c[i] += ar*br - ai*bi;
+      c[n+i] += ai*br + ar*bi;
+    }
+  }
 }
 
-static void u128(register WDL_FFT_COMPLEX *a)
-{
-  u64(a);
-  u32(a + 64);
-  u32(a + 96);
-  upass(a,d128,16);
+#undef SSE2_SPLIT_TYPE
+#undef SSE2_SPLIT_N
+#undef SSE2_SPLIT_LOAD
+#undef SSE2_SPLIT_STORE
+#undef SSE2_SPLIT_ADD
+#undef SSE2_SPLIT_SUB
+#undef SSE2_SPLIT_MUL
+
+#endif // WDL_FFT_SIMD_SSE2
+
+
+#ifdef WDL_FFT_SIMD_AVX
+
+#if WDL_FFT_REALSIZE == 4
+
+#define AVX_CPLXMUL(va,vb,out) { \
+  const __m256 bre = _mm256_moveldup_ps(vb); \
+  const __m256 bim = _mm256_movehdup_ps(vb); \
+  const __m256 asw = _mm256_permute_ps(va,_MM_SHUFFLE(2,3,0,1)); \
+  out = _mm256_add_ps(_mm256_mul_ps(va,bre),_mm256_xor_ps(_mm256_mul_ps(asw,bim),negre)); \
 }
 
-static void u256(register WDL_FFT_COMPLEX *a)
+// 4 complex values per iteration, n is even so there may be 2 left
+WDL_FFT_AVX_TARGET static void complexmul2_avx(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
 {
-  u128(a);
-  u64(a + 128);
-  u64(a + 192);
-  upass(a,d256,32);
+  const __m256 negre = _mm256_set_ps(0.0f,-0.0f,0.0f,-0.0f,0.0f,-0.0f,0.0f,-0.0f);
+  for (; n >= 4; n -= 4)
+  {
+    const __m256 va = _mm256_loadu_ps(&a->re), vb = _mm256_loadu_ps(&b->re);
+    __m256 t;
+    AVX_CPLXMUL(va,vb,t)
+    _mm256_storeu_ps(&c->re,t);
+    a += 4;
+    b += 4;
+    c += 4;
+  }
+  if (n)
+  {
+    const __m256 va = _mm256_castps128_ps256(_mm_loadu_ps(&a->re)), vb = _mm256_castps128_ps256(_mm_loadu_ps(&b->re));
+    __m256 t;
+    AVX_CPLXMUL(va,vb,t)
+    _mm_storeu_ps(&c->re,_mm256_castps256_ps128(t));
+  }
 }
 
-static void u512(register WDL_FFT_COMPLEX *a)
+WDL_FFT_AVX_TARGET static void complexmul3_avx(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
 {
-  u256(a);
-  u128(a + 256);
-  u128(a + 384);
-  upass(a,d512,64);
+  const __m256 negre = _mm256_set_ps(0.0f,-0.0f,0.0f,-0.0f,0.0f,-0.0f,0.0f,-0.0f);
+  for (; n >= 4; n -= 4)
+  {
+    const __m256 va = _mm256_loadu_ps(&a->re), vb = _mm256_loadu_ps(&b->re);
+    __m256 t;
+    AVX_CPLXMUL(va,vb,t)
+    _mm256_storeu_ps(&c->re,_mm256_add_ps(_mm256_loadu_ps(&c->re),t));
+    a += 4;
+    b += 4;
+    c += 4;
+  }
+  if (n)
+  {
+    const __m256 va = _mm256_castps128_ps256(_mm_loadu_ps(&a->re)), vb = _mm256_castps128_ps256(_mm_loadu_ps(&b->re));
+    __m256 t;
+    AVX_CPLXMUL(va,vb,t)
+    _mm_storeu_ps(&c->re,_mm_add_ps(_mm_loadu_ps(&c->re),_mm256_castps256_ps128(t)));
+  }
 }
 
+#undef AVX_CPLXMUL
 
-/* a[0...8n-1], w[0...n-2]; n even, n >= 4 */
-static void upassbig(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX *w,register unsigned int n)
-{
-  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
-  register WDL_FFT_COMPLEX *a1;
-  register WDL_FFT_COMPLEX *a2;
-  register WDL_FFT_COMPLEX *a3;
-  register unsigned int k;
+#define AVX_SPLIT_TYPE __m256
+#define AVX_SPLIT_N 8
+#define AVX_SPLIT_LOAD _mm256_loadu_ps
+#define AVX_SPLIT_STORE _mm256_storeu_ps
+#define AVX_SPLIT_ADD _mm256_add_ps
+#define AVX_SPLIT_SUB _mm256_sub_ps
+#define AVX_SPLIT_MUL _mm256_mul_ps
 
-  a2 = a + 4 * n;
-  a1 = a + 2 * n;
-  a3 = a2 + 2 * n;
-  k = n - 2;
+#else // WDL_FFT_REALSIZE == 8
+
+#define AVX_CPLXMUL(va,vb,out) { \
+  const __m256d bre = _mm256_movedup_pd(vb); \
+  const __m256d bim = _mm256_permute_pd(vb,0xf); \
+  const __m256d asw = _mm256_permute_pd(va,0x5); \
+  out = _mm256_add_pd(_mm256_mul_pd(va,bre),_mm256_xor_pd(_mm256_mul_pd(asw,bim),negre)); \
+}
+
+// 2 complex values per iteration, n is even
+WDL_FFT_AVX_TARGET static void complexmul2_avx(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  const __m256d negre = _mm256_set_pd(0.0,-0.0,0.0,-0.0);
+  do {
+    const __m256d va = _mm256_loadu_pd(&a->re), vb = _mm256_loadu_pd(&b->re);
+    __m256d t;
+    AVX_CPLXMUL(va,vb,t)
+    _mm256_storeu_pd(&c->re,t);
+    a += 2;
+    b += 2;
+    c += 2;
+  } while (n -= 2);
+}
+
+WDL_FFT_AVX_TARGET static void complexmul3_avx(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  const __m256d negre = _mm256_set_pd(0.0,-0.0,0.0,-0.0);
+  do {
+    const __m256d va = _mm256_loadu_pd(&a->re), vb = _mm256_loadu_pd(&b->re);
+    __m256d t;
+    AVX_CPLXMUL(va,vb,t)
+    _mm256_storeu_pd(&c->re,_mm256_add_pd(_mm256_loadu_pd(&c->re),t));
+    a += 2;
+    b += 2;
+    c += 2;
+  } while (n -= 2);
+}
+
+#undef AVX_CPLXMUL
+
+#define AVX_SPLIT_TYPE __m256d
+#define AVX_SPLIT_N 4
+#define AVX_SPLIT_LOAD _mm256_loadu_pd
+#define AVX_SPLIT_STORE _mm256_storeu_pd
+#define AVX_SPLIT_ADD _mm256_add_pd
+#define AVX_SPLIT_SUB _mm256_sub_pd
+#define AVX_SPLIT_MUL _mm256_mul_pd
+
+#endif // WDL_FFT_REALSIZE == 8
+
+WDL_FFT_AVX_TARGET static void complexmul2_split_avx(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
+{
+  const int nv = n & ~(AVX_SPLIT_N-1);
+  int i;
+  for (i = 0; i < nv; i += AVX_SPLIT_N)
+  {
+    const AVX_SPLIT_TYPE ar = AVX_SPLIT_LOAD(a+i), ai = AVX_SPLIT_LOAD(a+n+i);
+    const AVX_SPLIT_TYPE br = AVX_SPLIT_LOAD(b+i), bi = AVX_SPLIT_LOAD(b+n+i);
+    AVX_SPLIT_STORE(c+i,AVX_SPLIT_SUB(AVX_SPLIT_MUL(ar,br),AVX_SPLIT_MUL(ai,bi)));
+    AVX_SPLIT_STORE(c+n+i,AVX_SPLIT_ADD(AVX_SPLIT_MUL(ai,br),AVX_SPLIT_MUL(ar,bi)));
+  }
+  for (i = nv; i < n; i ++)
+  {
+    const WDL_FFT_REAL ar = a[i], ai = a[n+i], br = b[i], bi = b[n+i];
+    c[i] = ar*br - ai*bi;
+    c[n+i] = ai*br + ar*bi;
+  }
+}
+
+WDL_FFT_AVX_TARGET static void complexmul3_split_avx(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
+{
+  const int nv = n & ~(AVX_SPLIT_N-1);
+  int i;
+  for (i = 0; i < nv; i += AVX_SPLIT_N)
+  {
+    const AVX_SPLIT_TYPE ar = AVX_SPLIT_LOAD(a+i), ai = AVX_SPLIT_LOAD(a+n+i);
+    const AVX_SPLIT_TYPE br = AVX_SPLIT_LOAD(b+i), bi = AVX_SPLIT_LOAD(b+n+i);
+    AVX_SPLIT_STORE(c+i,AVX_SPLIT_ADD(AVX_SPLIT_LOAD(c+i),AVX_SPLIT_SUB(AVX_SPLIT_MUL(ar,br),AVX_SPLIT_MUL(ai,bi))));
+    AVX_SPLIT_STORE(c+n+i,AVX_SPLIT_ADD(AVX_SPLIT_LOAD(c+n+i),AVX_SPLIT_ADD(AVX_SPLIT_MUL(ai,br),AVX_SPLIT_MUL(ar,bi))));
+  }
+  for (i = nv; i < n; i ++)
+  {
+    const WDL_FFT_REAL ar = a[i], ai = a[n+i], br = b[i], bi = b[n+i];
+    c[i] += ar*br - ai*bi;
+    c[n+i] += ai*br + ar*bi;
+  }
+}
+
+#undef AVX_SPLIT_TYPE
+#undef AVX_SPLIT_N
+#undef AVX_SPLIT_LOAD
+#undef AVX_SPLIT_STORE
+#undef AVX_SPLIT_ADD
+#undef AVX_SPLIT_SUB
+#undef AVX_SPLIT_MUL
+
+#endif // WDL_FFT_SIMD_AVX
+
+
+#if defined(WDL_FFT_SIMD_NEON) && (WDL_FFT_REALSIZE == 4 || defined(__aarch64__))
+
+#if WDL_FFT_REALSIZE == 4
+  #define NEON_TYPE float32x4_t
+  #define NEON_TYPE2 float32x4x2_t
+  #define NEON_N 4
+  #define NEON_LD vld1q_f32
+  #define NEON_ST vst1q_f32
+  #define NEON_LD2 vld2q_f32
+  #define NEON_ST2 vst2q_f32
+  #define NEON_ADD vaddq_f32
+  #define NEON_SUB vsubq_f32
+  #define NEON_MUL vmulq_f32
+#else
+  #define NEON_TYPE float64x2_t
+  #define NEON_TYPE2 float64x2x2_t
+  #define NEON_N 2
+  #define NEON_LD vld1q_f64
+  #define NEON_ST vst1q_f64
+  #define NEON_LD2 vld2q_f64
+  #define NEON_ST2 vst2q_f64
+  #define NEON_ADD vaddq_f64
+  #define NEON_SUB vsubq_f64
+  #define NEON_MUL vmulq_f64
+#endif
+
+// vld2 deinterleaves, so these are the split versions with a scalar tail (n is even)
+static void complexmul2_neon(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  const int nv = n & ~(NEON_N-1);
+  if (nv)
+  {
+    int i;
+    for (i = 0; i < nv; i += NEON_N)
+    {
+      const NEON_TYPE2 va = NEON_LD2(&a[i].re), vb = NEON_LD2(&b[i].re);
+      NEON_TYPE2 t;
+      t.val[0] = NEON_SUB(NEON_MUL(va.val[0],vb.val[0]),NEON_MUL(va.val[1],vb.val[1]));
+      t.val[1] = NEON_ADD(NEON_MUL(va.val[1],vb.val[0]),NEON_MUL(va.val[0],vb.val[1]));
+      NEON_ST2(&c[i].re,t);
+    }
+  }
+  if (nv < n) complexmul2_c(c+nv,a+nv,b+nv,n-nv);
+}
+
+static void complexmul3_neon(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  const int nv = n & ~(NEON_N-1);
+  if (nv)
+  {
+    int i;
+    for (i = 0; i < nv; i += NEON_N)
+    {
+      const NEON_TYPE2 va = NEON_LD2(&a[i].re), vb = NEON_LD2(&b[i].re);
+      NEON_TYPE2 t = NEON_LD2(&c[i].re);
+      t.val[0] = NEON_ADD(t.val[0],NEON_SUB(NEON_MUL(va.val[0],vb.val[0]),NEON_MUL(va.val[1],vb.val[1])));
+      t.val[1] = NEON_ADD(t.val[1],NEON_ADD(NEON_MUL(va.val[1],vb.val[0]),NEON_MUL(va.val[0],vb.val[1])));
+      NEON_ST2(&c[i].re,t);
+    }
+  }
+  if (nv < n) complexmul3_c(c+nv,a+nv,b+nv,n-nv);
+}
+
+static void complexmul2_split_neon(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
+{
+  const int nv = n & ~(NEON_N-1);
+  int i;
+  for (i = 0; i < nv; i += NEON_N)
+  {
+    const NEON_TYPE ar = NEON_LD(a+i), ai = NEON_LD(a+n+i);
+    const NEON_TYPE br = NEON_LD(b+i), bi = NEON_LD(b+n+i);
+    NEON_ST(c+i,NEON_SUB(NEON_MUL(ar,br),NEON_MUL(ai,bi)));
+    NEON_ST(c+n+i,NEON_ADD(NEON_MUL(ai,br),NEON_MUL(ar,bi)));
+  }
+  for (i = nv; i < n; i ++)
+  {
+    const WDL_FFT_REAL ar = a[i], ai = a[n+i], br = b[i], bi = b[n+i];
+    c[i] = ar*br - ai*bi;
+    c[n+i] = ai*br + ar*bi;
+  }
+}
+
+static void complexmul3_split_neon(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
+{
+  const int nv = n & ~(NEON_N-1);
+  int i;
+  for (i = 0; i < nv; i += NEON_N)
+  {
+    const NEON_TYPE ar = NEON_LD(a+i), ai = NEON_LD(a+n+i);
+    const NEON_TYPE br = NEON_LD(b+i), bi = NEON_LD(b+n+i);
+    NEON_ST(c+i,NEON_ADD(NEON_LD(c+i),NEON_SUB(NEON_MUL(ar,br),NEON_MUL(ai,bi))));
+    NEON_ST(c+n+i,NEON_ADD(NEON_LD(c+n+i),NEON_ADD(NEON_MUL(ai,br),NEON_MUL(ar,bi))));
+  }
+  for (i = nv; i < n; i ++)
+  {
+    const WDL_FFT_REAL ar = a[i], ai = a[n+i], br = b[i], bi = b[n+i];
+    c[i] += ar*br - ai*bi;
+    c[n+i] += ai*br + ar*bi;
+  }
+}
+
+#undef NEON_TYPE
+#undef NEON_TYPE2
+#undef NEON_N
+#undef NEON_LD
+#undef NEON_ST
+#undef NEON_LD2
+#undef NEON_ST2
+#undef NEON_ADD
+#undef NEON_SUB
+#undef NEON_MUL
+
+#define WDL_FFT_NEON_KERNELS
+
+#endif // WDL_FFT_SIMD_NEON
+
+
+static void (*s_complexmul2)(WDL_FFT_COMPLEX *, WDL_FFT_COMPLEX *, WDL_FFT_COMPLEX *, int) = complexmul2_c;
+static void (*s_complexmul3)(WDL_FFT_COMPLEX *, WDL_FFT_COMPLEX *, WDL_FFT_COMPLEX *, int) = complexmul3_c;
+static void (*s_complexmul2_split)(WDL_FFT_REAL *, WDL_FFT_REAL *, WDL_FFT_REAL *, int) = complexmul2_split_c;
+static void (*s_complexmul3_split)(WDL_FFT_REAL *, WDL_FFT_REAL *, WDL_FFT_REAL *, int) = complexmul3_split_c;
+
+#if defined(WDL_FFT_SIMD_SSE2) || defined(WDL_FFT_SIMD_AVX)
+static void cpu_features(int *has_sse2, int *has_avx)
+{
+  unsigned int xcr0 = 0;
+#ifdef _MSC_VER
+  int info[4];
+  __cpuid(info,1);
+  *has_sse2 = !!(info[3] & (1<<26));
+  *has_avx = (info[2] & (1<<27)) && (info[2] & (1<<28)); // OSXSAVE, AVX
+#if _MSC_VER >= 1600
+  if (*has_avx) xcr0 = (unsigned int)_xgetbv(0);
+#endif
+#else
+  unsigned int a, b, c, d;
+  if (!__get_cpuid(1,&a,&b,&c,&d)) { *has_sse2 = *has_avx = 0; return; }
+  *has_sse2 = !!(d & (1<<26));
+  *has_avx = (c & (1<<27)) && (c & (1<<28)); // OSXSAVE, AVX
+  if (*has_avx) __asm__ __volatile__ (".byte 0x0f, 0x01, 0xd0" : "=a"(a), "=d"(d) : "c"(0)); // xgetbv
+  xcr0 = a;
+#endif
+  if ((xcr0 & 6) != 6) *has_avx = 0; // OS must save XMM and YMM state
+}
+#endif
+
+static void complexmul_init()
+{
+#if defined(WDL_FFT_SIMD_SSE2) || defined(WDL_FFT_SIMD_AVX)
+  int has_sse2, has_avx;
+  cpu_features(&has_sse2,&has_avx);
+#ifdef WDL_FFT_SIMD_SSE2
+  if (has_sse2)
+  {
+    s_complexmul2 = complexmul2_sse2;
+    s_complexmul3 = complexmul3_sse2;
+    s_complexmul2_split = complexmul2_split_sse2;
+    s_complexmul3_split = complexmul3_split_sse2;
+  }
+#endif
+#ifdef WDL_FFT_SIMD_AVX
+  if (has_avx)
+  {
+    s_complexmul2 = complexmul2_avx;
+    s_complexmul3 = complexmul3_avx;
+    s_complexmul2_split = complexmul2_split_avx;
+    s_complexmul3_split = complexmul3_split_avx;
+  }
+#endif
+#elif defined(WDL_FFT_NEON_KERNELS)
+  s_complexmul2 = complexmul2_neon;
+  s_complexmul3 = complexmul3_neon;
+  s_complexmul2_split = complexmul2_split_neon;
+  s_complexmul3_split = complexmul3_split_neon;
+#endif
+}
+
+void WDL_fft_complexmul(WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  if (n<2 || (n&1)) return;
+  s_complexmul2(a,a,b,n);
+}
+
+void WDL_fft_complexmul2(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  if (n<2 || (n&1)) return;
+  s_complexmul2(c,a,b,n);
+}
+
+void WDL_fft_complexmul3(WDL_FFT_COMPLEX *c, WDL_FFT_COMPLEX *a, WDL_FFT_COMPLEX *b, int n)
+{
+  if (n<2 || (n&1)) return;
+  s_complexmul3(c,a,b,n);
+}
+
+void WDL_fft_complexmul2_split(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
+{
+  if (n<1) return;
+  s_complexmul2_split(c,a,b,n);
+}
+
+void WDL_fft_complexmul3_split(WDL_FFT_REAL *c, WDL_FFT_REAL *a, WDL_FFT_REAL *b, int n)
+{
+  if (n<1) return;
+  s_complexmul3_split(c,a,b,n);
+}
+
+void WDL_fft_split(WDL_FFT_REAL *dest, WDL_FFT_COMPLEX *src, int n)
+{
+  WDL_FFT_REAL *desti = dest + n;
+  int i;
+  for (i = 0; i < n; i ++)
+  {
+    dest[i] = src[i].re;
+    desti[i] = src[i].im;
+  }
+}
+
+void WDL_fft_unsplit(WDL_FFT_COMPLEX *dest, WDL_FFT_REAL *src, int n)
+{
+  const WDL_FFT_REAL *srci = src + n;
+  int i;
+  for (i = 0; i < n; i ++)
+  {
+    dest[i].re = src[i];
+    dest[i].im = srci[i];
+  }
+}
+
+
+static inline void u4(register WDL_FFT_COMPLEX *a)
+{
+  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+
+  t1 = VOL a[1].re;
+  t3 = a[0].re - t1;
+  t6 = VOL a[2].re;
+  t1 += a[0].re;
+  t8 = a[3].re - t6;
+  t6 += a[3].re;
+  a[0].re = t1 + t6;
+  t1 -= t6;
+  a[2].re = t1;
+
+  t2 = VOL a[1].im;
+  t4 = a[0].im - t2;
+  t2 += a[0].im;
+  t5 = VOL a[3].im;
+  a[1].im = t4 + t8;
+  t4 -= t8;
+  a[3].im = t4;
+
+  t7 = a[2].im - t5;
+  t5 += a[2].im;
+  a[1].re = t3 + t7;
+  t3 -= t7;
+  a[3].re = t3;
+  a[0].im = t2 + t5;
+  t2 -= t5;
+  a[2].im = t2;
+}
+
+static void u8(register WDL_FFT_COMPLEX *a)
+{
+  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+
+  u4(a);
+
+  t1 = a[5].re;
+  a[5].re = a[4].re - t1;
+  t1 += a[4].re;
+
+  t3 = a[7].re;
+  a[7].re = a[6].re - t3;
+  t3 += a[6].re;
+
+  t8 = t3 - t1;
+  t1 += t3;
+
+  t6 = a[2].im - t8;
+  t8 += a[2].im;
+  a[2].im = t8;
+
+  t5 = a[0].re - t1;
+  a[4].re = t5;
+  t1 += a[0].re;
+  a[0].re = t1;
+
+  t2 = a[5].im;
+  a[5].im = a[4].im - t2;
+  t2 += a[4].im;
+
+  t4 = a[7].im;
+  a[7].im = a[6].im - t4;
+  t4 += a[6].im;
+
+  a[6].im = t6;
+
+  t7 = t2 - t4;
+  t2 += t4;
+
+  t3 = a[2].re - t7;
+  a[6].re = t3;
+  t7 += a[2].re;
+  a[2].re = t7;
+
+  t6 = a[0].im - t2;
+  a[4].im = t6;
+  t2 += a[0].im;
+  a[0].im = t2;
+
+  t6 = sqrthalf;
+
+  t1 = a[5].re;
+  t2 = a[5].im - t1;
+  t2 *= t6;
+  t1 += a[5].im;
+  t1 *= t6;
+  t4 = a[7].im;
+  t3 = a[7].re - t4;
+  t3 *= t6;
+  t4 += a[7].re;
+  t4 *= t6;
+
+  t8 = t3 - t1;
+  t1 += t3;
+  t7 = t2 - t4;
+  t2 += t4;
+
+  t4 = a[3].im - t8;
+  a[7].im = t4;
+  t5 = a[1].re - t1;
+  a[5].re = t5;
+  t3 = a[3].re - t7;
+  a[7].re = t3;
+  t6 = a[1].im - t2;
+  a[5].im = t6;
+
+  t8 += a[3].im;
+  a[3].im = t8;
+  t1 += a[1].re;
+  a[1].re = t1;
+  t7 += a[3].re;
+  a[3].re = t7;
+  t2 += a[1].im;
+  a[1].im = t2;
+}
+
+static void u16(register WDL_FFT_COMPLEX *a)
+{
+  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+
+  u8(a);
+  u4(a + 8);
+  u4(a + 12);
+
+  UNTRANSFORMZERO(a[0],a[4],a[8],a[12]);
+  UNTRANSFORMHALF(a[2],a[6],a[10],a[14]);
+  UNTRANSFORM(a[1],a[5],a[9],a[13],d16[0].re,d16[0].im);
+  UNTRANSFORM(a[3],a[7],a[11],a[15],d16[0].im,d16[0].re);
+}
+
+/* a[0...8n-1], w[0...2n-2] */
+static void upass(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX *w,register unsigned int n)
+{
+  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  register WDL_FFT_COMPLEX *a1;
+  register WDL_FFT_COMPLEX *a2;
+  register WDL_FFT_COMPLEX *a3;
+
+  a2 = a + 4 * n;
+  a1 = a + 2 * n;
+  a3 = a2 + 2 * n;
+  n -= 1;
+
+  UNTRANSFORMZERO(a[0],a1[0],a2[0],a3[0]);
+  UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].re,w[0].im);
+
+  for (;;) {
+    UNTRANSFORM(a[2],a1[2],a2[2],a3[2],w[1].re,w[1].im);
+    UNTRANSFORM(a[3],a1[3],a2[3],a3[3],w[2].re,w[2].im);
+    if (!--n) break;
+    a += 2;
+    a1 += 2;
+    a2 += 2;
+    a3 += 2;
+    w += 2;
+  }
+}
+static void (*s_upass)(WDL_FFT_COMPLEX *, const WDL_FFT_COMPLEX *, unsigned int) = upass;
+
+static void u32(register WDL_FFT_COMPLEX *a)
+{
+  u16(a);
+  u8(a + 16);
+  u8(a + 24);
+  s_upass(a,d32,4);
+}
+
+static void u64(register WDL_FFT_COMPLEX *a)
+{
+  u32(a);
+  u16(a + 32);
+  u16(a + 48);
+  s_upass(a,d64,8);
+}
+
+static void u128(register WDL_FFT_COMPLEX *a)
+{
+  u64(a);
+  u32(a + 64);
+  u32(a + 96);
+  s_upass(a,d128,16);
+}
+
+static void u256(register WDL_FFT_COMPLEX *a)
+{
+  u128(a);
+  u64(a + 128);
+  u64(a + 192);
+  s_upass(a,d256,32);
+}
+
+static void u512(register WDL_FFT_COMPLEX *a)
+{
+  u256(a);
+  u128(a + 256);
+  u128(a + 384);
+  s_upass(a,d512,64);
+}
+
+
+/* a[0...8n-1], w[0...n-2]; n even, n >= 4 */
+static void upassbig(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX *w,register unsigned int n)
+{
+  register WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  register WDL_FFT_COMPLEX *a1;
+  register WDL_FFT_COMPLEX *a2;
+  register WDL_FFT_COMPLEX *a3;
+  register unsigned int k;
+
+  a2 = a + 4 * n;
+  a1 = a + 2 * n;
+  a3 = a2 + 2 * n;
+  k = n - 2;
 
   UNTRANSFORMZERO(a[0],a1[0],a2[0],a3[0]);
   UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].re,w[0].im);
@@ -992,8 +1639,260 @@ static void upassbig(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX
   a3 += 2;
 
   do {
-    UNTRANSFORM(a[0],a1[0],a2[0],a3[0],w[1].re,w[1].im);
-    UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[2].re,w[2].im);
+    UNTRANSFORM(a[0],a1[0],a2[0],a3[0],w[1].re,w[1].im);
+    UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[2].re,w[2].im);
+    a += 2;
+    a1 += 2;
+    a2 += 2;
+    a3 += 2;
+    w += 2;
+  } while (k -= 2);
+
+  UNTRANSFORMHALF(a[0],a1[0],a2[0],a3[0]);
+  UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].im,w[0].re);
+  a += 2;
+  a1 += 2;
+  a2 += 2;
+  a3 += 2;
+
+  k = n - 2;
+  do {
+    UNTRANSFORM(a[0],a1[0],a2[0],a3[0],w[-1].im,w[-1].re);
+    UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[-2].im,w[-2].re);
+    a += 2;
+    a1 += 2;
+    a2 += 2;
+    a3 += 2;
+    w -= 2;
+  } while (k -= 2);
+}
+static void (*s_upassbig)(WDL_FFT_COMPLEX *, const WDL_FFT_COMPLEX *, unsigned int) = upassbig;
+
+
+
+static void u1024(register WDL_FFT_COMPLEX *a)
+{
+  u512(a);
+  u256(a + 512);
+  u256(a + 768);
+  s_upassbig(a,d1024,128);
+}
+
+static void u2048(register WDL_FFT_COMPLEX *a)
+{
+  u1024(a);
+  u512(a + 1024);
+  u512(a + 1536);
+  s_upassbig(a,d2048,256);
+}
+
+
+static void u4096(register WDL_FFT_COMPLEX *a)
+{
+  u2048(a);
+  u1024(a + 2048);
+  u1024(a + 3072);
+  s_upassbig(a,d4096,512);
+}
+
+static void u8192(register WDL_FFT_COMPLEX *a)
+{
+  u4096(a);
+  u2048(a + 4096);
+  u2048(a + 6144);
+  s_upassbig(a,d8192,1024);
+}
+
+static void u16384(register WDL_FFT_COMPLEX *a)
+{
+  u8192(a);
+  u4096(a + 8192);
+  u4096(a + 8192 + 4096);
+  s_upassbig(a,d16384,2048);
+}
+
+static void u32768(register WDL_FFT_COMPLEX *a)
+{
+  u16384(a);
+  u8192(a + 16384);
+  u8192(a + 16384  + 8192 );
+  s_upassbig(a,d32768,4096);
+}
+
+#if FFT_MAXBITLEN >= 16
+static void u65536(register WDL_FFT_COMPLEX *a)
+{
+  u32768(a);
+  u16384(a + 32768);
+  u16384(a + 32768 + 16384);
+  s_upassbig(a,d65536,8192);
+}
+#endif
+
+#if FFT_MAXBITLEN >= 17
+static void u131072(register WDL_FFT_COMPLEX *a)
+{
+  u65536(a);
+  u32768(a + 65536);
+  u32768(a + 65536 + 32768);
+  s_upassbig(a,d131072,16384);
+}
+#endif
+
+
+#ifdef WDL_FFT_SIMD_SSE2
+
+/*
+  SSE2 versions of cpass/cpassbig/upass/upassbig. The butterflies work on interleaved complex
+  values using the same operations as TRANSFORM/UNTRANSFORM (a*w is computed as re*wre and
+  swap(re,im)*wim, combined per lane), so the results are bit-identical to the scalar passes.
+  The zero/half twiddle butterflies are left to the scalar macros.
+*/
+
+#if WDL_FFT_REALSIZE == 4
+
+#define FP_T __m128
+#define FP_LD(p) _mm_loadu_ps((const float *)(p))
+#define FP_ST(p,v) _mm_storeu_ps((float *)(p),v)
+#define FP_ADD _mm_add_ps
+#define FP_SUB _mm_sub_ps
+#define FP_MUL _mm_mul_ps
+#define FP_SWAP(v) _mm_shuffle_ps(v,v,_MM_SHUFFLE(2,3,0,1))
+#define FP_BLEND(re,im) _mm_or_ps(_mm_and_ps(m,re),_mm_andnot_ps(m,im))
+#define FP_MASK _mm_castsi128_ps(_mm_set_epi32(0,-1,0,-1))
+
+// a[0..1] with w[0..1]
+#define FP_TW2(w,BFLY,a0,a1,a2,a3) { \
+  const FP_T W_ = FP_LD(w); \
+  wr = _mm_shuffle_ps(W_,W_,_MM_SHUFFLE(2,2,0,0)); \
+  wi = _mm_shuffle_ps(W_,W_,_MM_SHUFFLE(3,3,1,1)); \
+  BFLY(a0,a1,a2,a3); \
+}
+// a[0..1] with w[0],w[-1], re/im swapped
+#define FP_TW2REV(w,BFLY,a0,a1,a2,a3) { \
+  const FP_T W_ = FP_LD((w)-1); \
+  wr = _mm_shuffle_ps(W_,W_,_MM_SHUFFLE(1,1,3,3)); \
+  wi = _mm_shuffle_ps(W_,W_,_MM_SHUFFLE(0,0,2,2)); \
+  BFLY(a0,a1,a2,a3); \
+}
+
+#else // WDL_FFT_REALSIZE == 8
+
+#define FP_T __m128d
+#define FP_LD(p) _mm_loadu_pd((const double *)(p))
+#define FP_ST(p,v) _mm_storeu_pd((double *)(p),v)
+#define FP_ADD _mm_add_pd
+#define FP_SUB _mm_sub_pd
+#define FP_MUL _mm_mul_pd
+#define FP_SWAP(v) _mm_shuffle_pd(v,v,1)
+#define FP_BLEND(re,im) _mm_or_pd(_mm_and_pd(m,re),_mm_andnot_pd(m,im))
+#define FP_MASK _mm_castsi128_pd(_mm_set_epi32(0,0,-1,-1))
+
+#define FP_TW2(w,BFLY,a0,a1,a2,a3) { \
+  FP_T W_ = FP_LD(w); \
+  wr = _mm_unpacklo_pd(W_,W_); \
+  wi = _mm_unpackhi_pd(W_,W_); \
+  BFLY(a0,a1,a2,a3); \
+  W_ = FP_LD((w)+1); \
+  wr = _mm_unpacklo_pd(W_,W_); \
+  wi = _mm_unpackhi_pd(W_,W_); \
+  BFLY((a0)+1,(a1)+1,(a2)+1,(a3)+1); \
+}
+#define FP_TW2REV(w,BFLY,a0,a1,a2,a3) { \
+  FP_T W_ = FP_LD(w); \
+  wr = _mm_unpackhi_pd(W_,W_); \
+  wi = _mm_unpacklo_pd(W_,W_); \
+  BFLY(a0,a1,a2,a3); \
+  W_ = FP_LD((w)-1); \
+  wr = _mm_unpackhi_pd(W_,W_); \
+  wi = _mm_unpacklo_pd(W_,W_); \
+  BFLY((a0)+1,(a1)+1,(a2)+1,(a3)+1); \
+}
+
+#endif
+
+// see TRANSFORM: a2 = (d02 + i*d13) * w, a3 = (d02 - i*d13) * conj(w)
+#define FP_TRANSFORM(a0,a1,a2,a3) { \
+  const FP_T v0 = FP_LD(a0), v1 = FP_LD(a1), v2 = FP_LD(a2), v3 = FP_LD(a3); \
+  const FP_T d02 = FP_SUB(v0,v2), d13 = FP_SWAP(FP_SUB(v1,v3)); \
+  const FP_T vp = FP_ADD(d02,d13), vm = FP_SUB(d02,d13); \
+  const FP_T x = FP_BLEND(vm,vp), y = FP_BLEND(vp,vm); \
+  FP_T t1, t2; \
+  FP_ST(a0,FP_ADD(v0,v2)); \
+  FP_ST(a1,FP_ADD(v1,v3)); \
+  t1 = FP_MUL(x,wr); \
+  t2 = FP_MUL(FP_SWAP(x),wi); \
+  FP_ST(a2,FP_BLEND(FP_SUB(t1,t2),FP_ADD(t1,t2))); \
+  t1 = FP_MUL(y,wr); \
+  t2 = FP_MUL(FP_SWAP(y),wi); \
+  FP_ST(a3,FP_BLEND(FP_ADD(t1,t2),FP_SUB(t1,t2))); \
+}
+
+// see UNTRANSFORM: p = a2 * conj(w), q = a3 * w
+#define FP_UNTRANSFORM(a0,a1,a2,a3) { \
+  const FP_T v0 = FP_LD(a0), v1 = FP_LD(a1), v2 = FP_LD(a2), v3 = FP_LD(a3); \
+  FP_T t1 = FP_MUL(v2,wr), t2 = FP_MUL(FP_SWAP(v2),wi); \
+  const FP_T p = FP_BLEND(FP_ADD(t1,t2),FP_SUB(t1,t2)); \
+  FP_T q, s, e; \
+  t1 = FP_MUL(v3,wr); \
+  t2 = FP_MUL(FP_SWAP(v3),wi); \
+  q = FP_BLEND(FP_SUB(t1,t2),FP_ADD(t1,t2)); \
+  s = FP_ADD(p,q); \
+  e = FP_BLEND(FP_SWAP(FP_SUB(p,q)),FP_SWAP(FP_SUB(q,p))); \
+  FP_ST(a0,FP_ADD(v0,s)); \
+  FP_ST(a2,FP_SUB(v0,s)); \
+  FP_ST(a1,FP_ADD(v1,e)); \
+  FP_ST(a3,FP_SUB(v1,e)); \
+}
+
+WDL_FFT_SSE2_TARGET static void cpass_sse2(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n)
+{
+  WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  WDL_FFT_COMPLEX *a1, *a2, *a3;
+  const FP_T m = FP_MASK;
+  FP_T wr, wi;
+
+  a2 = a + 4 * n;
+  a1 = a + 2 * n;
+  a3 = a2 + 2 * n;
+  --n;
+
+  TRANSFORMZERO(a[0],a1[0],a2[0],a3[0]);
+  TRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].re,w[0].im);
+
+  for (;;) {
+    FP_TW2(w+1,FP_TRANSFORM,a+2,a1+2,a2+2,a3+2)
+    if (!--n) break;
+    a += 2;
+    a1 += 2;
+    a2 += 2;
+    a3 += 2;
+    w += 2;
+  }
+}
+
+WDL_FFT_SSE2_TARGET static void cpassbig_sse2(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n)
+{
+  WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  WDL_FFT_COMPLEX *a1, *a2, *a3;
+  unsigned int k;
+  const FP_T m = FP_MASK;
+  FP_T wr, wi;
+
+  a2 = a + 4 * n;
+  a1 = a + 2 * n;
+  a3 = a2 + 2 * n;
+  k = n - 2;
+
+  TRANSFORMZERO(a[0],a1[0],a2[0],a3[0]);
+  TRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].re,w[0].im);
+  a += 2;
+  a1 += 2;
+  a2 += 2;
+  a3 += 2;
+
+  do {
+    FP_TW2(w+1,FP_TRANSFORM,a,a1,a2,a3)
     a += 2;
     a1 += 2;
     a2 += 2;
@@ -1001,8 +1900,8 @@ static void upassbig(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX
     w += 2;
   } while (k -= 2);
 
-  UNTRANSFORMHALF(a[0],a1[0],a2[0],a3[0]);
-  UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].im,w[0].re);
+  TRANSFORMHALF(a[0],a1[0],a2[0],a3[0]);
+  TRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].im,w[0].re);
   a += 2;
   a1 += 2;
   a2 += 2;
@@ -1010,8 +1909,7 @@ static void upassbig(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX
 
   k = n - 2;
   do {
-    UNTRANSFORM(a[0],a1[0],a2[0],a3[0],w[-1].im,w[-1].re);
-    UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[-2].im,w[-2].re);
+    FP_TW2REV(w-1,FP_TRANSFORM,a,a1,a2,a3)
     a += 2;
     a1 += 2;
     a2 += 2;
@@ -1020,55 +1918,108 @@ static void upassbig(register WDL_FFT_COMPLEX *a,register const WDL_FFT_COMPLEX
   } while (k -= 2);
 }
 
+WDL_FFT_SSE2_TARGET static void upass_sse2(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n)
+{
+  WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  WDL_FFT_COMPLEX *a1, *a2, *a3;
+  const FP_T m = FP_MASK;
+  FP_T wr, wi;
+
+  a2 = a + 4 * n;
+  a1 = a + 2 * n;
+  a3 = a2 + 2 * n;
+  n -= 1;
 
+  UNTRANSFORMZERO(a[0],a1[0],a2[0],a3[0]);
+  UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].re,w[0].im);
 
-static void u1024(register WDL_FFT_COMPLEX *a)
-{
-  u512(a);
-  u256(a + 512);
-  u256(a + 768);
-  upassbig(a,d1024,128);
+  for (;;) {
+    FP_TW2(w+1,FP_UNTRANSFORM,a+2,a1+2,a2+2,a3+2)
+    if (!--n) break;
+    a += 2;
+    a1 += 2;
+    a2 += 2;
+    a3 += 2;
+    w += 2;
+  }
 }
 
-static void u2048(register WDL_FFT_COMPLEX *a)
+WDL_FFT_SSE2_TARGET static void upassbig_sse2(WDL_FFT_COMPLEX *a, const WDL_FFT_COMPLEX *w, unsigned int n)
 {
-  u1024(a);
-  u512(a + 1024);
-  u512(a + 1536);
-  upassbig(a,d2048,256);
-}
+  WDL_FFT_REAL t1, t2, t3, t4, t5, t6, t7, t8;
+  WDL_FFT_COMPLEX *a1, *a2, *a3;
+  unsigned int k;
+  const FP_T m = FP_MASK;
+  FP_T wr, wi;
 
+  a2 = a + 4 * n;
+  a1 = a + 2 * n;
+  a3 = a2 + 2 * n;
+  k = n - 2;
 
-static void u4096(register WDL_FFT_COMPLEX *a)
-{
-  u2048(a);
-  u1024(a + 2048);
-  u1024(a + 3072);
-  upassbig(a,d4096,512);
-}
+  UNTRANSFORMZERO(a[0],a1[0],a2[0],a3[0]);
+  UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].re,w[0].im);
+  a += 2;
+  a1 += 2;
+  a2 += 2;
+  a3 += 2;
 
-static void u8192(register WDL_FFT_COMPLEX *a)
-{
-  u4096(a);
-  u2048(a + 4096);
-  u2048(a + 6144);
-  upassbig(a,d8192,1024);
-}
+  do {
+    FP_TW2(w+1,FP_UNTRANSFORM,a,a1,a2,a3)
+    a += 2;
+    a1 += 2;
+    a2 += 2;
+    a3 += 2;
+    w += 2;
+  } while (k -= 2);
 
-static void u16384(register WDL_FFT_COMPLEX *a)
-{
-  u8192(a);
-  u4096(a + 8192);
-  u4096(a + 8192 + 4096);
-  upassbig(a,d16384,2048);
+  UNTRANSFORMHALF(a[0],a1[0],a2[0],a3[0]);
+  UNTRANSFORM(a[1],a1[1],a2[1],a3[1],w[0].im,w[0].re);
+  a += 2;
+  a1 += 2;
+  a2 += 2;
+  a3 += 2;
+
+  k = n - 2;
+  do {
+    FP_TW2REV(w-1,FP_UNTRANSFORM,a,a1,a2,a3)
+    a += 2;
+    a1 += 2;
+    a2 += 2;
+    a3 += 2;
+    w -= 2;
+  } while (k -= 2);
 }
 
-static void u32768(register WDL_FFT_COMPLEX *a)
-{
-  u16384(a);
-  u8192(a + 16384);
-  u8192(a + 16384  + 8192 );
-  upassbig(a,d32768,4096);
+#undef FP_T
+#undef FP_LD
+#undef FP_ST
+#undef FP_ADD
+#undef FP_SUB
+#undef FP_MUL
+#undef FP_SWAP
+#undef FP_BLEND
+#undef FP_MASK
+#undef FP_TW2
+#undef FP_TW2REV
+#undef FP_TRANSFORM
+#undef FP_UNTRANSFORM
+
+#endif // WDL_FFT_SIMD_SSE2
+
+static void fftpass_init()
+{
+#ifdef WDL_FFT_SIMD_SSE2
+  int has_sse2, has_avx;
+  cpu_features(&has_sse2,&has_avx);
+  if (has_sse2)
+  {
+    s_cpass = cpass_sse2;
+    s_cpassbig = cpassbig_sse2;
+    s_upass = upass_sse2;
+    s_upassbig = upassbig_sse2;
+  }
+#endif
 }
 
 
@@ -1116,18 +2067,565 @@ static void idx_perm_calc(int offs, int n)
 	}
 }
 
+static const int *mixed_permute_tab(int n);
+
 int WDL_fft_permute(int fftsize, int idx)
 {
+  if (fftsize & (fftsize-1))
+  {
+    const int *tab = mixed_permute_tab(fftsize);
+    return tab ? tab[idx] : idx;
+  }
   return _idxperm[fftsize+idx-2];
 }
 int *WDL_fft_permute_tab(int fftsize)
 {
+  if (fftsize & (fftsize-1)) return (int *)mixed_permute_tab(fftsize);
   return _idxperm + fftsize - 2;
 }
 
 
 #endif
 
+/*
+  Mixed radix (2, 3, 4, 5) transforms for sizes that are not powers of two. The forward transform is
+  decimation in frequency, leaving the output in digit-reversed order, and the inverse is the
+  exact reverse (decimation in time from digit-reversed input), so as with the power of two sizes
+  no reordering pass is needed and WDL_fft_permute_tab() describes where each bin ends up.
+  Twiddle and permutation tables are built (and kept) by WDL_fft_prepare() or WDL_fft_permute_tab(),
+  or failing that, the first time a size is used. The same plans (power of two sizes included) are
+  used by WDL_fft_batch().
+
+  Plans are kept in a list that only grows: a plan is complete before it is published as the list
+  head (with a barrier), so lookups don't lock. Building one takes a spin lock, so that two threads
+  never build at once. Unsupported sizes get a plan without tables, so they are only checked once.
+*/
+
+#ifdef _WIN32
+  #include <windows.h>
+  #define MIXED_BARRIER() MemoryBarrier()
+  #define MIXED_YIELD() Sleep(0)
+  static volatile LONG s_mixed_lock;
+  #define MIXED_TRYLOCK() (!InterlockedExchange(&s_mixed_lock,1))
+  #define MIXED_UNLOCK() InterlockedExchange(&s_mixed_lock,0)
+#else
+  #include <sched.h>
+  #define MIXED_BARRIER() __sync_synchronize()
+  #define MIXED_YIELD() sched_yield()
+  static volatile int s_mixed_lock;
+  #define MIXED_TRYLOCK() (!__sync_lock_test_and_set(&s_mixed_lock,1))
+  #define MIXED_UNLOCK() __sync_lock_release(&s_mixed_lock)
+#endif
+
+#define MIXED_MAXRADIX 32
+
+typedef struct mixed_plan
+{
+  int n, nradix;
+  int radix[MIXED_MAXRADIX];
+  WDL_FFT_COMPLEX *tw; // e^(-2*pi*i*k/n), NULL if n is not supported
+  int *perm;
+  int *cycles; // power of two sizes: moves from digit-reversed to WDL_fft() order, as (length, positions...) runs
+  int cycles_len;
+  struct mixed_plan *next;
+} mixed_plan;
+
+static mixed_plan *s_mixed; // only written with s_mixed_lock held
+
+static const mixed_plan *mixed_findplan(int n)
+{
+  const mixed_plan *p = *(mixed_plan * volatile *)&s_mixed;
+  MIXED_BARRIER(); // see mixed_buildplan()
+  while (p && p->n != n) p = p->next;
+  return p;
+}
+
+// with s_mixed_lock held
+static const mixed_plan *mixed_buildplan(int n)
+{
+  mixed_plan *p;
+  int x, r, len;
+
+  p = (mixed_plan *)calloc(1,sizeof(mixed_plan));
+  if (!p) return NULL;
+  p->n = n;
+
+  len = n;
+  while (len > 1 && p->nradix < MIXED_MAXRADIX)
+  {
+    if (!(len&3)) r=4;
+    else if (!(len&1)) r=2;
+    else if (!(len%3)) r=3;
+    else if (!(len%5)) r=5;
+    else break;
+    p->radix[p->nradix++] = r;
+    len /= r;
+  }
+  if (len != 1) goto publish; // unsupported
+
+  p->tw = (WDL_FFT_COMPLEX *)malloc(n * sizeof(WDL_FFT_COMPLEX));
+  p->perm = (int *)malloc(n * sizeof(int));
+  if (!p->tw || !p->perm)
+  {
+    free(p->tw);
+    free(p->perm);
+    free(p);
+    return NULL;
+  }
+
+  for (x = 0; x < n; x ++)
+  {
+    p->tw[x].re = (WDL_FFT_REAL) cos(2.0*PI*x/n);
+    p->tw[x].im = (WDL_FFT_REAL) -sin(2.0*PI*x/n);
+  }
+  for (x = 0; x < n; x ++)
+  {
+    // bin x = k0 + r0*(k1 + r1*(k2 + ...)), k0 selects the block of size n/r0 after the first stage, etc
+    int k = x, pos = 0, m = n, i;
+    for (i = 0; i < p->nradix; i ++)
+    {
+      m /= p->radix[i];
+      pos += (k % p->radix[i]) * m;
+      k /= p->radix[i];
+    }
+    p->perm[x] = pos;
+  }
+
+#ifndef WDL_FFT_NO_PERMUTE
+  if (!(n & (n-1)))
+  {
+    // digit-reversed position perm[k] moves to WDL_fft_permute_tab(n)[k]
+    const int *wdlperm = _idxperm + n - 2;
+    int *dest = (int *)malloc(n * sizeof(int));
+    int *cyc = (int *)malloc(2 * n * sizeof(int));
+    if (!dest || !cyc)
+    {
+      free(dest);
+      free(cyc);
+      free(p->tw);
+      free(p->perm);
+      free(p);
+      return NULL;
+    }
+    for (x = 0; x < n; x ++) dest[p->perm[x]] = wdlperm[x];
+    for (x = 0; x < n; x ++)
+    {
+      int i = x, cnt = 0;
+      if (dest[x] < 0 || dest[x] == x) continue;
+      while (dest[i] >= 0)
+      {
+        const int nx = dest[i];
+        cyc[p->cycles_len + 1 + cnt++] = i;
+        dest[i] = -1;
+        i = nx;
+      }
+      cyc[p->cycles_len] = cnt;
+      p->cycles_len += cnt + 1;
+    }
+    free(dest);
+    p->cycles = cyc;
+  }
+#endif
+
+publish:
+  p->next = s_mixed;
+  MIXED_BARRIER(); // the tables are complete before the plan is visible
+  *(mixed_plan * volatile *)&s_mixed = p;
+  return p;
+}
+
+// builds (allocating) the plan for n if there is none, NULL if n is not supported
+static const mixed_plan *mixed_getplan(int n)
+{
+  const mixed_plan *p = mixed_findplan(n);
+  if (!p && n >= 2 && n <= (1<<FFT_MAXBITLEN))
+  {
+    while (!MIXED_TRYLOCK()) MIXED_YIELD();
+    p = mixed_findplan(n); // another thread may have built it
+    if (!p) p = mixed_buildplan(n);
+    MIXED_UNLOCK();
+  }
+  return p && p->tw ? p : NULL;
+}
+
+int WDL_fft_prepare(int len)
+{
+  return mixed_getplan(len) != NULL;
+}
+
+static const int *mixed_permute_tab(int n)
+{
+  const mixed_plan *p = mixed_getplan(n);
+  return p ? p->perm : NULL;
+}
+
+#define CMUL(o,a,w) { WDL_FFT_REAL tr_ = (a).re * (w).re - (a).im * (w).im; (o).im = (a).re * (w).im + (a).im * (w).re; (o).re = tr_; }
+#define CMULC(o,a,w) { WDL_FFT_REAL tr_ = (a).re * (w).re + (a).im * (w).im; (o).im = (a).im * (w).re - (a).re * (w).im; (o).re = tr_; }
+
+// r-point DFT of a[0], a[m], ..., a[(r-1)*m] in place, sign<0 forward
+static inline void mixed_butterfly(WDL_FFT_COMPLEX *a, int m, int r, int sign)
+{
+  const WDL_FFT_REAL s = sign < 0 ? (WDL_FFT_REAL)1.0 : (WDL_FFT_REAL)-1.0; // multiplies -i
+  WDL_FFT_COMPLEX x0 = a[0], x1 = a[m];
+  if (r == 2)
+  {
+    a[0].re = x0.re + x1.re; a[0].im = x0.im + x1.im;
+    a[m].re = x0.re - x1.re; a[m].im = x0.im - x1.im;
+  }
+  else if (r == 4)
+  {
+    const WDL_FFT_COMPLEX x2 = a[2*m], x3 = a[3*m];
+    const WDL_FFT_REAL s0r = x0.re + x2.re, s0i = x0.im + x2.im, d0r = x0.re - x2.re, d0i = x0.im - x2.im;
+    const WDL_FFT_REAL s1r = x1.re + x3.re, s1i = x1.im + x3.im, d1r = (x1.re - x3.re) * s, d1i = (x1.im - x3.im) * s;
+    a[0].re = s0r + s1r; a[0].im = s0i + s1i;
+    a[2*m].re = s0r - s1r; a[2*m].im = s0i - s1i;
+    a[m].re = d0r + d1i; a[m].im = d0i - d1r; // d0 - i*d1
+    a[3*m].re = d0r - d1i; a[3*m].im = d0i + d1r;
+  }
+  else if (r == 3)
+  {
+    const WDL_FFT_REAL c1 = (WDL_FFT_REAL)-0.5, s1 = (WDL_FFT_REAL)(0.86602540378443864676 * s);
+    const WDL_FFT_COMPLEX x2 = a[2*m];
+    const WDL_FFT_REAL tr = x1.re + x2.re, ti = x1.im + x2.im;
+    const WDL_FFT_REAL mr = x0.re + c1 * tr, mi = x0.im + c1 * ti;
+    const WDL_FFT_REAL nr = s1 * (x1.re - x2.re), ni = s1 * (x1.im - x2.im);
+    a[0].re = x0.re + tr; a[0].im = x0.im + ti;
+    a[m].re = mr + ni; a[m].im = mi - nr; // m - i*n
+    a[2*m].re = mr - ni; a[2*m].im = mi + nr;
+  }
+  else // r == 5
+  {
+    const WDL_FFT_REAL c1 = (WDL_FFT_REAL)0.30901699437494742410, c2 = (WDL_FFT_REAL)-0.80901699437494742410;
+    const WDL_FFT_REAL s1 = (WDL_FFT_REAL)(0.95105651629515357212 * s), s2 = (WDL_FFT_REAL)(0.58778525229247312917 * s);
+    const WDL_FFT_COMPLEX x2 = a[2*m], x3 = a[3*m], x4 = a[4*m];
+    const WDL_FFT_REAL t1r = x1.re + x4.re, t1i = x1.im + x4.im, t2r = x2.re + x3.re, t2i = x2.im + x3.im;
+    const WDL_FFT_REAL t3r = x1.re - x4.re, t3i = x1.im - x4.im, t4r = x2.re - x3.re, t4i = x2.im - x3.im;
+    const WDL_FFT_REAL m1r = x0.re + c1 * t1r + c2 * t2r, m1i = x0.im + c1 * t1i + c2 * t2i;
+    const WDL_FFT_REAL m2r = x0.re + c2 * t1r + c1 * t2r, m2i = x0.im + c2 * t1i + c1 * t2i;
+    const WDL_FFT_REAL n1r = s1 * t3r + s2 * t4r, n1i = s1 * t3i + s2 * t4i;
+    const WDL_FFT_REAL n2r = s2 * t3r - s1 * t4r, n2i = s2 * t3i - s1 * t4i;
+    a[0].re = x0.re + t1r + t2r; a[0].im = x0.im + t1i + t2i;
+    a[m].re = m1r + n1i; a[m].im = m1i - n1r; // m1 - i*n1
+    a[4*m].re = m1r - n1i; a[4*m].im = m1i + n1r;
+    a[2*m].re = m2r + n2i; a[2*m].im = m2i - n2r;
+    a[3*m].re = m2r - n2i; a[3*m].im = m2i + n2r;
+  }
+}
+
+static void mixed_fft(WDL_FFT_COMPLEX *buf, int n, int isInverse)
+{
+  const mixed_plan *p = mixed_getplan(n);
+  int stage;
+  if (!p) return;
+
+  if (!isInverse)
+  {
+    int len = n;
+    for (stage = 0; stage < p->nradix; stage ++)
+    {
+      const int r = p->radix[stage], m = len / r, twstep = n / len;
+      int blk, j, q;
+      for (blk = 0; blk < n; blk += len)
+      {
+        WDL_FFT_COMPLEX *a = buf + blk;
+        for (j = 0; j < m; j ++)
+        {
+          mixed_butterfly(a + j, m, r, -1);
+          if (j) for (q = 1; q < r; q ++) CMUL(a[j+q*m],a[j+q*m],p->tw[q*j*twstep])
+        }
+      }
+      len = m;
+    }
+  }
+  else
+  {
+    int len = 1;
+    for (stage = p->nradix-1; stage >= 0; stage --)
+    {
+      const int r = p->radix[stage], m = len;
+      int blk, j, q, twstep;
+      len *= r;
+      twstep = n / len;
+      for (blk = 0; blk < n; blk += len)
+      {
+        WDL_FFT_COMPLEX *a = buf + blk;
+        for (j = 0; j < m; j ++)
+        {
+          if (j) for (q = 1; q < r; q ++) CMULC(a[j+q*m],a[j+q*m],p->tw[q*j*twstep])
+          mixed_butterfly(a + j, m, r, 1);
+        }
+      }
+    }
+  }
+}
+
+/*
+  Batched transforms: nch interleaved channels (buf[i*nch+ch]) go through the plan's stages together,
+  so each butterfly and twiddle is applied across channels (SIMD lanes) at once.
+*/
+
+static inline void batch_butterfly_c(WDL_FFT_COMPLEX *a, int m, int nch, int r, int sign)
+{
+  int c;
+  for (c = 0; c < nch; c ++) mixed_butterfly(a + c, m * nch, r, sign);
+}
+
+static inline void batch_twiddle_c(WDL_FFT_COMPLEX *a, int nch, WDL_FFT_COMPLEX w)
+{
+  int c;
+  for (c = 0; c < nch; c ++) CMUL(a[c],a[c],w)
+}
+
+// one radix-r stage over all blocks of l points, forward (DIF) or inverse (DIT, conjugate twiddles)
+static void batch_stage_c(WDL_FFT_COMPLEX *buf, int len, int nch, int l, int r, const WDL_FFT_COMPLEX *tw, int isInverse)
+{
+  const int m = l / r, twstep = len / l;
+  int blk, j, q;
+  for (blk = 0; blk < len; blk += l)
+  {
+    WDL_FFT_COMPLEX *a = buf + blk * nch;
+    if (!isInverse)
+    {
+      batch_butterfly_c(a, m, nch, r, -1);
+      for (j = 1; j < m; j ++)
+      {
+        batch_butterfly_c(a + j*nch, m, nch, r, -1);
+        for (q = 1; q < r; q ++) batch_twiddle_c(a + (j+q*m)*nch, nch, tw[q*j*twstep]);
+      }
+    }
+    else
+    {
+      batch_butterfly_c(a, m, nch, r, 1);
+      for (j = 1; j < m; j ++)
+      {
+        for (q = 1; q < r; q ++)
+        {
+          WDL_FFT_COMPLEX w = tw[q*j*twstep];
+          w.im = -w.im;
+          batch_twiddle_c(a + (j+q*m)*nch, nch, w);
+        }
+        batch_butterfly_c(a + j*nch, m, nch, r, 1);
+      }
+    }
+  }
+}
+
+#ifdef WDL_FFT_SIMD_SSE2
+
+#if WDL_FFT_REALSIZE == 4
+  #define BV_T __m128
+  #define BV_N 2
+  #define BV_LD(p) _mm_loadu_ps((const float *)(p))
+  #define BV_ST(p,v) _mm_storeu_ps((float *)(p),v)
+  #define BV_ADD _mm_add_ps
+  #define BV_SUB _mm_sub_ps
+  #define BV_MUL _mm_mul_ps
+  #define BV_SET1 _mm_set1_ps
+  #define BV_SWAP(v) _mm_shuffle_ps(v,v,_MM_SHUFFLE(2,3,0,1))
+  #define BV_NEGI(v) _mm_xor_ps(BV_SWAP(v),_mm_castsi128_ps(_mm_set_epi32(0x80000000,0,0x80000000,0))) // *-i
+  #define BV_WI(wi) _mm_set_ps(wi,-(wi),wi,-(wi))
+#else
+  #define BV_T __m128d
+  #define BV_N 1
+  #define BV_LD(p) _mm_loadu_pd((const double *)(p))
+  #define BV_ST(p,v) _mm_storeu_pd((double *)(p),v)
+  #define BV_ADD _mm_add_pd
+  #define BV_SUB _mm_sub_pd
+  #define BV_MUL _mm_mul_pd
+  #define BV_SET1 _mm_set1_pd
+  #define BV_SWAP(v) _mm_shuffle_pd(v,v,1)
+  #define BV_NEGI(v) _mm_xor_pd(BV_SWAP(v),_mm_castsi128_pd(_mm_set_epi32(0x80000000,0,0,0)))
+  #define BV_WI(wi) _mm_set_pd(wi,-(wi))
+#endif
+
+// r-point DFTs of nch channels (a[0..nch-1], a[m*nch..], ...), the same formulas as mixed_butterfly()
+WDL_FFT_SSE2_TARGET static inline void batch_butterfly_sse2(WDL_FFT_COMPLEX *a, int m, int nch, int r, int sign)
+{
+  const int st = m * nch;
+  const BV_T sg = BV_SET1(sign < 0 ? (WDL_FFT_REAL)1.0 : (WDL_FFT_REAL)-1.0); // inverse: +i as -i of the negation
+  int c;
+  for (c = 0; c + BV_N <= nch; c += BV_N)
+  {
+    WDL_FFT_COMPLEX *p = a + c;
+    const BV_T x0 = BV_LD(p), x1 = BV_LD(p+st);
+    if (r == 2)
+    {
+      BV_ST(p,BV_ADD(x0,x1));
+      BV_ST(p+st,BV_SUB(x0,x1));
+    }
+    else if (r == 4)
+    {
+      const BV_T x2 = BV_LD(p+2*st), x3 = BV_LD(p+3*st);
+      const BV_T s0 = BV_ADD(x0,x2), d0 = BV_SUB(x0,x2), s1 = BV_ADD(x1,x3);
+      const BV_T d1 = BV_NEGI(BV_MUL(BV_SUB(x1,x3),sg));
+      BV_ST(p,BV_ADD(s0,s1));
+      BV_ST(p+2*st,BV_SUB(s0,s1));
+      BV_ST(p+st,BV_ADD(d0,d1));
+      BV_ST(p+3*st,BV_SUB(d0,d1));
+    }
+    else if (r == 3)
+    {
+      const BV_T x2 = BV_LD(p+2*st);
+      const BV_T t = BV_ADD(x1,x2);
+      const BV_T mm = BV_ADD(x0,BV_MUL(t,BV_SET1((WDL_FFT_REAL)-0.5)));
+      const BV_T nn = BV_NEGI(BV_MUL(BV_SUB(x1,x2),BV_MUL(sg,BV_SET1((WDL_FFT_REAL)0.86602540378443864676))));
+      BV_ST(p,BV_ADD(x0,t));
+      BV_ST(p+st,BV_ADD(mm,nn));
+      BV_ST(p+2*st,BV_SUB(mm,nn));
+    }
+    else
+    {
+      const BV_T c1 = BV_SET1((WDL_FFT_REAL)0.30901699437494742410), c2 = BV_SET1((WDL_FFT_REAL)-0.80901699437494742410);
+      const BV_T s1 = BV_MUL(sg,BV_SET1((WDL_FFT_REAL)0.95105651629515357212)), s2 = BV_MUL(sg,BV_SET1((WDL_FFT_REAL)0.58778525229247312917));
+      const BV_T x2 = BV_LD(p+2*st), x3 = BV_LD(p+3*st), x4 = BV_LD(p+4*st);
+      const BV_T t1 = BV_ADD(x1,x4), t2 = BV_ADD(x2,x3), t3 = BV_SUB(x1,x4), t4 = BV_SUB(x2,x3);
+      const BV_T m1 = BV_ADD(BV_ADD(x0,BV_MUL(c1,t1)),BV_MUL(c2,t2));
+      const BV_T m2 = BV_ADD(BV_ADD(x0,BV_MUL(c2,t1)),BV_MUL(c1,t2));
+      const BV_T n1 = BV_NEGI(BV_ADD(BV_MUL(s1,t3),BV_MUL(s2,t4)));
+      const BV_T n2 = BV_NEGI(BV_SUB(BV_MUL(s2,t3),BV_MUL(s1,t4)));
+      BV_ST(p,BV_ADD(BV_ADD(x0,t1),t2));
+      BV_ST(p+st,BV_ADD(m1,n1));
+      BV_ST(p+4*st,BV_SUB(m1,n1));
+      BV_ST(p+2*st,BV_ADD(m2,n2));
+      BV_ST(p+3*st,BV_SUB(m2,n2));
+    }
+  }
+  for (; c < nch; c ++) mixed_butterfly(a + c, st, r, sign);
+}
+
+WDL_FFT_SSE2_TARGET static inline void batch_twiddle_sse2(WDL_FFT_COMPLEX *a, int nch, WDL_FFT_COMPLEX w)
+{
+  const BV_T wr = BV_SET1(w.re), wi = BV_WI(w.im);
+  int c;
+  for (c = 0; c + BV_N <= nch; c += BV_N)
+  {
+    const BV_T x = BV_LD(a+c);
+    BV_ST(a+c,BV_ADD(BV_MUL(x,wr),BV_MUL(BV_SWAP(x),wi)));
+  }
+  for (; c < nch; c ++) CMUL(a[c],a[c],w)
+}
+
+// one radix-r stage over all blocks of l points, forward (DIF) or inverse (DIT, conjugate twiddles)
+WDL_FFT_SSE2_TARGET static void batch_stage_sse2(WDL_FFT_COMPLEX *buf, int len, int nch, int l, int r, const WDL_FFT_COMPLEX *tw, int isInverse)
+{
+  const int m = l / r, twstep = len / l;
+  int blk, j, q;
+  for (blk = 0; blk < len; blk += l)
+  {
+    WDL_FFT_COMPLEX *a = buf + blk * nch;
+    if (!isInverse)
+    {
+      batch_butterfly_sse2(a, m, nch, r, -1);
+      for (j = 1; j < m; j ++)
+      {
+        batch_butterfly_sse2(a + j*nch, m, nch, r, -1);
+        for (q = 1; q < r; q ++) batch_twiddle_sse2(a + (j+q*m)*nch, nch, tw[q*j*twstep]);
+      }
+    }
+    else
+    {
+      batch_butterfly_sse2(a, m, nch, r, 1);
+      for (j = 1; j < m; j ++)
+      {
+        for (q = 1; q < r; q ++)
+        {
+          WDL_FFT_COMPLEX w = tw[q*j*twstep];
+          w.im = -w.im;
+          batch_twiddle_sse2(a + (j+q*m)*nch, nch, w);
+        }
+        batch_butterfly_sse2(a + j*nch, m, nch, r, 1);
+      }
+    }
+  }
+}
+
+#undef BV_T
+#undef BV_N
+#undef BV_LD
+#undef BV_ST
+#undef BV_ADD
+#undef BV_SUB
+#undef BV_MUL
+#undef BV_SET1
+#undef BV_SWAP
+#undef BV_NEGI
+#undef BV_WI
+
+#endif // WDL_FFT_SIMD_SSE2
+
+static void (*s_batch_stage)(WDL_FFT_COMPLEX *, int, int, int, int, const WDL_FFT_COMPLEX *, int) = batch_stage_c;
+
+static void batch_init()
+{
+#ifdef WDL_FFT_SIMD_SSE2
+  int has_sse2, has_avx;
+  cpu_features(&has_sse2,&has_avx);
+  if (has_sse2)
+  {
+    s_batch_stage = batch_stage_sse2;
+  }
+#endif
+}
+
+// swaps blocks of nch values along the plan's cycles, inv walks them backwards
+static void batch_reorder(WDL_FFT_COMPLEX *buf, int nch, const int *cyc, int cyclen, int inv)
+{
+  int x = 0;
+  while (x < cyclen)
+  {
+    const int cnt = cyc[x];
+    const int *list = cyc + x + 1;
+    WDL_FFT_COMPLEX *b0 = buf + list[0] * nch;
+    int i;
+    for (i = 1; i < cnt; i ++)
+    {
+      WDL_FFT_COMPLEX *b1 = buf + list[inv ? cnt-i : i] * nch;
+      int c;
+      for (c = 0; c < nch; c ++)
+      {
+        const WDL_FFT_COMPLEX t = b0[c];
+        b0[c] = b1[c];
+        b1[c] = t;
+      }
+    }
+    x += cnt + 1;
+  }
+}
+
+void WDL_fft_batch(WDL_FFT_COMPLEX *buf, int len, int nch, int isInverse)
+{
+  const mixed_plan *p;
+  int stage, l;
+
+  if (nch < 1) return;
+  if (nch == 1 || len < 2)
+  {
+    WDL_fft(buf,len,isInverse);
+    return;
+  }
+  p = mixed_getplan(len);
+  if (!p) return;
+
+  if (!isInverse)
+  {
+    for (l = len, stage = 0; stage < p->nradix; l /= p->radix[stage++])
+      s_batch_stage(buf,len,nch,l,p->radix[stage],p->tw,0);
+    if (p->cycles) batch_reorder(buf,nch,p->cycles,p->cycles_len,0);
+  }
+  else
+  {
+    if (p->cycles) batch_reorder(buf,nch,p->cycles,p->cycles_len,1);
+    for (l = 1, stage = p->nradix-1; stage >= 0; stage --)
+    {
+      l *= p->radix[stage];
+      s_batch_stage(buf,len,nch,l,p->radix[stage],p->tw,1);
+    }
+  }
+}
+
+#undef CMUL
+#undef CMULC
+
 void WDL_fft_init()
 {
   static int ffttabinit;
@@ -1136,6 +2634,10 @@ void WDL_fft_init()
     int i, offs;
   	ffttabinit=1;
 
+    complexmul_init();
+    fftpass_init();
+    batch_init();
+
 #define fft_gen(x,y) __fft_gen(x,sizeof(x)/sizeof(x[0]),y)
     fft_gen(d16,1);
     fft_gen(d32,1);
@@ -1149,11 +2651,17 @@ void WDL_fft_init()
     fft_gen(d8192,0);
     fft_gen(d16384,0);
     fft_gen(d32768,0);
+#if FFT_MAXBITLEN >= 16
+    fft_gen(d65536,0);
+#endif
+#if FFT_MAXBITLEN >= 17
+    fft_gen(d131072,0);
+#endif
 #undef fft_gen
 
 #ifndef WDL_FFT_NO_PERMUTE
 	  offs = 0;
-	  for (i = 2; i <= 32768; i *= 2) 
+	  for (i = 2; i <= (1<<FFT_MAXBITLEN); i *= 2) 
     {
 		  idx_perm_calc(offs, i);
 		  offs += i;
@@ -1183,7 +2691,16 @@ void WDL_fft(WDL_FFT_COMPLEX *buf, int len, int isInverse)
     TMP(8192)
     TMP(16384)
     TMP(32768)
+#if FFT_MAXBITLEN >= 16
+    TMP(65536)
+#endif
+#if FFT_MAXBITLEN >= 17
+    TMP(131072)
+#endif
 #undef TMP
+    default:
+      if (len > 2 && (len & (len-1))) mixed_fft(buf,len,isInverse);
+    break;
   }
 }
 
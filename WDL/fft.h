@@ -57,15 +57,37 @@ extern void WDL_fft_complexmul(WDL_FFT_COMPLEX *dest, WDL_FFT_COMPLEX *src, int
 extern void WDL_fft_complexmul2(WDL_FFT_COMPLEX *dest, WDL_FFT_COMPLEX *src, WDL_FFT_COMPLEX *src2, int len);
 extern void WDL_fft_complexmul3(WDL_FFT_COMPLEX *destAdd, WDL_FFT_COMPLEX *src, WDL_FFT_COMPLEX *src2, int len);
 
+// split (planar) layout versions: each buffer holds len real values followed by len imaginary values
+extern void WDL_fft_complexmul2_split(WDL_FFT_REAL *dest, WDL_FFT_REAL *src, WDL_FFT_REAL *src2, int len);
+extern void WDL_fft_complexmul3_split(WDL_FFT_REAL *destAdd, WDL_FFT_REAL *src, WDL_FFT_REAL *src2, int len);
+extern void WDL_fft_split(WDL_FFT_REAL *dest, WDL_FFT_COMPLEX *src, int len); // dest must not overlap src
+extern void WDL_fft_unsplit(WDL_FFT_COMPLEX *dest, WDL_FFT_REAL *src, int len);
+
+// the complexmul functions use SSE2/AVX/NEON when available (selected by WDL_fft_init(), define WDL_FFT_NO_SIMD to disable)
+
+// len can be a power of two up to 1<<WDL_FFT_MAXBITLEN (default 131072), or any other size of the form 2^a*3^b*5^c
+// up to that (mixed radix, whose tables are built by WDL_fft_prepare(), see below). unsupported sizes are left
+// unchanged. output is in permuted order, see WDL_fft_permute_tab(). the power of two passes use SSE2 when available.
 extern void WDL_fft(WDL_FFT_COMPLEX *, int len, int isInverse);
 
+// builds and keeps the tables for len (mixed radix sizes for WDL_fft(), any size for WDL_fft_batch()), returns 0 if
+// len is not supported. call it from a non-realtime thread before using such a size (WDL_fft_permute_tab() of a
+// mixed radix size does the same): if the tables aren't there, the first WDL_fft()/WDL_fft_batch() of that size
+// allocates and builds them. thread safe.
+extern int WDL_fft_prepare(int len);
+
 #if 0 // these dont work right!
 extern void WDL_fft_realmul(WDL_FFT_REAL *dest, WDL_FFT_REAL *src, int len);
 extern void WDL_real_fft(WDL_FFT_REAL *, int len, int isInverse);
 #endif
 
+// nch same-size transforms in one call, with the channels interleaved (buf[i*nch+ch]) so that each butterfly
+// is done across channels (SIMD lanes) at once. any len WDL_fft() supports, output in the same (permuted) order.
+// like the mixed radix sizes, the tables for each len are built by WDL_fft_prepare().
+extern void WDL_fft_batch(WDL_FFT_COMPLEX *buf, int len, int nch, int isInverse);
+
 int WDL_fft_permute(int fftsize, int idx);
-int *WDL_fft_permute_tab(int fftsize);
+int *WDL_fft_permute_tab(int fftsize); // bin k of WDL_fft(fftsize) is at index tab[k] (NULL for unsupported mixed radix sizes)
 
 #ifdef __cplusplus
 };
@@ -361,6 +361,12 @@ class _LICE_Template_Blit2 // these controlled by LICE_FAVOR_SIZE
         int n=w;
         const LICE_pixel_chan *pin=src;
         LICE_pixel_chan *pout=dest;
+#ifndef LICE_FAVOR_SIZE
+        const int simd=_LICE_CombineRow<COMBFUNC>::doRow(pout,pin,n,ia);
+        pin += simd*sizeof(LICE_pixel);
+        pout += simd*sizeof(LICE_pixel);
+        n -= simd;
+#endif
         while (n--)
         {
 
@@ -804,8 +810,329 @@ class _LICE_Template_Blit4 // stuff controlled by LICE_FAVOR_SPEED
 
 
 
+// Optional banded execution of large blits/fills, see LICE_SetBlitThreads(). Each call's
+// destination rows are split into one band per thread, the calling thread renders band 0.
+// Band start values are computed in the same fixed point as the row loops advance, so the
+// output is identical to rendering on one thread.
+
+#ifndef LICE_NO_BLIT_THREADS
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+#include "../wdlatomic.h"
+
+#define LICE_MAX_BLIT_THREADS 16
+
+typedef void (*_LICE_BandFunc)(void *ctx, int y, int h); // renders rows y..y+h-1 of a job
+
+class _LICE_BlitThreads
+{
+public:
+  _LICE_BlitThreads()
+  {
+    m_nthreads=0;
+    m_minpixels=0;
+    m_busy=0;
+    m_kill=0;
+    m_remaining=0;
+    m_func=NULL;
+    m_ctx=NULL;
+    m_h=m_nbands=0;
+    memset(m_threads,0,sizeof(m_threads));
+#ifdef _WIN32
+    m_done=CreateEvent(NULL,FALSE,FALSE,NULL);
+#else
+    m_gen=0;
+    pthread_mutex_init(&m_mutex,NULL);
+    pthread_cond_init(&m_cond,NULL);
+    pthread_cond_init(&m_donecond,NULL);
+#endif
+  }
+  ~_LICE_BlitThreads()
+  {
+    // never join here: static destructors can run under the loader lock (DLL unload on Windows), where
+    // waiting for a thread deadlocks. If LICE_SetBlitThreads(0) wasn't called before unloading, the workers
+    // are detached and told to exit, and the objects they wait on are leaked.
+    if (m_nthreads >= 2)
+    {
+      Kill();
+      int x;
+      for (x = 1; x < m_nthreads; x ++)
+      {
+#ifdef _WIN32
+        CloseHandle(m_threads[x].thread);
+#else
+        pthread_detach(m_threads[x].thread);
+#endif
+      }
+      return;
+    }
+
+#ifdef _WIN32
+    CloseHandle(m_done);
+#else
+    pthread_cond_destroy(&m_donecond);
+    pthread_cond_destroy(&m_cond);
+    pthread_mutex_destroy(&m_mutex);
+#endif
+  }
+
+  void SetThreads(int nthreads, int minpixels)
+  {
+    if (nthreads > LICE_MAX_BLIT_THREADS) nthreads=LICE_MAX_BLIT_THREADS;
+    m_minpixels=minpixels;
+    if (nthreads == m_nthreads || (nthreads < 2 && m_nthreads < 2)) return;
+
+    Stop();
+    if (nthreads < 2) return;
+
+    m_kill=0;
+    int x;
+    for (x = 1; x < nthreads; x ++)
+    {
+      Thread *t=m_threads+x;
+      t->pool=this;
+      t->idx=x;
+#ifdef _WIN32
+      t->start=CreateEvent(NULL,FALSE,FALSE,NULL);
+      unsigned id;
+      t->thread=(HANDLE)_beginthreadex(NULL,0,_threadfunc,(void *)t,0,&id);
+      if (!t->thread) { CloseHandle(t->start); t->start=NULL; break; }
+#else
+      t->lastgen=m_gen;
+      if (pthread_create(&t->thread,NULL,_threadfunc,(void *)t) != 0) break;
+#endif
+    }
+    m_nthreads = x>1 ? x : 0;
+  }
+
+  void Run(_LICE_BandFunc func, void *ctx, int w, int h)
+  {
+    // small jobs, and jobs issued while another one is in progress (including from a band), run here
+    if (m_nthreads < 2 || h < 2 || (double)w*h < m_minpixels) { func(ctx,0,h); return; }
+    if (wdl_atomic_incr(&m_busy) != 1)
+    {
+      wdl_atomic_decr(&m_busy);
+      func(ctx,0,h);
+      return;
+    }
+
+    m_func=func;
+    m_ctx=ctx;
+    m_h=h;
+    m_nbands=lice_min(m_nthreads,h);
+
+#ifdef _WIN32
+    m_remaining=m_nthreads-1;
+    int x;
+    for (x = 1; x < m_nthreads; x ++) SetEvent(m_threads[x].start);
+    RunBand(0);
+    WaitForSingleObject(m_done,INFINITE);
+#else
+    pthread_mutex_lock(&m_mutex);
+    m_remaining=m_nthreads-1;
+    m_gen++;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+
+    RunBand(0);
+
+    pthread_mutex_lock(&m_mutex);
+    while (m_remaining>0) pthread_cond_wait(&m_donecond,&m_mutex);
+    pthread_mutex_unlock(&m_mutex);
+#endif
+
+    wdl_atomic_decr(&m_busy);
+  }
+
+private:
+  struct Thread
+  {
+    _LICE_BlitThreads *pool;
+    int idx;
+#ifdef _WIN32
+    HANDLE thread, start;
+#else
+    pthread_t thread;
+    int lastgen;
+#endif
+  };
+
+  void RunBand(int band)
+  {
+    if (band >= m_nbands) return;
+    const int y=(int)(((double)m_h*band)/m_nbands);
+    const int y2=(int)(((double)m_h*(band+1))/m_nbands);
+    if (y2>y) m_func(m_ctx,y,y2-y);
+  }
+
+  void Kill()
+  {
+#ifdef _WIN32
+    m_kill=1;
+    int x;
+    for (x = 1; x < m_nthreads; x ++) SetEvent(m_threads[x].start);
+#else
+    pthread_mutex_lock(&m_mutex);
+    m_kill=1;
+    pthread_cond_broadcast(&m_cond);
+    pthread_mutex_unlock(&m_mutex);
+#endif
+  }
+
+  void Stop()
+  {
+    if (m_nthreads < 2) return;
+    Kill();
+    int x;
+#ifdef _WIN32
+    for (x = 1; x < m_nthreads; x ++)
+    {
+      WaitForSingleObject(m_threads[x].thread,INFINITE);
+      CloseHandle(m_threads[x].thread);
+      CloseHandle(m_threads[x].start);
+    }
+#else
+    for (x = 1; x < m_nthreads; x ++)
+    {
+      void *p;
+      pthread_join(m_threads[x].thread,&p);
+    }
+#endif
+    memset(m_threads,0,sizeof(m_threads));
+    m_nthreads=0;
+  }
+
+  void ThreadProc(Thread *t)
+  {
+    for (;;)
+    {
+#ifdef _WIN32
+      WaitForSingleObject(t->start,INFINITE);
+#else
+      pthread_mutex_lock(&m_mutex);
+      while (t->lastgen == m_gen && !m_kill) pthread_cond_wait(&m_cond,&m_mutex);
+      t->lastgen=m_gen;
+      pthread_mutex_unlock(&m_mutex);
+#endif
+      if (m_kill) break;
+
+      RunBand(t->idx);
+
+#ifdef _WIN32
+      if (!wdl_atomic_decr(&m_remaining)) SetEvent(m_done);
+#else
+      pthread_mutex_lock(&m_mutex);
+      if (!--m_remaining) pthread_cond_broadcast(&m_donecond);
+      pthread_mutex_unlock(&m_mutex);
+#endif
+    }
+  }
+
+#ifdef _WIN32
+  static unsigned WINAPI _threadfunc(void *_t)
+#else
+  static void *_threadfunc(void *_t)
+#endif
+  {
+    Thread *t=(Thread *)_t;
+    t->pool->ThreadProc(t);
+    return 0;
+  }
+
+  int m_nthreads, m_minpixels;
+  int m_busy;
+  volatile int m_kill;
+  int m_remaining;
+
+  _LICE_BandFunc m_func;
+  void *m_ctx;
+  int m_h, m_nbands;
+
+  Thread m_threads[LICE_MAX_BLIT_THREADS]; // [0] is the calling thread
+#ifdef _WIN32
+  HANDLE m_done;
+#else
+  pthread_mutex_t m_mutex;
+  pthread_cond_t m_cond, m_donecond;
+  int m_gen;
+#endif
+};
+
+static _LICE_BlitThreads s_blitthreads;
+
+void LICE_SetBlitThreads(int nthreads, int minpixels)
+{
+  s_blitthreads.SetThreads(nthreads,minpixels);
+}
+
+#define _LICE_RunBands(func,ctx,w,h) s_blitthreads.Run(func,ctx,w,h)
+
+#else
+
+void LICE_SetBlitThreads(int nthreads, int minpixels) { }
+
+#define _LICE_RunBands(func,ctx,w,h) (func)(ctx,0,h)
+
+#endif
+
+#ifndef LICE_NO_BLIT_SUPPORT
+// bitmaps that share memory (the same bitmap, or LICE_SubBitmaps of it) can't be split into bands
+static bool _LICE_BitmapsOverlap(LICE_IBitmap *a, LICE_IBitmap *b)
+{
+  const LICE_pixel *pa=a->getBits(), *pb=b->getBits();
+  const int sa=a->getRowSpan()*a->getHeight(), sb=b->getRowSpan()*b->getHeight();
+  return pa < pb+sb && pb < pa+sa;
+}
+#endif
+
 #ifndef LICE_NO_GRADIENT_SUPPORT
 
+struct _LICE_GradRect_Job
+{
+  LICE_pixel_chan *pdest;
+  int dstw, dest_span, mode;
+  int iir, iig, iib, iia, idrdx, idgdx, idbdx, idadx, idrdy, idgdy, idbdy, idady;
+};
+
+static void _LICE_GradRect_Rows(void *ctx, int y, int dsth)
+{
+  const _LICE_GradRect_Job *job = (const _LICE_GradRect_Job *)ctx;
+
+  LICE_pixel_chan *pdest = job->pdest + y*job->dest_span;
+  const int dstw=job->dstw, dest_span=job->dest_span, mode=job->mode;
+  const int iir=job->iir+y*job->idrdy, iig=job->iig+y*job->idgdy, iib=job->iib+y*job->idbdy, iia=job->iia+y*job->idady,
+            idrdx=job->idrdx, idgdx=job->idgdx, idbdx=job->idbdx, idadx=job->idadx,
+            idrdy=job->idrdy, idgdy=job->idgdy, idbdy=job->idbdy, idady=job->idady;
+
+#ifdef LICE_FAVOR_SIZE_EXTREME
+  LICE_COMBINEFUNC blitfunc=NULL;      
+  #define __LICE__ACTION(comb) blitfunc=comb::doPix;
+#else
+
+  #define __LICE__ACTION(comb) _LICE_Template_Blit1<comb>::gradBlit(pdest,dstw,dsth,iir,iig,iib,iia,idrdx,idgdx,idbdx,idadx,idrdy,idgdy,idbdy,idady,dest_span)
+#endif
+
+    // todo: could predict whether or not the colors will ever go out of 0.255 range and optimize
+
+    if ((mode & LICE_BLIT_MODE_MASK)==LICE_BLIT_MODE_COPY && iia==65536 && idady==0 && idadx == 0)
+    {
+      __LICE__ACTION(_LICE_CombinePixelsClobberClamp);
+    }
+    else 
+    {
+      __LICE_ACTION_NOSRCALPHA(mode,256,true);
+    }
+  #undef __LICE__ACTION
+
+#ifdef LICE_FAVOR_SIZE_EXTREME
+   if (blitfunc) _LICE_Template_Blit1::gradBlit(pdest,dstw,dsth,iir,iig,iib,iia,idrdx,idgdx,idbdx,idadx,idrdy,idgdy,idbdy,idady,dest_span,blitfunc);
+#endif
+}
+
 void LICE_GradRect(LICE_IBitmap *dest, int dstx, int dsty, int dstw, int dsth, 
                       float ir, float ig, float ib, float ia,
                       float drdx, float dgdx, float dbdx, float dadx,
@@ -855,41 +1182,105 @@ void LICE_GradRect(LICE_IBitmap *dest, int dstx, int dsty, int dstw, int dsth,
   pdest+=dstx*sizeof(LICE_pixel);
 #define TOFIX(a) ((int)((a)*65536.0))
 
-  int iir=TOFIX(ir), iig=TOFIX(ig), iib=TOFIX(ib), iia=TOFIX(ia), idrdx=TOFIX(drdx),idgdx=TOFIX(dgdx),idbdx=TOFIX(dbdx),idadx=TOFIX(dadx),
-      idrdy=TOFIX(drdy), idgdy=TOFIX(dgdy), idbdy=TOFIX(dbdy), idady=TOFIX(dady);
-
+  _LICE_GradRect_Job job = { pdest, dstw, dest_span, mode,
+    TOFIX(ir), TOFIX(ig), TOFIX(ib), TOFIX(ia), TOFIX(drdx), TOFIX(dgdx), TOFIX(dbdx), TOFIX(dadx),
+    TOFIX(drdy), TOFIX(dgdy), TOFIX(dbdy), TOFIX(dady) };
+#undef TOFIX
 
-#ifdef LICE_FAVOR_SIZE_EXTREME
-  LICE_COMBINEFUNC blitfunc=NULL;      
-  #define __LICE__ACTION(comb) blitfunc=comb::doPix;
-#else
+  _LICE_RunBands(_LICE_GradRect_Rows,&job,dstw,dsth);
+}
 
-  #define __LICE__ACTION(comb) _LICE_Template_Blit1<comb>::gradBlit(pdest,dstw,dsth,iir,iig,iib,iia,idrdx,idgdx,idbdx,idadx,idrdy,idgdy,idbdy,idady,dest_span)
 #endif
 
-    // todo: could predict whether or not the colors will ever go out of 0.255 range and optimize
 
-    if ((mode & LICE_BLIT_MODE_MASK)==LICE_BLIT_MODE_COPY && iia==65536 && idady==0 && idadx == 0)
+#ifndef LICE_NO_BLIT_SUPPORT 
+struct _LICE_Blit_Job
+{
+  LICE_pixel_chan *pdest;
+  const LICE_pixel_chan *psrc;
+  int cpsize, src_span, dest_span, mode;
+  float alpha;
+};
+
+static void _LICE_Blit_Rows(void *ctx, int y, int i)
+{
+  const _LICE_Blit_Job *job = (const _LICE_Blit_Job *)ctx;
+
+  LICE_pixel_chan *pdest = job->pdest + y*job->dest_span;
+  const LICE_pixel_chan *psrc = job->psrc + y*job->src_span;
+  const int cpsize=job->cpsize, src_span=job->src_span, dest_span=job->dest_span, mode=job->mode;
+  const float alpha=job->alpha;
+
+  if ((mode&LICE_BLIT_MODE_MASK) >= LICE_BLIT_MODE_CHANCOPY && (mode&LICE_BLIT_MODE_MASK) < LICE_BLIT_MODE_CHANCOPY+0x10)
+  {
+    while (i-->0)
     {
-      __LICE__ACTION(_LICE_CombinePixelsClobberClamp);
+      LICE_pixel_chan *o=pdest+((mode>>2)&3);
+      const LICE_pixel_chan *in=psrc+(mode&3);
+      int a=cpsize;
+      while (a--)
+      {
+        *o=*in;
+        o+=sizeof(LICE_pixel);
+        in+=sizeof(LICE_pixel);
+      }
+      pdest+=dest_span;
+      psrc += src_span;
     }
-    else 
+  }
+  // special fast case for copy with no source alpha and alpha=1.0 or 0.5
+  else if ((mode&(LICE_BLIT_MODE_MASK|LICE_BLIT_USE_ALPHA))==LICE_BLIT_MODE_COPY && (alpha==1.0||alpha==0.5))
+  {
+    if (alpha==0.5)
     {
-      __LICE_ACTION_NOSRCALPHA(mode,256,true);
-    }
-  #undef __LICE__ACTION
+      while (i-->0)
+      {
+        const LICE_pixel *rd = (LICE_pixel *)psrc;
+        LICE_pixel *wr = (LICE_pixel *)pdest;
+        const int simd=_LICE_SIMD_HalfMixRow(wr,rd,cpsize);
+        int a=cpsize-simd;
+        rd += simd;
+        wr += simd;
+        while (a-->0)
+        {
+          *wr = ((*wr>>1)&0x7f7f7f7f)+((*rd++>>1)&0x7f7f7f7f);
+          wr++;
+        }
 
-#ifdef LICE_FAVOR_SIZE_EXTREME
-   if (blitfunc) _LICE_Template_Blit1::gradBlit(pdest,dstw,dsth,iir,iig,iib,iia,idrdx,idgdx,idbdx,idadx,idrdy,idgdy,idbdy,idady,dest_span,blitfunc);
-#endif
+        pdest+=dest_span;
+        psrc += src_span;
+      }
+    }
+    else
+    {
+      while (i-->0)
+      {
+        memcpy(pdest,psrc,cpsize*sizeof(LICE_pixel));
+        pdest+=dest_span;
+        psrc += src_span;
+      }
+    }
+  }
+  else 
+  {
+    int ia=(int)(alpha*256.0);
+    #ifdef LICE_FAVOR_SIZE
+        LICE_COMBINEFUNC blitfunc=NULL;      
+        #define __LICE__ACTION(comb) blitfunc=comb::doPix;
+    #else
+        #define __LICE__ACTION(comb) _LICE_Template_Blit2<comb>::blit(pdest,psrc,cpsize,i,src_span,dest_span,ia)
+    #endif
+      
+        __LICE_ACTION_SRCALPHA(mode,ia,false);
+    
+    #undef __LICE__ACTION
 
-#undef TOFIX
+    #ifdef LICE_FAVOR_SIZE
+        if (blitfunc) _LICE_Template_Blit2::blit(pdest,psrc,cpsize,i,src_span,dest_span,ia,blitfunc);
+    #endif
+  }
 }
 
-#endif
-
-
-#ifndef LICE_NO_BLIT_SUPPORT 
 void LICE_Blit(LICE_IBitmap *dest, LICE_IBitmap *src, int dstx, int dsty, int srcx, int srcy, int srcw, int srch, float alpha, int mode)
 {
   RECT r={srcx,srcy,srcx+srcw,srcy+srch};
@@ -957,74 +1348,9 @@ void LICE_Blit(LICE_IBitmap *dest, LICE_IBitmap *src, int dstx, int dsty, const
   else pdest += dsty*dest_span;
   pdest+=dstx*sizeof(LICE_pixel);
 
-  int i=sr.bottom-sr.top;
-  int cpsize=sr.right-sr.left;
-
-  if ((mode&LICE_BLIT_MODE_MASK) >= LICE_BLIT_MODE_CHANCOPY && (mode&LICE_BLIT_MODE_MASK) < LICE_BLIT_MODE_CHANCOPY+0x10)
-  {
-    while (i-->0)
-    {
-      LICE_pixel_chan *o=pdest+((mode>>2)&3);
-      const LICE_pixel_chan *in=psrc+(mode&3);
-      int a=cpsize;
-      while (a--)
-      {
-        *o=*in;
-        o+=sizeof(LICE_pixel);
-        in+=sizeof(LICE_pixel);
-      }
-      pdest+=dest_span;
-      psrc += src_span;
-    }
-  }
-  // special fast case for copy with no source alpha and alpha=1.0 or 0.5
-  else if ((mode&(LICE_BLIT_MODE_MASK|LICE_BLIT_USE_ALPHA))==LICE_BLIT_MODE_COPY && (alpha==1.0||alpha==0.5))
-  {
-    if (alpha==0.5)
-    {
-      while (i-->0)
-      {
-        int a=cpsize;
-        const LICE_pixel *rd = (LICE_pixel *)psrc;
-        LICE_pixel *wr = (LICE_pixel *)pdest;
-        while (a-->0)
-        {
-          *wr = ((*wr>>1)&0x7f7f7f7f)+((*rd++>>1)&0x7f7f7f7f);
-          wr++;
-        }
-
-        pdest+=dest_span;
-        psrc += src_span;
-      }
-    }
-    else
-    {
-      while (i-->0)
-      {
-        memcpy(pdest,psrc,cpsize*sizeof(LICE_pixel));
-        pdest+=dest_span;
-        psrc += src_span;
-      }
-    }
-  }
-  else 
-  {
-    int ia=(int)(alpha*256.0);
-    #ifdef LICE_FAVOR_SIZE
-        LICE_COMBINEFUNC blitfunc=NULL;      
-        #define __LICE__ACTION(comb) blitfunc=comb::doPix;
-    #else
-        #define __LICE__ACTION(comb) _LICE_Template_Blit2<comb>::blit(pdest,psrc,cpsize,i,src_span,dest_span,ia)
-    #endif
-      
-        __LICE_ACTION_SRCALPHA(mode,ia,false);
-    
-    #undef __LICE__ACTION
-
-    #ifdef LICE_FAVOR_SIZE
-        if (blitfunc) _LICE_Template_Blit2::blit(pdest,psrc,cpsize,i,src_span,dest_span,ia,blitfunc);
-    #endif
-  }
+  _LICE_Blit_Job job = { pdest, psrc, sr.right-sr.left, src_span, dest_span, mode, alpha };
+  if (_LICE_BitmapsOverlap(dest,src)) _LICE_Blit_Rows(&job,0,sr.bottom-sr.top);
+  else _LICE_RunBands(_LICE_Blit_Rows,&job,sr.right-sr.left,sr.bottom-sr.top);
 }
 
 #endif
@@ -1154,6 +1480,107 @@ void LICE_Blur(LICE_IBitmap *dest, LICE_IBitmap *src, int dstx, int dsty, int sr
 #endif
 
 #ifndef LICE_NO_BLIT_SUPPORT
+struct _LICE_ScaledBlit_Job
+{
+  LICE_pixel_chan *pdest;
+  const LICE_pixel_chan *psrc;
+  int dstw, icurx, icury, idx, idy, clip_r, clip_b, src_span, dest_span, mode;
+  double xadvance, yadvance;
+  float alpha;
+};
+
+static void _LICE_ScaledBlit_Rows(void *ctx, int y, int dsth)
+{
+  const _LICE_ScaledBlit_Job *job = (const _LICE_ScaledBlit_Job *)ctx;
+
+  LICE_pixel_chan *pdest = job->pdest + y*job->dest_span;
+  const LICE_pixel_chan *psrc = job->psrc;
+  const int dstw=job->dstw, icurx=job->icurx, icury=job->icury + y*job->idy, idx=job->idx, idy=job->idy;
+  const int clip_r=job->clip_r, clip_b=job->clip_b, src_span=job->src_span, dest_span=job->dest_span, mode=job->mode;
+  const double xadvance=job->xadvance, yadvance=job->yadvance;
+  const float alpha=job->alpha;
+
+  int ia=(int)(alpha*256.0);
+
+  if ((mode&(LICE_BLIT_FILTER_MASK|LICE_BLIT_MODE_MASK|LICE_BLIT_USE_ALPHA))==LICE_BLIT_MODE_COPY && (ia==128 || ia==256))
+  {
+    if (ia==128)
+    {
+      _LICE_Template_Blit0<_LICE_CombinePixelsHalfMixFAST>::scaleBlitFAST(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span);
+    }
+    else
+    {
+      _LICE_Template_Blit0<_LICE_CombinePixelsClobberFAST>::scaleBlitFAST(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span);
+    }
+  }
+  else
+  {
+    if (xadvance>=1.7 && yadvance >=1.7 && (mode&LICE_BLIT_FILTER_MASK)==LICE_BLIT_FILTER_BILINEAR)
+    {
+      int msc = lice_max(idx,idy);
+      const int filtsz=msc>(3<<16) ? 5 : 3;
+      const int filt_start = - (filtsz/2);
+
+      int filter[25]; // 5x5 max
+      {
+        int y;
+      //  char buf[4096];
+    //    sprintf(buf,"filter, msc=%f: ",msc);
+        int *p=filter;
+        for(y=0;y<filtsz;y++)
+        {
+          int x;
+          for(x=0;x<filtsz;x++)
+          {
+            if (x==y && x==filtsz/2) *p++ = 65536; // src pix is always valued at 1.
+            else
+            {
+              double dx=x+filt_start;
+              double dy=y+filt_start;
+              double v = (msc-1.0) / sqrt(dx*dx+dy*dy); // this needs serious tweaking...
+
+  //            sprintf(buf+strlen(buf),"%f,",v);
+
+              if(v<0.0) *p++=0;
+              else if (v>1.0) *p++=65536;
+              else *p++=(int)(v*65536.0);
+            }
+          }
+        }
+//        OutputDebugString(buf);
+      }
+
+      #ifdef LICE_FAVOR_SIZE
+        LICE_COMBINEFUNC blitfunc=NULL;      
+        #define __LICE__ACTION(comb) blitfunc=comb::doPix;
+      #else
+        #define __LICE__ACTION(comb) _LICE_Template_Blit2<comb>::scaleBlitFilterDown(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span,ia,filter,filt_start,filtsz)
+      #endif
+          __LICE_ACTION_SRCALPHA(mode,ia,false);
+      #undef __LICE__ACTION
+
+      #ifdef LICE_FAVOR_SIZE
+        if (blitfunc) _LICE_Template_Blit2::scaleBlitFilterDown(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span,ia,filter,filt_start,filtsz,blitfunc);
+      #endif
+
+    }
+    else
+    {
+      #ifdef LICE_FAVOR_SIZE
+        LICE_COMBINEFUNC blitfunc=NULL;      
+        #define __LICE__ACTION(comb) blitfunc=comb::doPix;
+      #else
+        #define __LICE__ACTION(comb) _LICE_Template_Blit2<comb>::scaleBlit(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span,ia,mode&LICE_BLIT_FILTER_MASK)
+      #endif
+          __LICE_ACTION_SRCALPHA(mode,ia,false);
+      #undef __LICE__ACTION
+      #ifdef LICE_FAVOR_SIZE
+        if (blitfunc) _LICE_Template_Blit2::scaleBlit(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span,ia,mode&LICE_BLIT_FILTER_MASK,blitfunc);
+      #endif
+    }
+  }
+}
+
 void LICE_ScaledBlit(LICE_IBitmap *dest, LICE_IBitmap *src, 
                      int dstx, int dsty, int dstw, int dsth, 
                      float srcx, float srcy, float srcw, float srch, 
@@ -1293,85 +1720,9 @@ void LICE_ScaledBlit(LICE_IBitmap *dest, LICE_IBitmap *src,
 
   if (clip_r<1||clip_b<1) return;
 
-  int ia=(int)(alpha*256.0);
-
-  if ((mode&(LICE_BLIT_FILTER_MASK|LICE_BLIT_MODE_MASK|LICE_BLIT_USE_ALPHA))==LICE_BLIT_MODE_COPY && (ia==128 || ia==256))
-  {
-    if (ia==128)
-    {
-      _LICE_Template_Blit0<_LICE_CombinePixelsHalfMixFAST>::scaleBlitFAST(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span);
-    }
-    else
-    {
-      _LICE_Template_Blit0<_LICE_CombinePixelsClobberFAST>::scaleBlitFAST(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span);
-    }
-  }
-  else
-  {
-    if (xadvance>=1.7 && yadvance >=1.7 && (mode&LICE_BLIT_FILTER_MASK)==LICE_BLIT_FILTER_BILINEAR)
-    {
-      int msc = lice_max(idx,idy);
-      const int filtsz=msc>(3<<16) ? 5 : 3;
-      const int filt_start = - (filtsz/2);
-
-      int filter[25]; // 5x5 max
-      {
-        int y;
-      //  char buf[4096];
-    //    sprintf(buf,"filter, msc=%f: ",msc);
-        int *p=filter;
-        for(y=0;y<filtsz;y++)
-        {
-          int x;
-          for(x=0;x<filtsz;x++)
-          {
-            if (x==y && x==filtsz/2) *p++ = 65536; // src pix is always valued at 1.
-            else
-            {
-              double dx=x+filt_start;
-              double dy=y+filt_start;
-              double v = (msc-1.0) / sqrt(dx*dx+dy*dy); // this needs serious tweaking...
-
-  //            sprintf(buf+strlen(buf),"%f,",v);
-
-              if(v<0.0) *p++=0;
-              else if (v>1.0) *p++=65536;
-              else *p++=(int)(v*65536.0);
-            }
-          }
-        }
-//        OutputDebugString(buf);
-      }
-
-      #ifdef LICE_FAVOR_SIZE
-        LICE_COMBINEFUNC blitfunc=NULL;      
-        #define __LICE__ACTION(comb) blitfunc=comb::doPix;
-      #else
-        #define __LICE__ACTION(comb) _LICE_Template_Blit2<comb>::scaleBlitFilterDown(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span,ia,filter,filt_start,filtsz)
-      #endif
-          __LICE_ACTION_SRCALPHA(mode,ia,false);
-      #undef __LICE__ACTION
-
-      #ifdef LICE_FAVOR_SIZE
-        if (blitfunc) _LICE_Template_Blit2::scaleBlitFilterDown(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span,ia,filter,filt_start,filtsz,blitfunc);
-      #endif
-
-    }
-    else
-    {
-      #ifdef LICE_FAVOR_SIZE
-        LICE_COMBINEFUNC blitfunc=NULL;      
-        #define __LICE__ACTION(comb) blitfunc=comb::doPix;
-      #else
-        #define __LICE__ACTION(comb) _LICE_Template_Blit2<comb>::scaleBlit(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span,ia,mode&LICE_BLIT_FILTER_MASK)
-      #endif
-          __LICE_ACTION_SRCALPHA(mode,ia,false);
-      #undef __LICE__ACTION
-      #ifdef LICE_FAVOR_SIZE
-        if (blitfunc) _LICE_Template_Blit2::scaleBlit(pdest,psrc,dstw,dsth,icurx,icury,idx,idy,clip_r,clip_b,src_span,dest_span,ia,mode&LICE_BLIT_FILTER_MASK,blitfunc);
-      #endif
-    }
-  }
+  _LICE_ScaledBlit_Job job = { pdest, psrc, dstw, icurx, icury, idx, idy, clip_r, clip_b, src_span, dest_span, mode, xadvance, yadvance, alpha };
+  if (_LICE_BitmapsOverlap(dest,src)) _LICE_ScaledBlit_Rows(&job,0,dsth);
+  else _LICE_RunBands(_LICE_ScaledBlit_Rows,&job,dstw,dsth);
 }
 
 void LICE_DeltaBlit(LICE_IBitmap *dest, LICE_IBitmap *src, 
@@ -1614,6 +1965,37 @@ void LICE_DeltaBlitAlpha(LICE_IBitmap *dest, LICE_IBitmap *src,
                       
 
 
+struct _LICE_RotatedBlit_Job
+{
+  LICE_pixel_chan *pdest;
+  const LICE_pixel_chan *psrc;
+  int dstw, isrcx, isrcy, idsdx, idtdx, idsdy, idtdy, sr, sb, src_span, dest_span, ia, mode;
+};
+
+static void _LICE_RotatedBlit_Rows(void *ctx, int y, int dsth)
+{
+  const _LICE_RotatedBlit_Job *job = (const _LICE_RotatedBlit_Job *)ctx;
+
+  LICE_pixel_chan *pdest = job->pdest + y*job->dest_span;
+  const LICE_pixel_chan *psrc = job->psrc;
+  const int dstw=job->dstw, isrcx=job->isrcx + y*job->idsdy, isrcy=job->isrcy + y*job->idtdy;
+  const int idsdx=job->idsdx, idtdx=job->idtdx, idsdy=job->idsdy, idtdy=job->idtdy;
+  const int sr=job->sr, sb=job->sb, src_span=job->src_span, dest_span=job->dest_span, ia=job->ia, mode=job->mode;
+
+#ifndef LICE_FAVOR_SPEED
+  LICE_COMBINEFUNC blitfunc=NULL;
+  #define __LICE__ACTION(comb) blitfunc = comb::doPix;
+#else
+  #define __LICE__ACTION(comb) _LICE_Template_Blit3<comb>::deltaBlit(pdest,psrc,dstw,dsth,isrcx,isrcy,idsdx,idtdx,idsdy,idtdy,0,0,sr,sb,src_span,dest_span,ia,mode&LICE_BLIT_FILTER_MASK)
+#endif
+      __LICE_ACTION_SRCALPHA(mode,ia,false);
+  #undef __LICE__ACTION
+
+#ifndef LICE_FAVOR_SPEED
+  if (blitfunc) _LICE_Template_Blit3::deltaBlit(pdest,psrc,dstw,dsth,isrcx,isrcy,idsdx,idtdx,idsdy,idtdy,0,0,sr,sb,src_span,dest_span,ia,mode&LICE_BLIT_FILTER_MASK,blitfunc);
+#endif
+}
+
 void LICE_RotatedBlit(LICE_IBitmap *dest, LICE_IBitmap *src, 
                       int dstx, int dsty, int dstw, int dsth, 
                       float srcx, float srcy, float srcw, float srch, 
@@ -1723,18 +2105,9 @@ void LICE_RotatedBlit(LICE_IBitmap *dest, LICE_IBitmap *src,
   int idsdy=(int)(dsdy*65536.0);
   int idtdy=(int)(dtdy*65536.0);
 
-#ifndef LICE_FAVOR_SPEED
-  LICE_COMBINEFUNC blitfunc=NULL;
-  #define __LICE__ACTION(comb) blitfunc = comb::doPix;
-#else
-  #define __LICE__ACTION(comb) _LICE_Template_Blit3<comb>::deltaBlit(pdest,psrc,dstw,dsth,isrcx,isrcy,idsdx,idtdx,idsdy,idtdy,0,0,sr,sb,src_span,dest_span,ia,mode&LICE_BLIT_FILTER_MASK)
-#endif
-      __LICE_ACTION_SRCALPHA(mode,ia,false);
-  #undef __LICE__ACTION
-
-#ifndef LICE_FAVOR_SPEED
-  if (blitfunc) _LICE_Template_Blit3::deltaBlit(pdest,psrc,dstw,dsth,isrcx,isrcy,idsdx,idtdx,idsdy,idtdy,0,0,sr,sb,src_span,dest_span,ia,mode&LICE_BLIT_FILTER_MASK,blitfunc);
-#endif
+  _LICE_RotatedBlit_Job job = { pdest, psrc, dstw, isrcx, isrcy, idsdx, idtdx, idsdy, idtdy, sr, sb, src_span, dest_span, ia, mode };
+  if (_LICE_BitmapsOverlap(dest,src)) _LICE_RotatedBlit_Rows(&job,0,dsth);
+  else _LICE_RunBands(_LICE_RotatedBlit_Rows,&job,dstw,dsth);
 }
 
 #endif
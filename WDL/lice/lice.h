@@ -371,6 +371,15 @@ LICE_pixel LICE_GetPixel(LICE_IBitmap *bm, int x, int y);
 
 void LICE_Copy(LICE_IBitmap *dest, LICE_IBitmap *src); // resizes dest to fit
 
+// LICE_Blit/LICE_ScaledBlit/LICE_RotatedBlit/LICE_GradRect can split large destinations into row bands, rendered
+// on nthreads threads (including the calling thread). Output is identical to single threaded rendering. Calls covering
+// fewer than minpixels destination pixels, calls made while another call is being split (or from within one), and
+// calls where src and dest share memory run on the calling thread. nthreads<2 disables this (the default).
+// Only change this while no other thread is using LICE. Define LICE_NO_BLIT_THREADS to compile it out.
+// Call LICE_SetBlitThreads(0) before LICE's module is unloaded (e.g. when a plug-in's last instance closes, not from
+// DllMain): the worker threads are only joined there, static destruction just tells them to exit.
+void LICE_SetBlitThreads(int nthreads, int minpixels=256*256);
+
 
 //alpha parameter = const alpha (combined with source alpha if spcified)
 void LICE_Blit(LICE_IBitmap *dest, LICE_IBitmap *src, int dstx, int dsty, const RECT *srcrect, float alpha, int mode);
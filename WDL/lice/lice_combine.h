@@ -723,6 +723,270 @@ public:
 #define _LICE_CombinePixelsHSVAdjust _LICE_CombinePixelsCopyClamp
 #endif
 
+// SIMD row versions of the common combine modes, used by blits that read a contiguous row of
+// source pixels. _LICE_CombineRow<COMBFUNC>::doRow() combines as many of the n pixels as it can
+// (a multiple of 4), returns that count and leaves the rest to COMBFUNC::doPix(). The results are
+// identical to doPix(). Modes without a SIMD version return 0, as does everything when the CPU
+// doesn't support it (checked at runtime) or LICE_NO_SIMD is defined.
+
+#ifndef LICE_NO_SIMD
+  #if defined(__SSE2__) || defined(_M_X64) || (defined(_MSC_VER) && defined(_M_IX86))
+    #define LICE_SIMD_SSE2
+    #include <emmintrin.h>
+    #if defined(_M_IX86) && !defined(__SSE2__) && (!defined(_M_IX86_FP) || _M_IX86_FP < 2)
+      #include <intrin.h>
+      #define LICE_SIMD_SSE2_CPUID
+    #endif
+  #endif
+#endif
+
+template<class COMBFUNC> class _LICE_CombineRow
+{
+public:
+  static inline int doRow(LICE_pixel_chan *dest, const LICE_pixel_chan *src, int n, int alpha) { return 0; }
+};
+
+#ifdef LICE_SIMD_SSE2
+
+static inline bool _LICE_SIMD_Available()
+{
+#ifdef LICE_SIMD_SSE2_CPUID
+  static int s_sse2=-1;
+  if (s_sse2<0)
+  {
+    int info[4];
+    __cpuid(info,1);
+    s_sse2 = (info[3]>>26)&1;
+  }
+  return !!s_sse2;
+#else
+  return true;
+#endif
+}
+
+// The kernels work on two pixels at a time, one 16 bit lane per channel.
+
+#define _LICE_SIMD_ALPHASHUF _MM_SHUFFLE(LICE_PIXEL_A,LICE_PIXEL_A,LICE_PIXEL_A,LICE_PIXEL_A)
+
+// each pixel's alpha in all of its lanes
+static inline __m128i _LICE_SIMD_AlphaBroadcast(__m128i v)
+{
+  return _mm_shufflehi_epi16(_mm_shufflelo_epi16(v,_LICE_SIMD_ALPHASHUF),_LICE_SIMD_ALPHASHUF);
+}
+
+// all ones in each pixel's alpha lane
+static inline __m128i _LICE_SIMD_AlphaLanes()
+{
+  return _mm_slli_epi64(_mm_set_epi32(0,0xffff,0,0xffff),16*LICE_PIXEL_A);
+}
+
+static inline __m128i _LICE_SIMD_Select(__m128i mask, __m128i a, __m128i b) // mask ? a : b
+{
+  return _mm_or_si128(_mm_and_si128(mask,a),_mm_andnot_si128(mask,b));
+}
+
+// (alpha*(a+1))/256, for alpha and a+1 up to 256
+static inline __m128i _LICE_SIMD_ScaleAlpha(__m128i alpha, __m128i a)
+{
+  return _mm_mulhi_epu16(_mm_slli_epi16(alpha,7),_mm_slli_epi16(_mm_add_epi16(a,_mm_set1_epi16(1)),1));
+}
+
+// s + ((d-s)*sc)/256, sc up to 256. The division truncates toward zero, so |d-s| is scaled and the sign applied after.
+static inline __m128i _LICE_SIMD_Lerp(__m128i d, __m128i s, __m128i sc)
+{
+  const __m128i up=_mm_srli_epi16(_mm_mullo_epi16(_mm_subs_epu16(d,s),sc),8);
+  const __m128i down=_mm_srli_epi16(_mm_mullo_epi16(_mm_subs_epu16(s,d),sc),8);
+  return _mm_sub_epi16(_mm_add_epi16(s,up),down);
+}
+
+// rgb = s + ((d-s)*sc)/256, alpha = d + sa (saturated by the final pack). Pixels with a source alpha of 0 are left alone.
+static inline __m128i _LICE_SIMD_CopyAlpha(__m128i d, __m128i s, __m128i a, __m128i sa, __m128i sc)
+{
+  const __m128i v=_LICE_SIMD_Select(_LICE_SIMD_AlphaLanes(),_mm_add_epi16(d,sa),_LICE_SIMD_Lerp(d,s,sc));
+  return _LICE_SIMD_Select(_mm_cmpeq_epi16(a,_mm_setzero_si128()),d,v);
+}
+
+// (d*(da + s*alpha))>>16 with da=(256-alpha)*256, alpha 1..256
+static inline __m128i _LICE_SIMD_Mul(__m128i d, __m128i s, __m128i alpha)
+{
+  const __m128i da=_mm_slli_epi16(_mm_sub_epi16(_mm_set1_epi16(256),alpha),8);
+  return _mm_mulhi_epu16(d,_mm_add_epi16(da,_mm_mullo_epi16(s,alpha)));
+}
+
+// _LICE_CombinePixelsOverlay, alpha 0..256. With u=alpha*(s-128) (which fits in 16 bits) the scalar version is
+// (d*(32768 + u - (d*u)/256))>>15, where (d*u)/256 truncates toward zero.
+static inline __m128i _LICE_SIMD_Overlay(__m128i d, __m128i s, __m128i alpha)
+{
+  const __m128i u=_mm_mullo_epi16(alpha,_mm_sub_epi16(s,_mm_set1_epi16(128)));
+  const __m128i lo=_mm_mullo_epi16(d,u), hi=_mm_mulhi_epi16(d,u);
+  __m128i du=_mm_or_si128(_mm_slli_epi16(hi,8),_mm_srli_epi16(lo,8)); // (d*u)>>8, rounded down
+  const __m128i frac=_mm_cmpeq_epi16(_mm_and_si128(lo,_mm_set1_epi16(0xff)),_mm_setzero_si128());
+  du=_mm_sub_epi16(du,_mm_andnot_si128(frac,_mm_srai_epi16(hi,15))); // round negative products up
+  const __m128i inner=_mm_sub_epi16(_mm_add_epi16(_mm_set1_epi16((short)0x8000),u),du);
+  return _mm_mulhi_epu16(_mm_slli_epi16(d,1),inner);
+}
+
+class _LICE_SIMD_KernelCopy
+{
+public:
+  static inline __m128i doPix2(__m128i d, __m128i s, __m128i alpha)
+  {
+    return _LICE_SIMD_Lerp(d,s,_mm_sub_epi16(_mm_set1_epi16(256),alpha));
+  }
+};
+
+class _LICE_SIMD_KernelCopySourceAlpha
+{
+public:
+  static inline __m128i doPix2(__m128i d, __m128i s, __m128i alpha)
+  {
+    const __m128i a=_LICE_SIMD_AlphaBroadcast(s);
+    const __m128i sc2=_LICE_SIMD_ScaleAlpha(alpha,a);
+    return _LICE_SIMD_CopyAlpha(d,s,a,sc2,_mm_sub_epi16(_mm_set1_epi16(256),sc2));
+  }
+};
+
+class _LICE_SIMD_KernelCopySourceAlphaIgnoreAlphaParm
+{
+public:
+  static inline __m128i doPix2(__m128i d, __m128i s, __m128i alpha)
+  {
+    const __m128i a=_LICE_SIMD_AlphaBroadcast(s);
+    return _LICE_SIMD_CopyAlpha(d,s,a,a,_mm_sub_epi16(_mm_set1_epi16(255),a));
+  }
+};
+
+class _LICE_SIMD_KernelAdd
+{
+public:
+  static inline __m128i doPix2(__m128i d, __m128i s, __m128i alpha)
+  {
+    return _mm_add_epi16(d,_mm_srli_epi16(_mm_mullo_epi16(s,alpha),8));
+  }
+};
+
+class _LICE_SIMD_KernelAddSourceAlpha
+{
+public:
+  static inline __m128i doPix2(__m128i d, __m128i s, __m128i alpha)
+  {
+    const __m128i a=_LICE_SIMD_AlphaBroadcast(s);
+    const __m128i v=_LICE_SIMD_KernelAdd::doPix2(d,s,_LICE_SIMD_ScaleAlpha(alpha,a));
+    return _LICE_SIMD_Select(_mm_cmpeq_epi16(a,_mm_setzero_si128()),d,v);
+  }
+};
+
+class _LICE_SIMD_KernelMul
+{
+public:
+  static inline __m128i doPix2(__m128i d, __m128i s, __m128i alpha)
+  {
+    return _LICE_SIMD_Mul(d,s,alpha);
+  }
+};
+
+class _LICE_SIMD_KernelMulSourceAlpha
+{
+public:
+  static inline __m128i doPix2(__m128i d, __m128i s, __m128i alpha)
+  {
+    const __m128i a=_LICE_SIMD_AlphaBroadcast(s);
+    const __m128i ua=_LICE_SIMD_ScaleAlpha(alpha,a);
+    const __m128i zero=_mm_setzero_si128();
+    // ua=0 leaves the pixel alone too (da would not fit in 16 bits)
+    return _LICE_SIMD_Select(_mm_or_si128(_mm_cmpeq_epi16(a,zero),_mm_cmpeq_epi16(ua,zero)),d,_LICE_SIMD_Mul(d,s,ua));
+  }
+};
+
+class _LICE_SIMD_KernelOverlay
+{
+public:
+  static inline __m128i doPix2(__m128i d, __m128i s, __m128i alpha)
+  {
+    return _LICE_SIMD_Overlay(d,s,alpha);
+  }
+};
+
+class _LICE_SIMD_KernelOverlaySourceAlpha
+{
+public:
+  static inline __m128i doPix2(__m128i d, __m128i s, __m128i alpha)
+  {
+    return _LICE_SIMD_Overlay(d,s,_LICE_SIMD_ScaleAlpha(alpha,_LICE_SIMD_AlphaBroadcast(s)));
+  }
+};
+
+template<class KERNEL> static int _LICE_SIMD_DoRow(LICE_pixel_chan *dest, const LICE_pixel_chan *src, int n, int alpha)
+{
+  // alpha outside 1..256 isn't handled by the kernels. If the source trails the destination in the same row,
+  // the scalar version reads pixels it has just written, so that has to stay scalar as well.
+  if (n < 4 || alpha < 1 || alpha > 256 || (src < dest && dest < src+n*sizeof(LICE_pixel)) || !_LICE_SIMD_Available()) return 0;
+
+  const __m128i zero=_mm_setzero_si128(), ia=_mm_set1_epi16((short)alpha);
+  int x;
+  for (x = 0; x+4 <= n; x += 4)
+  {
+    const __m128i d=_mm_loadu_si128((const __m128i *)dest), s=_mm_loadu_si128((const __m128i *)src);
+    const __m128i lo=KERNEL::doPix2(_mm_unpacklo_epi8(d,zero),_mm_unpacklo_epi8(s,zero),ia);
+    const __m128i hi=KERNEL::doPix2(_mm_unpackhi_epi8(d,zero),_mm_unpackhi_epi8(s,zero),ia);
+    _mm_storeu_si128((__m128i *)dest,_mm_packus_epi16(lo,hi));
+    dest += 4*sizeof(LICE_pixel);
+    src += 4*sizeof(LICE_pixel);
+  }
+  return x;
+}
+
+// _LICE_CombinePixelsHalfMixFAST for a row of pixels
+static inline int _LICE_SIMD_HalfMixRow(LICE_pixel *dest, const LICE_pixel *src, int n)
+{
+  if (n < 4 || (src < dest && dest < src+n) || !_LICE_SIMD_Available()) return 0;
+
+  const __m128i m=_mm_set1_epi8(0x7f);
+  int x;
+  for (x = 0; x+4 <= n; x += 4)
+  {
+    const __m128i d=_mm_loadu_si128((const __m128i *)(dest+x)), s=_mm_loadu_si128((const __m128i *)(src+x));
+    _mm_storeu_si128((__m128i *)(dest+x),_mm_add_epi32(_mm_and_si128(_mm_srli_epi32(d,1),m),_mm_and_si128(_mm_srli_epi32(s,1),m)));
+  }
+  return x;
+}
+
+#define _LICE_SIMD_COMBINEROW(comb,kernel) \
+  template<> class _LICE_CombineRow<comb> { \
+  public: \
+    static inline int doRow(LICE_pixel_chan *dest, const LICE_pixel_chan *src, int n, int alpha) { return _LICE_SIMD_DoRow<kernel>(dest,src,n,alpha); } \
+  };
+
+// the clamp and no-clamp versions of these give the same results for LICE_pixel input
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsCopyNoClamp,_LICE_SIMD_KernelCopy)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsCopyClamp,_LICE_SIMD_KernelCopy)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsCopySourceAlphaNoClamp,_LICE_SIMD_KernelCopySourceAlpha)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsCopySourceAlphaClamp,_LICE_SIMD_KernelCopySourceAlpha)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsCopySourceAlphaIgnoreAlphaParmNoClamp,_LICE_SIMD_KernelCopySourceAlphaIgnoreAlphaParm)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsCopySourceAlphaIgnoreAlphaParmClamp,_LICE_SIMD_KernelCopySourceAlphaIgnoreAlphaParm)
+#ifndef LICE_DISABLE_BLEND_ADD
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsAdd,_LICE_SIMD_KernelAdd)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsAddSourceAlpha,_LICE_SIMD_KernelAddSourceAlpha)
+#endif
+#ifndef LICE_DISABLE_BLEND_MUL
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsMulNoClamp,_LICE_SIMD_KernelMul)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsMulClamp,_LICE_SIMD_KernelMul)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsMulSourceAlphaNoClamp,_LICE_SIMD_KernelMulSourceAlpha)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsMulSourceAlphaClamp,_LICE_SIMD_KernelMulSourceAlpha)
+#endif
+#ifndef LICE_DISABLE_BLEND_OVERLAY
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsOverlay,_LICE_SIMD_KernelOverlay)
+_LICE_SIMD_COMBINEROW(_LICE_CombinePixelsOverlaySourceAlpha,_LICE_SIMD_KernelOverlaySourceAlpha)
+#endif
+
+#undef _LICE_SIMD_COMBINEROW
+
+#else // !LICE_SIMD_SSE2
+
+static inline int _LICE_SIMD_HalfMixRow(LICE_pixel *dest, const LICE_pixel *src, int n) { return 0; }
+
+#endif
+
 // note: the "clamp" parameter would generally be false, unless you're working with
 // input colors that need to be clamped (i.e. if you have a r value of >255 or <0, etc.
 // if your input is LICE_pixel only then use false, and it will clamp as needed depending 
@@ -101,6 +101,23 @@ class WDL_Mutex {
 #endif
     }
 
+    // returns false if another thread holds the mutex, Leave() only on success
+    bool TryEnter()
+    {
+#ifdef _WIN32
+      if (!TryEnterCriticalSection(&m_cs)) return false;
+#elif defined(WDL_MAC_USE_CARBON_CRITSEC)
+      if (MPEnterCriticalRegion(m_cr,kDurationImmediate) != noErr) return false;
+#else
+      if (pthread_mutex_trylock(&m_mutex)) return false;
+#endif
+
+#ifdef _DEBUG
+      _debug_cnt++;
+#endif
+      return true;
+    }
+
     void Leave()
     {
 #ifdef _DEBUG
@@ -27,6 +27,11 @@
 
 #include "denormal.h"
 
+#if !defined(WDL_RESAMPLE_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define WDL_RESAMPLE_SSE2
+#include <emmintrin.h>
+#endif
+
 #ifndef PI
 #define PI 3.1415926535897932384626433832795
 #endif
@@ -91,96 +96,213 @@ private:
 };
 
 
-void inline WDL_Resampler::SincSample(WDL_ResampleSample *outptr, const WDL_ResampleSample *inptr, double fracpos, int nch, const WDL_SincFilterSample *filter, int filtsz)
+// blackman-harris * sinc, at xfrac taps into a filter of 2*hwantsize taps
+static double inline WDL_Resampler_WindowedSinc(double xfrac, double dwindowpos, double dsincpos, int hwantsize)
 {
-  const int oversize=m_lp_oversize;
+  const double windowpos = dwindowpos * xfrac;
+  const double sincpos = dsincpos * (xfrac - hwantsize);
+  return (0.35875 - 0.48829 * cos(windowpos) + 0.14128 * cos(2*windowpos) - 0.01168 * cos(3*windowpos)) * sin(sincpos) / sincpos; 
+}
 
-  fracpos *= oversize;
-  const int ifpos=(int)fracpos;
-  filter += (oversize-ifpos) * filtsz;
-  fracpos -= ifpos;
+/*
+  sinc kernels. the filter phases are stored in WDL_ResampleSample precision (m_filter_phases), so
+  the inner loops need no conversion. the vector type is chosen by sample type: SSE2 where available,
+  otherwise one lane (plain scalar code). channels are accumulated in vector lanes (4/6/8 channels
+  stay in registers), mono accumulates taps in lanes instead.
+*/
 
-  int x;
-  for (x = 0; x < nch; x ++)
+template<class T> struct WDL_Resampler_Vec // scalar fallback
+{
+  typedef T V;
+  enum { W=1 };
+  static V zero() { return 0; }
+  static V set1(T v) { return v; }
+  static V load(const T *p) { return *p; }
+  static V load2(const T *p) { return *p; }
+  static void store(T *p, V v) { *p=v; }
+  static void store2(T *p, V v) { *p=v; }
+  static V add(V a, V b) { return a+b; }
+  static V mul(V a, V b) { return a*b; }
+  static double hsum(V v) { return v; }
+};
+
+#ifdef WDL_RESAMPLE_SSE2
+template<> struct WDL_Resampler_Vec<double>
+{
+  typedef __m128d V;
+  enum { W=2 };
+  static V zero() { return _mm_setzero_pd(); }
+  static V set1(double v) { return _mm_set1_pd(v); }
+  static V load(const double *p) { return _mm_loadu_pd(p); }
+  static V load2(const double *p) { return _mm_loadu_pd(p); }
+  static void store(double *p, V v) { _mm_storeu_pd(p,v); }
+  static void store2(double *p, V v) { _mm_storeu_pd(p,v); }
+  static V add(V a, V b) { return _mm_add_pd(a,b); }
+  static V mul(V a, V b) { return _mm_mul_pd(a,b); }
+  static double hsum(V v) { return _mm_cvtsd_f64(_mm_add_sd(v,_mm_unpackhi_pd(v,v))); }
+};
+
+template<> struct WDL_Resampler_Vec<float>
+{
+  typedef __m128 V;
+  enum { W=4 };
+  static V zero() { return _mm_setzero_ps(); }
+  static V set1(float v) { return _mm_set1_ps(v); }
+  static V load(const float *p) { return _mm_loadu_ps(p); }
+  static V load2(const float *p) { return _mm_castpd_ps(_mm_load_sd((const double *)p)); } // low 2 lanes
+  static void store(float *p, V v) { _mm_storeu_ps(p,v); }
+  static void store2(float *p, V v) { _mm_store_sd((double *)p,_mm_castps_pd(v)); }
+  static V add(V a, V b) { return _mm_add_ps(a,b); }
+  static V mul(V a, V b) { return _mm_mul_ps(a,b); }
+  static double hsum(V v)
   {
-    double sum=0.0,sum2=0.0;
-    const WDL_SincFilterSample *fptr2=filter;
-    const WDL_SincFilterSample *fptr=fptr2 - filtsz;
-    const WDL_ResampleSample *iptr=inptr+x;
-    int i=filtsz/2;
-    while (i--)
-    {
-      sum += fptr[0]*iptr[0]; 
-      sum2 += fptr2[0]*iptr[0]; 
-      sum += fptr[1]*iptr[nch]; 
-      sum2 += fptr2[1]*iptr[nch]; 
-      iptr+=nch*2;
-      fptr+=2;
-      fptr2+=2;
-    }
-    outptr[x]=sum*fracpos + sum2*(1.0-fracpos);
+    v = _mm_add_ps(v,_mm_movehl_ps(v,v));
+    return _mm_cvtss_f32(_mm_add_ss(v,_mm_shuffle_ps(v,v,1)));
   }
+};
+#endif
 
+typedef WDL_Resampler_Vec<WDL_ResampleSample> WDL_Resampler_VecT;
+
+// one channel: sum(in*base) + frac*sum(in*delta), without building the kernel. filtsz is even.
+static double inline WDL_Resampler_SincDot1(const WDL_ResampleSample *in, const WDL_ResampleSample *base, const WDL_ResampleSample *delta, double frac, int filtsz)
+{
+  typedef WDL_Resampler_VecT VT;
+  VT::V s1=VT::zero(), s2=VT::zero(), s1b=VT::zero(), s2b=VT::zero(); // two sets to shorten the dependency chains
+  int i;
+  for (i = 0; i + 2*VT::W <= filtsz; i += 2*VT::W)
+  {
+    const VT::V x=VT::load(in+i), xb=VT::load(in+i+VT::W);
+    s1=VT::add(s1,VT::mul(x,VT::load(base+i)));
+    s2=VT::add(s2,VT::mul(x,VT::load(delta+i)));
+    s1b=VT::add(s1b,VT::mul(xb,VT::load(base+i+VT::W)));
+    s2b=VT::add(s2b,VT::mul(xb,VT::load(delta+i+VT::W)));
+  }
+  for (; i + VT::W <= filtsz; i += VT::W)
+  {
+    const VT::V x=VT::load(in+i);
+    s1=VT::add(s1,VT::mul(x,VT::load(base+i)));
+    s2=VT::add(s2,VT::mul(x,VT::load(delta+i)));
+  }
+  if (VT::W > 2 && i < filtsz)
+  {
+    const VT::V x=VT::load2(in+i);
+    s1=VT::add(s1,VT::mul(x,VT::load2(base+i)));
+    s2=VT::add(s2,VT::mul(x,VT::load2(delta+i)));
+  }
+  return VT::hsum(VT::add(s1,s1b)) + frac*VT::hsum(VT::add(s2,s2b));
 }
 
-void inline WDL_Resampler::SincSample1(WDL_ResampleSample *outptr, const WDL_ResampleSample *inptr, double fracpos, const WDL_SincFilterSample *filter, int filtsz)
+// one channel, single filter
+static double inline WDL_Resampler_SincDot(const WDL_ResampleSample *in, const WDL_ResampleSample *filter, int filtsz)
 {
-  const int oversize=m_lp_oversize;
-  fracpos *= oversize;
-  const int ifpos=(int)fracpos;
-  fracpos -= ifpos;
+  typedef WDL_Resampler_VecT VT;
+  VT::V s1=VT::zero(), s1b=VT::zero();
+  int i;
+  for (i = 0; i + 2*VT::W <= filtsz; i += 2*VT::W)
+  {
+    s1=VT::add(s1,VT::mul(VT::load(in+i),VT::load(filter+i)));
+    s1b=VT::add(s1b,VT::mul(VT::load(in+i+VT::W),VT::load(filter+i+VT::W)));
+  }
+  for (; i + VT::W <= filtsz; i += VT::W)
+    s1=VT::add(s1,VT::mul(VT::load(in+i),VT::load(filter+i)));
+  if (VT::W > 2 && i < filtsz)
+    s1=VT::add(s1,VT::mul(VT::load2(in+i),VT::load2(filter+i)));
+  return VT::hsum(VT::add(s1,s1b));
+}
+
+// kernel = base + frac*delta
+static void inline WDL_Resampler_SincKernel(WDL_ResampleSample *kernel, const WDL_ResampleSample *base, const WDL_ResampleSample *delta, double frac, int filtsz)
+{
+  typedef WDL_Resampler_VecT VT;
+  const VT::V f=VT::set1((WDL_ResampleSample)frac);
+  int i;
+  for (i = 0; i + VT::W <= filtsz; i += VT::W)
+    VT::store(kernel+i,VT::add(VT::load(base+i),VT::mul(f,VT::load(delta+i))));
+  if (VT::W > 2 && i < filtsz)
+    VT::store2(kernel+i,VT::add(VT::load2(base+i),VT::mul(f,VT::load2(delta+i))));
+}
+
+// NCH interleaved channels (of a frame of nch) filtered by kernel. NCH/W full vectors, then a 2 lane and 1 lane remainder.
+// even and odd taps go to separate accumulators, filtsz is even.
+template<int NCH> static void inline WDL_Resampler_SincSum(WDL_ResampleSample *out, const WDL_ResampleSample *in, const WDL_ResampleSample *kernel, int filtsz, int nch)
+{
+  typedef WDL_Resampler_VecT VT;
+  enum { NV = NCH / VT::W, R = NCH % VT::W };
+  VT::V acc[NV > 0 ? NV : 1], accb[NV > 0 ? NV : 1], acc2=VT::zero(), acc2b=VT::zero();
+  double acc1=0.0, acc1b=0.0;
+  int i, v;
+  for (v = 0; v < NV; v ++) acc[v]=accb[v]=VT::zero();
+  for (i = 0; i < filtsz; i += 2)
+  {
+    const WDL_ResampleSample *in2=in+nch;
+    const VT::V k=VT::set1(kernel[i]), kb=VT::set1(kernel[i+1]);
+    for (v = 0; v < NV; v ++)
+    {
+      acc[v]=VT::add(acc[v],VT::mul(k,VT::load(in+v*VT::W)));
+      accb[v]=VT::add(accb[v],VT::mul(kb,VT::load(in2+v*VT::W)));
+    }
+    if (R >= 2)
+    {
+      acc2=VT::add(acc2,VT::mul(k,VT::load2(in+NV*VT::W)));
+      acc2b=VT::add(acc2b,VT::mul(kb,VT::load2(in2+NV*VT::W)));
+    }
+    if (R & 1)
+    {
+      acc1+=kernel[i]*in[NCH-1];
+      acc1b+=kernel[i+1]*in2[NCH-1];
+    }
+    in=in2+nch;
+  }
+  for (v = 0; v < NV; v ++) VT::store(out+v*VT::W,VT::add(acc[v],accb[v]));
+  if (R >= 2) VT::store2(out+NV*VT::W,VT::add(acc2,acc2b));
+  if (R & 1) out[NCH-1]=(WDL_ResampleSample)(acc1+acc1b);
+}
 
-  double sum=0.0,sum2=0.0;
-  const WDL_SincFilterSample *fptr2=filter + (oversize-ifpos) * filtsz;
-  const WDL_SincFilterSample *fptr=fptr2 - filtsz;
-  const WDL_ResampleSample *iptr=inptr;
-  int i=filtsz/2;
-  while (i--)
+// all nch channels filtered by kernel
+static void inline WDL_Resampler_SincApply(WDL_ResampleSample *outptr, const WDL_ResampleSample *inptr, const WDL_ResampleSample *kernel, int filtsz, int nch)
+{
+  switch (nch)
   {
-    sum += fptr[0]*iptr[0]; 
-    sum2 += fptr2[0]*iptr[0];
-    sum += fptr[1]*iptr[1]; 
-    sum2 += fptr2[1]*iptr[1];
-    iptr+=2;
-    fptr+=2;
-    fptr2+=2;
+    case 1: outptr[0] = (WDL_ResampleSample) WDL_Resampler_SincDot(inptr,kernel,filtsz); break;
+    case 2: WDL_Resampler_SincSum<2>(outptr,inptr,kernel,filtsz,2); break;
+    case 4: WDL_Resampler_SincSum<4>(outptr,inptr,kernel,filtsz,4); break;
+    case 6: WDL_Resampler_SincSum<6>(outptr,inptr,kernel,filtsz,6); break;
+    case 8: WDL_Resampler_SincSum<8>(outptr,inptr,kernel,filtsz,8); break;
+    default:
+      {
+        int x=0;
+        for (; x + 8 <= nch; x += 8) WDL_Resampler_SincSum<8>(outptr+x,inptr+x,kernel,filtsz,nch);
+        if (x + 4 <= nch) { WDL_Resampler_SincSum<4>(outptr+x,inptr+x,kernel,filtsz,nch); x += 4; }
+        if (x + 2 <= nch) { WDL_Resampler_SincSum<2>(outptr+x,inptr+x,kernel,filtsz,nch); x += 2; }
+        if (x < nch) WDL_Resampler_SincSum<1>(outptr+x,inptr+x,kernel,filtsz,nch);
+      }
+    break;
   }
-  outptr[0]=sum*fracpos+sum2*(1.0-fracpos);
 }
 
-void inline WDL_Resampler::SincSample2(WDL_ResampleSample *outptr, const WDL_ResampleSample *inptr, double fracpos, const WDL_SincFilterSample *filter, int filtsz)
+void inline WDL_Resampler::SincSample(WDL_ResampleSample *outptr, const WDL_ResampleSample *inptr, double fracpos, int nch, int filtsz)
 {
   const int oversize=m_lp_oversize;
+
   fracpos *= oversize;
-  const int ifpos=(int)fracpos;
+  int ifpos=(int)fracpos;
+  if (ifpos >= oversize) ifpos=oversize-1;
   fracpos -= ifpos;
 
-  const WDL_SincFilterSample *fptr2=filter + (oversize-ifpos) * filtsz;
-  const WDL_SincFilterSample *fptr=fptr2 - filtsz;
+  // blend of phases oversize-ifpos (weight 1-fracpos) and oversize-ifpos-1 (weight fracpos)
+  const WDL_ResampleSample *base = m_filter_phases.Get() + (oversize-1-ifpos) * 2 * filtsz;
+  const WDL_ResampleSample *delta = base + filtsz;
 
-  double sum=0.0;
-  double sum2=0.0;
-  double sumb=0.0;
-  double sum2b=0.0;
-  const WDL_ResampleSample *iptr=inptr;
-  int i=filtsz/2;
-  while (i--)
+  if (nch == 1)
   {
-    sum += fptr[0]*iptr[0];
-    sum2 += fptr[0]*iptr[1];
-    sumb += fptr2[0]*iptr[0];
-    sum2b += fptr2[0]*iptr[1];
-    sum += fptr[1]*iptr[2];
-    sum2 += fptr[1]*iptr[3];
-    sumb += fptr2[1]*iptr[2];
-    sum2b += fptr2[1]*iptr[3];
-    iptr+=4;
-    fptr+=2;
-    fptr2+=2;
+    outptr[0] = (WDL_ResampleSample) WDL_Resampler_SincDot1(inptr,base,delta,fracpos,filtsz);
+    return;
   }
-  outptr[0]=sum*fracpos + sumb*(1.0-fracpos);
-  outptr[1]=sum2*fracpos + sum2b*(1.0-fracpos);
 
+  WDL_ResampleSample *kernel = m_sinc_kernel.Get();
+  WDL_Resampler_SincKernel(kernel,base,delta,fracpos,filtsz);
+  WDL_Resampler_SincApply(outptr,inptr,kernel,filtsz,nch);
 }
 
 
@@ -202,6 +324,9 @@ WDL_Resampler::WDL_Resampler()
   m_srateout=44100.0; 
   m_ratio=1.0; 
   m_filter_ratio=-1.0; 
+  m_rational_filter_ratio=-1.0;
+  m_rational_p=m_rational_q=0;
+  m_rational_size=0;
   m_iirfilter=0;
 
   Reset(); 
@@ -235,6 +360,10 @@ void WDL_Resampler::SetMode(bool interp, int filtercnt, bool sinc, int sinc_size
   if (!m_sincsize) 
   {
     m_filter_coeffs.Resize(0);
+    m_filter_phases.Resize(0);
+    m_sinc_kernel.Resize(0);
+    m_rational_phases.Resize(0);
+    m_rational_size=0;
     m_filter_coeffs_size=0;
   }
   if (!m_filtercnt) 
@@ -253,6 +382,19 @@ void WDL_Resampler::SetRates(double rate_in, double rate_out)
     m_sratein=rate_in; 
     m_srateout=rate_out;  
     m_ratio=m_sratein / m_srateout;
+
+    m_rational_p=m_rational_q=0;
+    if (m_sratein < 2147483647.0 && m_srateout < 2147483647.0 &&
+        m_sratein == (int)m_sratein && m_srateout == (int)m_srateout)
+    {
+      int a=(int)m_sratein, b=(int)m_srateout;
+      while (b) { const int t=a%b; a=b; b=t; }
+      if ((int)m_srateout / a <= WDL_RESAMPLE_MAX_RATIONAL_PHASES)
+      {
+        m_rational_p = (int)m_sratein / a;
+        m_rational_q = (int)m_srateout / a;
+      }
+    }
   }
 }
 
@@ -298,12 +440,7 @@ void WDL_Resampler::BuildLowPass(double filtpos) // only called in sinc modes
           }
           else
           {
-            const double xfrac = frac + x;
-            const double windowpos = dwindowpos * xfrac;
-            const double sincpos = dsincpos * (xfrac - hwantsize);
-
-            // blackman-harris * sinc
-            const double val = (0.35875 - 0.48829 * cos(windowpos) + 0.14128 * cos(2*windowpos) - 0.01168 * cos(3*windowpos)) * sin(sincpos) / sincpos; 
+            const double val = WDL_Resampler_WindowedSinc(frac + x,dwindowpos,dsincpos,hwantsize);
             if (slice<wantinterp) filtpower+=val;        
             *ptrout++ = (WDL_SincFilterSample)val;
           }
@@ -317,12 +454,75 @@ void WDL_Resampler::BuildLowPass(double filtpos) // only called in sinc modes
       {
         cfout[x] = (WDL_SincFilterSample) (cfout[x]*filtpower);
       }
+
+      // phase table for SincSample(): entry p is slice p+1 followed by (slice p - slice p+1)
+      const int phasesize = wantsize*2*wantinterp;
+      WDL_ResampleSample *ph = m_filter_phases.Resize(phasesize);
+      m_sinc_kernel.Resize(wantsize);
+      if (m_filter_phases.GetSize() == phasesize && m_sinc_kernel.GetSize() == wantsize)
+      {
+        for (slice = 0; slice < wantinterp; slice ++)
+        {
+          const WDL_SincFilterSample *s0 = cfout + slice*wantsize, *s1 = s0 + wantsize;
+          for (x = 0; x < wantsize; x ++)
+          {
+            ph[x] = (WDL_ResampleSample) s1[x];
+            ph[x+wantsize] = (WDL_ResampleSample) ((double)s0[x] - (double)s1[x]);
+          }
+          ph += wantsize*2;
+        }
+      }
+      else m_filter_coeffs_size=0;
     }
     else m_filter_coeffs_size=0;
 
   }
 }
 
+bool WDL_Resampler::BuildRationalPhases(double filtpos) // only called in sinc modes with m_rational_q>0
+{
+  const int wantsize=m_sincsize, nphases=m_rational_q;
+
+  if (m_rational_filter_ratio!=filtpos ||
+      m_rational_size != wantsize ||
+      m_rational_phases.GetSize() != wantsize*nphases)
+  {
+    const int allocsize = wantsize*nphases;
+    WDL_ResampleSample *out = m_rational_phases.Resize(allocsize);
+    if (m_rational_phases.GetSize()!=allocsize)
+    {
+      m_rational_size=0;
+      return false;
+    }
+    m_rational_size=wantsize;
+    m_rational_filter_ratio=filtpos;
+
+    const double dwindowpos = 2.0 * PI/(double)wantsize;
+    const double dsincpos  = PI * filtpos;
+    const int hwantsize=wantsize/2;
+
+    // phase k is input position n+k/nphases, which is slice 1-k/nphases of BuildLowPass(). each phase is normalized to unity gain
+    int k;
+    for (k = 0; k < nphases; k ++)
+    {
+      const double frac = 1.0 - k / (double)nphases;
+      double filtpower=0.0;
+      int x;
+      for (x = 0; x < wantsize; x ++)
+      {
+        const double xfrac = frac + x;
+        const double val = xfrac == hwantsize ? 1.0 : WDL_Resampler_WindowedSinc(xfrac,dwindowpos,dsincpos,hwantsize);
+        filtpower += val;
+        out[x] = (WDL_ResampleSample) val;
+      }
+      filtpower = filtpower != 0.0 ? 1.0/filtpower : 1.0;
+      for (x = 0; x < wantsize; x ++) out[x] = (WDL_ResampleSample) (out[x]*filtpower);
+      out += wantsize;
+    }
+  }
+  return true;
+}
+
 double WDL_Resampler::GetCurrentLatency() 
 { 
   double v=((double)m_samples_in_rsinbuf-m_filtlatency)/m_sratein;
@@ -433,57 +633,50 @@ int WDL_Resampler::ResampleOut(WDL_ResampleSample *out, int nsamples_in, int nsa
 
   int outlatadj=0;
 
-  if (m_sincsize) // sinc interpolating
+  if (m_sincsize && m_rational_q > 0 && BuildRationalPhases(m_ratio > 1.0 ? 1.0 / (m_ratio*1.03) : 1.0)) // sinc, exact phases
   {
-    if (m_ratio > 1.0) BuildLowPass(1.0 / (m_ratio*1.03));
-    else BuildLowPass(1.0);
-
-    int filtsz=m_filter_coeffs_size;
+    const int filtsz=m_sincsize, nphases=m_rational_q;
+    const int iadv = m_rational_p / nphases, padv = m_rational_p % nphases;
+    const WDL_ResampleSample *phases = m_rational_phases.Get();
     int filtlen = rsinbuf_availtemp - filtsz;
     outlatadj=filtsz/2-1;
-    WDL_SincFilterSample *filter=m_filter_coeffs.Get();   
-
-    if (nch == 1)
-    {
-      while (ns--)
-      {
-        int ipos = (int)srcpos;
 
-        if (ipos >= filtlen-1)  break; // quit decoding, not enough input samples
+    // m_fracpos is k/nphases after a rational block, rounding only applies when switching from the interpolated mode
+    int ipos = 0, phase = (int) (srcpos * nphases + 0.5);
+    if (phase >= nphases) { phase -= nphases; ipos++; }
 
-        SincSample1(outptr,localin + ipos,srcpos-ipos,filter,filtsz);
-        outptr ++;
-        srcpos+=drspos;
-        ret++;
-      }
-    }
-    else if (nch==2)
+    while (ns--)
     {
-      while (ns--)
-      {
-        int ipos = (int)srcpos;
+      if (ipos >= filtlen-1)  break; // quit decoding, not enough input samples
+
+      WDL_Resampler_SincApply(outptr,localin + ipos*nch,phases + phase*filtsz,filtsz,nch);
+      outptr += nch;
+      ipos += iadv;
+      phase += padv;
+      if (phase >= nphases) { phase -= nphases; ipos++; }
+      ret++;
+    }
+    srcpos = ipos + phase / (double)nphases;
+  }
+  else if (m_sincsize) // sinc interpolating
+  {
+    if (m_ratio > 1.0) BuildLowPass(1.0 / (m_ratio*1.03));
+    else BuildLowPass(1.0);
 
-        if (ipos >= filtlen-1)  break; // quit decoding, not enough input samples
+    int filtsz=m_filter_coeffs_size;
+    int filtlen = rsinbuf_availtemp - filtsz;
+    outlatadj=filtsz/2-1;
 
-        SincSample2(outptr,localin + ipos*2,srcpos-ipos,filter,filtsz);
-        outptr+=2;
-        srcpos+=drspos;
-        ret++;
-      }
-    }
-    else
+    if (filtsz) while (ns--)
     {
-      while (ns--)
-      {
-        int ipos = (int)srcpos;
+      int ipos = (int)srcpos;
 
-        if (ipos >= filtlen-1)  break; // quit decoding, not enough input samples
+      if (ipos >= filtlen-1)  break; // quit decoding, not enough input samples
 
-        SincSample(outptr,localin + ipos*nch,srcpos-ipos,nch,filter,filtsz);
-        outptr += nch;
-        srcpos+=drspos;
-        ret++;
-      }
+      SincSample(outptr,localin + ipos*nch,srcpos-ipos,nch,filtsz);
+      outptr += nch;
+      srcpos+=drspos;
+      ret++;
     }
   }
   else if (!m_interp) // point sampling
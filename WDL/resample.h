@@ -53,6 +53,11 @@ typedef double WDL_ResampleSample;
 #define WDL_RESAMPLE_MAX_NCH 64
 #endif
 
+// sinc modes use exact filter phases when rate_out/gcd(rate_in,rate_out) is at most this (0 disables)
+#ifndef WDL_RESAMPLE_MAX_RATIONAL_PHASES
+#define WDL_RESAMPLE_MAX_RATIONAL_PHASES 512
+#endif
+
 
 class WDL_Resampler
 {
@@ -66,7 +71,8 @@ public:
   void SetFeedMode(bool wantInputDriven) { m_feedmode=wantInputDriven; } // if true, that means the first parameter to ResamplePrepare will specify however much input you have, not how much you want
 
   void Reset(double fracpos=0.0);
-  void SetRates(double rate_in, double rate_out);
+  void SetRates(double rate_in, double rate_out); // integer rates with a small ratio denominator (44.1k<->48k, 2x, 4x) select the rational mode
+  int GetRationalPhases() const { return m_rational_q; } // number of filter phases in the rational mode, 0 if not in use
 
   double GetCurrentLatency(); // amount of input that has been received but not yet converted to output, in seconds
 
@@ -85,9 +91,8 @@ public:
 
 private:
   void BuildLowPass(double filtpos);
-  void inline SincSample(WDL_ResampleSample *outptr, const WDL_ResampleSample *inptr, double fracpos, int nch, const WDL_SincFilterSample *filter, int filtsz);
-  void inline SincSample1(WDL_ResampleSample *outptr, const WDL_ResampleSample *inptr, double fracpos, const WDL_SincFilterSample *filter, int filtsz);
-  void inline SincSample2(WDL_ResampleSample *outptr, const WDL_ResampleSample *inptr, double fracpos, const WDL_SincFilterSample *filter, int filtsz);
+  bool BuildRationalPhases(double filtpos);
+  void inline SincSample(WDL_ResampleSample *outptr, const WDL_ResampleSample *inptr, double fracpos, int nch, int filtsz);
 
   double m_sratein WDL_FIXALIGN;
   double m_srateout;
@@ -97,6 +102,10 @@ private:
   float m_filterq, m_filterpos;
   WDL_TypedBuf<WDL_ResampleSample> m_rsinbuf;
   WDL_TypedBuf<WDL_SincFilterSample> m_filter_coeffs;
+  WDL_TypedBuf<WDL_ResampleSample> m_filter_phases; // per phase: coefficients, then the delta to the next phase
+  WDL_TypedBuf<WDL_ResampleSample> m_sinc_kernel; // phase interpolated filter for the current output sample
+  WDL_TypedBuf<WDL_ResampleSample> m_rational_phases; // filter for input position n+k/m_rational_q at k*m_sincsize
+  double m_rational_filter_ratio;
 
   class WDL_Resampler_IIRFilter;
   WDL_Resampler_IIRFilter *m_iirfilter;
@@ -108,6 +117,8 @@ private:
   int m_lp_oversize;
 
   int m_sincsize;
+  int m_rational_p, m_rational_q; // m_ratio is exactly p/q if q>0
+  int m_rational_size; // m_sincsize that m_rational_phases was built for
   int m_filtercnt;
   int m_sincoversize;
   bool m_interp;
@@ -5,11 +5,15 @@
 
 static int wdl_atomic_incr(int *v) { return (int) InterlockedIncrement((LONG *)v); }
 static int wdl_atomic_decr(int *v) { return (int) InterlockedDecrement((LONG *)v); }
+static inline int wdl_atomic_get(int *v) { return (int) InterlockedExchangeAdd((LONG *)v,0); } // full barrier
+static inline int wdl_atomic_add(int *v, int n) { return (int) InterlockedExchangeAdd((LONG *)v,n) + n; }
 
 #elif !defined(__ppc__) && (defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 2))))
 
 static int wdl_atomic_incr(int *v) { return __sync_add_and_fetch(v,1); }
 static int wdl_atomic_decr(int *v) { return __sync_add_and_fetch(v,~0); }
+static inline int wdl_atomic_get(int *v) { return __sync_add_and_fetch(v,0); } // full barrier
+static inline int wdl_atomic_add(int *v, int n) { return __sync_add_and_fetch(v,n); }
 
 #elif defined(__APPLE__)
 // used by GCC < 4.2 on OSX
@@ -17,6 +21,8 @@ static int wdl_atomic_decr(int *v) { return __sync_add_and_fetch(v,~0); }
 
 static int wdl_atomic_incr(int *v) { return (int) OSAtomicIncrement32Barrier((int32_t*)v); }
 static int wdl_atomic_decr(int *v) { return (int) OSAtomicDecrement32Barrier((int32_t*)v); }
+static inline int wdl_atomic_get(int *v) { return (int) OSAtomicAdd32Barrier(0,(int32_t*)v); } // full barrier
+static inline int wdl_atomic_add(int *v, int n) { return (int) OSAtomicAdd32Barrier(n,(int32_t*)v); }
 #else
 
 // unsupported! 